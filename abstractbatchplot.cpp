@@ -2,15 +2,20 @@
 
 #include <QFileDialog>
 #include <QMessageBox>
+#include <algorithm>
 
 #include <qwt6/qwt_plot_renderer.h>
 #include <qwt6/qwt_legend_label.h>
 #include <qwt6/qwt_legend.h>
 #include <qwt6/qwt_picker_machine.h>
 #include <qwt6/qwt_symbol.h>
+#include <qwt6/qwt_graphic.h>
+
+#include "batchprintjob.h"
 
 AbstractBatchPlot::AbstractBatchPlot(QString name, QWidget *parent) :
-    ZoomPanPlot(name,parent), d_zoneScanNum(0), d_showZonePending(false), d_recalcZoneOnResize(false), d_doNotReplot(false), d_hideBadZones(false), d_hidePlotLabels(false)
+    ZoomPanPlot(name,parent), d_zoneScanNum(0), d_showZonePending(false), d_recalcZoneOnResize(false), d_doNotReplot(false), d_hideBadZones(false), d_hidePlotLabels(false),
+    d_maxMarkerWidth(0), d_markerHeight(qMakePair(0,0)), d_markersSorted(true)
 {
     QFont labelFont(QString("sans serif"),8);
     setAxisFont(QwtPlot::xBottom,labelFont);
@@ -329,69 +334,36 @@ void AbstractBatchPlot::filterData()
         return;
 
     if(!d_plotMarkers.isEmpty() && !d_hidePlotLabels)
-    {
-	   //loop over labels, seeing if the next will overlap
-	   int activeIndex = 0;
-
-	   QFontMetrics fm(d_plotMarkers.at(0)->label().font());
-	   double min = axisScaleDiv(QwtPlot::xBottom).lowerBound();
-	   double max = axisScaleDiv(QwtPlot::xBottom).upperBound();
-
-
-	   for(int i=0; i<d_plotMarkers.size(); i++)
-	   {
-		  auto thisRange = calculateMarkerBoundaries(fm,i);
-		  if(thisRange.first < min)
-			 d_plotMarkers[i]->setVisible(false);
-		  else
-		  {
-			 activeIndex = i;
-			 d_plotMarkers[i]->setVisible(true);
-			 break;
-		  }
-	   }
-
-	   auto activeRange = calculateMarkerBoundaries(fm,activeIndex);
-	   for(int i=activeIndex+1; i<d_plotMarkers.size(); i++)
-	   {
-		  //calculate right edge of active marker, and left edge of current marker
-		  //get widest text line
-		  auto thisRange = calculateMarkerBoundaries(fm,i);
-
-		  //hide this label if it overlaps with the active label
-		  if(thisRange.first < activeRange.second || thisRange.second > max)
-			 d_plotMarkers[i]->setVisible(false);
-		  else //otherwise, it is visible, and will be the reference for the next iteration of the loop
-		  {
-			 activeRange = thisRange;
-			 d_plotMarkers[i]->setVisible(true);
-			 activeIndex = i;
-		  }
-
-	   }
-
-    }
+        layoutMarkers();
 
+    while(d_curvePyramids.size() < d_plotCurveData.size())
+        d_curvePyramids.append(MinMaxPyramid());
 
+    QwtScaleMap map = canvasMap(QwtPlot::xBottom);
     for(int i=0; i<d_plotCurveData.size(); i++)
     {
+        //the pyramid is only extended with the points added since the last replot
+        MinMaxPyramid &p = d_curvePyramids[i];
+        if(i == 0 && !d_curveStore.isNull())
+            p.setStore(d_curveStore);
+        else
+            p.setData(d_plotCurveData.at(i));
 
-        QVector<QPointF> d = d_plotCurveData.at(i);
-        if(d.isEmpty())
+        int size = p.size();
+        if(size == 0)
             continue;
 
-        if(d.size() < 2*canvas()->width())
+        if(size < 2*canvas()->width() || !p.isMonotonic())
         {
-            d_plotCurves[i]->setSamples(d);
+            d_plotCurves[i]->setSamples(p.points(0,size));
             continue;
         }
 
         int firstPixel = 0;
         int lastPixel = canvas()->width();
         int pixelIncr = 1;
-        QwtScaleMap map = canvasMap(QwtPlot::xBottom);
 
-        if(d.last().x() < d.first().x())
+        if(!p.isAscending())
         {
             qSwap(firstPixel,lastPixel);
             pixelIncr = -1;
@@ -401,72 +373,34 @@ void AbstractBatchPlot::filterData()
         filtered.reserve(2*canvas()->width() + 2);
 
         //find first data point that is in the range of the plot
-        int dataIndex = 0;
-        while(dataIndex+1 < d.size())
-        {
-            if(pixelIncr > 0)
-            {
-                if(map.transform(d.at(dataIndex).x()) > static_cast<double>(firstPixel))
-                    break;
-            }
-            else if(map.transform(d.at(dataIndex).x()) < static_cast<double>(firstPixel))
-                break;
-
-            dataIndex++;
-        }
+        int dataIndex = p.countBefore(map.invTransform(static_cast<double>(firstPixel)));
 
         //add previous point to filtered array
         //this ensures curve goes to edge of plot
         if(dataIndex - 1 >= 0)
-            filtered.append(d.at(dataIndex-1));
+            filtered.append(p.point(dataIndex-1));
 
         //dataIndex is the first point in range of the plot. loop over pixels, compressing data
-        for(int p = firstPixel; p != lastPixel; p+=pixelIncr)
+        //each pixel contains the points up to the edge of the next pixel, found by binary search; the pyramid gives their range
+        for(int px = firstPixel; px != lastPixel && dataIndex < size; px+=pixelIncr)
         {
-            double pixel = static_cast<double>(p);
-            double min = d.at(dataIndex).y();
-            double max = min;
-            int numPnts = 0;
-            int minIndex = dataIndex;
-            int maxIndex = dataIndex;
-
-            while(dataIndex+1 < d.size())
-            {
-                if(pixelIncr > 0)
-                {
-                    if(map.transform(d.at(dataIndex).x()) > pixel+1.0)
-                        break;
-                }
-                else if(map.transform(d.at(dataIndex).x()) < pixel-1.0)
-                    break;
-
-                if(d.at(dataIndex).y() < min)
-                {
-                    min = d.at(dataIndex).y();
-                    minIndex = dataIndex;
-                }
-                if(d.at(dataIndex).y() > max)
-                {
-                    max = d.at(dataIndex).y();
-                    maxIndex = dataIndex;
-                }
-                dataIndex++;
-                numPnts++;
-            }
+            double pixel = static_cast<double>(px);
+            int end = qMax(dataIndex,p.countBefore(map.invTransform(pixel+static_cast<double>(pixelIncr))));
+            int numPnts = end - dataIndex;
 
             if(numPnts == 1)
-                filtered.append(d.at(dataIndex-1));
+                filtered.append(p.point(dataIndex));
             else if(numPnts > 1)
             {
-                QPointF first(map.invTransform(pixel),d.at(minIndex).y());
-                QPointF second(map.invTransform(pixel),d.at(maxIndex).y());
-                filtered.append(first);
-                filtered.append(second);
+                MinMaxPyramid::Range r = p.range(dataIndex,end);
+                filtered.append(QPointF(map.invTransform(pixel),r.min));
+                filtered.append(QPointF(map.invTransform(pixel),r.max));
             }
+            dataIndex = end;
         }
 
-        if(dataIndex < d.size())
-            filtered.append(d.at(dataIndex));
+        if(dataIndex < size)
+            filtered.append(p.point(dataIndex));
 
         d_plotCurves[i]->setSamples(filtered);
     }
@@ -509,17 +443,27 @@ void AbstractBatchPlot::exportXY()
             t << tab << QString("y%1%2").arg(i).arg(labelBase);
     }
 
-    for(int i=0; i<d_plotCurveData.at(0).size(); i++)
+    //a curve kept in a store is read in blocks, so that it is never all in memory
+    int size = d_curveStore.isNull() ? d_plotCurveData.at(0).size() : d_curveStore->size();
+    const int blockSize = 65536;
+    for(int first=0; first<size; first+=blockSize)
     {
-        t << nl << d_plotCurveData.at(0).at(i).x();
-        for(int j=0; j<d_plotCurveData.size(); j++)
+        QVector<QPointF> block = d_curveStore.isNull() ? d_plotCurveData.at(0).mid(first,blockSize) : d_curveStore->read(first,blockSize);
+        for(int k=0; k<block.size(); k++)
         {
-            if(d_plotCurveMetaData.at(j).visible)
+            int i = first + k;
+            t << nl << block.at(k).x();
+            for(int j=0; j<d_plotCurveData.size(); j++)
             {
-                if(i < d_plotCurveData.at(j).size())
-                    t << tab << d_plotCurveData.at(j).at(i).y();
-                else
-                    t << tab << 0.0;
+                if(d_plotCurveMetaData.at(j).visible)
+                {
+                    if(j == 0)
+                        t << tab << block.at(k).y();
+                    else if(i < d_plotCurveData.at(j).size())
+                        t << tab << d_plotCurveData.at(j).at(i).y();
+                    else
+                        t << tab << 0.0;
+                }
             }
         }
     }
@@ -666,6 +610,7 @@ void AbstractBatchPlot::replot()
     {
 	    if(!d_plotMarkers.isEmpty())
 	    {
+		    updateMarkerExtents();
 		    if(d_hidePlotLabels)
 		    {
 			    //get max height for left and right axes
@@ -732,42 +677,115 @@ double AbstractBatchPlot::calculateAxisMaxWithLabel(QwtPlot::Axis axis) const
 	if(d_plotMarkers.isEmpty())
 		return yRange.second;
 
-	int height = 0;
-	QFontMetrics fm(d_plotMarkers.at(0)->label().font());
-	for(int i=0;i<d_plotMarkers.size();i++)
-	{
-		if((axis == QwtPlot::yLeft && !d_metaDataList.at(i).isCal) ||
-				(axis == QwtPlot::yRight && d_metaDataList.at(i).isCal))
-		{
-			QString text = d_plotMarkers.at(i)->label().text();
-			int numLines = text.split(QString("\n"),QString::SkipEmptyParts).size();
-			height = qMax(height,fm.boundingRect(text).height()*numLines);
-		}
-	}
+	//label heights are kept up to date by updateMarkerExtents()
+	int height = axis == QwtPlot::yLeft ? d_markerHeight.first : d_markerHeight.second;
 
 	double scaling = (yRange.second - yRange.first)/(double)canvas()->height();
 	return static_cast<double>(height+20)*scaling + yRange.second;
 
 }
 
-QPair<double, double> AbstractBatchPlot::calculateMarkerBoundaries(QFontMetrics fm, int index)
+QPair<double, double> AbstractBatchPlot::calculateMarkerBoundaries(int index, double scaling) const
 {
-    if(index < 0 || index >= d_plotMarkers.size())
+    if(index < 0 || index >= d_markerExtents.size())
 	   return qMakePair(-1.0,-1.0);
 
-    double scaleMin = axisScaleDiv(QwtPlot::xBottom).lowerBound();
-    double scaleMax = axisScaleDiv(QwtPlot::xBottom).upperBound();
-    double scaling = (scaleMax-scaleMin)/static_cast<double>(canvas()->width());
+    double halfWidth = static_cast<double>(d_markerExtents.at(index).width())*scaling/2.0;
+    double x = static_cast<double>(d_metaDataList.at(index).scanNum);
 
-    QStringList lines = d_plotMarkers.at(index)->label().text().split(QString("\n"),QString::SkipEmptyParts);
-    int w = 0;
-    for(int j=0; j<lines.size(); j++)
-	   w = qMax(w,fm.boundingRect(lines.at(j)).width())+5;
+    return qMakePair(x - halfWidth,x + halfWidth);
+}
 
-    double min = (double)d_metaDataList.at(index).scanNum - (double)w*scaling/2.0;
-    double max = (double)d_metaDataList.at(index).scanNum + (double)w*scaling/2.0;
+void AbstractBatchPlot::updateMarkerExtents()
+{
+    if(d_plotMarkers.isEmpty())
+    {
+	   d_markerExtents.clear();
+	   d_visibleMarkers.clear();
+	   return;
+    }
 
-    return qMakePair(min,max);
+    //label sizes only depend on the text and the font, so they are measured once
+    QFont f = d_plotMarkers.at(0)->label().font();
+    if(f != d_markerFont || d_markerExtents.size() > d_plotMarkers.size())
+    {
+	   d_markerFont = f;
+	   d_markerExtents.clear();
+	   d_maxMarkerWidth = 0;
+	   d_markerHeight = qMakePair(0,0);
+	   d_markersSorted = true;
+    }
+
+    QFontMetrics fm(d_markerFont);
+    d_markerExtents.reserve(d_plotMarkers.size());
+    for(int i=d_markerExtents.size(); i<d_plotMarkers.size(); i++)
+    {
+	   QString text = d_plotMarkers.at(i)->label().text();
+	   QStringList lines = text.split(QString("\n"),QString::SkipEmptyParts);
+	   int w = 0;
+	   for(int j=0; j<lines.size(); j++)
+		  w = qMax(w,fm.boundingRect(lines.at(j)).width())+5;
+	   int h = fm.boundingRect(text).height()*lines.size();
+
+	   d_markerExtents.append(QSize(w,h));
+	   d_maxMarkerWidth = qMax(d_maxMarkerWidth,w);
+	   if(d_metaDataList.at(i).isCal)
+		  d_markerHeight.second = qMax(d_markerHeight.second,h);
+	   else
+		  d_markerHeight.first = qMax(d_markerHeight.first,h);
+
+	   if(i > 0 && d_metaDataList.at(i).scanNum < d_metaDataList.at(i-1).scanNum)
+		  d_markersSorted = false;
+    }
+}
+
+void AbstractBatchPlot::layoutMarkers()
+{
+    updateMarkerExtents();
+
+    double min = axisScaleDiv(QwtPlot::xBottom).lowerBound();
+    double max = axisScaleDiv(QwtPlot::xBottom).upperBound();
+    double scaling = (max-min)/static_cast<double>(canvas()->width());
+
+    //markers are normally in scan number order, so only the ones whose labels can reach the visible range are examined
+    int first = 0, last = d_plotMarkers.size();
+    if(d_markersSorted)
+    {
+	   double reach = static_cast<double>(d_maxMarkerWidth)*scaling/2.0;
+	   auto lessThan = [](const QtFTM::BatchPlotMetaData &md, double x){ return static_cast<double>(md.scanNum) < x; };
+	   first = std::lower_bound(d_metaDataList.constBegin(),d_metaDataList.constBegin()+last,min-reach,lessThan) - d_metaDataList.constBegin();
+	   last = std::lower_bound(d_metaDataList.constBegin()+first,d_metaDataList.constBegin()+last,max+reach,lessThan) - d_metaDataList.constBegin();
+    }
+
+    //the first label that starts inside the plot is shown; after that, each label is shown if it does not overlap the last one shown
+    QVector<int> visible;
+    QPair<double,double> activeRange;
+    for(int i=first; i<last; i++)
+    {
+	   auto thisRange = calculateMarkerBoundaries(i,scaling);
+	   bool show = false;
+	   if(visible.isEmpty())
+		  show = thisRange.first >= min;
+	   else
+		  show = thisRange.first >= activeRange.second && thisRange.second <= max;
+
+	   d_plotMarkers[i]->setVisible(show);
+	   if(show)
+	   {
+		  activeRange = thisRange;
+		  visible.append(i);
+	   }
+    }
+
+    //labels that were shown before, but are now outside the examined range
+    for(int i=0; i<d_visibleMarkers.size(); i++)
+    {
+	   int index = d_visibleMarkers.at(i);
+	   if((index < first || index >= last) && index < d_plotMarkers.size())
+		  d_plotMarkers[index]->setVisible(false);
+    }
+
+    d_visibleMarkers = visible;
 }
 
 void AbstractBatchPlot::doPrint(double start, double end, double xRange, int plotsPerPage, QString title, QPrinter *pr, bool oneCurvePerPlot, bool autoYRanges)
@@ -863,23 +881,27 @@ void AbstractBatchPlot::doPrint(double start, double end, double xRange, int plo
     int curveIndex = 0, curveCount = 0;
     QwtLegend *leg = static_cast<QwtLegend*>(legend());
 
-    QPainter p;
-    p.begin(pr);
+    //each page is recorded here, and written to the printer by the job on its own thread
+    BatchPrintJob job(pr,numPages,this);
+    bool replotWasDisabled = d_doNotReplot;
+    d_doNotReplot = true;
 
     //all preparation is complete, enter render loop
     for(int page = 0; page<numPages; page++)
     {
-        if(page>0)
-            pr->newPage();
+        QwtGraphic *pageGraphic = new QwtGraphic();
+        pageGraphic->setDefaultSize(job.pageSize());
+        QPainter p(pageGraphic);
 
         //set page number in title
         pageLabel.setText(QString("Page %1/%2").arg(page+1).arg(numPages));
-        p.scale(scale,scale);
+        //the title bar is laid out at screen resolution, which is close to the resolution of the recorded page
+        p.scale(scale/job.scale(),scale/job.scale());
 
         //render title bar
         df.render(&p,QPoint(),QRegion(),DrawChildren);
 
-        p.scale(1.0/scale,1.0/scale);
+        p.resetTransform();
 
 
         if(!oneCurvePerPlot)
@@ -908,7 +930,7 @@ void AbstractBatchPlot::doPrint(double start, double end, double xRange, int plo
                 }
                 if(replotAgain)
                     QwtPlot::replot();
-                rend.render(this,&p,graphRects.at(rect));
+                rend.render(this,&p,job.toPage(graphRects.at(rect)));
 
                 if(xMax >= end)
                     break;
@@ -960,7 +982,7 @@ void AbstractBatchPlot::doPrint(double start, double end, double xRange, int plo
                 if(replotAgain)
                     QwtPlot::replot();
 
-                rend.render(this,&p,graphRects.at(rect));
+                rend.render(this,&p,job.toPage(graphRects.at(rect)));
 
                 //break out of the plotting loop if we're done
                 if(xMax >= end && curveIndex==d_plotCurves.size())
@@ -973,9 +995,14 @@ void AbstractBatchPlot::doPrint(double start, double end, double xRange, int plo
 
             }
         }
+
+        p.end();
+        if(!job.addPage(pageGraphic))
+            break;
     }
 
-    p.end();
+    job.finish();
+    d_doNotReplot = replotWasDisabled;
 
     if(oneCurvePerPlot)
     {
@@ -30,6 +30,8 @@
 #include <QPushButton>
 
 #include "datastructs.h"
+#include "minmaxpyramid.h"
+#include "rastercurve.h"
 
 class QPrinter;
 
@@ -80,6 +82,8 @@ public slots:
 protected:
     QList<QwtPlotCurve*> d_plotCurves;
     QList<QVector<QPointF>> d_plotCurveData;
+    QList<MinMaxPyramid> d_curvePyramids; /*!< Decimation index for each curve in d_plotCurveData, updated by filterData() */
+    QSharedPointer<SpectrumStore> d_curveStore; /*!< If set, holds the data of the first curve, and d_plotCurveData.at(0) is not used (see SurveyPlot) */
     QwtPlotCurve *p_calCurve;
     QVector<QPointF> d_calCurveData;
     QwtPlotZoneItem *p_selectedZone;
@@ -95,12 +99,21 @@ protected:
     bool d_hideBadZones;
     bool d_hidePlotLabels;
 
+    QVector<QSize> d_markerExtents; /*!< Pixel size of each label in d_plotMarkers, measured with d_markerFont by updateMarkerExtents() */
+    QFont d_markerFont;
+    int d_maxMarkerWidth;
+    QPair<int,int> d_markerHeight; /*!< Tallest survey (first) and calibration (second) label */
+    bool d_markersSorted; /*!< Whether the markers are in increasing scan number order, so the visible ones can be found by binary search */
+    QVector<int> d_visibleMarkers; /*!< Markers shown by the last call to layoutMarkers() */
+
     void addBadZone(QtFTM::BatchPlotMetaData md);
     virtual QMenu *contextMenu();
     virtual bool eventFilter(QObject *obj, QEvent *ev);
     virtual void replot();
     double calculateAxisMaxWithLabel(Axis axis) const;
-    QPair<double,double> calculateMarkerBoundaries(QFontMetrics fm, int index);
+    QPair<double,double> calculateMarkerBoundaries(int index, double scaling) const;
+    void updateMarkerExtents();
+    void layoutMarkers();
 
     void doPrint(double start, double end, double xRange, int plotsPerPage, QString title, QPrinter *pr, bool oneCurvePerPlot = false, bool autoYRanges = false);
 
@@ -24,6 +24,11 @@ QPair<QVector<QPointF>, double> AbstractFitter::doStandardFT(const Fid fid)
     return ftw.doFT(fid);
 }
 
+QList<QVector<QPointF>> AbstractFitter::doBandFT(const Fid fid, const QList<QPair<double,double>> bands)
+{
+    return ftw.doBandFT(fid,bands);
+}
+
 void AbstractFitter::setUseWindow(bool b)
 {
     ftw.setUseWindow(b);
@@ -115,6 +120,45 @@ QList<QPair<QPointF,double>> AbstractFitter::findPeaks(QVector<QPointF> ft, doub
     return out;
 }
 
+QList<QPair<QPointF,double>> AbstractFitter::refinePeaks(const Fid fid, QList<QPair<QPointF,double>> peaks, double halfWidth)
+{
+    if(halfWidth <= 0.0)
+        return peaks;
+
+    //33 points put the grid at 1/16 of the half-width; the parabola does the rest
+    const int points = 33;
+    for(int i=0; i<peaks.size(); i++)
+    {
+        double x = peaks.at(i).first.x();
+        QVector<QPointF> zoom = ftw.doZoomFT(fid,x-halfWidth,x+halfWidth,points,true);
+        if(zoom.size() != points)
+            continue;
+
+        int maxIndex = 0;
+        for(int j=1; j<zoom.size(); j++)
+        {
+            if(zoom.at(j).y() > zoom.at(maxIndex).y())
+                maxIndex = j;
+        }
+
+        if(maxIndex == 0 || maxIndex == zoom.size()-1)
+            continue;
+
+        double y1 = zoom.at(maxIndex-1).y();
+        double y2 = zoom.at(maxIndex).y();
+        double y3 = zoom.at(maxIndex+1).y();
+        double denom = y1 - 2.0*y2 + y3;
+        double shift = 0.0;
+        if(fabs(denom) > 0.0)
+            shift = 0.5*(y1 - y3)/denom;
+
+        double step = zoom.at(1).x() - zoom.at(0).x();
+        peaks[i].first.setX(zoom.at(maxIndex).x() + qBound(-0.5,shift,0.5)*step);
+    }
+
+    return peaks;
+}
+
 FitResult AbstractFitter::dopplerFit(const QVector<QPointF> ft, const FitResult &in, const QList<double> commonParams, const QList<FitResult::DopplerPairParameters> dpParams, const QList<QPointF> singleParams, const int maxIterations, double noisey0, double noisem)
 {
     //copy existing info into output
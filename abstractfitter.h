@@ -21,6 +21,7 @@ public:
 
     FitResult::FitterType type() const { return d_type; }
     QPair<QVector<QPointF>, double> doStandardFT(const Fid fid);
+    QList<QVector<QPointF>> doBandFT(const Fid fid, const QList<QPair<double,double>> bands);
 
     void setDelay(double d) { ftw.setDelay(d); }
     void setHpf(double d) { ftw.setHpf(d); }
@@ -62,6 +63,18 @@ protected:
 
     virtual void calcCoefs(int winSize, int polyOrder);
     virtual QList<QPair<QPointF, double> > findPeaks(QVector<QPointF> ft, double noisey0, double noisem);
+    /*!
+     \brief Refines the positions of peaks found on a coarse FT grid with a zoom transform (FtWorker::doZoomFT())
+
+     Each peak is moved to the maximum of a finely sampled FT within halfWidth of its position, interpolated with a parabola.
+     Peaks whose maximum is at the edge of the window are not moved.
+
+     \param fid Fid the peaks were found in
+     \param peaks Peaks, with x as an offset from the probe frequency (MHz)
+     \param halfWidth Half-width of the window around each peak (MHz)
+     \return The peaks with refined x values
+    */
+    QList<QPair<QPointF, double> > refinePeaks(const Fid fid, QList<QPair<QPointF, double> > peaks, double halfWidth);
     virtual FitResult dopplerFit(const QVector<QPointF> ft, const FitResult &in, const QList<double> commonParams, const QList<FitResult::DopplerPairParameters> dpParams, const QList<QPointF> singleParams, const int maxIterations, double noisey0, double noisem);
     virtual FitResult fitLine(const FitResult &in, QVector<QPointF> data, double probeFreq, double noisey0, double noisem);
     double estimateLinewidth(const FitResult::BufferGas &bg, double probeFreq, double stagT);
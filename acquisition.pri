@@ -7,7 +7,10 @@ SOURCES += batchmanager.cpp \
     batchattenuation.cpp \
     $$PWD/drcorrelation.cpp \
     $$PWD/batchcategorize.cpp \
-    $$PWD/amdorbatch.cpp
+    $$PWD/amdorbatch.cpp \
+    $$PWD/scanwriter.cpp \
+    $$PWD/batchreportwriter.cpp \
+    $$PWD/batchcheckpoint.cpp
 
 HEADERS += batchmanager.h \
     batchsingle.h \
@@ -18,4 +21,7 @@ HEADERS += batchmanager.h \
     batchattenuation.h \
     $$PWD/drcorrelation.h \
     $$PWD/batchcategorize.h \
-    $$PWD/amdorbatch.h
+    $$PWD/amdorbatch.h \
+    $$PWD/scanwriter.h \
+    $$PWD/batchreportwriter.h \
+    $$PWD/batchcheckpoint.h
@@ -1,7 +1,10 @@
 #include "amdorbatch.h"
 
+#include "configservice.h"
+#include "batchcheckpoint.h"
+
 AmdorBatch::AmdorBatch(QList<QPair<Scan, bool> > templateList, QList<QPair<double,double>> drOnlyList, double threshold, double fw, double exc, int maxChildren, int maxTreeSize, AbstractFitter *ftr) : BatchManager(QtFTM::Amdor,false,ftr),
-    d_currentFtIndex(0), d_currentDrIndex(0), d_currentRefInt(0.0), d_threshold(threshold), d_frequencyWindow(fw),
+    d_templateList(templateList), d_drOnlyList(drOnlyList), d_currentFtIndex(0), d_currentDrIndex(0), d_currentRefInt(0.0), d_threshold(threshold), d_frequencyWindow(fw),
     d_excludeRange(exc), d_maxChildren(maxChildren), d_calIsNext(false), d_currentScanIsRef(false),
     d_currentScanIsVerification(false), d_startTime(QDateTime::currentDateTime()), d_maxTreeSize(maxTreeSize)
 {
@@ -14,6 +17,12 @@ AmdorBatch::AmdorBatch(QList<QPair<Scan, bool> > templateList, QList<QPair<doubl
     d_hasCal = false;
     d_scansSinceCal = 0;
     p_currentNode = nullptr;
+
+    //reference scans are taken with the DR synthesizer at its minimum frequency and power
+    ConfigSnapshot config = ConfigService::instance().snapshot();
+    double minDr = config.drSynthMin() + 648.21;
+    double minPwr = config.drSynthMinPower();
+
     for(int i=0; i<templateList.size(); i++)
     {
         if(templateList.at(i).second)
@@ -27,14 +36,6 @@ AmdorBatch::AmdorBatch(QList<QPair<Scan, bool> > templateList, QList<QPair<doubl
         QList<Scan> sList;
         d_frequencies.append(templateList.at(i).first.ftFreq());
 
-        QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-        s.beginGroup(QString("drSynth"));
-        s.beginGroup(s.value(QString("subKey"),QString("virtual")).toString());
-        double minDr = s.value(QString("min")).toDouble();
-        double minPwr = s.value(QString("minPower"),-20.0).toDouble();
-        minDr += 648.21;
-        s.endGroup();
-        s.endGroup();
 
         for(int j=0; j<templateList.size(); j++)
         {
@@ -128,6 +129,30 @@ AmdorBatch::AmdorBatch(QList<QPair<Scan, bool> > templateList, QList<QPair<doubl
     d_totalShots = totalTests;
 }
 
+AmdorBatch *AmdorBatch::fromSettings(QDataStream &ds, AbstractFitter *ftr)
+{
+    qint32 size;
+    ds >> size;
+    QList<QPair<Scan,bool>> templateList;
+    for(int i=0; i<size && ds.status() == QDataStream::Ok; i++)
+    {
+        Scan s = BatchCheckpoint::readScan(ds);
+        bool cal;
+        ds >> cal;
+        templateList.append(qMakePair(s,cal));
+    }
+
+    QList<QPair<double,double>> drOnlyList;
+    double threshold, fw, exc;
+    qint32 maxChildren, maxTreeSize;
+    ds >> drOnlyList >> threshold >> fw >> exc >> maxChildren >> maxTreeSize;
+
+    if(ds.status() != QDataStream::Ok)
+        return nullptr;
+
+    return new AmdorBatch(templateList,drOnlyList,threshold,fw,exc,maxChildren,maxTreeSize,ftr);
+}
+
 AmdorBatch::AmdorBatch(int num, AbstractFitter *ftr) :
     BatchManager(QtFTM::Amdor,true,ftr), d_currentFtIndex(0), d_currentDrIndex(0), d_currentRefInt(0.0),
     d_calIsNext(false), d_currentScanIsRef(false), d_currentScanIsVerification(false)
@@ -139,8 +164,7 @@ AmdorBatch::AmdorBatch(int num, AbstractFitter *ftr) :
     int batchThousands = d_batchNum/1000;
 
     //create directory, if necessary
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/amdor/%1/%2").arg(batchMillions).arg(batchThousands));
     QFile in(QString("%1/%2.txt").arg(d.absolutePath()).arg(d_batchNum));
 
@@ -322,44 +346,31 @@ double AmdorBatch::matchThreshold()
 
 void AmdorBatch::writeReport()
 {
-    if(d_saveData.isEmpty())
+    finishReport(makeHeader());
+}
+
+bool AmdorBatch::writeSettings(QDataStream &ds) const
+{
+    ds << static_cast<qint32>(d_templateList.size());
+    for(int i=0; i<d_templateList.size(); i++)
     {
-        emit logMessage(QString("Did not create AMDOR report because no scans were completed."),QtFTM::LogWarning);
-        return;
+        BatchCheckpoint::writeScan(ds,d_templateList.at(i).first);
+        ds << d_templateList.at(i).second;
     }
 
-    //figure out where to save the data
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    int batchNum = s.value(d_numKey,1).toInt();
-    int batchMillions = batchNum/1000000;
-    int batchThousands = batchNum/1000;
+    ds << d_drOnlyList << d_threshold << d_frequencyWindow << d_excludeRange << static_cast<qint32>(d_maxChildren) << static_cast<qint32>(d_maxTreeSize);
 
-    //create directory, if necessary
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
-    QDir d(savePath + QString("/amdor/%1/%2").arg(batchMillions).arg(batchThousands));
-    if(!d.exists())
-    {
-        if(!d.mkpath(d.absolutePath()))
-        {
-            emit logMessage(QString("Could not create directory for saving AMDOR data! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-            return;
-        }
-    }
+    return true;
+}
 
-    //open file for writing
-    QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(batchNum));
+QString AmdorBatch::makeHeader()
+{
+    QString out;
     QTextStream t(&out);
     QString tab = QString("\t");
     QString nl = QString("\n");
 
-    if(!out.open(QIODevice::WriteOnly))
-    {
-        emit logMessage(QString("Could not open file for writing AMDOR data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-        return;
-    }
-
-    //header stuff
-    t << QString("#AMDOR") << tab << batchNum << tab << nl;
+    t << QString("#AMDOR") << tab << d_batchNum << tab << nl;
     t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
     t << QString("#FID delay") << tab << d_fitter->delay() << tab << QString("us") << nl;
     t << QString("#FID high pass") << tab << d_fitter->hpf() << tab << QString("kHz") << nl;
@@ -372,6 +383,19 @@ void AmdorBatch::writeReport()
     t << QString("#Max children") << tab << QString::number(d_maxChildren) << tab << nl;
     t << QString("#Max tree size") << tab << QString::number(d_maxTreeSize) << tab << nl;
 
+    t.flush();
+    return out;
+}
+
+QString AmdorBatch::makePreamble()
+{
+    //the frequency list is known from the start, so it is written before the scan table
+    QString out;
+    QTextStream t(&out);
+    QString tab = QString("\t");
+    QString nl = QString("\n");
+    int batchNum = d_batchNum;
+
     t << nl <<QString("amdorfrequencies") << batchNum << tab << QString("amdordronly") << batchNum;
     t.setRealNumberNotation(QTextStream::FixedNotation);
     t.setRealNumberPrecision(3);
@@ -385,22 +409,8 @@ void AmdorBatch::writeReport()
     t << tab << QString("amdordrid") << batchNum << tab << QString("amdorintensity") << batchNum;
     t << tab << QString("amdorelapsedsecs") << batchNum;
 
-    for(int i=0; i<d_saveData.size(); i++)
-    {
-        const AmdorSaveData &sd = d_saveData.at(i);
-        t << nl << sd.scanNum;
-        t << tab << (sd.isCal ? 1 : 0);
-        t << tab << (sd.isRef ? 1 : 0);
-        t << tab << (sd.isValidation ? 1 : 0);
-        t << tab << sd.ftId;
-        t << tab << sd.drId;
-        t << tab << sd.intensity;
-        t << tab << sd.elapsedS;
-    }
-
-    s.setValue(d_numKey,batchNum+1);
-    s.sync();
-
+    t.flush();
+    return out;
 }
 
 void AmdorBatch::advanceBatch(const Scan s)
@@ -422,7 +432,7 @@ void AmdorBatch::advanceBatch(const Scan s)
     d_lastScan = s;
     d_scansSinceCal++;
 
-    FitResult res = d_fitter->doFit(s);
+    FitResult res = fitScan(s);
 
     //the scan number will be used on the X axis of the plot
     double num = (double)s.number();
@@ -464,17 +474,25 @@ void AmdorBatch::advanceBatch(const Scan s)
 
     if(!d_loading)
     {
-        AmdorSaveData sd;
-        sd.scanNum = s.number();
-        sd.ftId = d_currentFtIndex;
-        sd.drId = d_currentDrIndex;
-        sd.intensity = intensity;
-        sd.isCal = d_thisScanIsCal;
-        sd.isRef = d_currentScanIsRef;
-        sd.isValidation = d_currentScanIsVerification;
-        sd.elapsedS = (QDateTime::currentDateTime().toMSecsSinceEpoch() - d_startTime.toMSecsSinceEpoch())/1000;
-
-        d_saveData.append(sd);
+        if(!d_report.isOpen())
+            openReport(QString("amdor"),makeHeader(),makePreamble());
+
+        QString row;
+        QTextStream t(&row);
+        QString tab = QString("\t");
+        t.setRealNumberNotation(QTextStream::FixedNotation);
+        t.setRealNumberPrecision(3);
+        t << QString("\n") << s.number();
+        t << tab << (d_thisScanIsCal ? 1 : 0);
+        t << tab << (d_currentScanIsRef ? 1 : 0);
+        t << tab << (d_currentScanIsVerification ? 1 : 0);
+        t << tab << d_currentFtIndex;
+        t << tab << d_currentDrIndex;
+        t << tab << intensity;
+        t << tab << (QDateTime::currentDateTime().toMSecsSinceEpoch() - d_startTime.toMSecsSinceEpoch())/1000;
+        t.flush();
+
+        appendToReport(row);
     }
 
     /****************************************
@@ -800,14 +818,9 @@ Scan AmdorBatch::prepareNextScan()
         d_currentScanIsRef = true;
         d_currentScanIsVerification = false;
 
-        QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-        s.beginGroup(QString("drSynth"));
-        s.beginGroup(s.value(QString("subKey"),QString("virtual")).toString());
-        double minDr = s.value(QString("min")).toDouble();
-        double minPwr = s.value(QString("minPower"),-20.0).toDouble();
-        minDr += 648.21;
-        s.endGroup();
-        s.endGroup();
+        ConfigSnapshot config = ConfigService::instance().snapshot();
+        double minDr = config.drSynthMin() + 648.21;
+        double minPwr = config.drSynthMinPower();
 
         out.setDrPower(minPwr);
         out.setDrFreq(minDr);
@@ -13,16 +13,7 @@ public:
     AmdorBatch(int num, AbstractFitter *ftr);
     ~AmdorBatch();
 
-    struct AmdorSaveData {
-        int scanNum;
-        bool isCal;
-        bool isRef;
-        bool isValidation;
-        int ftId;
-        int drId;
-        double intensity;
-        qint64 elapsedS;
-    };
+    static AmdorBatch *fromSettings(QDataStream &ds, AbstractFitter *ftr);
 
     QList<double> allFrequencies();
     double matchThreshold();
@@ -34,6 +25,7 @@ protected:
     void processScan(Scan s);
     Scan prepareNextScan();
     bool isBatchComplete();
+    bool writeSettings(QDataStream &ds) const;
 
 signals:
     void newRefScan(int,int,double);
@@ -43,6 +35,7 @@ private:
     QList<QList<bool>> d_completedMatrix;
     QList<QList<Scan>> d_scanMatrix;
     QList<QPair<Scan,bool>> d_templateList;
+    QList<QPair<double,double>> d_drOnlyList;
     QVector<QPointF> d_drData, d_calData;
     QList<double> d_frequencies;
     int d_currentFtIndex;
@@ -62,7 +55,6 @@ private:
     bool d_currentScanIsVerification;
     AmdorNode *p_currentNode;
     QList<AmdorNode*> d_trees;
-    QList<AmdorSaveData> d_saveData;
     QList<bool> d_loadCalList, d_loadRefList, d_loadVerificationList;
     QList<QPair<int,int>> d_loadIndices;
     int d_loadIndex;
@@ -72,6 +64,8 @@ private:
     bool incrementIndices();
     bool nextTreeBranch();
     void resumeFromBranch();
+    QString makeHeader();
+    QString makePreamble();
 };
 
 #endif // AMDORBATCH_H
@@ -1,5 +1,6 @@
 #include "analysis.h"
 #include <math.h>
+#include <QtEndian>
 #include <gsl/gsl_fit.h>
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_multifit.h>
@@ -327,118 +328,183 @@ void Analysis::estimateDopplerPairAmplitude(const QVector<QPointF> ft, DopplerPa
 }
 
 
-Fid Analysis::parseWaveform(const QByteArray d, double probeFreq)
+Analysis::WaveformFormat Analysis::parseWaveformPrefix(const QByteArray &d)
 {
     //the byte array consists of a waveform prefix with data about the scaling, etc, followed by a block of data preceded by #xyyyy (number of y characters = x)
     //to parse, first find the hash and split the prefix from the total array, then split the prefix on semicolons
+    WaveformFormat out;
     int hashIndex = d.indexOf('#');
+    if(hashIndex < 0)
+        return out;
+
     QByteArray prefix = d.mid(0,hashIndex);
     QList<QByteArray> prefixFields = prefix.split(';');
 
     //important data from prefix: number of bytes (0), byte format (3), byte order (4), x increment (10), y multiplier (14), y offset (15)
     if(prefixFields.size()<16)
-    {
-//        emit logMessage(QString("Could not parse waveform prefix. Too few fields. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(5e-7,probeFreq,QVector<double>(400));
-    }
+        return out;
 
     bool ok = true;
-    int n_bytes = prefixFields.at(0).trimmed().toInt(&ok);
-    if(!ok || n_bytes < 1 || n_bytes > 2)
-    {
-//        emit logMessage(QString("Could not parse waveform prefix. Invalid number of bytes per record. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(5e-7,probeFreq,QVector<double>(400));
-    }
+    out.bytes = prefixFields.at(0).trimmed().toInt(&ok);
+    if(!ok || out.bytes < 1 || out.bytes > 2)
+        return out;
 
-    bool n_signed = true;
     if(prefixFields.at(3).trimmed() == QByteArray("RP"))
-        n_signed = false;
+        out.isSigned = false;
 
-    QDataStream::ByteOrder n_order = QDataStream::BigEndian;
     if(prefixFields.at(4).trimmed() == QByteArray("LSB"))
-        n_order = QDataStream::LittleEndian;
+        out.order = QDataStream::LittleEndian;
 
-    double xIncr = prefixFields.at(10).trimmed().toDouble(&ok);
-    if(!ok || xIncr <= 0.0)
-    {
-//        emit logMessage(QString("Could not parse waveform prefix. Invalid X spacing. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(5e-7,probeFreq,QVector<double>(400));
-    }
+    out.xIncr = prefixFields.at(10).trimmed().toDouble(&ok);
+    if(!ok || out.xIncr <= 0.0)
+        return out;
 
-    double yMult = prefixFields.at(14).trimmed().toDouble(&ok);
-    if(!ok || yMult == 0.0)
-    {
-//        emit logMessage(QString("Could not parse waveform prefix. Invalid Y multipier. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(5e-7,probeFreq,QVector<double>(400));
-    }
+    out.yMult = prefixFields.at(14).trimmed().toDouble(&ok);
+    if(!ok || out.yMult == 0.0)
+        return out;
 
-    double yOffset = prefixFields.at(15).trimmed().toDouble(&ok);
+    out.yOffset = prefixFields.at(15).trimmed().toDouble(&ok);
     if(!ok)
-    {
-//        emit logMessage(QString("Could not parse waveform prefix. Invalid Y offset. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(5e-7,probeFreq,QVector<double>(400));
-    }
+        return out;
 
     //calculate data stride
-    int stride = (int)ceil(500e-9/xIncr);
+    out.stride = (int)ceil(500e-9/out.xIncr);
 
-    //now, locate and extract data block
+    //now, locate the data block
     int numHeaderBytes = d.mid(hashIndex+1,1).toInt();
     int numDataBytes = d.mid(hashIndex+2,numHeaderBytes).toInt();
-    int numRecords = numDataBytes/n_bytes;
-    QByteArray dataBlock = d.mid(hashIndex+numHeaderBytes+2,numDataBytes);
+    out.numRecords = numDataBytes/out.bytes;
+    out.dataStart = hashIndex+numHeaderBytes+2;
 
-    if(dataBlock.size() < numDataBytes)
+    if(d.size() - out.dataStart < numDataBytes)
     {
-//        emit logMessage(QString("Could not parse waveform. Incomplete wave. If this problem persists, restart program."),QtFTM::LogWarning);
-        return Fid(xIncr*(double)stride,probeFreq,QVector<double>(400));
+        out.numRecords = 0;
+        return out;
     }
 
-    //prepare data stream and data vector
-    QDataStream ds(&dataBlock,QIODevice::ReadOnly);
-    ds.setByteOrder(n_order);
-    QVector<double> dat;
-    dat.reserve((int)ceil(numRecords/stride));
+    out.valid = true;
+    return out;
+}
 
-    for(int i=0; i<numRecords; i++)
+qint32 Analysis::rawCode(const uchar *dataBlock, const WaveformFormat &fmt, int i)
+{
+    if(fmt.bytes == 1)
     {
-        double yVal;
-        if(n_bytes == 1)
-        {
-            if(n_signed)
-            {
-                qint8 num;
-                ds >> num;
-                yVal = yMult*((double)num+yOffset);
-            }
-            else
-            {
-                quint8 num;
-                ds >> num;
-                yVal = yMult*((double)num+yOffset);
-            }
-        }
+        if(fmt.isSigned)
+            return static_cast<qint8>(dataBlock[i]);
         else
+            return dataBlock[i];
+    }
+
+    const uchar *p = dataBlock + 2*i;
+    if(fmt.isSigned)
+        return fmt.order == QDataStream::BigEndian ? qFromBigEndian<qint16>(p) : qFromLittleEndian<qint16>(p);
+    else
+        return fmt.order == QDataStream::BigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+}
+
+Fid Analysis::parseWaveform(const QByteArray d, double probeFreq)
+{
+    WaveformFormat fmt = parseWaveformPrefix(d);
+    if(!fmt.valid)
+    {
+//        emit logMessage(QString("Could not parse waveform. If this problem persists, restart program."),QtFTM::LogWarning);
+        if(fmt.stride > 0)
+            return Fid(fmt.xIncr*(double)fmt.stride,probeFreq,QVector<double>(400));
+        return Fid(5e-7,probeFreq,QVector<double>(400));
+    }
+
+    //samples are decoded in place; only every stride-th point is converted
+    //the raw codes are kept so that the FID can be stored losslessly (the voltages are computed from them)
+    const uchar *dataBlock = reinterpret_cast<const uchar*>(d.constData()) + fmt.dataStart;
+    QVector<qint64> codes;
+    codes.reserve(fmt.numRecords/fmt.stride+1);
+
+    for(int i=0; i<fmt.numRecords; i+=fmt.stride)
+        codes.append(rawCode(dataBlock,fmt,i));
+
+    Fid out(fmt.xIncr*(double)fmt.stride,probeFreq,QVector<double>());
+    out.setRawSum(codes,1,fmt.yMult,fmt.yOffset);
+    return out;
+
+}
+
+QList<Fid> Analysis::parseWaveformFrames(const QByteArray d, double probeFreq, int frames, QList<bool> *saturated)
+{
+    //the data block of a segmented (FastFrame) record contains frames records of equal length, one after the other
+    QList<Fid> out;
+    WaveformFormat fmt = parseWaveformPrefix(d);
+    if(!fmt.valid || frames < 1 || fmt.numRecords < frames)
+        return out;
+
+    int frameLength = fmt.numRecords/frames;
+    const uchar *dataBlock = reinterpret_cast<const uchar*>(d.constData()) + fmt.dataStart;
+
+    //a shot is saturated if any raw sample reaches the edge of the ADC range
+    double halfRange = fmt.bytes == 1 ? 128.0 : 32768.0;
+    double center = fmt.isSigned ? 0.0 : halfRange;
+    double limit = frameSaturationFraction*halfRange;
+
+    for(int j=0; j<frames; j++)
+    {
+        const uchar *frameBlock = dataBlock + j*frameLength*fmt.bytes;
+        QVector<qint64> codes;
+        codes.reserve(frameLength/fmt.stride+1);
+        bool sat = false;
+
+        for(int i=0; i<frameLength; i++)
         {
-            if(n_signed)
-            {
-                qint16 num;
-                ds >> num;
-                yVal = yMult*((double)num+yOffset);
-            }
-            else
-            {
-                quint16 num;
-                ds >> num;
-                yVal = yMult*((double)num+yOffset);
-            }
+            qint32 code = rawCode(frameBlock,fmt,i);
+            if(fabs(static_cast<double>(code)-center) >= limit)
+                sat = true;
+            if(i % fmt.stride == 0)
+                codes.append(code);
         }
-        if(!(i%stride))
-            dat.append(yVal);
+
+        Fid f(fmt.xIncr*(double)fmt.stride,probeFreq,QVector<double>());
+        f.setRawSum(codes,1,fmt.yMult,fmt.yOffset);
+        out.append(f);
+        if(saturated != nullptr)
+            saturated->append(sat);
+    }
+
+    return out;
+}
+
+QList<bool> Analysis::findOutlierFrames(const QList<Fid> frames)
+{
+    //a frame is an outlier if its rms deviates from the median rms by more than frameOutlierThreshold median absolute deviations.
+    //This catches shots with a missing or doubled gas pulse, discharge spikes, etc.
+    QList<bool> out;
+    if(frames.size() < 3)
+    {
+        for(int i=0; i<frames.size(); i++)
+            out.append(false);
+        return out;
     }
 
-    return Fid(xIncr*(double)stride,probeFreq,dat);
+    QVector<double> rms;
+    rms.reserve(frames.size());
+    for(int i=0; i<frames.size(); i++)
+    {
+        const Fid &f = frames.at(i);
+        double sumSq = 0.0;
+        for(int j=0; j<f.size(); j++)
+            sumSq += f.at(j)*f.at(j);
+        rms.append(f.size() > 0 ? sqrt(sumSq/(double)f.size()) : 0.0);
+    }
 
+    double med = median(rms);
+    QVector<double> dev;
+    dev.reserve(rms.size());
+    for(int i=0; i<rms.size(); i++)
+        dev.append(fabs(rms.at(i)-med));
+    double mad = median(dev);
+
+    for(int i=0; i<rms.size(); i++)
+        out.append(mad > 0.0 && dev.at(i) > frameOutlierThreshold*mad);
+
+    return out;
 }
 
 
@@ -4,6 +4,7 @@
 #include <QVector>
 #include <QPair>
 #include <QPointF>
+#include <QDataStream>
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_const_cgs.h>
 #include "fid.h"
@@ -20,6 +21,8 @@ namespace Analysis {
 const int baselineMedianBinSize = 10;
 const double twoLogTwo = 2.0*log(2.0);
 const double rootTwoLogTwo = sqrt(twoLogTwo);
+const double frameSaturationFraction = 0.98; /*!< Fraction of the ADC half-range at which a shot is considered saturated */
+const double frameOutlierThreshold = 5.0; /*!< Number of median absolute deviations of the rms at which a shot is rejected */
 
 /******************************
  * ENUM/STRUCTURE DEFINITIONS *
@@ -30,6 +33,25 @@ enum Coordinate {
     Ycoord
 };
 
+/*!
+ * \brief Scaling and location of the data block of an oscilloscope record, taken from the waveform prefix
+ */
+struct WaveformFormat {
+    bool valid;
+    int bytes;
+    bool isSigned;
+    QDataStream::ByteOrder order;
+    double xIncr;
+    double yMult;
+    double yOffset;
+    int stride; /*!< Only every stride-th point is kept, so that the FID spacing is at least 500 ns */
+    int dataStart; /*!< Index of the first data byte */
+    int numRecords; /*!< Number of points in the data block */
+
+    WaveformFormat() : valid(false), bytes(0), isSigned(true), order(QDataStream::BigEndian), xIncr(0.0), yMult(0.0),
+        yOffset(0.0), stride(0), dataStart(0), numRecords(0) {}
+};
+
 /***********************************
  *    GENERAL-PURPOSE ROUTINES     *
  ***********************************/
@@ -63,7 +85,11 @@ double gauss(double x, double center, double fwhm);
 /*******************************
  *   OSCILLOSCOPE PARSING      *
  ******************************/
+WaveformFormat parseWaveformPrefix(const QByteArray &d);
+qint32 rawCode(const uchar *dataBlock, const WaveformFormat &fmt, int i);
 Fid parseWaveform(const QByteArray d, double probeFreq);
+QList<Fid> parseWaveformFrames(const QByteArray d, double probeFreq, int frames, QList<bool> *saturated = nullptr);
+QList<bool> findOutlierFrames(const QList<Fid> frames);
 
 }
 
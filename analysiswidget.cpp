@@ -1,6 +1,7 @@
 #include "analysiswidget.h"
 #include <QSettings>
 #include <QApplication>
+#include "configservice.h"
 #include <QDialog>
 #include <QMessageBox>
 #include <QFileDialog>
@@ -14,6 +15,8 @@
 #include <QFile>
 #include "analysis.h"
 #include "autofitwidget.h"
+#include "numberallocator.h"
+#include "scanrepository.h"
 
 AnalysisWidget::AnalysisWidget(QWidget *parent) :
      QWidget(parent),
@@ -47,8 +50,7 @@ AnalysisWidget::AnalysisWidget(QWidget *parent) :
 
 	ui->analysisNotes->installEventFilter(this);
 	ui->lineListView->setModel(llm);
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	ui->analysisScanSpinBox->setMaximum(s.value(QString("scanNum"),0).toInt());
+	ui->analysisScanSpinBox->setMaximum(NumberAllocator::instance().lastScanNumber());
 
 	fitThread = new QThread(this);
 }
@@ -169,7 +171,11 @@ void AnalysisWidget::showLatestScan()
 
 void AnalysisWidget::loadScan(int num)
 {
-	showScan(Scan(num));
+	int step = num < d_currentScan.number() ? -1 : 1;
+	showScan(ScanRepository::instance().get(num));
+
+	//read the scans that are likely to be viewed next while this one is displayed
+	ScanRepository::instance().prefetchNeighbors(num,step);
 }
 
 void AnalysisWidget::showScan(Scan s)
@@ -292,8 +298,7 @@ void AnalysisWidget::saveScanMetaData()
 	int dirMillionsNum = (int)floor((double) d_currentScan.number()/1000000.0);
 	int dirThousandsNum = (int)floor((double) d_currentScan.number()/1000.0);
 
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
+	QString savePath = ConfigService::instance().snapshot().savePath();
 
 	QDir d(savePath + QString("/metadata/%1/%2").arg(dirMillionsNum).arg(dirThousandsNum));
 	if(!d.exists())
@@ -343,8 +348,7 @@ void AnalysisWidget::loadScanMetaData()
     FitResult res(d_currentScan.number());
     d_currentBaseline = res.baselineY0Slope();
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
 
 	//open metadata file
 	QFile f(savePath + QString("/metadata/%1/%2/%3.txt").arg(dirMillionsNum).arg(dirThousandsNum).arg(d_currentScan.number()));
@@ -1,6 +1,6 @@
 #include "batch.h"
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
+#include "batchcheckpoint.h"
 
 Batch::Batch(QList<QPair<Scan, bool> > l, AbstractFitter *ftr) :
     BatchManager(QtFTM::Batch,false,ftr), d_scanList(l), d_processScanIsCal(false)
@@ -12,6 +12,25 @@ Batch::Batch(QList<QPair<Scan, bool> > l, AbstractFitter *ftr) :
 
 }
 
+Batch *Batch::fromSettings(QDataStream &ds, AbstractFitter *ftr)
+{
+    qint32 size;
+    ds >> size;
+    QList<QPair<Scan,bool> > l;
+    for(int i=0; i<size && ds.status() == QDataStream::Ok; i++)
+    {
+        Scan s = BatchCheckpoint::readScan(ds);
+        bool cal;
+        ds >> cal;
+        l.append(qMakePair(s,cal));
+    }
+
+    if(ds.status() != QDataStream::Ok)
+        return nullptr;
+
+    return new Batch(l,ftr);
+}
+
 Batch::Batch(int num, AbstractFitter *ftr) : BatchManager(QtFTM::Batch,true,ftr), d_loadingIndex(0), d_processScanIsCal(false)
 {
     d_prettyName = QString("Batch");
@@ -22,8 +41,7 @@ Batch::Batch(int num, AbstractFitter *ftr) : BatchManager(QtFTM::Batch,true,ftr)
     int batchThousands = (int)floor((double)batchNum/1000.0);
 
     //get directory and file
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/batch/%1/%2").arg(batchMillions).arg(batchThousands));
     QFile f(QString("%1/%2.txt").arg(d.absolutePath()).arg(batchNum));
 
@@ -101,11 +119,7 @@ void Batch::advanceBatch(const Scan s)
 void Batch::processScan(Scan s)
 {
 
-    FitResult res;
-    if(d_loading && d_fitter->type() == FitResult::NoFitting)
-        res = FitResult(s.number());
-    else
-        res = d_fitter->doFit(s);
+    FitResult res = fitScan(s);
 
 	//the scan number will be used on the X axis of the plot
 	double num = (double)s.number();
@@ -166,14 +180,22 @@ void Batch::processScan(Scan s)
     bool badTune = s.tuningVoltage() <= 0;
     QtFTM::BatchPlotMetaData md(QtFTM::Batch,s.number(),mdmin,mdmax,d_processScanIsCal,badTune,markerText);
 
-	//record the marker text and FT max for saving
-    ScanResult sr;
-    sr.scan = s;
-    sr.isCal = d_processScanIsCal;
-    sr.isSat = sat;
-    sr.ftMax = max;
-    sr.result = res;
-    d_saveData.append(sr);
+	//write the results to the report
+    if(!d_loading)
+    {
+        if(!d_report.isOpen())
+        {
+            QString title;
+            QTextStream tt(&title);
+            tt << QString("\nbatchscan") << d_batchNum << QString("\tbatchmax") << d_batchNum << QString("\tbatchiscal") << d_batchNum << QString("\tbatchissat") << d_batchNum << QString("\tbatchftfreq") << d_batchNum << QString("\t");
+            tt << QString("batchattn") << d_batchNum << QString("\tbatchdrfreq") << d_batchNum << QString("\tbatchdrpower") << d_batchNum << QString("\tbatchpulses") << d_batchNum << QString("\tbatchshots") << d_batchNum << QString("\t");
+            tt << QString("batchautofitpairfreqs") << d_batchNum << QString("\tbatchautofitpairints") << d_batchNum << QString("\tbatchautofitsinglefreqs") << d_batchNum << QString("\t");
+            tt << QString("batchautofitsingleints") << d_batchNum << QString("\t");
+            tt.flush();
+            openReport(QString("batch"),makeHeader(),title);
+        }
+        appendToReport(makeRow(s,max,sat,res));
+    }
 
 	//send the data to the plot
 	QList<QVector<QPointF> > out;
@@ -187,112 +209,98 @@ void Batch::processScan(Scan s)
 
 void Batch::writeReport()
 {
-    if(d_saveData.isEmpty())
-	{
-		emit logMessage(QString("Did not create batch scan report because no scans were completed."),QtFTM::LogWarning);
-		return;
-	}
-
-	//figure out where to save the data
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	int batchNum = s.value(d_numKey,1).toInt();
-	int batchMillions = (int)floor((double)batchNum/1000000.0);
-	int batchThousands = (int)floor((double)batchNum/1000.0);
-
-	//create directory, if necessary
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-	QDir d(savePath + QString("/batch/%1/%2").arg(batchMillions).arg(batchThousands));
-	if(!d.exists())
-	{
-		if(!d.mkpath(d.absolutePath()))
-		{
-			emit logMessage(QString("Could not create directory for saving batch scan! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-			return;
-		}
-	}
+    finishReport(makeHeader());
+}
 
-	//open file for writing
-	QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(batchNum));
-	QTextStream t(&out);
-	QString tab = QString("\t");
-	QString nl = QString("\n");
-    QString zerop = QString("0.0");
-    QString zero = QString("0");
-    QString one = QString("1");
-    QString sc = QString(";");
+bool Batch::writeSettings(QDataStream &ds) const
+{
+    ds << static_cast<qint32>(d_scanList.size());
+    for(int i=0; i<d_scanList.size(); i++)
+    {
+        BatchCheckpoint::writeScan(ds,d_scanList.at(i).first);
+        ds << d_scanList.at(i).second;
+    }
 
-	if(!out.open(QIODevice::WriteOnly))
-	{
-		emit logMessage(QString("Could not open file for writing batch data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-		return;
-	}
+    return true;
+}
 
-	t.setRealNumberNotation(QTextStream::FixedNotation);
-	t.setRealNumberPrecision(4);
-	//header stuff
-	t << QString("#Batch scan") << tab << batchNum << tab << nl;
-	t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
+QString Batch::makeHeader()
+{
+    QString out;
+    QTextStream t(&out);
+    QString tab = QString("\t");
+    QString nl = QString("\n");
+
+    t.setRealNumberNotation(QTextStream::FixedNotation);
+    t.setRealNumberPrecision(4);
+    t << QString("#Batch scan") << tab << d_batchNum << tab << nl;
+    t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
     t << QString("#FID delay") << tab << d_fitter->delay() << tab << QString("us") << nl;
     t << QString("#FID high pass") << tab << d_fitter->hpf() << tab << QString("kHz") << nl;
     t << QString("#FID exp decay") << tab << d_fitter->exp() << tab << QString("us") << nl;
     t << QString("#FID remove baseline") << tab << (d_fitter->removeDC() ? QString("Yes") : QString("No")) << tab << nl;
     t << QString("#FID zero padding") << tab << (d_fitter->autoPad() ? QString("Yes") : QString("No")) << tab << nl;
 
-	//write save data to file
-    t << nl << QString("batchscan") << batchNum << tab << QString("batchmax") << batchNum <<  tab << QString("batchiscal") << batchNum << tab << QString("batchissat") << batchNum  << tab << QString("batchftfreq") << batchNum << tab;
-    t << QString("batchattn") << batchNum << tab << QString("batchdrfreq") << batchNum << tab << QString("batchdrpower") << batchNum << tab << QString("batchpulses") << batchNum << tab << QString("batchshots") << batchNum << tab;
-    t << QString("batchautofitpairfreqs") << batchNum << tab << QString("batchautofitpairints") << batchNum << tab << QString("batchautofitsinglefreqs") << batchNum << tab;
-    t << QString("batchautofitsingleints") << batchNum << tab;
-    for(int i=0;i<d_saveData.size(); i++)
-    {
-        const ScanResult &sr = d_saveData.at(i);
-        t << nl << sr.scan.number() << tab << sr.ftMax << tab << sr.isCal << tab << sr.isSat << tab << sr.scan.ftFreq() << tab << sr.scan.attenuation() << tab << sr.scan.drFreq() << tab << sr.scan.drPower() << tab;
+    t.flush();
+    return out;
+}
 
-        PulseGenConfig pc = sr.scan.pulseConfiguration();
-        QString pulses;
-        for(int j=0; j<pc.size(); j++)
-        {
-            if(pc.setting(j,QtFTM::PulseEnabled).toBool())
-                pulses.append(one);
-            else
-                pulses.append(zero);
-        }
-        t << pulses << tab << sr.scan.completedShots() << tab;
+QString Batch::makeRow(const Scan s, double ftMax, bool isSat, const FitResult &res)
+{
+    QString out;
+    QTextStream t(&out);
+    QString tab = QString("\t");
+    QString nl = QString("\n");
+    QString zerop = QString("0.0");
+    QString zero = QString("0");
+    QString one = QString("1");
+    QString sc = QString(";");
 
-        if(sr.result.freqAmpPairList().isEmpty())
-            t << zerop << tab << zerop;
-        else
-        {
-            auto list = sr.result.freqAmpPairList();
-            t << list.first().first;
-            for(int j=1; j<list.size(); j++)
-                t << sc << list.at(j).first;
-
-            t << tab << list.first().second;
-            for(int j=1; j<list.size(); j++)
-                t << sc << list.at(j).second;
-        }
+    t.setRealNumberNotation(QTextStream::FixedNotation);
+    t.setRealNumberPrecision(4);
 
-        t << tab;
-        if(sr.result.freqAmpSingleList().isEmpty())
-            t << zerop << tab << zerop;
+    t << nl << s.number() << tab << ftMax << tab << d_processScanIsCal << tab << isSat << tab << s.ftFreq() << tab << s.attenuation() << tab << s.drFreq() << tab << s.drPower() << tab;
+
+    PulseGenConfig pc = s.pulseConfiguration();
+    QString pulses;
+    for(int j=0; j<pc.size(); j++)
+    {
+        if(pc.setting(j,QtFTM::PulseEnabled).toBool())
+            pulses.append(one);
         else
-        {
-            auto list = sr.result.freqAmpSingleList();
-            t << list.first().first;
-            for(int j=1; j<list.size(); j++)
-                t << sc << list.at(j).first;
-
-            t << tab << list.first().second;
-            for(int j=1; j<list.size(); j++)
-                t << sc << list.at(j).second;
-        }
+            pulses.append(zero);
     }
+    t << pulses << tab << s.completedShots() << tab;
 
-	t.flush();
-	out.close();
+    if(res.freqAmpPairList().isEmpty())
+        t << zerop << tab << zerop;
+    else
+    {
+        auto list = res.freqAmpPairList();
+        t << list.first().first;
+        for(int j=1; j<list.size(); j++)
+            t << sc << list.at(j).first;
+
+        t << tab << list.first().second;
+        for(int j=1; j<list.size(); j++)
+            t << sc << list.at(j).second;
+    }
+
+    t << tab;
+    if(res.freqAmpSingleList().isEmpty())
+        t << zerop << tab << zerop;
+    else
+    {
+        auto list = res.freqAmpSingleList();
+        t << list.first().first;
+        for(int j=1; j<list.size(); j++)
+            t << sc << list.at(j).first;
+
+        t << tab << list.first().second;
+        for(int j=1; j<list.size(); j++)
+            t << sc << list.at(j).second;
+    }
 
-	//increment batch number
-	s.setValue(d_numKey,batchNum+1);
-	s.sync();
+    t.flush();
+    return out;
 }
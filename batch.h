@@ -9,6 +9,7 @@
  * These can optionally be considered calibration scans.
  * The report consists of a list of scan numbers, maximum FT intensities, and a string with additional info (Ft frequency, attenuation, etc).
  * Batch reports are stored in savePath/batch/x/y/z.txt, where z is the batch number, y are the thousands digits, and x are the millions digits (though it's unlikely that will ever go above 0!)
+ * A row is appended to the report as each scan is processed.
  */
 class Batch : public BatchManager
 {
@@ -17,13 +18,7 @@ public:
     explicit Batch(QList<QPair<Scan,bool> > l, AbstractFitter *ftr = new NoFitter());
     explicit Batch(int num, AbstractFitter *ftr = new NoFitter());
 
-    struct ScanResult {
-        Scan scan;
-        bool isCal;
-        bool isSat;
-        double ftMax;
-        FitResult result;
-    };
+    static Batch *fromSettings(QDataStream &ds, AbstractFitter *ftr);
 	
 signals:
 	
@@ -35,16 +30,19 @@ protected:
     void advanceBatch(const Scan s);
 	void processScan(Scan s);
 	void writeReport();
+    bool writeSettings(QDataStream &ds) const;
 
 private:
     QList<QPair<Scan,bool> > d_scanList;
     QVector<QPointF> d_theData;
     QVector<QPointF> d_calData;
-    QList<ScanResult> d_saveData;
 
     QList<bool> d_loadCalList;
     int d_loadingIndex;
     bool d_processScanIsCal;
+
+    QString makeHeader();
+    QString makeRow(const Scan s, double ftMax, bool isSat, const FitResult &res);
 	
 };
 
@@ -1,5 +1,7 @@
 #include "batchattenuation.h"
 
+#include "configservice.h"
+
 BatchAttenuation::BatchAttenuation(double minFreq, double maxFreq, double stepSize, int atten10GHz, Scan s, QString name) :
     BatchManager(QtFTM::Attenuation), d_scanUpComplete(false), d_scanDownComplete(false), d_scanUpIndex(0), d_scanDownIndex(0), d_template(s), d_atnFilename(name),
     d_minFreq(minFreq), d_maxFreq(maxFreq), d_stepSize(stepSize), d_atten10GHz(atten10GHz), d_retrying(false), d_aborted(false), d_nextAttn(atten10GHz)
@@ -33,8 +35,7 @@ BatchAttenuation::BatchAttenuation(int num) :
     int millions = (int)floor((double)num/1000000.0);
     int thousands = (int)floor((double)num/1000.0);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QFile f(savePath + QString("/attn/%1/%2/%3.txt").arg(millions).arg(thousands).arg(num));
 
     if(!f.exists())
@@ -244,12 +245,11 @@ void BatchAttenuation::writeReport()
     }
 
     //figure out where to save the data
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    int num = s.value(d_numKey,1).toInt();
+    int num = d_batchNum;
     int millions = (int)floor((double)num/1000000.0);
     int thousands = (int)floor((double)num/1000.0);
 
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/attn/%1/%2").arg(millions).arg(thousands));
 
     if(!d.exists())
@@ -349,6 +349,4 @@ void BatchAttenuation::writeReport()
 
         emit logMessage(QString("Attenuation file written to %1").arg(atnFile.fileName()),QtFTM::LogNormal);
     }
-
-    s.setValue(d_numKey,num+1);
 }
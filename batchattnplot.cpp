@@ -38,7 +38,7 @@ void BatchAttnPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPoin
         for(int i=0; i<sl.size(); i++)
         {
             QColor color = s.value(sl.at(i),QPalette().color(QPalette::ToolTipBase)).value<QColor>();
-            QwtPlotCurve *c = new QwtPlotCurve(sl.at(i));
+            QwtPlotCurve *c = new RasterCurve(sl.at(i));
             c->setRenderHint(QwtPlotItem::RenderAntialiased);
             c->setPen(QPen(color));
             d_plotCurves.append(c);
@@ -1,5 +1,9 @@
 #include "batchcategorize.h"
 
+#include "configservice.h"
+#include "batchreportwriter.h"
+#include "batchcheckpoint.h"
+
 #include <QStringList>
 
 BatchCategorize::BatchCategorize(QList<QPair<Scan, bool> > scanList, QList<CategoryTest> testList, double freqWindow, AbstractFitter *ftr) :
@@ -27,12 +31,38 @@ BatchCategorize::BatchCategorize(QList<QPair<Scan, bool> > scanList, QList<Categ
     //can't calculate total shots. use list size and advance manually
     d_totalShots = d_templateList.size();
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    s.beginGroup(QString("attn"));
-    s.beginGroup(s.value(QString("subKey"),QString("virtual")).toString());
-    d_maxAttn = s.value(QString("max"),100).toInt();
-    s.endGroup();
-    s.endGroup();
+    d_maxAttn = ConfigService::instance().snapshot().attnMax();
+}
+
+BatchCategorize *BatchCategorize::fromSettings(QDataStream &ds, AbstractFitter *ftr)
+{
+    qint32 size;
+    ds >> size;
+    QList<QPair<Scan,bool>> scanList;
+    for(int i=0; i<size && ds.status() == QDataStream::Ok; i++)
+    {
+        Scan s = BatchCheckpoint::readScan(ds);
+        bool cal;
+        ds >> cal;
+        scanList.append(qMakePair(s,cal));
+    }
+
+    ds >> size;
+    QList<CategoryTest> testList;
+    for(int i=0; i<size && ds.status() == QDataStream::Ok; i++)
+    {
+        CategoryTest test;
+        ds >> test.key >> test.name >> test.categorize >> test.valueList;
+        testList.append(test);
+    }
+
+    double freqWindow;
+    ds >> freqWindow;
+
+    if(ds.status() != QDataStream::Ok)
+        return nullptr;
+
+    return new BatchCategorize(scanList,testList,freqWindow,ftr);
 }
 
 BatchCategorize::BatchCategorize(int num, AbstractFitter *ftr) :
@@ -44,8 +74,7 @@ BatchCategorize::BatchCategorize(int num, AbstractFitter *ftr) :
     int catMillions = (int)floor((double)catNum/1000000.0);
     int catThousands = (int)floor((double)catNum/1000.0);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/categorize/%1/%2").arg(catMillions).arg(catThousands));
 
     //create output file
@@ -125,12 +154,14 @@ BatchCategorize::BatchCategorize(int num, AbstractFitter *ftr) :
         d_loadLabelTextMap.insert(num,labelText);
     }
 
+    bool foundCal = false;
     while(!f.atEnd())
     {
         QString line = QString(f.readLine().trimmed());
         if(line.isEmpty())
             continue;
 
+        foundCal = true;
         bool ok = false;
         int num = line.toInt(&ok);
         d_loadScanList.append(num);
@@ -138,6 +169,20 @@ BatchCategorize::BatchCategorize(int num, AbstractFitter *ftr) :
             d_loadLabelTextMap.insert(num,QString("CAL"));
     }
 
+    //if the test did not finish, the calibration list was never written; use the journal instead
+    if(!foundCal)
+    {
+        QList<QPair<int,bool>> j = BatchReportWriter::journalScans(f.fileName());
+        for(int i=0; i<j.size(); i++)
+        {
+            if(j.at(i).second)
+            {
+                d_loadScanList.append(j.at(i).first);
+                d_loadLabelTextMap.insert(j.at(i).first,QString("CAL"));
+            }
+        }
+    }
+
     std::sort(d_loadScanList.begin(),d_loadScanList.end());
 
 }
@@ -151,46 +196,48 @@ BatchCategorize::~BatchCategorize()
 
 void BatchCategorize::writeReport()
 {
-    if(d_resultList.isEmpty())
+    QString trailer;
+    if(!d_calScans.isEmpty())
     {
-        emit logMessage(QString("Did not create %1 report because no scans were completed successfully.").arg(d_prettyName),QtFTM::LogWarning);
-        return;
+        QTextStream t(&trailer);
+        t << QString("\n\ncalscans_") << d_batchNum;
+        for(int i=0; i<d_calScans.size(); i++)
+            t << QString("\n") << d_calScans.at(i);
+        t.flush();
     }
 
-    //figure out where to save the data
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    int batchNum = s.value(d_numKey,1).toInt();
-    int batchMillions = (int)floor((double)batchNum/1000000.0);
-    int batchThousands = (int)floor((double)batchNum/1000.0);
+    finishReport(makeHeader(),trailer);
+}
 
-    //create directory, if necessary
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
-    QDir d(savePath + QString("/categorize/%1/%2").arg(batchMillions).arg(batchThousands));
-    if(!d.exists())
+bool BatchCategorize::writeSettings(QDataStream &ds) const
+{
+    ds << static_cast<qint32>(d_templateList.size());
+    for(int i=0; i<d_templateList.size(); i++)
     {
-        if(!d.mkpath(d.absolutePath()))
-        {
-            emit logMessage(QString("Could not create directory for saving batch scan! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-            return;
-        }
+        BatchCheckpoint::writeScan(ds,d_templateList.at(i).first);
+        ds << d_templateList.at(i).second;
     }
 
-    //open file for writing
-    QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(batchNum));
+    //the test list has already been filtered by the constructor; filtering it again does not change it
+    ds << static_cast<qint32>(d_testList.size());
+    for(int i=0; i<d_testList.size(); i++)
+        ds << d_testList.at(i).key << d_testList.at(i).name << d_testList.at(i).categorize << d_testList.at(i).valueList;
+
+    ds << d_frequencyWindow;
+
+    return true;
+}
+
+QString BatchCategorize::makeHeader()
+{
+    QString out;
     QTextStream t(&out);
     QString tab = QString("\t");
     QString nl = QString("\n");
 
-    if(!out.open(QIODevice::WriteOnly))
-    {
-        emit logMessage(QString("Could not open file for writing batch data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-        return;
-    }
-
     t.setRealNumberNotation(QTextStream::FixedNotation);
     t.setRealNumberPrecision(4);
-    //header stuff
-    t << QString("#Category Test") << tab << batchNum << tab << nl;
+    t << QString("#Category Test") << tab << d_batchNum << tab << nl;
     t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
     t << QString("#Frequency window") << tab << QString::number(d_frequencyWindow,'f',3) << tab << QString("MHz");
     t << QString("#FID delay") << tab << d_fitter->delay() << tab << QString("us") << nl;
@@ -199,71 +246,80 @@ void BatchCategorize::writeReport()
     t << QString("#FID remove baseline") << tab << (d_fitter->removeDC() ? QString("Yes") : QString("No")) << tab << nl;
     t << QString("#FID zero padding") << tab << (d_fitter->autoPad() ? QString("Yes") : QString("No")) << tab << nl;
 
-    t << nl << QString("id_") << batchNum << tab << QString("scan_") << batchNum << tab;
+    t.flush();
+    return out;
+}
+
+QString BatchCategorize::makeColumnTitles()
+{
+    QString out;
+    QTextStream t(&out);
+    QString tab = QString("\t");
+    int batchNum = d_batchNum;
+
+    t << QString("\nid_") << batchNum << tab << QString("scan_") << batchNum << tab;
     t << QString("test_") << batchNum << tab << QString("value_") << batchNum << tab;
     t << QString("extraAttn_") << batchNum << tab << QString("attn_") << batchNum << tab;
     t << QString("ftMax_") << batchNum << tab;
     t << QString("lines_") << batchNum << tab << QString("intensities_") << batchNum << tab;
     t << QString("afFreq_") << batchNum << tab << QString("afInt_") << batchNum;
 
+    t.flush();
+    return out;
+}
+
+QString BatchCategorize::makeRow(const ScanResult &sr)
+{
+    QString out;
+    QTextStream t(&out);
+    QString tab = QString("\t");
+    QString nl = QString("\n");
     QString slash("/"), zero("0.0");
-    for(int i=0; i<d_resultList.size(); i++)
+
+    t.setRealNumberNotation(QTextStream::FixedNotation);
+    t.setRealNumberPrecision(4);
+
+    t << nl << sr.index << tab << sr.scanNum << tab << sr.testKey << tab << sr.testValue.toString();
+    t << tab << sr.extraAttn << tab << sr.attenuation << tab;
+    t << sr.ftMax << tab;
+    if(sr.frequencies.isEmpty())
+        t << zero;
+    else
     {
-        const ScanResult &sr = d_resultList.at(i);
-        t << nl << sr.index << tab << sr.scanNum << tab << sr.testKey << tab << sr.testValue.toString();
-        t << tab << sr.extraAttn << tab << sr.attenuation << tab;
-        t << sr.ftMax << tab;
-        if(sr.frequencies.isEmpty())
-            t << zero;
-        else
-        {
-            t << sr.frequencies.first();
-            for(int i=1; i<sr.frequencies.size(); i++)
-                t << slash << sr.frequencies.at(i);
-        }
-        t << tab;
-        if(sr.intensities.isEmpty())
-            t << zero;
-        else
-        {
-            t << sr.intensities.first();
-            for(int i=1; i<sr.intensities.size(); i++)
-                t << slash << sr.intensities.at(i);
-        }
-        t << tab;
-        if(sr.fit.type() == FitResult::NoFitting || sr.fit.freqAmpPairList().isEmpty())
-            t << zero;
-        else
-        {
-            t << sr.fit.freqAmpPairList().first().first;
-            for(int i=1; i<sr.fit.freqAmpPairList().size(); i++)
-                t << slash << sr.fit.freqAmpPairList().at(i).first;
-        }
-        t << tab;
-        if(sr.fit.type() == FitResult::NoFitting || sr.fit.freqAmpPairList().isEmpty())
-            t << zero;
-        else
-        {
-            t << sr.fit.freqAmpPairList().first().second;
-            for(int i=1; i<sr.fit.freqAmpPairList().size(); i++)
-                t << slash << sr.fit.freqAmpPairList().at(i).second;
-        }
+        t << sr.frequencies.first();
+        for(int i=1; i<sr.frequencies.size(); i++)
+            t << slash << sr.frequencies.at(i);
     }
-
-    if(!d_calScans.isEmpty())
+    t << tab;
+    if(sr.intensities.isEmpty())
+        t << zero;
+    else
     {
-        t << nl << nl << QString("calscans_") << batchNum;
-        for(int i=0; i<d_calScans.size(); i++)
-            t << nl << d_calScans.at(i);
+        t << sr.intensities.first();
+        for(int i=1; i<sr.intensities.size(); i++)
+            t << slash << sr.intensities.at(i);
+    }
+    t << tab;
+    if(sr.fit.type() == FitResult::NoFitting || sr.fit.freqAmpPairList().isEmpty())
+        t << zero;
+    else
+    {
+        t << sr.fit.freqAmpPairList().first().first;
+        for(int i=1; i<sr.fit.freqAmpPairList().size(); i++)
+            t << slash << sr.fit.freqAmpPairList().at(i).first;
+    }
+    t << tab;
+    if(sr.fit.type() == FitResult::NoFitting || sr.fit.freqAmpPairList().isEmpty())
+        t << zero;
+    else
+    {
+        t << sr.fit.freqAmpPairList().first().second;
+        for(int i=1; i<sr.fit.freqAmpPairList().size(); i++)
+            t << slash << sr.fit.freqAmpPairList().at(i).second;
     }
 
     t.flush();
-    out.close();
-
-    s.setValue(d_numKey,batchNum+1);
-    s.sync();
-
-
+    return out;
 }
 
 void BatchCategorize::advanceBatch(const Scan s)
@@ -271,11 +327,7 @@ void BatchCategorize::advanceBatch(const Scan s)
     //in order to determine what scan to do next, we need to do the processing here
     //instead of in processScan
 
-    FitResult res;
-    if(d_loading && d_fitter->type() == FitResult::NoFitting)
-        res = FitResult(s.number());
-    else
-        res = d_fitter->doFit(s);
+    FitResult res = fitScan(s);
 
     auto p = d_fitter->doStandardFT(s.fid());
     QVector<QPointF> ft = p.first;
@@ -298,6 +350,8 @@ void BatchCategorize::advanceBatch(const Scan s)
         else
             d_thisScanIsCal = false;
     }
+    else if(!d_report.isOpen())
+        openReport(QString("categorize"),makeHeader(),makeColumnTitles());
 
 
     if(d_thisScanIsCal)
@@ -318,6 +372,8 @@ void BatchCategorize::advanceBatch(const Scan s)
         labelText = QString("CAL");
 
         d_calScans.append(s.number());
+        if(!d_loading)
+            recordReportScan(s.number(),true);
         d_status.advance();
         emit advanced();
     }
@@ -645,7 +701,7 @@ void BatchCategorize::advanceBatch(const Scan s)
                 }
             }
 
-            d_resultList.append(sr);
+            appendToReport(makeRow(sr));
 
         } // end if(d_loading) else
     } // end if(d_thisScanIsCal) else
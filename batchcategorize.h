@@ -71,6 +71,8 @@ public:
     explicit BatchCategorize(int num, AbstractFitter *ftr = new NoFitter());
 	~BatchCategorize();
 
+	static BatchCategorize *fromSettings(QDataStream &ds, AbstractFitter *ftr);
+
 	// BatchManager interface
 protected:
 	void writeReport();
@@ -78,6 +80,7 @@ protected:
 	void processScan(Scan s);
 	Scan prepareNextScan();
 	bool isBatchComplete();
+	bool writeSettings(QDataStream &ds) const;
 
 private:
     const double d_lineMatchMaxDiff = 0.01;
@@ -86,7 +89,6 @@ private:
     double d_frequencyWindow;
 	QList<QPair<Scan,bool>> d_templateList;
 	QList<CategoryTest> d_testList;
-    QList<ScanResult> d_resultList;
     QList<int> d_calScans;
 	QVector<QPointF> d_scanData, d_calData;
     QMap<int,QString> d_loadLabelTextMap;
@@ -98,6 +100,9 @@ private:
     bool setNextTest();
     bool skipCurrentTest();
     bool configureScanTemplate();
+    QString makeHeader();
+    QString makeColumnTitles();
+    QString makeRow(const ScanResult &sr);
     void getBestResult();
 };
 
@@ -0,0 +1,417 @@
+#include "batchcheckpoint.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "configservice.h"
+#include "nofitter.h"
+#include "dopplerpairfitter.h"
+#include "batchsurvey.h"
+#include "batchdr.h"
+#include "batch.h"
+#include "drcorrelation.h"
+#include "batchcategorize.h"
+#include "amdorbatch.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 checkpointMagic = 0x31504b43;
+
+}
+
+BatchCheckpoint::BatchCheckpoint() : d_headerSize(0)
+{
+}
+
+BatchCheckpoint::~BatchCheckpoint()
+{
+	close();
+}
+
+bool BatchCheckpoint::create(QtFTM::BatchType type, int num, const QString title, const QByteArray settings)
+{
+	close();
+
+	QString name = fileName(type,num);
+	QDir d = QFileInfo(name).absoluteDir();
+	if(!d.exists() && !d.mkpath(d.absolutePath()))
+	{
+		d_error = QString("Could not create directory %1.").arg(d.absolutePath());
+		return false;
+	}
+
+	//the header is written completely or not at all
+	QSaveFile f(name);
+	if(!f.open(QIODevice::WriteOnly))
+	{
+		d_error = f.errorString();
+		return false;
+	}
+
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds << checkpointMagic << static_cast<qint32>(type) << static_cast<qint32>(num) << title
+	   << QDateTime::currentDateTime().toMSecsSinceEpoch() << settings;
+	if(ds.status() != QDataStream::Ok || !f.commit())
+	{
+		d_error = f.errorString();
+		return false;
+	}
+
+	d_file.setFileName(name);
+	if(!d_file.open(QIODevice::WriteOnly|QIODevice::Append))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	d_headerSize = d_file.size();
+	return true;
+}
+
+bool BatchCheckpoint::open(QtFTM::BatchType type, int num)
+{
+	close();
+
+	d_file.setFileName(fileName(type,num));
+	if(!d_file.open(QIODevice::ReadWrite))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	QDataStream ds(&d_file);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	Info info;
+	QByteArray settings;
+	if(!readHeader(ds,info,settings) || info.type != type || info.number != num)
+	{
+		d_error = QString("%1 is not a valid checkpoint for this batch.").arg(d_file.fileName());
+		d_file.close();
+		return false;
+	}
+
+	d_headerSize = d_file.pos();
+	return truncateScans(static_cast<int>((d_file.size() - d_headerSize)/static_cast<qint64>(sizeof(qint32))));
+}
+
+bool BatchCheckpoint::truncateScans(int count)
+{
+	if(!d_file.isOpen())
+		return false;
+
+	qint64 size = d_headerSize + static_cast<qint64>(count)*static_cast<qint64>(sizeof(qint32));
+	if(d_file.size() != size && !d_file.resize(size))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+	if(!d_file.seek(size))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	return sync();
+}
+
+bool BatchCheckpoint::recordScan(int num, bool sync)
+{
+	if(!d_file.isOpen())
+		return false;
+
+	QDataStream ds(&d_file);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds << static_cast<qint32>(num);
+	if(ds.status() != QDataStream::Ok)
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	if(sync)
+		return this->sync();
+
+	return true;
+}
+
+bool BatchCheckpoint::sync()
+{
+	if(!d_file.isOpen())
+		return false;
+
+	if(!d_file.flush())
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+#ifdef Q_OS_UNIX
+	if(fsync(d_file.handle()) != 0)
+	{
+		d_error = QString("Could not sync %1 to disk.").arg(d_file.fileName());
+		return false;
+	}
+#endif
+	return true;
+}
+
+void BatchCheckpoint::close()
+{
+	if(d_file.isOpen())
+	{
+		sync();
+		d_file.close();
+	}
+}
+
+void BatchCheckpoint::remove()
+{
+	if(d_file.isOpen())
+		d_file.close();
+
+	if(!d_file.fileName().isEmpty())
+		d_file.remove();
+}
+
+QString BatchCheckpoint::fileName(QtFTM::BatchType type, int num)
+{
+	QString savePath = ConfigService::instance().snapshot().savePath();
+	return QString("%1/checkpoints/%2-%3.ckpt").arg(savePath).arg(static_cast<int>(type)).arg(num);
+}
+
+QList<BatchCheckpoint::Info> BatchCheckpoint::available()
+{
+	QList<Info> out;
+	QString savePath = ConfigService::instance().snapshot().savePath();
+	QDir d(QString("%1/checkpoints").arg(savePath));
+	QFileInfoList files = d.entryInfoList(QStringList(QString("*.ckpt")),QDir::Files,QDir::Time);
+	for(int i=0; i<files.size(); i++)
+	{
+		QFile f(files.at(i).absoluteFilePath());
+		if(!f.open(QIODevice::ReadOnly))
+			continue;
+
+		QDataStream ds(&f);
+		ds.setVersion(QDataStream::Qt_5_0);
+		ds.setByteOrder(QDataStream::LittleEndian);
+		Info info;
+		QByteArray settings;
+		if(!readHeader(ds,info,settings))
+			continue;
+
+		info.scans = static_cast<int>((f.size() - f.pos())/static_cast<qint64>(sizeof(qint32)));
+		info.lastScan = files.at(i).lastModified();
+		out.append(info);
+	}
+
+	return out;
+}
+
+bool BatchCheckpoint::read(QtFTM::BatchType type, int num, Info &info, QByteArray &settings, QList<int> &scans)
+{
+	QFile f(fileName(type,num));
+	if(!f.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	if(!readHeader(ds,info,settings) || info.type != type || info.number != num)
+		return false;
+
+	//an incomplete number at the end was interrupted while it was being written
+	scans.clear();
+	while(f.size() - f.pos() >= static_cast<qint64>(sizeof(qint32)))
+	{
+		qint32 n;
+		ds >> n;
+		scans.append(n);
+	}
+
+	info.scans = scans.size();
+	info.lastScan = QFileInfo(f).lastModified();
+	return true;
+}
+
+void BatchCheckpoint::discard(QtFTM::BatchType type, int num)
+{
+	QFile::remove(fileName(type,num));
+}
+
+BatchManager *BatchCheckpoint::restore(QtFTM::BatchType type, int num, QString &error)
+{
+	Info info;
+	QByteArray settings;
+	QList<int> scans;
+	if(!read(type,num,info,settings,scans))
+	{
+		error = QString("Could not read checkpoint file %1.").arg(fileName(type,num));
+		return nullptr;
+	}
+
+	//common settings; see BatchManager::checkpointSettings()
+	QDataStream ds(settings);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	AbstractFitter *ftr = readFitter(ds);
+	bool sleep;
+	BatchManager::Limits pressure;
+	QList<BatchManager::Limits> flows;
+	qint32 numFlows;
+	ds >> sleep >> pressure.enabled >> pressure.min >> pressure.max >> numFlows;
+	for(int i=0; i<numFlows && ds.status() == QDataStream::Ok; i++)
+	{
+		BatchManager::Limits l;
+		ds >> l.enabled >> l.min >> l.max;
+		flows.append(l);
+	}
+
+	BatchManager *bm = nullptr;
+	if(ftr != nullptr && ds.status() == QDataStream::Ok)
+	{
+		switch(type)
+		{
+		case QtFTM::Survey:
+			bm = BatchSurvey::fromSettings(ds,ftr);
+			break;
+		case QtFTM::DrScan:
+			bm = BatchDR::fromSettings(ds,ftr);
+			break;
+		case QtFTM::Batch:
+			bm = Batch::fromSettings(ds,ftr);
+			break;
+		case QtFTM::DrCorrelation:
+			bm = DrCorrelation::fromSettings(ds,ftr);
+			break;
+		case QtFTM::Categorize:
+			bm = BatchCategorize::fromSettings(ds,ftr);
+			break;
+		case QtFTM::Amdor:
+			bm = AmdorBatch::fromSettings(ds,ftr);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if(bm == nullptr)
+	{
+		delete ftr;
+		error = QString("The settings in checkpoint file %1 could not be read.").arg(fileName(type,num));
+		return nullptr;
+	}
+
+	bm->setSleepWhenComplete(sleep);
+	if(pressure.enabled)
+		bm->setPressureLimits(pressure.min,pressure.max);
+	for(int i=0; i<flows.size(); i++)
+		bm->addFlowLimit(flows.at(i).enabled,flows.at(i).min,flows.at(i).max);
+	bm->setResumeScans(num,scans);
+
+	return bm;
+}
+
+void BatchCheckpoint::writeScan(QDataStream &ds, const Scan &s)
+{
+	//the pulse configuration is stored in the same format as in a scan file
+	QString pulses = QString("#Rep rate\t%1\tHz\n").arg(s.repRate(),0,'g',12) + s.pulseConfiguration().headerString();
+
+	ds << s.ftFreq() << static_cast<qint32>(s.attenuation()) << s.drFreq() << s.drPower() << s.dipoleMoment()
+	   << static_cast<qint32>(s.dcVoltage()) << s.magnet() << s.skipTune() << static_cast<qint32>(s.postTuneDelayShots())
+	   << static_cast<qint32>(s.protectionDelayTime()) << static_cast<qint32>(s.scopeDelayTime())
+	   << static_cast<qint32>(s.targetShots()) << pulses;
+}
+
+Scan BatchCheckpoint::readScan(QDataStream &ds)
+{
+	double ftFreq, drFreq, drPower, dipole;
+	qint32 attn, dc, postTune, protection, scope, shots;
+	bool magnet, skipTune;
+	QString pulses;
+	ds >> ftFreq >> attn >> drFreq >> drPower >> dipole >> dc >> magnet >> skipTune >> postTune
+	   >> protection >> scope >> shots >> pulses;
+
+	Scan out;
+	out.setFtFreq(ftFreq);
+	out.setAttenuation(attn);
+	out.setDrFreq(drFreq);
+	out.setDrPower(drPower);
+	out.setDipoleMoment(dipole);
+	out.setDcVoltage(dc);
+	out.setMagnet(magnet);
+	out.setSkiptune(skipTune);
+	out.setPostTuneDelayShots(postTune);
+	out.setProtectionDelayTime(protection);
+	out.setScopeDelayTime(scope);
+	out.setTargetShots(shots);
+	out.setPulseConfiguration(Scan::fromHeader(pulses,QVector<double>()).pulseConfiguration());
+
+	return out;
+}
+
+void BatchCheckpoint::writeFitter(QDataStream &ds, const AbstractFitter *f)
+{
+	ds << static_cast<qint32>(f->type()) << f->bufferGas().name << f->bufferGas().mass << f->bufferGas().gamma
+	   << f->temperature() << f->snrLimit() << f->delay() << f->hpf() << f->exp() << f->removeDC() << f->autoPad()
+	   << f->isUseWindow();
+}
+
+AbstractFitter *BatchCheckpoint::readFitter(QDataStream &ds)
+{
+	qint32 type;
+	FitResult::BufferGas bg;
+	double temperature, snr, delay, hpf, exp;
+	bool removeDC, autoPad, useWindow;
+	ds >> type >> bg.name >> bg.mass >> bg.gamma >> temperature >> snr >> delay >> hpf >> exp >> removeDC >> autoPad >> useWindow;
+	if(ds.status() != QDataStream::Ok)
+		return nullptr;
+
+	//same construction as AutoFitWidget::toFitter()
+	AbstractFitter *af;
+	if(type == static_cast<qint32>(FitResult::NoFitting))
+		af = new NoFitter();
+	else
+	{
+		af = new DopplerPairFitter();
+		af->setBufferGas(bg);
+		af->setTemperature(temperature);
+		af->setSnrLimit(snr);
+	}
+
+	af->setDelay(delay);
+	af->setHpf(hpf);
+	af->setExp(exp);
+	af->setRemoveDC(removeDC);
+	af->setAutoPad(autoPad);
+	af->setUseWindow(useWindow);
+
+	return af;
+}
+
+bool BatchCheckpoint::readHeader(QDataStream &ds, Info &info, QByteArray &settings)
+{
+	quint32 magic;
+	qint32 type, num;
+	qint64 started;
+	ds >> magic;
+	if(ds.status() != QDataStream::Ok || magic != checkpointMagic)
+		return false;
+
+	ds >> type >> num >> info.title >> started >> settings;
+	if(ds.status() != QDataStream::Ok)
+		return false;
+
+	info.type = static_cast<QtFTM::BatchType>(type);
+	info.number = num;
+	info.started = QDateTime::fromMSecsSinceEpoch(started);
+	info.scans = 0;
+	return true;
+}
@@ -0,0 +1,115 @@
+#ifndef BATCHCHECKPOINT_H
+#define BATCHCHECKPOINT_H
+
+#include <QString>
+#include <QFile>
+#include <QList>
+#include <QDateTime>
+#include <QDataStream>
+
+#include "datastructs.h"
+#include "scan.h"
+
+class BatchManager;
+class AbstractFitter;
+
+/*!
+ * \brief Records the progress of a batch acquisition so that it can be resumed after an interruption
+ *
+ * A checkpoint contains the settings needed to construct the batch again (see BatchManager::checkpointSettings()), followed by the number of each scan that has been processed.
+ * It is created when the batch begins, a scan number is appended and synced after every processed scan, and the checkpoint is removed when the batch completes normally.
+ * A resumed batch reopens its checkpoint with open() instead, so the scans it replays stay recorded; if the replay stops early, truncateScans() drops the scans that were not replayed.
+ * If the batch is aborted, or the program or a device stops during the batch, the checkpoint remains, and restore() creates a batch that continues where the checkpoint ends.
+ *
+ * The internal state of a batch (e.g., survey index, AMDOR trees, category test status) is not stored.
+ * Instead, the resumed batch replays the saved scans through the same steps as during acquisition (see BatchManager::beginBatch()), using the saved fit results, and rebuilds the state exactly without acquiring them again.
+ *
+ * Checkpoints are stored in savePath/checkpoints/t-n.ckpt, where t is the batch type and n is the batch number.
+ * The file begins with a header (magic number, batch type, number, title, start time, settings) written with QDataStream, followed by one qint32 per scan.
+ */
+class BatchCheckpoint
+{
+public:
+	struct Info {
+		QtFTM::BatchType type;
+		int number;
+		QString title;
+		QDateTime started;
+		QDateTime lastScan;
+		int scans;
+	};
+
+	BatchCheckpoint();
+	~BatchCheckpoint();
+
+	/*!
+	 * \brief Creates the checkpoint for a batch, replacing any existing one
+	 * \param type Batch type
+	 * \param num Batch number
+	 * \param title Batch title (e.g., "Survey 12")
+	 * \param settings Settings from BatchManager::checkpointSettings()
+	 * \return Whether the checkpoint was written
+	 */
+	bool create(QtFTM::BatchType type, int num, const QString title, const QByteArray settings);
+	/*!
+	 * \brief Opens an existing checkpoint so that more scans can be appended
+	 *
+	 * An incomplete scan number at the end of the file is removed.
+	 *
+	 * \param type Batch type
+	 * \param num Batch number
+	 * \return Whether the checkpoint was opened
+	 */
+	bool open(QtFTM::BatchType type, int num);
+	/*!
+	 * \brief Keeps only the first count scans, and syncs the file
+	 * \return Whether the file was truncated
+	 */
+	bool truncateScans(int count);
+	/*!
+	 * \brief Appends a processed scan
+	 * \param num Scan number
+	 * \param sync Whether to sync the file to disk
+	 * \return Whether the scan was recorded
+	 */
+	bool recordScan(int num, bool sync = true);
+	bool sync();
+	bool isOpen() const { return d_file.isOpen(); }
+	QString errorString() const { return d_error; }
+	void close();
+	/*!
+	 * \brief Closes and deletes the checkpoint (the batch is complete)
+	 */
+	void remove();
+
+	static QString fileName(QtFTM::BatchType type, int num);
+	/*!
+	 * \brief Lists the checkpoints of batches that can be resumed, most recent first
+	 */
+	static QList<Info> available();
+	static bool read(QtFTM::BatchType type, int num, Info &info, QByteArray &settings, QList<int> &scans);
+	static void discard(QtFTM::BatchType type, int num);
+	/*!
+	 * \brief Creates a batch that will resume from a checkpoint when it begins
+	 * \param type Batch type
+	 * \param num Batch number
+	 * \param error Set to a description of the problem if the batch could not be created
+	 * \return The batch, or nullptr
+	 */
+	static BatchManager *restore(QtFTM::BatchType type, int num, QString &error);
+
+	static void writeScan(QDataStream &ds, const Scan &s);
+	static Scan readScan(QDataStream &ds);
+	static void writeFitter(QDataStream &ds, const AbstractFitter *f);
+	static AbstractFitter *readFitter(QDataStream &ds);
+
+private:
+	QFile d_file;
+	QString d_error;
+	qint64 d_headerSize;
+
+	static bool readHeader(QDataStream &ds, Info &info, QByteArray &settings);
+
+};
+
+#endif // BATCHCHECKPOINT_H
@@ -1,8 +1,9 @@
 #include "batchdr.h"
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
 
 #include "analysis.h"
+#include "batchreportwriter.h"
+#include "batchcheckpoint.h"
 
 BatchDR::BatchDR(Scan ftScan, double start, double stop, double step, int numScansBetween, QList<QPair<double, double> > ranges, bool doCal, AbstractFitter *f) :
     BatchManager(QtFTM::DrScan,false,f), d_template(ftScan), d_start(start), d_stop(stop), d_numScansBetween (0), d_integrationRanges(ranges),
@@ -55,6 +56,21 @@ BatchDR::BatchDR(Scan ftScan, double start, double stop, double step, int numSca
     }
 }
 
+BatchDR *BatchDR::fromSettings(QDataStream &ds, AbstractFitter *ftr)
+{
+	Scan ftScan = BatchCheckpoint::readScan(ds);
+	double start, stop, step;
+	qint32 numScansBetween;
+	QList<QPair<double,double> > ranges;
+	bool doCal;
+	ds >> start >> stop >> step >> numScansBetween >> ranges >> doCal;
+
+	if(ds.status() != QDataStream::Ok)
+		return nullptr;
+
+	return new BatchDR(ftScan,start,stop,step,numScansBetween,ranges,doCal,ftr);
+}
+
 BatchDR::BatchDR(int num, AbstractFitter *ftr) : BatchManager(QtFTM::DrScan,true,ftr), d_completedScans(0)
 {
     d_prettyName = QString("DR Scan");
@@ -64,8 +80,7 @@ BatchDR::BatchDR(int num, AbstractFitter *ftr) : BatchManager(QtFTM::DrScan,true
     int drMillions = (int)floor((double)drNum/1000000.0);
     int drThousands = (int)floor((double)drNum/1000.0);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/dr/%1/%2").arg(drMillions).arg(drThousands));
 
     //create output file
@@ -177,6 +192,14 @@ BatchDR::BatchDR(int num, AbstractFitter *ftr) : BatchManager(QtFTM::DrScan,true
         }
     }
 
+    //if the scan did not finish, the scan list was never written; use the journal instead
+    if(d_loadScanList.isEmpty())
+    {
+        QList<QPair<int,bool>> j = BatchReportWriter::journalScans(f.fileName());
+        for(int i=0; i<j.size(); i++)
+            d_loadScanList.append(j.at(i).first);
+    }
+
     d_numScans = d_loadScanList.size();
 
     //reserve space for data storage
@@ -274,20 +297,20 @@ void BatchDR::advanceBatch(const Scan s)
 
 void BatchDR::processScan(Scan s)
 {
+    if(!d_loading)
+    {
+        if(!d_report.isOpen())
+            openReport(QString("dr"),makeHeader(),makeColumnTitles());
+        recordReportScan(s.number(),d_processScanIsCal);
+    }
+
     d_scanNumbers.append(s.number());
 
-    //do the FT
-    QVector<QPointF> ft = d_fitter->doStandardFT(s.fid()).first;
-    double ftSpacing = ft.at(1).x() - ft.at(0).x();
+    //only the parts of the FT that are integrated are calculated
+    QList<QVector<QPointF>> bands = d_fitter->doBandFT(s.fid(),d_integrationRanges);
 
-    FitResult res;
-    if(d_loading && d_fitter->type() == FitResult::NoFitting)
-        res = FitResult(s.number());
-    else
-        res = d_fitter->doFit(s);
-
-    if(d_fitter->type() != FitResult::NoFitting && res.category() != FitResult::Saturated && res.category() != FitResult::Invalid)
-        ft = Analysis::removeBaseline(ft,res.baselineY0Slope().first,res.baselineY0Slope().second,s.fid().probeFreq());
+    FitResult res = fitScan(s);
+    bool removeBaseline = d_fitter->type() != FitResult::NoFitting && res.category() != FitResult::Saturated && res.category() != FitResult::Invalid;
 
     bool badTune = s.tuningVoltage() <= 0;
 
@@ -298,6 +321,21 @@ void BatchDR::processScan(Scan s)
         double xMax = d_integrationRanges.at(i).second;
         double integral = 0.0;
 
+        //each band has one extra point below and two above the range, so the indices below match those of the full FT
+        QVector<QPointF> ft = bands.at(i);
+        if(ft.size() < 2)
+        {
+            if(d_processScanIsCal)
+                d_cal[i].append(integral);
+            else
+                d_dr[i].append(integral);
+            continue;
+        }
+
+        if(removeBaseline)
+            ft = Analysis::removeBaseline(ft,res.baselineY0Slope().first,res.baselineY0Slope().second,s.fid().probeFreq());
+        double ftSpacing = ft.at(1).x() - ft.at(0).x();
+
         int firstIndex = (int)ceil((xMin-ft.at(0).x())/ftSpacing);
         int lastIndex = (int)floor((xMax-ft.at(0).x())/ftSpacing);
 
@@ -401,6 +439,9 @@ void BatchDR::processScan(Scan s)
             QtFTM::BatchPlotMetaData md(QtFTM::DrScan,s.number(),plotStart,plotEnd,false,badTune);
             emit plotData(md,d_drData);
         }
+
+        if(!d_loading)
+            appendToReport(makeRow(d_processingIndex));
     }
 
 }
@@ -408,49 +449,67 @@ void BatchDR::processScan(Scan s)
 
 void BatchDR::writeReport()
 {
-	if(d_drData.at(0).isEmpty())
-	{
-		emit logMessage(QString("Did not create DR scan report because no DR scans were completed."),QtFTM::LogWarning);
-		return;
-	}
+	//the rows were written as the scans were processed; only the list of scans remains
+	QString trailer;
+	QTextStream t(&trailer);
+	QString tab = QString("\t");
+	QString nl = QString("\n");
 
-	//figure out where to save the data
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	int drNum = s.value(d_numKey,1).toInt();
-	int drMillions = (int)floor((double)drNum/1000000.0);
-	int drThousands = (int)floor((double)drNum/1000.0);
+	//make list of scans
+	t << nl << nl;
+	if(d_hasCalibration)
+		t << QString("drcalscans") << d_batchNum << tab;
 
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-	QDir d(savePath + QString("/dr/%1/%2").arg(drMillions).arg(drThousands));
+	t << QString("drscans") << d_batchNum;
 
-	if(!d.exists())
+	for(int i=0; i<d_scanNumbers.size(); i++)
 	{
-		if(!d.mkpath(d.absolutePath()))
+		if(d_hasCalibration)
 		{
-			emit logMessage(QString("Could not create directory for saving DR scan! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-			return;
+			if(i%2==0)
+				t << nl << d_scanNumbers.at(i);
+			else
+				t << tab << d_scanNumbers.at(i);
 		}
+		else
+			t << nl << d_scanNumbers.at(i);
 	}
 
-	//create output file
-	QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(drNum));
+	t.flush();
+	finishReport(makeHeader(),trailer);
+}
+
+bool BatchDR::writeSettings(QDataStream &ds) const
+{
+	BatchCheckpoint::writeScan(ds,d_template);
+	ds << d_start << d_stop << fabs(d_step) << static_cast<qint32>(d_numScansBetween) << d_integrationRanges << d_hasCalibration;
+
+	return true;
+
+}
+
+QString BatchDR::makeHeader()
+{
+	QString out;
 	QTextStream t(&out);
 	QString tab = QString("\t");
 	QString nl = QString("\n");
 
-	if(!out.open(QIODevice::WriteOnly))
-	{
-		emit logMessage(QString("Could not open file for writing DR data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-		return;
-	}
-
 	t.setRealNumberNotation(QTextStream::FixedNotation);
 	t.setRealNumberPrecision(4);
-	//header stuff
-	t << QString("#DR scan") << tab << drNum << tab << nl;
+	t << QString("#DR scan") << tab << d_batchNum << tab << nl;
 	t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
-	t << QString("#Start freq") << tab << d_drData.at(0).at(0).x() << QString("\tMHz\n");
-	t << QString("#End freq") << tab << d_drData.at(0).at(d_drData.at(0).size()-1).x() << QString("\tMHz\n");
+	//until the first DR scan has been processed, the planned range is shown
+	if(d_drData.at(0).isEmpty())
+	{
+		t << QString("#Start freq") << tab << d_start << QString("\tMHz\n");
+		t << QString("#End freq") << tab << d_stop << QString("\tMHz\n");
+	}
+	else
+	{
+		t << QString("#Start freq") << tab << d_drData.at(0).at(0).x() << QString("\tMHz\n");
+		t << QString("#End freq") << tab << d_drData.at(0).at(d_drData.at(0).size()-1).x() << QString("\tMHz\n");
+	}
 	t << QString("#Step size") << tab << d_step << QString("\tMHz\n");
     t << QString("#Scans between each reading of tuning voltage")<< tab << d_numScansBetween << QString("\t\n");
 	t << QString("#FT freq") << tab << d_template.ftFreq() << QString("\tMHz\n");
@@ -472,82 +531,71 @@ void BatchDR::writeReport()
 	t << QString("#FID zero padding") << tab << (d_fitter->autoPad() ? QString("Yes") : QString("No")) << tab << nl;
 	t << QString("#Autofit Enabled") << tab << (d_fitter->type() == FitResult::NoFitting ? QString("No") : QString("Yes")) << tab << nl;
 
-	t << nl;
-	t.setRealNumberNotation(QTextStream::ScientificNotation);
-	t.setRealNumberPrecision(6);
+	t.flush();
+	return out;
+}
+
+QString BatchDR::makeColumnTitles()
+{
+	QString out;
+	QTextStream t(&out);
+	QString tab = QString("\t");
 
 	//make header line
-	t << QString("drfreq") << drNum;
+	t << QString("\ndrfreq") << d_batchNum;
 	for(int i=0; i<d_integrationRanges.size(); i++)
 	{
-		t << tab << QString("dr") << i << QString("int") << drNum;
+		t << tab << QString("dr") << i << QString("int") << d_batchNum;
 		if(d_hasCalibration)
 		{
 			//we have cal data, so we want to add the raw and cal data
-			t << tab << QString("dr") << i << QString("rawint") << drNum;
-			t << tab << QString("dr") << i << QString("calint") << drNum;
+			t << tab << QString("dr") << i << QString("rawint") << d_batchNum;
+			t << tab << QString("dr") << i << QString("calint") << d_batchNum;
 		}
 	}
 
-	for(int i=0; i<d_drData.at(0).size(); i++) // loop over first data vector to get row # (i)
-	{
-		//record frequency
-		t << nl << QString::number(d_drData.at(0).at(i).x(),'f',4);
-
-		//loop over list of ranges, and grab the y data of each point (column # is j)
-		for(int j=0; j<d_drData.size(); j++)
-		{
-			//this should never be an issue, but make sure we don't run over an index that is not explicitly checked
-			//all data vectors are created at the same time, so they should always be the same length
-			//nevertheless, don't want to cause a crash if something goes wrong...
-			if(i<d_drData.at(j).size())
-				t << tab << d_drData.at(j).at(i).y();
-			else
-				t << tab << 0.0;
-
-			if(d_hasCalibration)
-			{
-				//then the raw integral
-				if(i<d_dr.at(j).size())
-					t << tab << d_dr.at(j).at(i);
-				else
-					t << tab << 0.0;
-
-				//then the cal integral
-				if(i<d_cal.at(j).size())
-					t << tab << d_cal.at(j).at(i);
-				else
-					t << tab << 0.0;
-			}
-		}
+	t.flush();
+	return out;
+}
 
-	}
+QString BatchDR::makeRow(int i)
+{
+	QString out;
+	QTextStream t(&out);
+	QString tab = QString("\t");
 
-	//make list of scans
-	t << nl << nl;
-	if(d_hasCalibration)
-		t << QString("drcalscans") << drNum << tab;
+	t.setRealNumberNotation(QTextStream::ScientificNotation);
+	t.setRealNumberPrecision(6);
 
-	t << QString("drscans") << drNum;
+	//record frequency
+	t << QString("\n") << QString::number(d_drData.at(0).at(i).x(),'f',4);
 
-	for(int i=0; i<d_scanNumbers.size(); i++)
+	//loop over list of ranges, and grab the y data of each point (column # is j)
+	for(int j=0; j<d_drData.size(); j++)
 	{
+		//all data vectors are created at the same time, so they should always be the same length
+		//nevertheless, don't want to cause a crash if something goes wrong...
+		if(i<d_drData.at(j).size())
+			t << tab << d_drData.at(j).at(i).y();
+		else
+			t << tab << 0.0;
+
 		if(d_hasCalibration)
 		{
-			if(i%2==0)
-				t << nl << d_scanNumbers.at(i);
+			//then the raw integral
+			if(i<d_dr.at(j).size())
+				t << tab << d_dr.at(j).at(i);
 			else
-				t << tab << d_scanNumbers.at(i);
+				t << tab << 0.0;
+
+			//then the cal integral
+			if(i<d_cal.at(j).size())
+				t << tab << d_cal.at(j).at(i);
+			else
+				t << tab << 0.0;
 		}
-		else
-			t << nl << d_scanNumbers.at(i);
 	}
 
 	t.flush();
-	out.close();
-
-	//increment DR scan number
-	s.setValue(d_numKey,drNum+1);
-	s.sync();
-
+	return out;
 }
@@ -13,6 +13,7 @@
  * The ranges list in the constructor contains the regions that should be integrated.
  * In the report, lists of the DR and calibration scans are listed, along with XY arrays of the ratioed data, signal integrals, and calibration integrals vs frequency (if there is no calibration, then just the signal vs frequency is given.
  * DR scan reports are stored in savePath/dr/x/y/z.txt, where z is the drScan number, y are the thousands digits, and x are the millions digits (though it's unlikely that will ever go above 0!)
+ * A row is appended to the report as each DR scan is processed; the scan list is written when the scan ends.
  *
  */
 class BatchDR : public BatchManager
@@ -22,6 +23,8 @@ public:
     explicit BatchDR(Scan ftScan, double start, double stop, double step, int numScansBetween, QList<QPair<double,double> > ranges, bool doCal, AbstractFitter *f = new NoFitter());
 	explicit BatchDR(int num, AbstractFitter *ftr = new NoFitter());
 
+	static BatchDR *fromSettings(QDataStream &ds, AbstractFitter *ftr);
+
 	int numScans() const { return d_numScans; }
 	QList<QPair<double,double> > integrationRanges() const { return d_integrationRanges; }
 	
@@ -35,6 +38,7 @@ protected:
     void advanceBatch(const Scan s);
 	void processScan(Scan s);
 	void writeReport();
+	bool writeSettings(QDataStream &ds) const;
 
 private:
 	Scan d_template;
@@ -51,6 +55,10 @@ private:
 	QList<QVector<double> > d_cal;
 	QList<QVector<double> > d_dr;
 	QList<int> d_scanNumbers;
+
+	QString makeHeader();
+	QString makeColumnTitles();
+	QString makeRow(int i);
 	
 };
 
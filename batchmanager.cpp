@@ -1,9 +1,27 @@
 #include "batchmanager.h"
 #include <QSettings>
 #include <QApplication>
+#include <QFileInfo>
+
+#include "numberallocator.h"
+#include "scanrepository.h"
+#include "fitresultstore.h"
+#include "configservice.h"
+#include "batchcheckpoint.h"
+
+namespace {
+
+//frequencies may be rounded by the synthesizers
+const double freqTolerance = 0.005;
+//DR power (dB) may be rounded by the synthesizer
+const double powerTolerance = 0.05;
+//pulse delays and widths (us) may be rounded by the pulse generator
+const double pulseTolerance = 0.01;
+
+}
 
 BatchManager::BatchManager(QtFTM::BatchType b, bool load, AbstractFitter *ftr) :
-    QObject(), d_batchType(b), d_fitter(ftr), d_batchNum(-1), d_loading(load), d_thisScanIsCal(false), d_sleep(false)
+    QObject(), d_batchType(b), d_fitter(ftr), d_batchNum(-1), d_loading(load), d_thisScanIsCal(false), d_sleep(false), d_resuming(false), d_deferFitWrites(false), d_reportFailed(false), d_checkpointFailed(false), d_checkpointReopened(false)
 {
 	///TODO: Make name and key static public functions taking a QtFTM::BatchType as argument
  ///this will make the strings only exist in one place in the code!
@@ -42,14 +60,12 @@ BatchManager::BatchManager(QtFTM::BatchType b, bool load, AbstractFitter *ftr) :
 	}
 
 	if(!d_loading && !d_numKey.isEmpty())
-	{
-		QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-		d_batchNum = s.value(d_numKey,1).toInt();
-	}
+		d_batchNum = NumberAllocator::instance().next(d_numKey);
 }
 
 BatchManager::~BatchManager()
 {
+    finishFitWrites();
 	delete d_fitter;
 }
 
@@ -123,6 +139,8 @@ void BatchManager::scanComplete(const Scan s)
 
         //process the scan now that next scan has started
         processScan(s);
+        reportFitWriteErrors();
+        checkpointScan(s);
         if(!s.isDummy())
             emit processingComplete(s);
 	}
@@ -136,10 +154,17 @@ void BatchManager::scanComplete(const Scan s)
 		}
 
         processScan(s);
+        reportFitWriteErrors();
+        if(!s.isAborted())
+            checkpointScan(s);
         if(!s.isDummy())
             emit processingComplete(s);
         writeReport();
 
+        //an aborted batch keeps its checkpoint so that it can be resumed later
+        if(!s.isAborted())
+            d_checkpoint.remove();
+
         stopBatch(s.isAborted(),d_sleep);
 	}
 
@@ -147,11 +172,19 @@ void BatchManager::scanComplete(const Scan s)
 
 void BatchManager::beginBatch()
 {
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	int firstScanNum = s.value(QString("scanNum"),0).toInt()+1;
+	int firstScanNum = NumberAllocator::instance().lastScanNumber()+1;
 
-    if(d_batchType != QtFTM::SingleScan && !d_loading)
+    if(d_batchType != QtFTM::SingleScan && !d_loading && !d_resuming)
     {
+        //the batch number is reserved now, so that no other batch can use it while this one is running
+        if(!d_numKey.isEmpty())
+        {
+            int num = NumberAllocator::instance().allocate(d_numKey);
+            if(num > 0)
+                d_batchNum = num;
+            else
+                emit logMessage(QString("Could not reserve %1 number. Using %2.").arg(d_prettyName).arg(d_batchNum),QtFTM::LogWarning);
+        }
 
 	   if(d_batchType != QtFTM::Attenuation)
        {
@@ -166,13 +199,74 @@ void BatchManager::beginBatch()
 
     emit titleReady(title());
 
-    if(!d_loading)
+    //fit results are written in groups while the batch runs
+    FitResultStore::instance().beginDeferredWrites();
+    d_deferFitWrites = true;
+
+    if(d_loading)
+        loadBatch();
+    else
     {
-        Scan next = prepareNextScan();
-        emit beginScan(next,d_thisScanIsCal);
+        //the checkpoint must be written before prepareNextScan() changes the state of the batch.
+        //A resumed batch keeps its checkpoint, so the scans it replays are never lost from it
+        if(d_resuming)
+            reopenCheckpoint();
+        else if(d_batchType != QtFTM::SingleScan)
+            createCheckpoint();
+
+        if(d_resuming)
+            resumeBatch();
+        else
+        {
+            Scan next = prepareNextScan();
+            emit beginScan(next,d_thisScanIsCal);
+        }
     }
-    else
-        loadBatch();
+}
+
+QByteArray BatchManager::checkpointSettings() const
+{
+    QByteArray out;
+    QDataStream ds(&out,QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_0);
+    ds.setByteOrder(QDataStream::LittleEndian);
+
+    //common settings are read back by BatchCheckpoint::restore()
+    BatchCheckpoint::writeFitter(ds,d_fitter);
+    ds << d_sleep << d_pressureLimits.enabled << d_pressureLimits.min << d_pressureLimits.max;
+    ds << static_cast<qint32>(d_flowLimits.size());
+    for(int i=0; i<d_flowLimits.size(); i++)
+        ds << d_flowLimits.at(i).enabled << d_flowLimits.at(i).min << d_flowLimits.at(i).max;
+
+    if(!writeSettings(ds))
+        return QByteArray();
+
+    return out;
+}
+
+void BatchManager::setResumeScans(int num, const QList<int> scans)
+{
+    d_batchNum = num;
+    d_resumeScans = scans;
+    d_resuming = true;
+}
+
+bool BatchManager::writeSettings(QDataStream &ds) const
+{
+    Q_UNUSED(ds)
+    return false;
+}
+
+FitResult BatchManager::fitScan(const Scan s)
+{
+    //when loading without refitting, or replaying the scans of a resumed batch, the saved result is used
+    if(d_loading && d_fitter->type() == FitResult::NoFitting)
+        return loadedFitResult(s.number());
+
+    if(d_resuming && d_loadedFits.contains(s.number()))
+        return d_loadedFits.value(s.number());
+
+    return d_fitter->doFit(s);
 }
 
 bool BatchManager::checkAbortConditions(const Scan s)
@@ -216,9 +310,15 @@ void BatchManager::loadBatch()
 {
     if(d_batchType != QtFTM::Attenuation)
     {
+        //when the fits are not being redone, all saved results are read at once
+        if(d_fitter->type() == FitResult::NoFitting)
+            d_loadedFits = FitResultStore::instance().load(d_loadScanList);
+
         for(int i=0;i<d_loadScanList.size(); i++)
         {
-            Scan s(d_loadScanList.at(i));
+            //the next scans are read on the prefetch thread while this one is processed
+            ScanRepository::instance().prefetch(d_loadScanList.mid(i+1,2));
+            Scan s = ScanRepository::instance().get(d_loadScanList.at(i));
             if(s.number() < 1)
             {
                 stopBatch(true,false);
@@ -228,6 +328,8 @@ void BatchManager::loadBatch()
             processScan(s);
             emit processingComplete(s);
         }
+        d_loadedFits.clear();
+        finishFitWrites();
         //if there was nothing in the scan list there was a loading error, and the UI will display an error message
         emit batchComplete(d_loadScanList.isEmpty());
     }
@@ -240,8 +342,232 @@ void BatchManager::loadBatch()
     }
 }
 
+void BatchManager::createCheckpoint()
+{
+    QByteArray settings = checkpointSettings();
+    if(settings.isEmpty())
+        return;
+
+    if(!d_checkpoint.create(d_batchType,d_batchNum,title(),settings))
+    {
+        emit logMessage(QString("Could not create checkpoint for %1 %2 (%3). It will not be possible to resume it if it is interrupted.").arg(d_prettyName).arg(d_batchNum).arg(d_checkpoint.errorString()),QtFTM::LogWarning);
+        d_checkpointFailed = true;
+    }
+}
+
+void BatchManager::reopenCheckpoint()
+{
+    if(d_checkpoint.open(d_batchType,d_batchNum))
+    {
+        d_checkpointReopened = true;
+        return;
+    }
+
+    //the replayed scans are recorded again in a new checkpoint
+    emit logMessage(QString("Could not reopen checkpoint for %1 %2 (%3). A new checkpoint will be created.").arg(d_prettyName).arg(d_batchNum).arg(d_checkpoint.errorString()),QtFTM::LogWarning);
+    createCheckpoint();
+}
+
+void BatchManager::checkpointScan(const Scan s)
+{
+    if(!d_checkpoint.isOpen() || s.isDummy() || s.number() < 1)
+        return;
+
+    //scans that are replayed from a reopened checkpoint are already in it
+    if(d_resuming && d_checkpointReopened)
+        return;
+
+    if(!d_checkpoint.recordScan(s.number()) && !d_checkpointFailed)
+    {
+        emit logMessage(QString("Could not update checkpoint for %1 %2 (%3).").arg(d_prettyName).arg(d_batchNum).arg(d_checkpoint.errorString()),QtFTM::LogWarning);
+        d_checkpointFailed = true;
+    }
+}
+
+void BatchManager::resumeBatch()
+{
+    emit logMessage(QString("Resuming %1 %2. Replaying %3 saved scans.").arg(d_prettyName).arg(d_batchNum).arg(d_resumeScans.size()),QtFTM::LogHighlight);
+
+    //the fits are not repeated; the results saved when the scans were first processed give the same decisions
+    if(d_fitter->type() != FitResult::NoFitting)
+        d_loadedFits = FitResultStore::instance().load(d_resumeScans);
+
+    //same sequence as scanComplete(), except that the next scan is compared with the saved one instead of being acquired
+    Scan next = prepareNextScan();
+    int replayed = 0;
+    for(int i=0; i<d_resumeScans.size(); i++)
+    {
+        ScanRepository::instance().prefetch(d_resumeScans.mid(i+1,2));
+        Scan s = ScanRepository::instance().get(d_resumeScans.at(i));
+        if(s.number() < 1 || !isSameMeasurement(s,next))
+        {
+            emit logMessage(QString("Saved scan %1 could not be replayed. %2 %3 will continue from that point.").arg(d_resumeScans.at(i)).arg(d_prettyName).arg(d_batchNum),QtFTM::LogWarning);
+            break;
+        }
+
+        advanceBatch(s);
+        replayed++;
+        if(isBatchComplete())
+        {
+            //the batch was interrupted after its last scan
+            processScan(s);
+            checkpointScan(s);
+            emit processingComplete(s);
+            d_loadedFits.clear();
+            d_resuming = false;
+            emit logMessage(QString("%1 %2 complete. Final scan: %3.").arg(d_prettyName).arg(d_batchNum).arg(s.number()),QtFTM::LogHighlight);
+            writeReport();
+            d_checkpoint.remove();
+            stopBatch(false,d_sleep);
+            return;
+        }
+
+        next = prepareNextScan();
+        processScan(s);
+        checkpointScan(s);
+        emit processingComplete(s);
+    }
+
+    d_loadedFits.clear();
+    d_resuming = false;
+
+    //saved scans after the one that could not be replayed will be acquired again
+    bool ok = d_checkpointReopened ? d_checkpoint.truncateScans(replayed) : d_checkpoint.sync();
+    if(!ok && d_checkpoint.isOpen() && !d_checkpointFailed)
+    {
+        emit logMessage(QString("Could not update checkpoint for %1 %2 (%3).").arg(d_prettyName).arg(d_batchNum).arg(d_checkpoint.errorString()),QtFTM::LogWarning);
+        d_checkpointFailed = true;
+    }
+
+    emit logMessage(QString("Replayed %1 scans. Acquisition of %2 %3 continues.").arg(replayed).arg(d_prettyName).arg(d_batchNum),QtFTM::LogHighlight);
+    emit beginScan(next,d_thisScanIsCal);
+}
+
+bool BatchManager::isSameMeasurement(const Scan saved, const Scan planned)
+{
+    //every setting that prepareNextScan() can choose must match.
+    //Only settings that the hardware manager does not replace with its own choice are compared
+    if(qAbs(saved.ftFreq() - planned.ftFreq()) > freqTolerance)
+        return false;
+
+    //the attenuation is recalculated from the tuning voltage when a dipole moment is given
+    if(planned.dipoleMoment() <= 0.005 && saved.attenuation() != planned.attenuation())
+        return false;
+
+    if(saved.dcVoltage() != planned.dcVoltage() || saved.magnet() != planned.magnet())
+        return false;
+
+    PulseGenConfig sp = saved.pulseConfiguration();
+    PulseGenConfig pp = planned.pulseConfiguration();
+    if(sp.size() != pp.size())
+        return false;
+
+    for(int i=0; i<pp.size(); i++)
+    {
+        QtFTM::PulseChannelConfig sc = sp.at(i);
+        QtFTM::PulseChannelConfig pc = pp.at(i);
+        if(sc.enabled != pc.enabled)
+            return false;
+        if(!pc.enabled)
+            continue;
+        if(qAbs(sc.delay - pc.delay) > pulseTolerance)
+            return false;
+        //the pulse generator keeps its own gas pulse width
+        if(i != QTFTM_PGEN_GASCHANNEL && qAbs(sc.width - pc.width) > pulseTolerance)
+            return false;
+    }
+
+    if(pp.isDrEnabled())
+    {
+        if(qAbs(saved.drFreq() - planned.drFreq()) > freqTolerance)
+            return false;
+        if(qAbs(saved.drPower() - planned.drPower()) > powerTolerance)
+            return false;
+    }
+
+    return true;
+}
+
+FitResult BatchManager::loadedFitResult(int num) const
+{
+    if(d_loadedFits.contains(num))
+        return d_loadedFits.value(num);
+
+    return FitResult(num);
+}
+
+QString BatchManager::reportFileName(const QString dirName) const
+{
+    int batchMillions = d_batchNum/1000000;
+    int batchThousands = d_batchNum/1000;
+
+    QString savePath = ConfigService::instance().snapshot().savePath();
+    return QString("%1/%2/%3/%4/%5.txt").arg(savePath).arg(dirName).arg(batchMillions).arg(batchThousands).arg(d_batchNum);
+}
+
+bool BatchManager::openReport(const QString dirName, const QString header, const QString preamble)
+{
+    //don't try again after a failure was reported
+    if(d_reportFailed)
+        return false;
+
+    QString fileName = reportFileName(dirName);
+    QDir d = QFileInfo(fileName).absoluteDir();
+    if(!d.exists())
+    {
+        if(!d.mkpath(d.absolutePath()))
+        {
+            emit logMessage(QString("Could not create directory for saving %1 report! Creation of %2 failed, and data will not be saved!").arg(d_prettyName).arg(d.absolutePath()),QtFTM::LogError);
+            d_reportFailed = true;
+            return false;
+        }
+    }
+
+    if(!d_report.open(fileName,header,preamble))
+    {
+        emit logMessage(QString("Could not open file for writing %1 data! Creation of %2 failed (%3), and data will not be saved!").arg(d_prettyName).arg(fileName).arg(d_report.errorString()),QtFTM::LogError);
+        d_reportFailed = true;
+        return false;
+    }
+
+    return true;
+}
+
+void BatchManager::appendToReport(const QString text)
+{
+    if(!d_report.append(text) && !d_reportFailed)
+    {
+        //only complain once; the remaining scans will still be plotted
+        emit logMessage(QString("Could not write to %1 report %2 (%3).").arg(d_prettyName).arg(d_report.fileName()).arg(d_report.errorString()),QtFTM::LogError);
+        d_reportFailed = true;
+    }
+}
+
+void BatchManager::recordReportScan(int num, bool isCal)
+{
+    if(!d_report.recordScan(num,isCal) && !d_reportFailed)
+    {
+        emit logMessage(QString("Could not write to %1 report %2 (%3).").arg(d_prettyName).arg(d_report.fileName()).arg(d_report.errorString()),QtFTM::LogError);
+        d_reportFailed = true;
+    }
+}
+
+void BatchManager::finishReport(const QString header, const QString trailer)
+{
+    if(!d_report.isOpen())
+    {
+        if(!d_reportFailed)
+            emit logMessage(QString("Did not create %1 report because no scans were completed.").arg(d_prettyName),QtFTM::LogWarning);
+        return;
+    }
+
+    if(!d_report.finish(header,trailer))
+        emit logMessage(QString("Could not complete %1 report %2 (%3). The data written so far were kept.").arg(d_prettyName).arg(d_report.fileName()).arg(d_report.errorString()),QtFTM::LogError);
+}
+
 void BatchManager::stopBatch(bool aborted, bool sleep)
 {
+    finishFitWrites();
     emit batchComplete(aborted);
     if(sleep)
         emit sleepSignal();
@@ -257,3 +583,20 @@ QList<QPair<QString, QtFTM::BatchType> > BatchManager::typeList()
 
     return out;
 }
+
+void BatchManager::finishFitWrites()
+{
+    if(d_deferFitWrites)
+    {
+        d_deferFitWrites = false;
+        FitResultStore::instance().endDeferredWrites();
+        reportFitWriteErrors();
+    }
+}
+
+void BatchManager::reportFitWriteErrors()
+{
+    QString err = FitResultStore::instance().takeError();
+    if(!err.isEmpty())
+        emit logMessage(QString("Fit results could not be saved: %1 They are kept in memory and will be written again with the next fit result.").arg(err),QtFTM::LogError);
+}
@@ -4,9 +4,12 @@
 #include <QObject>
 #include <QFile>
 #include <QDir>
+#include <QHash>
 #include "datastructs.h"
 #include "scan.h"
 #include "nofitter.h"
+#include "batchreportwriter.h"
+#include "batchcheckpoint.h"
 #include <QTextStream>
 #include <QSettings>
 #include <QApplication>
@@ -29,7 +32,9 @@
  The prepareScan function should create the next scan object in the series and return it.
  In processScan, any analysis should be performed, and the results sent to the batch plot via the plotData signal.
  The acquisition finishes when isBatchComplete() returns true or a scan is aborted, and the writeReport function is then called.
- This function should usually generate a report in its own folder.
+ Reports are written while the batch runs: the report is opened with openReport() when the first scan is processed, processScan appends each scan's rows with appendToReport(), and writeReport completes the header and trailer with finishReport() (see BatchReportWriter).
+ Batches whose subclass implements writeSettings() keep a checkpoint (see BatchCheckpoint) that lists the processed scans, so that an interrupted batch can be resumed.
+ When resuming, the saved scans are passed through advanceBatch, prepareNextScan, and processScan as if they had just been acquired, so these functions must not depend on anything other than the scans and the constructor arguments. Fits should be done with fitScan().
 
  Data sent to the UI is in the form of a list of vectors of points.
  For most acquisitions, the list will only have a single vector with XY data.
@@ -114,6 +119,22 @@ public:
     int number() { return d_batchNum; }
     void setPressureLimits(double min, double max);
     void addFlowLimit(bool enabled, double min, double max);
+
+    /*!
+     \brief Serializes the settings needed to construct this batch again (see BatchCheckpoint)
+
+     \return QByteArray Settings, or an empty array if this type of batch cannot be resumed
+    */
+    QByteArray checkpointSettings() const;
+    /*!
+     \brief Makes the batch resume instead of starting from the beginning
+
+     When the batch begins, the saved scans are replayed in order without being acquired, and acquisition continues with the first scan that was not saved.
+
+     \param num Batch number
+     \param scans Scans that were processed before the batch was interrupted
+    */
+    void setResumeScans(int num, const QList<int> scans);
 	
 signals:
 	/*!
@@ -172,18 +193,19 @@ public slots:
 protected:
 	QtFTM::BatchType d_batchType; /*!< Type of acquisition */
 
-	QString d_numKey; /*!< Key in settings file for the batch count. Used to display batch number on log upon completion. Not needed for SingleScan */
+	QString d_numKey; /*!< NumberAllocator key for the batch count. Not needed for SingleScan */
 
 	QString d_prettyName; /*!< Type of acquisition in pretty printable text. Not needed for SingleScan */
 
 	int d_totalShots; /*!< Total number of shots to be collected for acquisition. Used for UI batch progress bar. */
 
 	/*!
-	 \brief Generates report for batch.
+	 \brief Completes report for batch.
 
-	 This function should generate a report (except SingleScan) in savePath/x/y/z, where x is a string unique for the type (presently, survey, dr, and batch), x is the millions digit, and y is the thousands digit.
-	 The file name should be num.txt, and the value of num comes from the settings key stored in d_numKey.
-	 This function should increment that number in the settings when the save is successfully completed.
+	 The report (except SingleScan) is in savePath/x/y/z, where x is a string unique for the type (presently, survey, dr, and batch), x is the millions digit, and y is the thousands digit.
+	 The file name should be num.txt, where num is d_batchNum.
+	 The number is reserved from the NumberAllocator (key d_numKey) when the batch begins, so this function does not need to increment it.
+	 Rows have already been appended as the scans were processed; this function usually only calls finishReport().
 	*/
 	virtual void writeReport() =0;
 
@@ -213,6 +235,51 @@ protected:
 	virtual bool isBatchComplete() =0;
 
     virtual bool checkAbortConditions(const Scan s);
+    /*!
+     \brief Returns the saved fit result for a scan that is being loaded
+
+     When a batch is loaded without refitting, the results for all of its scans are read from the FitResultStore at once.
+
+     \param num Scan number
+     \return FitResult Saved fit result
+    */
+    FitResult loadedFitResult(int num) const;
+    /*!
+     \brief Fits a scan with d_fitter, or returns the saved result when the batch is being loaded (without refitting) or replayed
+
+     \param s Scan
+     \return FitResult Fit result
+    */
+    FitResult fitScan(const Scan s);
+    /*!
+     \brief Writes the arguments of the constructor, so that the batch can be resumed
+
+     Subclasses that support resuming write their settings and return true, and provide a static fromSettings() function that reads them back (see BatchCheckpoint::restore()).
+
+     \param ds Stream
+     \return bool Whether the batch can be resumed. The default implementation returns false.
+    */
+    virtual bool writeSettings(QDataStream &ds) const;
+
+    /*!
+     \brief Returns the report file for this batch: savePath/dirName/x/y/num.txt
+    */
+    QString reportFileName(const QString dirName) const;
+    /*!
+     \brief Creates the report directory and file, and writes the header
+
+     \param dirName Report directory under the save path (e.g., surveys)
+     \param header Header lines
+     \param preamble Text written before the first row
+     \return bool Whether the report was created. If not, an error is logged.
+    */
+    bool openReport(const QString dirName, const QString header, const QString preamble = QString());
+    void appendToReport(const QString text);
+    void recordReportScan(int num, bool isCal);
+    /*!
+     \brief Writes the final header and trailer. Does nothing if the report was never opened.
+    */
+    void finishReport(const QString header, const QString trailer = QString());
 
     AbstractFitter *d_fitter; /*!< Worker for computing FTs */
 
@@ -226,10 +293,28 @@ protected:
     QList<Limits> d_flowLimits;
 
     bool d_sleep;
+    bool d_resuming;
+
+    BatchReportWriter d_report;
 
 private:
     void loadBatch();
     void stopBatch(bool aborted, bool sleep);
+    void finishFitWrites();
+    void reportFitWriteErrors();
+    void createCheckpoint();
+    void reopenCheckpoint();
+    void checkpointScan(const Scan s);
+    void resumeBatch();
+    static bool isSameMeasurement(const Scan saved, const Scan planned);
+
+    bool d_deferFitWrites;
+    bool d_reportFailed;
+    BatchCheckpoint d_checkpoint;
+    bool d_checkpointFailed;
+    bool d_checkpointReopened; /*!< The checkpoint of a resumed batch was reopened, and already lists the replayed scans */
+    QList<int> d_resumeScans;
+    QHash<int,FitResult> d_loadedFits;
 
 };
 
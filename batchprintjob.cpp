@@ -0,0 +1,158 @@
+#include "batchprintjob.h"
+
+#include <QRunnable>
+#include <QPainter>
+#include <QProgressDialog>
+#include <QApplication>
+#include <QtPrintSupport/QPrinter>
+
+#include <qwt6/qwt_graphic.h>
+
+class BatchPrintJob::PageTask : public QRunnable
+{
+public:
+	PageTask(BatchPrintJob *job, QwtGraphic *page, int index) : p_job(job), p_page(page), d_index(index) {}
+	void run() { p_job->writePage(p_page,d_index); }
+
+private:
+	BatchPrintJob *p_job;
+	QwtGraphic *p_page;
+	int d_index;
+};
+
+BatchPrintJob::BatchPrintJob(QPrinter *pr, int numPages, QWidget *parent) : QObject(parent), p_printer(pr), p_painter(nullptr),
+	d_queueSlots(4), d_written(0), d_stopped(0), d_numPages(numPages), d_queued(0), d_finished(false)
+{
+	//one writer thread keeps the pages in order
+	d_pool.setMaxThreadCount(1);
+
+	int dpi = QwtGraphic().logicalDpiX();
+	if(dpi <= 0)
+		dpi = 96;
+	d_scale = static_cast<double>(pr->logicalDpiX())/static_cast<double>(dpi);
+
+	p_dialog = new QProgressDialog(QString("Printing..."),QString("Cancel"),0,qMax(numPages,1),parent);
+	p_dialog->setWindowTitle(QString("Printing"));
+	p_dialog->setWindowModality(Qt::WindowModal);
+	p_dialog->setMinimumDuration(500);
+	p_dialog->setValue(0);
+}
+
+BatchPrintJob::~BatchPrintJob()
+{
+	if(!d_finished)
+	{
+		d_stopped.store(1);
+		finish();
+	}
+
+	delete p_dialog;
+}
+
+QSizeF BatchPrintJob::pageSize() const
+{
+	return QSizeF(p_printer->pageRect().size())/d_scale;
+}
+
+QRectF BatchPrintJob::toPage(const QRect &printerRect) const
+{
+	return QRectF(QPointF(printerRect.topLeft())/d_scale,QSizeF(printerRect.size())/d_scale);
+}
+
+bool BatchPrintJob::addPage(QwtGraphic *page)
+{
+	if(d_stopped.load() || p_dialog->wasCanceled())
+	{
+		d_stopped.store(1);
+		delete page;
+		return false;
+	}
+
+	//wait for room in the queue, keeping the progress dialog responsive
+	while(!d_queueSlots.tryAcquire(1,50))
+	{
+		updateProgress();
+		if(p_dialog->wasCanceled())
+		{
+			d_stopped.store(1);
+			delete page;
+			return false;
+		}
+	}
+
+	d_pool.start(new PageTask(this,page,d_queued));
+	d_queued++;
+	updateProgress();
+
+	return !d_stopped.load();
+}
+
+bool BatchPrintJob::finish()
+{
+	if(d_finished)
+		return !d_stopped.load();
+
+	while(!d_pool.waitForDone(50))
+	{
+		updateProgress();
+		if(p_dialog->wasCanceled())
+			d_stopped.store(1);
+	}
+
+	//the writer thread is done with the painter
+	if(p_painter != nullptr)
+	{
+		if(p_painter->isActive())
+		{
+			if(d_stopped.load())
+				p_printer->abort();
+			p_painter->end();
+		}
+		delete p_painter;
+		p_painter = nullptr;
+	}
+
+	d_finished = true;
+	updateProgress();
+	p_dialog->reset();
+
+	return !d_stopped.load() && d_written.load() == d_queued;
+}
+
+void BatchPrintJob::writePage(QwtGraphic *page, int index)
+{
+	if(!d_stopped.load())
+	{
+		bool ok = true;
+		if(index == 0)
+		{
+			p_painter = new QPainter();
+			ok = p_painter->begin(p_printer);
+		}
+		else
+			ok = p_painter->isActive() && p_printer->newPage();
+
+		if(ok)
+		{
+			p_painter->save();
+			p_painter->scale(d_scale,d_scale);
+			page->render(p_painter);
+			p_painter->restore();
+			d_written.ref();
+		}
+		else
+			d_stopped.store(1);
+	}
+
+	delete page;
+	d_queueSlots.release();
+}
+
+void BatchPrintJob::updateProgress()
+{
+	//called on the GUI thread; setValue() processes events while the dialog is modal
+	int written = d_written.load();
+	p_dialog->setLabelText(QString("Writing page %1 of %2...").arg(qMin(written+1,d_numPages)).arg(d_numPages));
+	p_dialog->setValue(qMin(written,p_dialog->maximum()-1));
+	emit progress(written,d_numPages);
+}
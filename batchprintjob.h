@@ -0,0 +1,72 @@
+#ifndef BATCHPRINTJOB_H
+#define BATCHPRINTJOB_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QRect>
+
+class QPrinter;
+class QPainter;
+class QProgressDialog;
+class QwtGraphic;
+
+/*!
+ * \brief Writes the pages of a batch plot printout on a worker thread
+ *
+ * Batch plots are printed one graph at a time with QwtPlotRenderer, which has to run on the GUI thread because it draws the plot widget.
+ * Writing those graphs to a printer or PDF file is much slower than drawing them, so the plot only records each page into a QwtGraphic, and hands it to the job with addPage().
+ * The job writes the recorded pages to the printer in order, on a thread from its own pool, while the plot records the next pages.
+ * At most a few recorded pages wait to be written at any time.
+ *
+ * A page is recorded at screen resolution: its size is pageSize(), and toPage() converts a rectangle in printer coordinates.
+ * The text is recorded as outlines, so it stays sharp when the page is scaled up to the printer resolution.
+ *
+ * A modal progress dialog shows how many pages have been written, and its Cancel button stops the job: addPage() returns false, and the pages that have not been written are discarded.
+ */
+class BatchPrintJob : public QObject
+{
+	Q_OBJECT
+public:
+	explicit BatchPrintJob(QPrinter *pr, int numPages, QWidget *parent);
+	~BatchPrintJob();
+
+	QSizeF pageSize() const;
+	QRectF toPage(const QRect &printerRect) const;
+	double scale() const { return d_scale; }
+
+	/*!
+	 * \brief Queues a recorded page to be written. The job takes ownership of the page.
+	 * \return False if the job has been cancelled or has failed; no more pages should be recorded
+	 */
+	bool addPage(QwtGraphic *page);
+	/*!
+	 * \brief Waits for the remaining pages to be written, and finishes the printout
+	 * \return True if all pages were written
+	 */
+	bool finish();
+
+signals:
+	void progress(int pagesWritten, int totalPages);
+
+private:
+	class PageTask;
+
+	QPrinter *p_printer;
+	QPainter *p_painter; /*!< Created and used by the writer thread */
+	QProgressDialog *p_dialog;
+	QThreadPool d_pool;
+	QSemaphore d_queueSlots;
+	QAtomicInt d_written;
+	QAtomicInt d_stopped;
+	int d_numPages;
+	int d_queued;
+	double d_scale;
+	bool d_finished;
+
+	void writePage(QwtGraphic *page, int index);
+	void updateProgress();
+};
+
+#endif // BATCHPRINTJOB_H
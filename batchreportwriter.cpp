@@ -0,0 +1,244 @@
+#include "batchreportwriter.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+//extra space reserved for the final header (counts and frequencies may be longer than they were when the report was opened)
+const int headerSlack = 512;
+const int syncRecords = 16;
+const qint64 syncInterval = 30000;
+
+}
+
+BatchReportWriter::BatchReportWriter() : d_reserved(0), d_unsynced(0)
+{
+}
+
+BatchReportWriter::~BatchReportWriter()
+{
+	close();
+}
+
+bool BatchReportWriter::open(const QString fileName, const QString header, const QString preamble)
+{
+	close();
+
+	d_file.setFileName(fileName);
+	if(!d_file.open(QIODevice::ReadWrite|QIODevice::Truncate))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	//a journal left over from an earlier attempt with the same number does not belong to this report
+	QFile::remove(journalFileName(fileName));
+	d_journal.setFileName(journalFileName(fileName));
+
+	QByteArray block = headerBlock(header,false,0);
+	d_reserved = block.size();
+	if(d_file.write(block) != block.size() || d_file.write(preamble.toUtf8()) < 0)
+	{
+		d_error = d_file.errorString();
+		d_file.close();
+		return false;
+	}
+
+	d_error.clear();
+	return sync(true);
+}
+
+bool BatchReportWriter::append(const QString text)
+{
+	if(!d_file.isOpen())
+		return false;
+
+	QByteArray b = text.toUtf8();
+	if(d_file.write(b) != b.size())
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	return sync(false);
+}
+
+bool BatchReportWriter::recordScan(int num, bool isCal)
+{
+	if(!d_file.isOpen())
+		return false;
+
+	if(!d_journal.isOpen() && !d_journal.open(QIODevice::WriteOnly|QIODevice::Append))
+	{
+		d_error = d_journal.errorString();
+		return false;
+	}
+
+	QByteArray b = QString("%1\t%2\n").arg(num).arg(isCal ? 1 : 0).toLatin1();
+	if(d_journal.write(b) != b.size())
+	{
+		d_error = d_journal.errorString();
+		return false;
+	}
+
+	return sync(false);
+}
+
+bool BatchReportWriter::finish(const QString header, const QString trailer)
+{
+	if(!d_file.isOpen())
+		return false;
+
+	QByteArray t = trailer.toUtf8();
+	if(d_file.write(t) != t.size() || !d_file.flush())
+	{
+		d_error = d_file.errorString();
+		close();
+		return false;
+	}
+
+	bool ok;
+	QByteArray block = headerBlock(header,true,d_reserved);
+	if(!block.isEmpty())
+	{
+		ok = d_file.seek(0) && d_file.write(block) == block.size() && sync(true);
+		if(!ok)
+			d_error = d_file.errorString();
+		d_file.close();
+	}
+	else
+		ok = rewriteWithHeader(headerBlock(header,true,0));
+
+	if(!ok)
+	{
+		close();
+		return false;
+	}
+
+	d_journal.close();
+	d_journal.remove();
+	return true;
+}
+
+void BatchReportWriter::close()
+{
+	if(d_file.isOpen())
+	{
+		sync(true);
+		d_file.close();
+	}
+
+	if(d_journal.isOpen())
+		d_journal.close();
+}
+
+QList<QPair<int, bool> > BatchReportWriter::journalScans(const QString reportFileName)
+{
+	QList<QPair<int,bool>> out;
+	QFile f(journalFileName(reportFileName));
+	if(!f.open(QIODevice::ReadOnly))
+		return out;
+
+	while(!f.atEnd())
+	{
+		QList<QByteArray> l = f.readLine().trimmed().split('\t');
+		if(l.size() < 2)
+			continue;
+
+		bool ok = false;
+		int num = l.at(0).toInt(&ok);
+		if(!ok || num < 1)
+			continue;
+
+		out.append(qMakePair(num,l.at(1).toInt() != 0));
+	}
+
+	return out;
+}
+
+QString BatchReportWriter::journalFileName(const QString reportFileName)
+{
+	QFileInfo fi(reportFileName);
+	return QString("%1/%2.scans").arg(fi.absolutePath()).arg(fi.completeBaseName());
+}
+
+QByteArray BatchReportWriter::headerBlock(const QString header, bool complete, qint64 size)
+{
+	QByteArray out = header.toUtf8();
+	if(!out.isEmpty() && !out.endsWith('\n'))
+		out.append('\n');
+	out.append(complete ? "#Complete\tYes\t\n" : "#Complete\tNo\t\n");
+
+	//the padding line is "#\t" followed by spaces and a newline
+	if(size <= 0)
+		size = out.size() + 3 + headerSlack;
+
+	qint64 pad = size - out.size() - 3;
+	if(pad < 0)
+		return QByteArray();
+
+	out.append("#\t").append(QByteArray(static_cast<int>(pad),' ')).append('\n');
+	return out;
+}
+
+bool BatchReportWriter::sync(bool force)
+{
+	d_unsynced++;
+	if(!d_file.flush() || (d_journal.isOpen() && !d_journal.flush()))
+	{
+		d_error = d_file.errorString();
+		return false;
+	}
+
+	QDateTime now = QDateTime::currentDateTime();
+	if(!force && d_unsynced < syncRecords && d_lastSync.isValid() && d_lastSync.msecsTo(now) < syncInterval)
+		return true;
+
+#ifdef Q_OS_UNIX
+	if(fsync(d_file.handle()) != 0)
+	{
+		d_error = QString("Could not sync %1 to disk.").arg(d_file.fileName());
+		return false;
+	}
+	if(d_journal.isOpen())
+		fsync(d_journal.handle());
+#endif
+
+	d_unsynced = 0;
+	d_lastSync = now;
+	return true;
+}
+
+bool BatchReportWriter::rewriteWithHeader(const QByteArray block)
+{
+	//the final header is too long to fit in the reserved space, so the rest of the report is copied after it
+	if(!d_file.seek(d_reserved))
+	{
+		d_error = d_file.errorString();
+		d_file.close();
+		return false;
+	}
+	QByteArray rest = d_file.readAll();
+	d_file.close();
+
+	QSaveFile f(d_file.fileName());
+	if(!f.open(QIODevice::WriteOnly) || f.write(block) != block.size() || f.write(rest) != rest.size())
+	{
+		d_error = f.errorString();
+		f.cancelWriting();
+		return false;
+	}
+
+	if(!f.commit())
+	{
+		d_error = f.errorString();
+		return false;
+	}
+
+	return true;
+}
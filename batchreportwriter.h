@@ -0,0 +1,89 @@
+#ifndef BATCHREPORTWRITER_H
+#define BATCHREPORTWRITER_H
+
+#include <QString>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QDateTime>
+
+/*!
+ * \brief Writes a batch report while the batch is running
+ *
+ * Batch reports used to be written in one piece when the batch ended, so every result had to be kept in memory until then, and nothing was saved if the program stopped before the end of the batch.
+ * Instead, the report is opened when the first scan is processed, and each scan's rows are appended with append() as soon as they are known.
+ *
+ * The header is written first, followed by a "#Complete" line and a padding comment line that reserves space so that the header can be rewritten in place when the batch ends (finish()).
+ * Until then, the "#Complete" line reads "No". If the final header does not fit in the reserved space, the report is copied once with the new header.
+ * Sections that can only be written at the end (e.g., lists of scan numbers following the data) are passed to finish() as the trailer.
+ *
+ * Scans recorded with recordScan() are also appended to a small journal next to the report (num.scans), which is deleted when the report is finished.
+ * Loaders use journalScans() to find the scans of a report whose trailer was never written.
+ *
+ * The report and journal are flushed after every append, and synced to disk every few records or seconds.
+ */
+class BatchReportWriter
+{
+public:
+	BatchReportWriter();
+	~BatchReportWriter();
+
+	/*!
+	 * \brief Creates the report, and writes the header and column titles
+	 * \param fileName Report file
+	 * \param header Header lines (each should start with #)
+	 * \param preamble Text written after the header, before any rows (e.g., column titles)
+	 * \return Whether the file was created
+	 */
+	bool open(const QString fileName, const QString header, const QString preamble = QString());
+	bool isOpen() const { return d_file.isOpen(); }
+	QString fileName() const { return d_file.fileName(); }
+	QString errorString() const { return d_error; }
+
+	/*!
+	 * \brief Appends text (usually one or more rows) to the report
+	 * \return Whether the text was written
+	 */
+	bool append(const QString text);
+	/*!
+	 * \brief Records a scan in the journal
+	 * \param num Scan number
+	 * \param isCal Whether the scan is a calibration
+	 * \return Whether the scan was recorded
+	 */
+	bool recordScan(int num, bool isCal);
+	/*!
+	 * \brief Appends the trailer, marks the report complete, and closes it
+	 * \param header Final header, which replaces the one given to open()
+	 * \param trailer Text appended to the end of the report
+	 * \return Whether the report was completed
+	 */
+	bool finish(const QString header, const QString trailer = QString());
+	/*!
+	 * \brief Syncs and closes the report without completing it
+	 */
+	void close();
+
+	/*!
+	 * \brief Returns the scans recorded in the journal of an incomplete report
+	 * \param reportFileName Report file
+	 * \return Scan numbers and whether they are calibrations, in the order they were recorded. Empty if there is no journal.
+	 */
+	static QList<QPair<int,bool>> journalScans(const QString reportFileName);
+	static QString journalFileName(const QString reportFileName);
+
+private:
+	QFile d_file;
+	QFile d_journal;
+	qint64 d_reserved;
+	int d_unsynced;
+	QDateTime d_lastSync;
+	QString d_error;
+
+	static QByteArray headerBlock(const QString header, bool complete, qint64 size);
+	bool sync(bool force);
+	bool rewriteWithHeader(const QByteArray block);
+
+};
+
+#endif // BATCHREPORTWRITER_H
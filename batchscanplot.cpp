@@ -22,7 +22,7 @@ void BatchScanPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPoin
     if(d_metaDataList.isEmpty())
     {
         //for a batch, there will only be one data curve
-        QwtPlotCurve *curve = new QwtPlotCurve(QString("Batch Data"));
+        QwtPlotCurve *curve = new RasterCurve(QString("Batch Data"));
         curve->setPen(QPen(QPalette().color(QPalette::Text)));
         curve->setRenderHint(QwtPlotItem::RenderAntialiased);
         d_plotCurves.append(curve);
@@ -1,11 +1,13 @@
 #include "batchsurvey.h"
 #include <math.h>
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
+#include "scanrepository.h"
+#include "batchreportwriter.h"
+#include "batchcheckpoint.h"
 
 BatchSurvey::BatchSurvey(Scan first, double step, double end, bool hascal, Scan cal, int scansPerCal, AbstractFitter *af) :
-    BatchManager(QtFTM::Survey,false,af), d_surveyTemplate(first), d_hasCalibration(hascal), d_calTemplate(cal),
-    d_scansPerCal(scansPerCal), d_currentSurveyIndex(0), d_processScanIsCal(false)
+    BatchManager(QtFTM::Survey,false,af), d_surveyTemplate(first), d_end(end), d_hasCalibration(hascal), d_calTemplate(cal),
+    d_scansPerCal(scansPerCal), d_currentSurveyIndex(0), d_processScanIsCal(false), d_surveyStore(new SpectrumStore)
 {
 	//10 kHz is smallest allowed step size for a survey!
 	if(step < 0.01)
@@ -21,11 +23,15 @@ BatchSurvey::BatchSurvey(Scan first, double step, double end, bool hascal, Scan
 	//center each chunk at the cavity frequency
 	//calculate offset between probe freq and cavity freq
 	//if the step size is more tham twice that, there will be gaps!
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	d_offset = s.value(QString("ftSynth/offset"),0.400).toDouble();
+	ConfigSnapshot config = ConfigService::instance().snapshot();
+	d_offset = config.ftSynthOffset();
 	d_chunkStart = qMax(d_offset - step/2.0, 0.0);
 	d_chunkEnd = qMin(d_offset + step/2.0, 2.0*d_offset);
 
+	//if the usable half-width is more than half the step size, overlapping chunks are co-added
+	configureStitching(config.value(QString("surveyStitchHalfWidth"),0.0).toDouble(),
+					   config.value(QString("surveyCavityFwhm"),0.5).toDouble());
+
 
 	//compute number of survey elements
     d_totalSurveyScans = (int)ceil( (end-first.ftFreq())/d_step ) + 1;
@@ -49,7 +55,23 @@ BatchSurvey::BatchSurvey(Scan first, double step, double end, bool hascal, Scan
 
 }
 
-BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Survey,true,af)
+BatchSurvey *BatchSurvey::fromSettings(QDataStream &ds, AbstractFitter *af)
+{
+    Scan first = BatchCheckpoint::readScan(ds);
+    double step, end;
+    bool hasCal;
+    ds >> step >> end >> hasCal;
+    Scan cal = BatchCheckpoint::readScan(ds);
+    qint32 scansPerCal;
+    ds >> scansPerCal;
+
+    if(ds.status() != QDataStream::Ok)
+        return nullptr;
+
+    return new BatchSurvey(first,step,end,hasCal,cal,scansPerCal,af);
+}
+
+BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Survey,true,af), d_surveyStore(new SpectrumStore)
 {
     d_prettyName = QString("Survey");
     d_batchNum = num;
@@ -60,8 +82,10 @@ BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Surv
     int surveyMillions = (int)floor((double)surveyNum/1000000.0);
     int surveyThousands = (int)floor((double)surveyNum/1000.0);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    ConfigSnapshot config = ConfigService::instance().snapshot();
+    QString savePath = config.savePath();
+    double stitchHalfWidth = 0.0;
+    double cavityFwhm = config.value(QString("surveyCavityFwhm"),0.5).toDouble();
     QDir d(savePath + QString("/surveys/%1/%2").arg(surveyMillions).arg(surveyThousands));
 
     //open file for writing
@@ -98,6 +122,10 @@ BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Surv
             d_hasCalibration = value.trimmed().toInt(&ok) > 0;
         if(key.startsWith(QString("#Scans per cal"),Qt::CaseInsensitive))
             d_scansPerCal = value.trimmed().toInt(&ok);
+        if(key.startsWith(QString("#Stitch half width"),Qt::CaseInsensitive))
+            stitchHalfWidth = value.trimmed().toDouble(&ok);
+        if(key.startsWith(QString("#Cavity FWHM"),Qt::CaseInsensitive))
+            cavityFwhm = value.trimmed().toDouble(&ok);
 
         if(!ok)
             return;
@@ -126,14 +154,30 @@ BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Surv
             d_loadScanList.append(n);
     }
 
+    //if the survey did not finish, the scan lists were never written; use the journal instead
+    QList<int> journalCalScans;
+    if(d_loadScanList.isEmpty())
+    {
+        QList<QPair<int,bool>> j = BatchReportWriter::journalScans(out.fileName());
+        for(int i=0; i<j.size(); i++)
+        {
+            if(j.at(i).second)
+                journalCalScans.append(j.at(i).first);
+            else
+                d_loadScanList.append(j.at(i).first);
+        }
+        d_hasCalibration = !journalCalScans.isEmpty();
+    }
+
     if(d_loadScanList.isEmpty())
         return;
 
-    d_surveyTemplate = Scan(d_loadScanList.at(0));
+    d_surveyTemplate = ScanRepository::instance().get(d_loadScanList.at(0));
 
-    d_offset = s.value(QString("ftSynth/offset"),0.400).toDouble();
+    d_offset = config.ftSynthOffset();
     d_chunkStart = qMax(d_offset - fabs(d_step)/2.0, 0.0);
     d_chunkEnd = qMin(d_offset + fabs(d_step)/2.0, 2.0*d_offset);
+    configureStitching(stitchHalfWidth,cavityFwhm);
     d_currentSurveyIndex = 0;
     d_totalSurveyScans = d_loadScanList.size();
     d_totalCalScans = 0;
@@ -142,32 +186,37 @@ BatchSurvey::BatchSurvey(int num, AbstractFitter *af) : BatchManager(QtFTM::Surv
     {
         d_thisScanIsCal = true;
 
-        //find cal scans list
-        while(!out.atEnd())
+        if(!journalCalScans.isEmpty())
+            d_loadScanList.append(journalCalScans);
+        else
         {
-            QString line = out.readLine();
-            if(line.startsWith(QString("surveycalscans")))
-                break;
-        }
+            //find cal scans list
+            while(!out.atEnd())
+            {
+                QString line = out.readLine();
+                if(line.startsWith(QString("surveycalscans")))
+                    break;
+            }
 
-        //load cal scans into list
-        while(!out.atEnd())
-        {
-            QString line = out.readLine();
-            if(line.startsWith(QString("\n")))
-                break;
+            //load cal scans into list
+            while(!out.atEnd())
+            {
+                QString line = out.readLine();
+                if(line.startsWith(QString("\n")))
+                    break;
 
-            bool ok = true;
-            int n = line.split(QString("\t")).at(0).trimmed().toInt(&ok);
+                bool ok = true;
+                int n = line.split(QString("\t")).at(0).trimmed().toInt(&ok);
 
-            if(ok && n>0)
-                d_loadScanList.append(n);
+                if(ok && n>0)
+                    d_loadScanList.append(n);
+            }
         }
 
         //sort list
         qSort(d_loadScanList);
 
-        d_calTemplate = Scan(d_loadScanList.at(0));
+        d_calTemplate = ScanRepository::instance().get(d_loadScanList.at(0));
         d_totalCalScans = d_loadScanList.size()-d_totalSurveyScans;
     }
 
@@ -234,18 +283,24 @@ void BatchSurvey::processScan(Scan s)
 	QList<QVector<QPointF> > out;
     bool badTune = s.tuningVoltage() <= 0;
 
-    FitResult res;
-    if(d_loading && d_fitter->type() == FitResult::NoFitting)
-        res = FitResult(s.number());
-    else
-        res = d_fitter->doFit(s);
+    FitResult res = fitScan(s);
 
     //don't need the result here
     Q_UNUSED(res)
 
+    if(!d_loading && !d_report.isOpen())
+    {
+        QString columns = QString("\nsurveyfreq%1\tsurveyint%1").arg(d_batchNum);
+        if(d_stitching)
+            columns.append(QString("\tsurveyshots%1").arg(d_batchNum));
+        openReport(QString("surveys"),makeHeader(d_batchNum),columns);
+    }
+
     if(d_processScanIsCal)
 	{
         d_calScanNumbers.append(s.number());
+        if(!d_loading)
+            recordReportScan(s.number(),true);
 
 		double max = 0.0;
 		for(int i=0; i<ft.size(); i++)
@@ -256,7 +311,7 @@ void BatchSurvey::processScan(Scan s)
 		//otherwise, we want to plot it at the last data point of the previous scan
 		//this depends on whether we're scanning up or down
 		double displayFreq;
-        if(d_surveyData.isEmpty())
+        if(d_surveyStore->isEmpty())
 		{
 			if(d_step > 0.0)
 				displayFreq = d_surveyTemplate.ftFreq() - d_offset + d_chunkStart;
@@ -264,7 +319,7 @@ void BatchSurvey::processScan(Scan s)
 				displayFreq = d_surveyTemplate.ftFreq() - d_offset + d_chunkEnd;
 		}
 		else
-            displayFreq = d_surveyData.at(d_surveyData.size()-1).x();
+            displayFreq = d_surveyStore->last().x();
 
         d_calData.append(QPointF(displayFreq,max));
         out.append(d_calData);
@@ -282,14 +337,24 @@ void BatchSurvey::processScan(Scan s)
 		double endFreq = s.fid().probeFreq() + d_chunkEnd;
 	   QtFTM::BatchPlotMetaData md(type(),s.number(),startFreq,endFreq,false,badTune);
 
+		QVector<QPointF> chunk;
+		if(d_stitching)
+		{
+			//bins that the next scan cannot reach are complete; after the last survey scan, all of them are
+			d_stitcher.addScan(ft,s.fid().probeFreq() + d_offset,s.completedShots());
+			if(d_currentSurveyIndex >= d_totalSurveyScans)
+				chunk = appendBins(d_stitcher.takeAll());
+			else
+				chunk = appendBins(d_stitcher.takeFinished(s.fid().probeFreq() + d_offset + d_step));
+		}
 		//if we're scanning down, the survey data will be ordered from highest to lowest frequency
-		if(d_step < 0.0)
+		else if(d_step < 0.0)
 		{
 			for(int i=0; i<ft.size(); i++)
 			{
 				double x = ft.at(ft.size()-1-i).x();
 				if(x >= startFreq && x < endFreq)
-                    d_surveyData.append(ft.at(ft.size()-1-i));
+                    chunk.append(ft.at(ft.size()-1-i));
 			}
 		}
 		else
@@ -298,11 +363,16 @@ void BatchSurvey::processScan(Scan s)
 			{
 				double x = ft.at(i).x();
 				if(x >= startFreq && x < endFreq)
-                    d_surveyData.append(ft.at(i));
+                    chunk.append(ft.at(i));
 			}
 		}
 
-        out.append(d_surveyData);
+        if(!d_stitching)
+            appendChunk(chunk);
+        if(!d_loading)
+            recordReportScan(s.number(),false);
+
+        out.append(chunk);
 		emit plotData(md, out);
 
 	}
@@ -311,82 +381,105 @@ void BatchSurvey::processScan(Scan s)
 
 void BatchSurvey::writeReport()
 {
-    if(d_surveyData.isEmpty())
-	{
-		emit logMessage(QString("Did not create survey report because no scans were completed."),QtFTM::LogWarning);
-		return;
-	}
-
-	//figure out where to save survey
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	int surveyNum = s.value(d_numKey,1).toInt();
-	int surveyMillions = (int)floor((double)surveyNum/1000000.0);
-	int surveyThousands = (int)floor((double)surveyNum/1000.0);
-
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-	QDir d(savePath + QString("/surveys/%1/%2").arg(surveyMillions).arg(surveyThousands));
-
-	if(!d.exists())
-	{
-		if(!d.mkpath(d.absolutePath()))
-		{
-			emit logMessage(QString("Could not create directory for saving survey! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-			return;
-		}
-	}
+	//if the survey was aborted, the stitched bins that were waiting for the next scan are final now
+	if(d_stitching)
+		appendBins(d_stitcher.takeAll());
 
-	//open file for writing
-	QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(surveyNum));
-	QTextStream t(&out);
+	//the survey data were written as the scans were processed; only the scan lists remain
+	QString trailer;
+	QTextStream t(&trailer);
 	QString tab = QString("\t");
 	QString nl = QString("\n");
 
-	if(!out.open(QIODevice::WriteOnly))
-	{
-		emit logMessage(QString("Could not open file for writing batch data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-		return;
-	}
-
-	//write header
-	t << makeHeader(surveyNum);
 	t.setRealNumberNotation(QTextStream::ScientificNotation);
-
-	//this controls how many digits are printed after decimal.
-	//in principle, an 8 bit digitizer requires only 3 digits (range = -127 to 128)
-	//For each ~factor of 10 averages, we need ~one more digit of precision
-	//This starts at 7 digits (sci notation; 6 places after decimal), and adds 1 for every factor of 10 shots.
-	int logFactor = 0;
-	if(d_surveyTemplate.targetShots() > 0)
-		logFactor = (int)floor(log10((double)d_surveyTemplate.targetShots()));
-	t.setRealNumberPrecision(6+logFactor);
-
-	//write survey data
-	t << nl << QString("surveyfreq") << surveyNum << QString("\tsurveyint") << surveyNum;
-    for(int i=0; i<d_surveyData.size(); i++)
-        t << nl << QString::number(d_surveyData.at(i).x(),'f',4) << tab << d_surveyData.at(i).y();
+	t.setRealNumberPrecision(intensityPrecision());
 
 	//write survey scan numbers
-	t << nl << nl << QString("surveyscans") << surveyNum;
+	t << nl << nl << QString("surveyscans") << d_batchNum;
     for(int i=0; i<d_surveyScanNumbers.size(); i++)
         t << nl << d_surveyScanNumbers.at(i);
 
 	//write cal data
     if(d_totalCalScans > 0)
 	{
-		t << nl << nl << QString("surveycalscans") << surveyNum << tab << QString("surveycalfreq")
-		  << surveyNum << tab << QString("surveycalint") << surveyNum;
+		t << nl << nl << QString("surveycalscans") << d_batchNum << tab << QString("surveycalfreq")
+		  << d_batchNum << tab << QString("surveycalint") << d_batchNum;
 
         for(int i=0; i<d_calScanNumbers.size(); i++)
             t << nl << d_calScanNumbers.at(i) << tab << QString::number(d_calData.at(i).x(),'f',4) << tab << d_calData.at(i).y();
 	}
 
 	t.flush();
-	out.close();
+	finishReport(makeHeader(d_batchNum),trailer);
+
+}
+
+bool BatchSurvey::writeSettings(QDataStream &ds) const
+{
+	BatchCheckpoint::writeScan(ds,d_surveyTemplate);
+	ds << fabs(d_step) << d_end << d_hasCalibration;
+	BatchCheckpoint::writeScan(ds,d_calTemplate);
+	ds << static_cast<qint32>(d_scansPerCal);
+
+	return true;
+}
+
+void BatchSurvey::configureStitching(double halfWidth, double cavityFwhm)
+{
+	//the chunk cannot extend past the edges of the FT
+	halfWidth = qMin(halfWidth,d_offset);
+	d_stitching = halfWidth > fabs(d_step)/2.0;
+	d_stitcher = SurveyStitcher(halfWidth,cavityFwhm,d_step < 0.0);
+}
+
+void BatchSurvey::appendChunk(const QVector<QPointF> chunk, const QVector<double> shots)
+{
+	d_surveyStore->append(chunk);
+	if(d_loading || chunk.isEmpty())
+		return;
+
+	QString rows;
+	QTextStream t(&rows);
+	t.setRealNumberNotation(QTextStream::ScientificNotation);
+	t.setRealNumberPrecision(intensityPrecision());
+	for(int i=0; i<chunk.size(); i++)
+	{
+		t << QString("\n") << QString::number(chunk.at(i).x(),'f',4) << QString("\t") << chunk.at(i).y();
+		if(i < shots.size())
+			t << QString("\t") << QString::number(shots.at(i),'f',1);
+	}
+	t.flush();
+
+	appendToReport(rows);
+}
+
+QVector<QPointF> BatchSurvey::appendBins(const QVector<SurveyStitcher::Bin> bins)
+{
+	QVector<QPointF> chunk;
+	QVector<double> shots;
+	chunk.reserve(bins.size());
+	shots.reserve(bins.size());
+	for(int i=0; i<bins.size(); i++)
+	{
+		chunk.append(QPointF(bins.at(i).x,bins.at(i).y));
+		shots.append(bins.at(i).shots);
+	}
 
-	//increment survey number
-	s.setValue(d_numKey,surveyNum+1);
-	s.sync();
+	appendChunk(chunk,shots);
+	return chunk;
+}
+
+int BatchSurvey::intensityPrecision() const
+{
+	//this controls how many digits are printed after decimal.
+	//in principle, an 8 bit digitizer requires only 3 digits (range = -127 to 128)
+	//For each ~factor of 10 averages, we need ~one more digit of precision
+	//This starts at 7 digits (sci notation; 6 places after decimal), and adds 1 for every factor of 10 shots.
+	int logFactor = 0;
+	if(d_surveyTemplate.targetShots() > 0)
+		logFactor = (int)floor(log10((double)d_surveyTemplate.targetShots()));
 
+	return 6+logFactor;
 }
 
 QString BatchSurvey::makeHeader(int num)
@@ -398,12 +491,26 @@ QString BatchSurvey::makeHeader(int num)
 
 	t << QString("#Survey\t") << num << QString("\t\n");
 	t << QString("#Date\t") << QDateTime::currentDateTime().toString() << QString("\t\n");
-    t << QString("#Start freq\t") << d_surveyData.at(0).x() << QString("\tMHz\n");
-    t << QString("#End freq\t") << d_surveyData.at(d_surveyData.size()-1).x() << QString("\tMHz\n");
+    //until the first survey scan has been processed, the planned range is shown
+    if(d_surveyStore->isEmpty())
+    {
+        t << QString("#Start freq\t") << d_surveyTemplate.ftFreq() << QString("\tMHz\n");
+        t << QString("#End freq\t") << d_surveyTemplate.ftFreq() + (double)(d_totalSurveyScans-1)*d_step << QString("\tMHz\n");
+    }
+    else
+    {
+        t << QString("#Start freq\t") << d_surveyStore->first().x() << QString("\tMHz\n");
+        t << QString("#End freq\t") << d_surveyStore->last().x() << QString("\tMHz\n");
+    }
 	t << QString("#Step size\t") << d_step << QString("\tMHz\n");
     t << QString("#Survey scans\t") << d_surveyScanNumbers.size() << QString("\t\n");
     t << QString("#Cal scans\t") << d_calScanNumbers.size() << QString("\t\n");
 	t << QString("#Scans per cal\t") << d_scansPerCal << QString("\t\n");
+	if(d_stitching)
+	{
+		t << QString("#Stitch half width\t") << d_stitcher.halfWidth() << QString("\tMHz\n");
+		t << QString("#Cavity FWHM\t") << d_stitcher.cavityFwhm() << QString("\tMHz\n");
+	}
 	t << QString("#FID delay\t") << d_fitter->delay() << QString("\tus\n");
 	t << QString("#FID high pass\t") << d_fitter->hpf() << QString("\tkHz\n");
 	t << QString("#FID exp decay\t") << d_fitter->exp() << QString("\tus\n");
@@ -2,6 +2,10 @@
 #define BATCHSURVEY_H
 
 #include "batchmanager.h"
+#include "spectrumstore.h"
+#include "surveystitcher.h"
+
+#include <QSharedPointer>
 
 /*!
  * \brief An implementation of BatchManager that scans the FT frequency across a continuous spectral region.
@@ -13,6 +17,11 @@
  * The survey will always begin and end with a calibration scan if they are enabled.
  * Survey reports are stored in savePath/surveys/x/y/z.txt, where z is the survey number, y are the thousands digits, and x are the millions digits (though it's unlikely that will ever go above 0!)
  * Reports contain lists of survey and calibration scan numbers, as well as XY lists of frequency and FT intensity for the survey, and frequency and peak calibration line intensity for the calibrations.
+ * The frequency and intensity rows are appended as each scan is processed; the scan lists are written when the survey ends.
+ * The stitched spectrum is kept in a SpectrumStore, which is shared with the SurveyPlot; plotData() only sends the new chunk of each scan.
+ * By default, each scan contributes the points within half a step of its cavity frequency.
+ * If the setting surveyStitchHalfWidth (MHz) is larger than half the step, the scans overlap, and a SurveyStitcher co-adds them with weights based on the noise and the cavity response (width set by surveyCavityFwhm).
+ * The report then has a third column with the effective number of shots at each frequency.
  */
 class BatchSurvey : public BatchManager
 {
@@ -20,6 +29,13 @@ class BatchSurvey : public BatchManager
 public:
     explicit BatchSurvey(Scan first, double step, double end, bool hascal = false, Scan cal = Scan(), int scansPerCal = 0, AbstractFitter *af = new NoFitter());
     explicit BatchSurvey(int num, AbstractFitter *af = new NoFitter());
+
+    static BatchSurvey *fromSettings(QDataStream &ds, AbstractFitter *af);
+
+    /*!
+     * \brief Store that holds the survey spectrum. The SurveyPlot reads from the same store (see SurveyPlot::setSpectrumStore())
+     */
+    QSharedPointer<SpectrumStore> spectrumStore() const { return d_surveyStore; }
 	
 signals:
 	
@@ -28,6 +44,7 @@ public slots:
 private:
 	Scan d_surveyTemplate;
 	double d_step;
+	double d_end;
 	double d_chunkStart;
 	double d_chunkEnd;
 	double d_offset;
@@ -40,10 +57,13 @@ private:
     bool d_processScanIsCal;
 
     QVector<QPointF> d_calData;
-    QVector<QPointF> d_surveyData;
+    QSharedPointer<SpectrumStore> d_surveyStore;
     QList<int> d_surveyScanNumbers;
     QList<int> d_calScanNumbers;
 
+    bool d_stitching;
+    SurveyStitcher d_stitcher;
+
 
 protected:
 	Scan prepareNextScan();
@@ -51,9 +71,14 @@ protected:
     void advanceBatch(const Scan s);
 	void processScan(Scan s);
 	void writeReport();
+    bool writeSettings(QDataStream &ds) const;
 
 private:
 	QString makeHeader(int num);
+	void configureStitching(double halfWidth, double cavityFwhm);
+	void appendChunk(const QVector<QPointF> chunk, const QVector<double> shots = QVector<double>());
+	QVector<QPointF> appendBins(const QVector<SurveyStitcher::Bin> bins);
+	int intensityPrecision() const;
 	
 };
 
@@ -181,8 +181,12 @@ void BatchViewWidget::process()
     switch(d_type)
     {
     case QtFTM::Survey:
-        batchPlot = new SurveyPlot(d_number,this);
+    {
+        SurveyPlot *sp = new SurveyPlot(d_number,this);
+        sp->setSpectrumStore(static_cast<BatchSurvey*>(bm)->spectrumStore());
+        batchPlot = sp;
         break;
+    }
     case QtFTM::DrScan:
         batchPlot = new DrPlot(d_number,this);
         break;
@@ -1,6 +1,7 @@
 #include "batchwidget.h"
 #include "ui_batchwidget.h"
 #include "singlescandialog.h"
+#include "numberallocator.h"
 #include <QFileDialog>
 #include <QSettings>
 #include <QApplication>
@@ -107,7 +108,6 @@ void BatchWidget::updateLabel()
 		repeats = d_numTests;
 	int totalTime = btm.timeEstimate(d_type,repeats);
 
-	QSettings set(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
 	QString name = QString("Batch Scan");
 	QString key = QString("batchNum");
 	if(d_type == QtFTM::DrCorrelation)
@@ -126,7 +126,7 @@ void BatchWidget::updateLabel()
 	int s = totalTime%60;
 
 	QString text;
-	text.append(QString("<table><th colspan=2>%1 Number %2</th></tr>").arg(name).arg(set.value(key,1).toInt()));
+	text.append(QString("<table><th colspan=2>%1 Number %2</th></tr>").arg(name).arg(NumberAllocator::instance().next(key)));
 	text.append(QString("<tr><td colspan=2 align=\"center\">Time estimates</td></tr>"));
 	text.append(QString("<tr><td>Total time: </td> <td> %1h %2m %3s</td></tr>").arg(h).arg(m).arg(s));
 	text.append(QString("<tr><td>Completed at: </td> <td> %1</td></tr>").arg(dt.toString()));
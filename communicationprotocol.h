@@ -27,6 +27,12 @@ public:
     virtual bool writeCmd(QString cmd) =0;
     virtual bool writeBinary(QByteArray dat) =0;
     virtual QByteArray queryCmd(QString cmd) =0;
+    /*!
+     * \brief Writes a command whose result will be checked by a following query (e.g., setting a frequency and reading it back)
+     *
+     * Protocols that can delay the write and send it together with the query (GpibInstrument) override this; by default, the command is written immediately.
+     */
+    virtual bool writeCmdPipelined(QString cmd) { return writeCmd(cmd); }
 
     QString key() { return d_key; }
     CommType type() { return d_type; }
@@ -0,0 +1,168 @@
+#include "configservice.h"
+
+#include <QSettings>
+#include <QApplication>
+#include <QHash>
+#include <QStringList>
+
+class ConfigSnapshotData : public QSharedData {
+public:
+	ConfigSnapshotData() : version(0), savePath(QString(".")), ftSynthOffset(0.400), drSynthMin(0.0), drSynthMinPower(-20.0),
+		attnMax(100), peakUpAverages(20), compressFid(false) {}
+
+	quint64 version;
+	QHash<QString,QVariant> values;
+
+	QString savePath;
+	double ftSynthOffset;
+	double drSynthMin;
+	double drSynthMinPower;
+	int attnMax;
+	int peakUpAverages;
+	bool compressFid;
+};
+
+ConfigSnapshot::ConfigSnapshot() : data(new ConfigSnapshotData)
+{
+}
+
+ConfigSnapshot::ConfigSnapshot(const ConfigSnapshot &rhs) : data(rhs.data)
+{
+}
+
+ConfigSnapshot &ConfigSnapshot::operator=(const ConfigSnapshot &rhs)
+{
+	if (this != &rhs)
+		data.operator=(rhs.data);
+	return *this;
+}
+
+ConfigSnapshot::~ConfigSnapshot()
+{
+}
+
+quint64 ConfigSnapshot::version() const
+{
+	return data->version;
+}
+
+QVariant ConfigSnapshot::value(const QString key, const QVariant defaultValue) const
+{
+	return data->values.value(key,defaultValue);
+}
+
+QVariant ConfigSnapshot::hardwareValue(const QString group, const QString key, const QVariant defaultValue) const
+{
+	QString subKey = value(QString("%1/subKey").arg(group),QString("virtual")).toString();
+	return value(QString("%1/%2/%3").arg(group).arg(subKey).arg(key),defaultValue);
+}
+
+QString ConfigSnapshot::savePath() const
+{
+	return data->savePath;
+}
+
+double ConfigSnapshot::ftSynthOffset() const
+{
+	return data->ftSynthOffset;
+}
+
+double ConfigSnapshot::drSynthMin() const
+{
+	return data->drSynthMin;
+}
+
+double ConfigSnapshot::drSynthMinPower() const
+{
+	return data->drSynthMinPower;
+}
+
+int ConfigSnapshot::attnMax() const
+{
+	return data->attnMax;
+}
+
+int ConfigSnapshot::peakUpAverages() const
+{
+	return data->peakUpAverages;
+}
+
+bool ConfigSnapshot::compressFid() const
+{
+	return data->compressFid;
+}
+
+
+
+ConfigService &ConfigService::instance()
+{
+	static ConfigService service;
+	return service;
+}
+
+ConfigService::ConfigService(QObject *parent) : QObject(parent), d_version(0)
+{
+	//the service may first be used from a worker thread; queued reload() calls must be handled by the main event loop
+	moveToThread(QApplication::instance()->thread());
+	reload();
+}
+
+ConfigSnapshot ConfigService::snapshot() const
+{
+	QReadLocker l(&d_lock);
+	return d_current;
+}
+
+void ConfigService::setValue(const QString key, const QVariant v)
+{
+	{
+		QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+		s.setValue(key,v);
+	}
+
+	//only the changed key needs to be updated; the rest of the file has not changed since the last reload
+	ConfigSnapshot snap;
+	{
+		QWriteLocker l(&d_lock);
+		snap = d_current;
+		snap.data->values.insert(key,v);
+		convertValues(snap);
+		snap.data->version = ++d_version;
+		d_current = snap;
+	}
+
+	emit configChanged(snap);
+}
+
+void ConfigService::reload()
+{
+	ConfigSnapshot snap;
+	ConfigSnapshotData *d = snap.data.data();
+
+	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+	QStringList keys = s.allKeys();
+	for(int i=0; i<keys.size(); i++)
+		d->values.insert(keys.at(i),s.value(keys.at(i)));
+
+	convertValues(snap);
+
+	{
+		QWriteLocker l(&d_lock);
+		d->version = ++d_version;
+		d_current = snap;
+	}
+
+	emit configChanged(snap);
+}
+
+void ConfigService::convertValues(ConfigSnapshot &snap)
+{
+	ConfigSnapshotData *d = snap.data.data();
+	d->savePath = snap.value(QString("savePath"),QString(".")).toString();
+	d->ftSynthOffset = snap.value(QString("ftSynth/offset"),0.400).toDouble();
+	d->drSynthMin = snap.hardwareValue(QString("drSynth"),QString("min"),0.0).toDouble();
+	d->drSynthMinPower = snap.hardwareValue(QString("drSynth"),QString("minPower"),-20.0).toDouble();
+	d->attnMax = snap.hardwareValue(QString("attn"),QString("max"),100).toInt();
+	d->peakUpAverages = snap.value(QString("peakUpAvgs"),20).toInt();
+	d->compressFid = snap.value(QString("compressFid"),false).toBool();
+}
@@ -0,0 +1,123 @@
+#ifndef CONFIGSERVICE_H
+#define CONFIGSERVICE_H
+
+#include <QObject>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QVariant>
+#include <QReadWriteLock>
+
+class ConfigSnapshotData;
+
+/*!
+ \brief Immutable, implicitly shared copy of the program settings
+
+ A snapshot contains every key in the settings file at the time it was taken, and is never modified afterwards.
+ Values that are read in performance-critical code (the save path, the FT synthesizer offset, hardware limits) are converted to their types when the snapshot is created, so reading them costs no more than a member access.
+ Any other key can be read with value() or hardwareValue().
+
+ Snapshots are obtained from the ConfigService, and each one carries a version number that increases every time the settings are reloaded.
+*/
+class ConfigSnapshot
+{
+public:
+	ConfigSnapshot();
+	ConfigSnapshot(const ConfigSnapshot &);
+	ConfigSnapshot &operator=(const ConfigSnapshot &);
+	~ConfigSnapshot();
+
+	/*!
+	 \brief Version of the settings this snapshot was made from (0 if empty)
+	*/
+	quint64 version() const;
+	/*!
+	 \brief Reads an arbitrary key
+	 \param key Full key, including groups (e.g., ftSynth/subKey)
+	 \param defaultValue Value returned if the key is not present
+	*/
+	QVariant value(const QString key, const QVariant defaultValue = QVariant()) const;
+	/*!
+	 \brief Reads a key belonging to the currently selected implementation of a piece of hardware
+
+	 Equivalent to beginGroup(group), beginGroup(value("subKey")), value(key) on a QSettings object.
+
+	 \param group Hardware key (e.g., drSynth)
+	 \param key Key within the implementation's group
+	 \param defaultValue Value returned if the key is not present
+	*/
+	QVariant hardwareValue(const QString group, const QString key, const QVariant defaultValue = QVariant()) const;
+
+	QString savePath() const;
+	double ftSynthOffset() const;
+	double drSynthMin() const;
+	double drSynthMinPower() const;
+	int attnMax() const;
+	int peakUpAverages() const;
+	bool compressFid() const;
+
+private:
+	QSharedDataPointer<ConfigSnapshotData> data;
+
+	friend class ConfigService;
+};
+
+/*!
+ \brief Provides the current ConfigSnapshot
+
+ Constructing a QSettings object parses the settings file, which is too slow for code that runs once per scan or once per template.
+ The service reads the file once and hands out the resulting snapshot; copying a snapshot only increments a reference count.
+
+ Code that writes to the settings file must call reload() afterwards (or use setValue(), which does both) so that the change becomes visible.
+ The SettingsDialog does this when settings are applied, and the MainWindow does it after any settings dialog is closed and whenever a synthesizer changes its range.
+ Each reload or setValue() creates a new snapshot with a higher version and emits configChanged(); snapshots that were handed out earlier are not affected.
+ Objects that keep a setting in a member (e.g., ScanManager's peak-up averages) should update it from configChanged().
+
+ The service is thread-safe, and is accessed through instance().
+*/
+class ConfigService : public QObject
+{
+	Q_OBJECT
+public:
+	static ConfigService &instance();
+
+	/*!
+	 \brief The current snapshot
+	*/
+	ConfigSnapshot snapshot() const;
+	/*!
+	 \brief Writes a value to the settings file and publishes a snapshot containing it
+
+	 Only the given key is updated; the settings file is not parsed again.
+
+	 \param key Full key, including groups
+	 \param v Value
+	*/
+	void setValue(const QString key, const QVariant v);
+
+signals:
+	void configChanged(const ConfigSnapshot);
+
+public slots:
+	/*!
+	 \brief Reads the settings file and replaces the current snapshot
+	*/
+	void reload();
+
+private:
+	explicit ConfigService(QObject *parent = nullptr);
+	Q_DISABLE_COPY(ConfigService)
+
+	mutable QReadWriteLock d_lock;
+	ConfigSnapshot d_current;
+	quint64 d_version;
+
+	/*!
+	 \brief Fills in the typed values of a snapshot from its key-value pairs
+	*/
+	static void convertValues(ConfigSnapshot &snap);
+
+};
+
+Q_DECLARE_METATYPE(ConfigSnapshot)
+
+#endif // CONFIGSERVICE_H
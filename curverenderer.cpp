@@ -0,0 +1,96 @@
+#include "curverenderer.h"
+
+#include <QPainter>
+#include <QCoreApplication>
+#include <QPolygonF>
+#include <math.h>
+
+CurveRenderer::CurveRenderer(QObject *parent) : QObject(parent), d_latest(0)
+{
+}
+
+QThread *CurveRenderer::sharedThread()
+{
+	static QThread *thread = nullptr;
+	if(thread == nullptr)
+	{
+		thread = new QThread(QCoreApplication::instance());
+		thread->setObjectName(QString("curveRenderThread"));
+		QObject::connect(QCoreApplication::instance(),&QCoreApplication::aboutToQuit,[](){
+			thread->quit();
+			thread->wait();
+		});
+		thread->start();
+	}
+
+	return thread;
+}
+
+void CurveRenderer::render(const CurveRenderer::Request r)
+{
+	if(r.serial != d_latest.load() || r.rect.isEmpty())
+		return;
+
+	int width = r.rect.width();
+	double left = static_cast<double>(r.rect.left());
+	double top = static_cast<double>(r.rect.top());
+
+	//keep the first, last, lowest, and highest point in each pixel column
+	//points beyond the left or right edge are collected in one column on each side, so the lines into the plot keep their slopes
+	QPolygonF poly;
+	poly.reserve(qMin(r.samples.size(),4*(width+2)));
+	int column = 0;
+	bool open = false;
+	QPointF first, last, low, high;
+	auto flush = [&](){
+		poly.append(first);
+		if(low != first && low != last)
+			poly.append(low);
+		if(high != first && high != last)
+			poly.append(high);
+		if(last != first)
+			poly.append(last);
+	};
+
+	for(int i=0; i<r.samples.size(); i++)
+	{
+		//a newer request makes this one pointless
+		if((i & 0xffff) == 0xffff && r.serial != d_latest.load())
+			return;
+
+		QPointF p(r.xMap.transform(r.samples.at(i).x()) - left,r.yMap.transform(r.samples.at(i).y()) - top);
+		int c = qBound(-1,static_cast<int>(floor(p.x())),width);
+		if(!open || c != column)
+		{
+			if(open)
+				flush();
+
+			column = c;
+			open = true;
+			first = p;
+			low = p;
+			high = p;
+		}
+		else
+		{
+			if(p.y() < low.y())
+				low = p;
+			if(p.y() > high.y())
+				high = p;
+		}
+		last = p;
+	}
+	if(open)
+		flush();
+
+	QImage image(r.rect.size(),QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+
+	QPainter painter(&image);
+	painter.setRenderHint(QPainter::Antialiasing,r.antialias);
+	painter.setPen(r.pen);
+	painter.drawPolyline(poly);
+	painter.end();
+
+	emit imageReady(r.serial,image);
+}
@@ -0,0 +1,63 @@
+#ifndef CURVERENDERER_H
+#define CURVERENDERER_H
+
+#include <QObject>
+#include <QVector>
+#include <QPointF>
+#include <QImage>
+#include <QPen>
+#include <QRect>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <qwt6/qwt_scale_map.h>
+
+/*!
+ * \brief Draws a curve into an image, on a worker thread
+ *
+ * Used by RasterCurve. Each curve has its own renderer, and all renderers run on one thread (see sharedThread()).
+ * Each request contains everything needed to draw the curve (a shared copy of the samples, the scale maps, and the pen), so nothing is shared with the GUI thread while drawing.
+ * Only the most recent request matters: setLatest() is called from the GUI thread before each request is sent, and older requests that are still in the queue are skipped.
+ * The samples are reduced to at most four points per pixel column (first, min, max, last) before they are drawn.
+ */
+class CurveRenderer : public QObject
+{
+	Q_OBJECT
+public:
+	explicit CurveRenderer(QObject *parent = nullptr);
+
+	struct Request {
+		int serial;
+		QVector<QPointF> samples;
+		QwtScaleMap xMap;
+		QwtScaleMap yMap;
+		QRect rect; /*!< Canvas rectangle; the image has its size, and its origin at rect.topLeft() */
+		QPen pen;
+		bool antialias;
+
+		Request() : serial(0), antialias(false) {}
+	};
+
+	void setLatest(int serial) { d_latest.store(serial); }
+
+	/*!
+	 * \brief The thread that all renderers are moved to
+	 *
+	 * It is created the first time an image is requested, and stopped when the application quits. Must be called from the GUI thread.
+	 */
+	static QThread *sharedThread();
+
+signals:
+	void imageReady(int serial, QImage image);
+
+public slots:
+	void render(const CurveRenderer::Request r);
+
+private:
+	QAtomicInt d_latest;
+
+};
+
+Q_DECLARE_METATYPE(CurveRenderer::Request)
+
+#endif // CURVERENDERER_H
@@ -13,7 +13,18 @@ SOURCES += fid.cpp \
     $$PWD/amdordata.cpp \
     $$PWD/amdordatamodel.cpp \
     $$PWD/amdornode.cpp \
-    $$PWD/dopplerpairfitter.cpp
+    $$PWD/dopplerpairfitter.cpp \
+    $$PWD/numberallocator.cpp \
+    $$PWD/configservice.cpp \
+    $$PWD/fidcodec.cpp \
+    $$PWD/scanindex.cpp \
+    $$PWD/scanrepository.cpp \
+    $$PWD/fitresultstore.cpp \
+    $$PWD/spectrumstore.cpp \
+    $$PWD/surveystitcher.cpp \
+    $$PWD/telemetrystore.cpp \
+    $$PWD/livefeed.cpp \
+    $$PWD/logmodel.cpp
 
 HEADERS += fid.h \
     ftworker.h \
@@ -31,4 +42,15 @@ HEADERS += fid.h \
     $$PWD/amdordata.h \
     $$PWD/amdordatamodel.h \
     $$PWD/amdornode.h \
-    $$PWD/dopplerpairfitter.h
+    $$PWD/dopplerpairfitter.h \
+    $$PWD/numberallocator.h \
+    $$PWD/configservice.h \
+    $$PWD/fidcodec.h \
+    $$PWD/scanindex.h \
+    $$PWD/scanrepository.h \
+    $$PWD/fitresultstore.h \
+    $$PWD/spectrumstore.h \
+    $$PWD/surveystitcher.h \
+    $$PWD/telemetrystore.h \
+    $$PWD/livefeed.h \
+    $$PWD/logmodel.h
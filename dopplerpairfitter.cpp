@@ -95,6 +95,10 @@ FitResult DopplerPairFitter::doFit(const Scan s)
 		return out;
 	}
 
+	//the positions are limited by the point spacing of the padded FT; a zoom transform finds the maxima between the points
+	double ftSpacing = ftBl.at(1).x() - ftBl.at(0).x();
+	peakList = refinePeaks(f,peakList,ftSpacing);
+
     out.appendToLog(QString("Found %1 peaks:").arg(peakList.size()));
     out.appendToLog(QString("Num\tFreq\tA\tSNR"));
     double maxSnr = 0.0;
@@ -106,7 +110,6 @@ FitResult DopplerPairFitter::doFit(const Scan s)
 	}
 
 
-	double ftSpacing = ftBl.at(1).x() - ftBl.at(0).x();
     double splitting = estimateSplitting(d_bufferGas,d_temperature,fid.probeFreq());
     out.appendToLog(QString("Estimated Doppler splitting: %1 MHz.").arg(QString::number(splitting,'f',6)));
     double width = estimateLinewidth(d_bufferGas,fid.probeFreq(),temperature());
@@ -3,9 +3,12 @@
 #include <QTcpSocket>
 
 #include <QTimer>
+#include <string.h>
 
 DPO3012::DPO3012(QObject *parent) :
-    Oscilloscope(parent)
+    Oscilloscope(parent), d_resolutionChangePending(false), d_parseState(SeekHash), d_blockStart(0), d_lengthDigits(0),
+    d_recordLength(-1), d_expectedDataBytes(20000), d_resyncCount(0), d_partialReadCount(0), d_recordCount(0),
+    d_waitingForReply(false), d_waitingForWakeUp(false)
 {
     d_subKey = QString("dpo3012");
     d_prettyName = QString("DPO3012 Oscilloscope");
@@ -60,8 +63,9 @@ bool DPO3012::testConnection()
         p_socket->readAll();
 
     //initialize acquisition variables
-    d_headerHashFound = false;
-    d_binaryDataLength = -1;
+    d_parseState = SeekHash;
+    d_recordLength = -1;
+    d_record = QByteArray();
 
     //set resolution
     setResolution();
@@ -115,88 +119,116 @@ void DPO3012::replyReceived()
     //this function is called when bytes are available at the TCP socket.
     //The scope manual describes the response format in more detail, but briefly, it looks like #xyyyy<data>\n\r
     //where x is an integer 1-9 that tells how many y digits follow, and yyyy is the number of bytes of binary data that follow before the \n\r
+    //Data are read from the socket in bulk directly into d_record, which already contains the waveform prefix.
+    //The state machine below only looks at the bytes it needs to parse the block header.
+    if(d_record.isEmpty())
+        beginRecord();
 
-    //first step is to find the header hash (#)
-    if(!d_headerHashFound)
+    bool complete = false;
+    while(!complete && p_socket->bytesAvailable() > 0)
     {
-//        emit logMessage(QString("Looking for hash... (%1 ms)").arg(timeTest.elapsed()));
-
-        //while there are bytes that can be read, read them and look for a hash
-        while(p_socket->bytesAvailable()>0) // we can ignore anything that is before the hash
+        switch(d_parseState)
+        {
+        case SeekHash:
         {
-            char c;
-            p_socket->getChar(&c);
-            if(c == '#')
+            //anything before the hash (e.g., the terminator from a previous reply) is discarded
+            int oldSize = d_record.size();
+            if(!readIntoRecord(p_socket->bytesAvailable()))
+                return;
+
+            const char *hash = static_cast<const char*>(memchr(d_record.constData()+oldSize,'#',d_record.size()-oldSize));
+            if(hash == nullptr)
             {
-                //put hash into response
-                d_response.append(c);
-//                emit logMessage(QString("Found hash. Time elapsed: %1").arg(timeTest.elapsed()));
-                d_headerHashFound = true;
+                d_record.resize(d_blockStart);
                 break;
             }
-        }
-    }
 
-    if(d_headerHashFound && d_binaryDataLength < 0) // we've found the header, now we need to read in the size of the binary data
-    {
-        //after the hash, the next character is a digit telling the how many digits are in the number of bytes of binary data to follow.
-        //We need to make sure there are still at least that many bytes available so we can parse the number of binary data bytes
-        char c;
-        p_socket->getChar(&c);
-        bool ok = true;
-        int numHeaderBytes = QByteArray(&c,1).toInt(&ok);
-        if(!ok)
-        {
-            //something went wrong; perhaps we're in the midst of some binary data or something. Ignore this and look for a new hash
-            d_headerHashFound = false;
-            d_response.clear();
-            return;
+            int hashIndex = hash - d_record.constData();
+            if(hashIndex > d_blockStart)
+            {
+                memmove(d_record.data()+d_blockStart,hash,d_record.size()-hashIndex);
+                d_record.resize(d_record.size()-(hashIndex-d_blockStart));
+            }
+            d_parseState = ReadHeaderDigit;
+            break;
         }
-
-        if(numHeaderBytes > p_socket->bytesAvailable()) // we don't have enough bytes! put that character back, and we'll try again when more data comes in
-        {
-            p_socket->ungetChar(c);
-            return;
+        case ReadHeaderDigit:
+        case ReadLengthDigits:
+        case ReadData:
+            if(!readIntoRecord(d_recordLength > 0 ? d_recordLength - d_record.size() : p_socket->bytesAvailable()))
+                return;
+            break;
         }
-        else
+
+        if(d_parseState == ReadHeaderDigit && d_record.size() > d_blockStart+1)
         {
-            d_response.append(c);
-            QByteArray numBytes = p_socket->read(numHeaderBytes);
-            d_binaryDataLength = numBytes.toInt(&ok);
-            if(!ok)
+            //after the hash, the next character is a digit telling the how many digits are in the number of bytes of binary data to follow.
+            char c = d_record.at(d_blockStart+1);
+            if(c < '1' || c > '9')
             {
                 //something went wrong; perhaps we're in the midst of some binary data or something. Ignore this and look for a new hash
-                d_headerHashFound = false;
-                d_binaryDataLength = -1;
-                d_response.clear();
-                return;
+                resyncParser();
+                continue;
             }
-            d_response.append(numBytes);
+            d_lengthDigits = c - '0';
+            d_parseState = ReadLengthDigits;
         }
-    }
-
-    if(d_binaryDataLength > 0 && p_socket->bytesAvailable() >= d_binaryDataLength) // data are ready to be read in
-    {
-        //read it all, and reset acquisition parameters
-        d_response.append(p_socket->readAll());
-        d_headerHashFound = false;
-        d_binaryDataLength = -1;
-        d_waitingForReply = false;
 
+        if(d_parseState == ReadLengthDigits && d_record.size() >= d_blockStart+2+d_lengthDigits)
+        {
+            bool ok = false;
+            int numBytes = QByteArray::fromRawData(d_record.constData()+d_blockStart+2,d_lengthDigits).toInt(&ok);
+            if(!ok || numBytes <= 0)
+            {
+                resyncParser();
+                continue;
+            }
 
-        //copy the waveform prefix and append the response to it. Send to scanmanager for further processing
-        emit fidAcquired(QByteArray(d_waveformPrefix).append(d_response));
+            d_recordLength = d_blockStart + 2 + d_lengthDigits + numBytes;
+            if(d_record.capacity() < d_recordLength)
+                d_record.reserve(d_recordLength);
+            d_parseState = ReadData;
+        }
 
-//        emit logMessage(QString("Read binary data (total length: %2). Time elapsed: %1 ms").arg(timeTest.elapsed()).arg(d_response.size()));
+        if(d_parseState == ReadData && d_record.size() >= d_recordLength)
+            complete = true;
+    }
 
-        //if the user requested to change the resolution while we were acquiring, do it now
-        if(d_resolutionChangePending)
-            setResolution();
+    if(!complete)
+    {
+        if(d_parseState != SeekHash)
+            d_partialReadCount++;
+        return;
+    }
 
+    //anything left over is the terminator
+    d_record.resize(d_recordLength);
+    if(p_socket->bytesAvailable())
+        p_socket->readAll();
 
+    d_parseState = SeekHash;
+    d_recordLength = -1;
+    d_waitingForReply = false;
+    d_recordCount++;
+
+    //the record already starts with the waveform prefix, so it can be sent to the ScanManager as is.
+    //Implicit sharing means that the buffer is only reused once the ScanManager is done with it
+    emit fidAcquired(d_record,d_averages,d_frames);
+    d_recordPool.append(d_record);
+    while(d_recordPool.size() > 3)
+        d_recordPool.removeFirst();
+    d_record = QByteArray();
+
+    //start the next hardware average or frame sequence
+    if(triggersPerRecord() > 1)
+    {
+        d_triggerCount = 0;
+        p_comm->writeCmd(QString("ACQUIRE:STATE ON\n"));
     }
-//    else if(d_binaryDataLength > 0)
-//        emit logMessage(QString("Waiting for full waveform.... (%1/%2) Time elapsed: %3 ms").arg(p_socket->bytesAvailable()).arg(d_binaryDataLength+2).arg(timeTest.elapsed()));
+
+    //if the user requested to change the resolution while we were acquiring, do it now
+    if(d_resolutionChangePending)
+        setResolution();
 
 }
 
@@ -219,22 +251,29 @@ void DPO3012::setResolution()
 												   .arg(d_key).arg(d_subKey),(int)QtFTM::Res_5kHz).toInt();
 
     //apply appropriate settings. 10 kHz = 100 us, 5 kHz = 200 us, 2 kHz = 500 us, 1 kHz = 1000 us
+    //the expected data length (2 bytes per point) is used to size the record buffers
     switch(r)
     {
     case QtFTM::Res_1kHz:
         p_comm->writeCmd(QString(":HORIZONTAL:SCALE 100e-6;RECORDLENGTH 100000;:DATA:STOP 100000\n"));
+        d_expectedDataBytes = 200000;
         break;
     case QtFTM::Res_2kHz:
         p_comm->writeCmd(QString(":HORIZONTAL:SCALE 100e-6;RECORDLENGTH 100000;:DATA:STOP 50000\n"));
+        d_expectedDataBytes = 100000;
         break;
     case QtFTM::Res_10kHz:
         p_comm->writeCmd(QString(":HORIZONTAL:SCALE 20e-6;RECORDLENGTH 10000;:DATA:STOP 5000\n"));
+        d_expectedDataBytes = 10000;
         break;
     case QtFTM::Res_5kHz:
     default:
         p_comm->writeCmd(QString(":HORIZONTAL:SCALE 20e-6;RECORDLENGTH 10000;:DATA:STOP 10000\n"));
+        d_expectedDataBytes = 20000;
         break;
     }
+    d_recordPool.clear();
+    d_record = QByteArray();
 
     if(p_socket->bytesAvailable())
         p_socket->readAll();
@@ -253,6 +292,32 @@ void DPO3012::setResolution()
     //get waveform prefix for use in parsing function
     d_waveformPrefix = p_comm->queryCmd(QString("WFMOUTPRE?\n"));
 
+    //scope-side averaging: the scope averages d_averages triggers, then stops until the record has been read
+    //segmented capture: the scope stores d_frames triggers as FastFrame frames, then stops until all frames have been read
+    d_averages = qBound(1,s.value(QString("%1/%2/averages").arg(d_key).arg(d_subKey),1).toInt(),512);
+    d_frames = qBound(1,s.value(QString("%1/%2/frames").arg(d_key).arg(d_subKey),1).toInt(),1000);
+    if(d_averages > 1)
+        d_frames = 1;
+
+    if(d_averages > 1)
+    {
+        p_comm->writeCmd(QString("ACQUIRE:STATE OFF;:HORIZONTAL:FASTFRAME:STATE OFF\n"));
+        p_comm->writeCmd(QString("ACQUIRE:MODE AVERAGE;NUMAVG %1;STOPAFTER SEQUENCE;STATE ON\n").arg(d_averages));
+    }
+    else if(d_frames > 1)
+    {
+        p_comm->writeCmd(QString("ACQUIRE:STATE OFF;:HORIZONTAL:FASTFRAME:STATE ON;COUNT %1\n").arg(d_frames));
+        p_comm->writeCmd(QString("DATA:FRAMESTART 1;FRAMESTOP %1\n").arg(d_frames));
+        p_comm->writeCmd(QString("ACQUIRE:MODE HIRES;STOPAFTER SEQUENCE;STATE ON\n"));
+        d_expectedDataBytes *= d_frames;
+    }
+    else
+    {
+        p_comm->writeCmd(QString("ACQUIRE:STATE OFF;:HORIZONTAL:FASTFRAME:STATE OFF\n"));
+        p_comm->writeCmd(QString("ACQUIRE:MODE HIRES;STOPAFTER RUNSTOP;STATE ON\n"));
+    }
+    d_triggerCount = 0;
+
     //restart everything
     d_resolutionChangePending = false;
     connect(p_socket,&QIODevice::readyRead,this,&DPO3012::replyReceived,Qt::UniqueConnection);
@@ -278,17 +343,93 @@ void DPO3012::sendCurveQuery()
 
     if(d_acquisitionActive && !d_waitingForReply)
     {
+        //in averaging and segmented modes, trigger() only calls this function once the sequence is complete.
+        //*WAI makes the scope finish the sequence before it answers the curve query
+        QString query = QString("CURVE?\n");
+        if(triggersPerRecord() > 1)
+            query = QString("*WAI;CURVE?\n");
+
         if(p_socket->bytesAvailable())
             p_socket->readAll();
-        d_response.clear();
-        p_comm->writeCmd(QString("CURVE?\n"));
+        beginRecord();
+        p_comm->writeCmd(query);
         d_responseTimeout.restart();
         d_waitingForReply = true;
-        d_headerHashFound = false;
-        d_binaryDataLength = -1;
     }
 }
 
+void DPO3012::setActive(bool active)
+{
+    if(!active && d_acquisitionActive && d_recordCount > 0)
+    {
+        emit logMessage(QString("Waveform parser: %1 records, %2 partial reads, %3 resyncs.")
+                        .arg(d_recordCount).arg(d_partialReadCount).arg(d_resyncCount),QtFTM::LogDebug);
+        d_recordCount = 0;
+        d_partialReadCount = 0;
+        d_resyncCount = 0;
+    }
+
+    //restart the hardware average or frame sequence so that a record never contains shots from before the scope was activated
+    if(active && !d_acquisitionActive && triggersPerRecord() > 1 && !d_waitingForReply)
+        p_comm->writeCmd(QString("ACQUIRE:STATE OFF;STATE ON\n"));
+
+    Oscilloscope::setActive(active);
+}
+
+void DPO3012::beginRecord()
+{
+    //reuse a buffer that is no longer referenced by the ScanManager, if one is available.
+    //Each buffer has room for the prefix, the block header, the data, and the terminator
+    int capacity = d_waveformPrefix.size() + 2 + 9 + d_expectedDataBytes + 2;
+    d_record = QByteArray();
+    for(int i=0; i<d_recordPool.size(); i++)
+    {
+        if(d_recordPool.at(i).isDetached())
+        {
+            d_record = d_recordPool.takeAt(i);
+            break;
+        }
+    }
+    if(d_record.capacity() < capacity)
+        d_record.reserve(capacity);
+
+    d_record.resize(0);
+    d_record.append(d_waveformPrefix);
+
+    d_blockStart = d_record.size();
+    d_parseState = SeekHash;
+    d_recordLength = -1;
+}
+
+bool DPO3012::readIntoRecord(int maxBytes)
+{
+    int n = qMin(static_cast<qint64>(maxBytes),p_socket->bytesAvailable());
+    if(n <= 0)
+        return true;
+
+    int oldSize = d_record.size();
+    d_record.resize(oldSize+n);
+    qint64 r = p_socket->read(d_record.data()+oldSize,n);
+    if(r < 0)
+    {
+        d_record.resize(oldSize);
+        emit logMessage(QString("Could not read waveform data from socket. %1").arg(p_socket->errorString()),QtFTM::LogWarning);
+        return false;
+    }
+
+    d_record.resize(oldSize+static_cast<int>(r));
+    return true;
+}
+
+void DPO3012::resyncParser()
+{
+    //the block header was malformed; throw away everything after the prefix and look for a new hash
+    d_resyncCount++;
+    d_record.resize(d_blockStart);
+    d_parseState = SeekHash;
+    d_recordLength = -1;
+}
+
 void DPO3012::wakeTheFUp()
 {
     //sometimes, the scope just stops responding. This is an effort to wake it the ^@#$ up!
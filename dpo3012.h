@@ -5,6 +5,7 @@
 
 #include <QTime>
 #include <QByteArray>
+#include <QList>
 
 class QTcpSocket;
 
@@ -22,17 +23,41 @@ public slots:
     void replyReceived();
     void setResolution();
     void sendCurveQuery();
+    void setActive(bool active = true);
     void wakeTheFUp();
 
 private:
     QTcpSocket *p_socket;
 
+    /*!
+     * \brief State of the IEEE 488.2 definite-length block parser used in replyReceived()
+     */
+    enum BlockParseState {
+        SeekHash,
+        ReadHeaderDigit,
+        ReadLengthDigits,
+        ReadData
+    };
+
     QByteArray d_waveformPrefix;
-    QByteArray d_response;
-    bool d_headerHashFound;
-    int d_binaryDataLength;
     bool d_resolutionChangePending;
 
+    //record parsing. d_record holds the waveform prefix followed by the #xyyyy<data> block, and is emitted without copying
+    QList<QByteArray> d_recordPool;
+    QByteArray d_record;
+    BlockParseState d_parseState;
+    int d_blockStart;
+    int d_lengthDigits;
+    int d_recordLength;
+    int d_expectedDataBytes;
+    int d_resyncCount;
+    int d_partialReadCount;
+    int d_recordCount;
+
+    void beginRecord();
+    bool readIntoRecord(int maxBytes);
+    void resyncParser();
+
     QTime d_responseTimeout;
     bool d_waitingForReply;
     bool d_waitingForWakeUp;
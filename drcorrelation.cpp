@@ -1,10 +1,12 @@
 #include "drcorrelation.h"
 
 #include "abstractfitter.h"
+#include "configservice.h"
+#include "batchcheckpoint.h"
 
 DrCorrelation::DrCorrelation(QList<QPair<Scan,bool>> templateList, AbstractFitter *ftr) :
     BatchManager(QtFTM::DrCorrelation,false,ftr), d_thisScanIsRef(false), d_processScanIsCal(false),
-    d_processScanIsRef(false), d_loadIndex(0)
+    d_processScanIsRef(false), d_templateList(templateList), d_loadIndex(0)
 {
 	for(int i=0; i<templateList.size();i++)
 	{
@@ -51,6 +53,25 @@ DrCorrelation::DrCorrelation(QList<QPair<Scan,bool>> templateList, AbstractFitte
 		d_totalShots += d_scanList.at(i).first.targetShots();
 }
 
+DrCorrelation *DrCorrelation::fromSettings(QDataStream &ds, AbstractFitter *ftr)
+{
+	qint32 size;
+	ds >> size;
+	QList<QPair<Scan,bool>> templateList;
+	for(int i=0; i<size && ds.status() == QDataStream::Ok; i++)
+	{
+		Scan s = BatchCheckpoint::readScan(ds);
+		bool cal;
+		ds >> cal;
+		templateList.append(qMakePair(s,cal));
+	}
+
+	if(ds.status() != QDataStream::Ok)
+		return nullptr;
+
+	return new DrCorrelation(templateList,ftr);
+}
+
 DrCorrelation::DrCorrelation(int num, AbstractFitter *ftr) :
     BatchManager(QtFTM::DrCorrelation,true,ftr), d_thisScanIsRef(false), d_processScanIsCal(false),
     d_processScanIsRef(false), d_loadIndex(0)
@@ -62,8 +83,7 @@ DrCorrelation::DrCorrelation(int num, AbstractFitter *ftr) :
 	int batchThousands = d_batchNum/1000;
 
 	//create directory, if necessary
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
+	QString savePath = ConfigService::instance().snapshot().savePath();
 	QDir d(savePath + QString("/drcorr/%1/%2").arg(batchMillions).arg(batchThousands));
 	QFile in(QString("%1/%2.txt").arg(d.absolutePath()).arg(d_batchNum));
 
@@ -114,44 +134,30 @@ DrCorrelation::~DrCorrelation()
 
 void DrCorrelation::writeReport()
 {
-	if(d_saveData.isEmpty())
-	 {
-		 emit logMessage(QString("Did not create DR Correlation report because no scans were completed."),QtFTM::LogWarning);
-		 return;
-	 }
-
-	//figure out where to save the data
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	int batchNum = s.value(d_numKey,1).toInt();
-	int batchMillions = batchNum/1000000;
-	int batchThousands = batchNum/1000;
+	finishReport(makeHeader());
+}
 
-	//create directory, if necessary
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-	QDir d(savePath + QString("/drcorr/%1/%2").arg(batchMillions).arg(batchThousands));
-	if(!d.exists())
+bool DrCorrelation::writeSettings(QDataStream &ds) const
+{
+	//the scan list is rebuilt from the templates by the constructor
+	ds << static_cast<qint32>(d_templateList.size());
+	for(int i=0; i<d_templateList.size(); i++)
 	{
-		if(!d.mkpath(d.absolutePath()))
-		{
-			emit logMessage(QString("Could not create directory for saving DR Correlation! Creation of %1 failed, and data were not saved!").arg(d.absolutePath()),QtFTM::LogError);
-			return;
-		}
+		BatchCheckpoint::writeScan(ds,d_templateList.at(i).first);
+		ds << d_templateList.at(i).second;
 	}
 
-	//open file for writing
-	QFile out(QString("%1/%2.txt").arg(d.absolutePath()).arg(batchNum));
+	return true;
+}
+
+QString DrCorrelation::makeHeader()
+{
+	QString out;
 	QTextStream t(&out);
 	QString tab = QString("\t");
 	QString nl = QString("\n");
 
-	if(!out.open(QIODevice::WriteOnly))
-	{
-		emit logMessage(QString("Could not open file for writing DR Correlation data! Creation of %1 failed, and data were not saved!").arg(out.fileName()),QtFTM::LogError);
-		return;
-	}
-
-	//header stuff
-	t << QString("#DR Correlation") << tab << batchNum << tab << nl;
+	t << QString("#DR Correlation") << tab << d_batchNum << tab << nl;
 	t << QString("#Date") << tab << QDateTime::currentDateTime().toString() << tab << nl;
     t << QString("#FID delay") << tab << d_fitter->delay() << tab << QString("us") << nl;
     t << QString("#FID high pass") << tab << d_fitter->hpf() << tab << QString("kHz") << nl;
@@ -159,17 +165,8 @@ void DrCorrelation::writeReport()
     t << QString("#FID remove baseline") << tab << (d_fitter->removeDC() ? QString("Yes") : QString("No")) << tab << nl;
     t << QString("#FID zero padding") << tab << (d_fitter->autoPad() ? QString("Yes") : QString("No")) << tab << nl;
 
-	t << nl << QString("drcscan") << batchNum << tab << QString("drciscal") << batchNum << tab << QString("drcisref") << batchNum << tab
-	  << QString("drcftmfreq") << batchNum << tab << QString("drcdrfreq") << batchNum << tab << QString("drcmax") << batchNum << nl;
-
-	for(int i=0; i<d_saveData.size(); i++)
-		t << nl << d_saveData.at(i);
-
 	t.flush();
-	out.close();
-
-	s.setValue(d_numKey,batchNum+1);
-    s.sync();
+	return out;
 }
 
 void DrCorrelation::advanceBatch(const Scan s)
@@ -184,7 +181,7 @@ void DrCorrelation::advanceBatch(const Scan s)
 void DrCorrelation::processScan(Scan s)
 {
 	//maybe do something intelligent with this later?
-	d_fitter->doFit(s);
+	fitScan(s);
 
 	//the scan number will be used on the X axis of the plot
 	double num = (double)s.number();
@@ -261,9 +258,9 @@ void DrCorrelation::processScan(Scan s)
 	else
 		md.drMatch = false;
 
-	 //record data for saving
+	 //write data to the report
 	QString tab("\t");
-	QString sd = QString::number(s.number()) + tab;
+	QString sd = QString("\n") + QString::number(s.number()) + tab;
     if(d_processScanIsCal)
 		sd.append("1");
 	else
@@ -275,7 +272,15 @@ void DrCorrelation::processScan(Scan s)
 		sd += tab + QString("0");
 
 	sd += tab + QString::number(s.ftFreq(),'f',4) + tab + QString::number(s.drFreq(),'f',4) + tab + QString::number(max,'f',2);
-	d_saveData.append(sd);
+	if(!d_loading)
+	{
+		if(!d_report.isOpen())
+		{
+			QString title = QString("\ndrcscan%1\tdrciscal%1\tdrcisref%1\tdrcftmfreq%1\tdrcdrfreq%1\tdrcmax%1\n").arg(d_batchNum);
+			openReport(QString("drcorr"),makeHeader(),title);
+		}
+		appendToReport(sd);
+	}
 
 	//send the data to the plot
 	QList<QVector<QPointF> > out;
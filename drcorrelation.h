@@ -15,6 +15,8 @@ public:
     explicit DrCorrelation(int num, AbstractFitter *ftr = new NoFitter());
 	~DrCorrelation();
 
+	static DrCorrelation *fromSettings(QDataStream &ds, AbstractFitter *ftr);
+
 	// BatchManager interface
 protected:
 	void writeReport();
@@ -22,16 +24,19 @@ protected:
 	void processScan(Scan s);
 	Scan prepareNextScan();
 	bool isBatchComplete();
+	bool writeSettings(QDataStream &ds) const;
 
 private:
     bool d_thisScanIsRef, d_processScanIsCal, d_processScanIsRef;
 	double d_currentRefMax;
+	QList<QPair<Scan,bool>> d_templateList;
 	QList<QPair<Scan,bool>> d_scanList;
 	QVector<QPointF> d_drData, d_calData;
-	QStringList d_saveData;
 
 	QList<bool> d_loadCalList, d_loadRefList;
 	int d_loadIndex;
+
+	QString makeHeader();
 };
 
 #endif // DRCORRELATION_H
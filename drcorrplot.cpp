@@ -2,6 +2,9 @@
 
 #include <qwt6/qwt_symbol.h>
 #include <qwt6/qwt_plot_renderer.h>
+#include <qwt6/qwt_graphic.h>
+
+#include "batchprintjob.h"
 
 DrCorrPlot::DrCorrPlot(int num, QtFTM::BatchType t, QWidget *parent) :
 	AbstractBatchPlot(QString("drCorrPlot"),parent)
@@ -33,7 +36,7 @@ void DrCorrPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF>
 	if(d_metaDataList.isEmpty())
 	{
 	    //for a batch, there will only be one data curve
-	    QwtPlotCurve *curve = new QwtPlotCurve(QString("Batch Data"));
+	    QwtPlotCurve *curve = new RasterCurve(QString("Batch Data"));
 	    curve->setPen(QPen(QPalette().color(QPalette::Text)));
 	    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
 	    d_plotCurves.append(curve);
@@ -613,8 +616,22 @@ void DrCorrPlot::doCorrPrint(QPrinter *pr, int firstScan, int lastScan, int grap
 	else
 		numPages = graphList.size()/graphsPerPage;
 
-	QPainter p;
-	p.begin(pr);
+	//the tallest label sets the space above each graph
+	height = 0;
+	for(int i=0;i<d_plotMarkers.size();i++)
+	{
+		if(!d_metaDataList.at(i).isCal)
+		{
+			QString text = d_plotMarkers.at(i)->label().text();
+			int numLines = text.split(QString("\n"),QString::SkipEmptyParts).size();
+			height = qMax(height,fm3.boundingRect(text).height()*numLines);
+		}
+	}
+
+	//each page is recorded here, and written to the printer by the job on its own thread
+	BatchPrintJob job(pr,numPages,this);
+	bool replotWasDisabled = d_doNotReplot;
+	d_doNotReplot = true;
 
 	int graphIndex = 0;
 
@@ -629,17 +646,19 @@ void DrCorrPlot::doCorrPrint(QPrinter *pr, int firstScan, int lastScan, int grap
 	//all preparation is complete, enter render loop
 	for(int page = 0; page<numPages; page++)
 	{
-	    if(page>0)
-		   pr->newPage();
+	    QwtGraphic *pageGraphic = new QwtGraphic();
+	    pageGraphic->setDefaultSize(job.pageSize());
+	    QPainter p(pageGraphic);
 
 	    //set page number in title
 	    pageLabel.setText(QString("Page %1/%2").arg(page+1).arg(numPages));
-	    p.scale(scale,scale);
+	    //the title bar is laid out at screen resolution, which is close to the resolution of the recorded page
+	    p.scale(scale/job.scale(),scale/job.scale());
 
 	    //render title bar
 	    df.render(&p,QPoint(),QRegion(),DrawChildren);
 
-	    p.scale(1.0/scale,1.0/scale);
+	    p.resetTransform();
 
 	    //loop over graph rectangles
 	    for(int rect=0; rect<graphRects.size(); rect++)
@@ -649,17 +668,6 @@ void DrCorrPlot::doCorrPrint(QPrinter *pr, int firstScan, int lastScan, int grap
 		   setAxisScale(QwtPlot::xBottom,xMin,xMax);
 		   double yMax = graphList.at(graphIndex).yMax;
 
-		   height = 0;
-		   for(int i=0;i<d_plotMarkers.size();i++)
-		   {
-			   if(!d_metaDataList.at(i).isCal)
-			   {
-				   QString text = d_plotMarkers.at(i)->label().text();
-				   int numLines = text.split(QString("\n"),QString::SkipEmptyParts).size();
-				   height = qMax(height,fm3.boundingRect(text).height()*numLines);
-			   }
-		   }
-
 		   //estimating that the x axis scale/label take up ~1000 pts in printer scale
 		   double scaling = yMax/((double)graphRects.at(rect).height()-1000);
 		   yMax += static_cast<double>(height+150)*scaling;
@@ -704,15 +712,20 @@ void DrCorrPlot::doCorrPrint(QPrinter *pr, int firstScan, int lastScan, int grap
 		   if(replotAgain)
 			  QwtPlot::replot();
 
-		   rend.render(this,&p,graphRects.at(rect));
+		   rend.render(this,&p,job.toPage(graphRects.at(rect)));
 
 		   graphIndex++;
 		   if(graphIndex == graphList.size())
 			  break;
 	    }
+
+	    p.end();
+	    if(!job.addPage(pageGraphic))
+		   break;
 	}
 
-	p.end();
+	job.finish();
+	d_doNotReplot = replotWasDisabled;
 
 	maxMarker->detach();
 	delete maxMarker;
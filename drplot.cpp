@@ -37,7 +37,7 @@ void DrPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF> > d
             QColor color = s.value(QString("DrRange%1").arg(QString::number(i)),
                                QPalette().color(QPalette::ToolTipBase)).value<QColor>();
 
-            QwtPlotCurve *c = new QwtPlotCurve(QString("DrRange%1").arg(QString::number(i)));
+            QwtPlotCurve *c = new RasterCurve(QString("DrRange%1").arg(QString::number(i)));
             c->setRenderHint(QwtPlotItem::RenderAntialiased);
             c->setPen(QPen(color));
             d_plotCurves.append(c);
@@ -3,6 +3,8 @@
 #include <QVBoxLayout>
 #include <QSettings>
 
+#include "numberallocator.h"
+
 DrSummaryPage::DrSummaryPage(QWidget *parent) :
      QWizardPage(parent)
 {
@@ -31,10 +33,9 @@ int DrSummaryPage::nextId() const
 void DrSummaryPage::initializePage()
 {
 	//this is all pretty straightforward
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
 
-	int drNum = s.value("drNum",1).toInt();
-	int firstScanNum = s.value("scanNum",0).toInt()+1;
+	int drNum = NumberAllocator::instance().next(QString("drNum"));
+	int firstScanNum = NumberAllocator::instance().lastScanNumber()+1;
 	bool hasCal = field(QString("drCal")).toBool();
 	double start = field(QString("drStart")).toDouble();
 	double stop = field(QString("drStop")).toDouble();
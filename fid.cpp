@@ -6,7 +6,8 @@
 /*!
  \brief Internal data for Fid
 
- Stores the time spacing between points (in s), the probe frequency (in MHz), and the FID data (arbitrary units)
+ Stores the time spacing between points (in s), the probe frequency (in MHz), and the FID data (arbitrary units).
+ If the FID was built from raw oscilloscope codes, their sum and scaling are also stored; rawShots is 0 otherwise.
 */
 class FidData : public QSharedData {
 public:
@@ -14,18 +15,23 @@ public:
  \brief Default constructor
 
 */
-    FidData() : spacing(5e-7), probeFreq(0.0), fid(QVector<double>(400)) {}
+    FidData() : spacing(5e-7), probeFreq(0.0), fid(QVector<double>(400)), rawShots(0), yMult(0.0), yOffset(0.0) {}
 /*!
  \brief Copy constructor
 
  \param other Object to copy
 */
-	FidData(const FidData &other) : QSharedData(other), spacing(other.spacing), probeFreq(other.probeFreq), fid(other.fid) {}
+	FidData(const FidData &other) : QSharedData(other), spacing(other.spacing), probeFreq(other.probeFreq), fid(other.fid),
+		rawSum(other.rawSum), rawShots(other.rawShots), yMult(other.yMult), yOffset(other.yOffset) {}
 	~FidData(){}
 
 	double spacing;
 	double probeFreq;
 	QVector<double> fid;
+	QVector<qint64> rawSum;
+	qint64 rawShots;
+	double yMult;
+	double yOffset;
 };
 
 Fid::Fid() : data(new FidData)
@@ -67,7 +73,39 @@ void Fid::setProbeFreq(const double f)
 
 void Fid::setData(const QVector<double> d)
 {
+	//the raw sum no longer describes the data
 	data->fid = d;
+	clearRawSum();
+}
+
+void Fid::setRawSum(const QVector<qint64> sum, const qint64 shots, const double yMult, const double yOffset)
+{
+	if(shots < 1)
+		return;
+
+	data->rawSum = sum;
+	data->rawShots = shots;
+	data->yMult = yMult;
+	data->yOffset = yOffset;
+
+	QVector<double> d(sum.size());
+	double *out = d.data();
+	const qint64 *in = sum.constData();
+	double n = static_cast<double>(shots);
+	for(int i=0; i<d.size(); i++)
+		out[i] = yMult*(static_cast<double>(in[i])/n + yOffset);
+	data->fid = d;
+}
+
+void Fid::clearRawSum()
+{
+	if(data->rawShots == 0)
+		return;
+
+	data->rawSum.clear();
+	data->rawShots = 0;
+	data->yMult = 0.0;
+	data->yOffset = 0.0;
 }
 
 int Fid::size() const
@@ -114,3 +152,33 @@ double Fid::maxFreq() const
     else
         return 0.0;
 }
+
+bool Fid::hasRawSum() const
+{
+	return data->rawShots > 0 && data->rawSum.size() == data->fid.size();
+}
+
+QVector<qint64> Fid::rawSum() const
+{
+	return data->rawSum;
+}
+
+qint64 Fid::rawShots() const
+{
+	return data->rawShots;
+}
+
+double Fid::yMult() const
+{
+	return data->yMult;
+}
+
+double Fid::yOffset() const
+{
+	return data->yOffset;
+}
+
+bool Fid::rawCompatible(const Fid &other) const
+{
+	return hasRawSum() && other.hasRawSum() && size() == other.size() && yMult() == other.yMult() && yOffset() == other.yOffset();
+}
@@ -16,6 +16,8 @@ class FidData;
  A deep member-by-member copy only occurs if the data is modified.
 
  An Fid object has a data vector of voltage as a function of time, a probe frequency, and a spacing between points in the vector.
+ An Fid that was built from oscilloscope records may also carry the integer sum of the raw ADC codes, together with the number of shots and the scope's y multiplier and offset (see setRawSum()).
+ In that case, the voltages are computed from the sum, so the Fid can be stored and recovered exactly (see FidCodec).
  This class provides a wrapper around the data storage that allows the implicit sharing functionality to work.
  All non-const functions will cause a deep copy if there are multiple references to the Fid object, but const functions will never cause a deep copy to occur.
 
@@ -79,6 +81,22 @@ public:
 	*/
 	void setData(const QVector<double> d);
 
+	/*!
+	 \brief Sets the sum of raw ADC codes and recomputes the data vector (can cause deep copy)
+
+	 Each point is set to yMult*(sum/shots + yOffset).
+
+	 \param sum Sum of raw codes for each point
+	 \param shots Number of shots in the sum
+	 \param yMult Volts per ADC code
+	 \param yOffset Offset, in ADC codes
+	*/
+	void setRawSum(const QVector<qint64> sum, const qint64 shots, const double yMult, const double yOffset);
+	/*!
+	 \brief Discards the raw sum, keeping the data vector (can cause deep copy)
+	*/
+	void clearRawSum();
+
 	/*!
 	 \brief Number of points in data vector
 
@@ -124,6 +142,19 @@ public:
      * \return Max frequency, in MHz
      */
     double maxFreq() const;
+
+	/*!
+	 \brief Whether the Fid carries the sum of raw ADC codes
+	*/
+	bool hasRawSum() const;
+	QVector<qint64> rawSum() const;
+	qint64 rawShots() const;
+	double yMult() const;
+	double yOffset() const;
+	/*!
+	 \brief Whether the raw sums of two Fids can be added together (same length and scaling)
+	*/
+	bool rawCompatible(const Fid &other) const;
 	
 private:
 	QSharedDataPointer<FidData> data; /*!< The internal data storage object */
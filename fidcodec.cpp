@@ -0,0 +1,162 @@
+#include "fidcodec.h"
+
+#include <QtEndian>
+#include <string.h>
+
+namespace {
+
+const int headerSize = 32;
+const int padding = 8;
+const quint8 formatVersion = 1;
+
+const int codeLength[4] = { 1, 2, 4, 8 };
+const quint64 codeMask[4] = { 0xffULL, 0xffffULL, 0xffffffffULL, ~0ULL };
+
+inline quint64 zigzag(qint64 v)
+{
+	return (static_cast<quint64>(v) << 1) ^ static_cast<quint64>(v >> 63);
+}
+
+inline qint64 unzigzag(quint64 u)
+{
+	return static_cast<qint64>(u >> 1) ^ -static_cast<qint64>(u & 1);
+}
+
+inline int lengthCode(quint64 u)
+{
+	if(u <= 0xffULL)
+		return 0;
+	if(u <= 0xffffULL)
+		return 1;
+	if(u <= 0xffffffffULL)
+		return 2;
+	return 3;
+}
+
+//total number of value bytes described by each possible control byte
+struct GroupLengths {
+	int bytes[256];
+	GroupLengths() {
+		for(int c=0; c<256; c++)
+			bytes[c] = codeLength[c&3] + codeLength[(c>>2)&3] + codeLength[(c>>4)&3] + codeLength[(c>>6)&3];
+	}
+};
+
+const GroupLengths groupLengths;
+
+}
+
+QByteArray FidCodec::encodeValues(const QVector<qint64> &values)
+{
+	int n = values.size();
+	int numGroups = (n+3)/4;
+	QByteArray control(numGroups,'\0');
+	QByteArray bytes;
+	bytes.reserve(n*2 + padding);
+
+	qint64 last = 0;
+	for(int i=0; i<n; i++)
+	{
+		//differences are taken modulo 2^64, so any pair of values round-trips
+		quint64 u = zigzag(static_cast<qint64>(static_cast<quint64>(values.at(i)) - static_cast<quint64>(last)));
+		last = values.at(i);
+
+		int code = lengthCode(u);
+		control[i/4] = static_cast<char>(static_cast<uchar>(control.at(i/4)) | (code << (2*(i%4))));
+
+		uchar le[8];
+		qToLittleEndian<quint64>(u,le);
+		bytes.append(reinterpret_cast<const char*>(le),codeLength[code]);
+	}
+
+	//padding allows the decoder to always load 8 bytes
+	bytes.append(QByteArray(padding,'\0'));
+	return control + bytes;
+}
+
+bool FidCodec::decodeValues(const uchar *d, qint64 size, int count, QVector<qint64> &values)
+{
+	if(count < 0)
+		return false;
+
+	qint64 numGroups = (static_cast<qint64>(count)+3)/4;
+	if(size < numGroups + padding)
+		return false;
+
+	//validate the total length first, so that no bounds checks are needed while decoding
+	const uchar *control = d;
+	qint64 total = 0;
+	for(qint64 g=0; g<numGroups; g++)
+		total += groupLengths.bytes[control[g]];
+	//unused codes in the last group are 0, which count as 1 byte each
+	total -= (4*numGroups - count);
+	if(size != numGroups + total + padding)
+		return false;
+
+	values.resize(count);
+	qint64 *out = values.data();
+	const uchar *p = d + numGroups;
+	qint64 last = 0;
+	for(int i=0; i<count; i++)
+	{
+		int code = (control[i>>2] >> (2*(i&3))) & 3;
+		quint64 u;
+		memcpy(&u,p,8);
+		u = qFromLittleEndian(u) & codeMask[code];
+		p += codeLength[code];
+
+		last = static_cast<qint64>(static_cast<quint64>(last) + static_cast<quint64>(unzigzag(u)));
+		out[i] = last;
+	}
+
+	return true;
+}
+
+QByteArray FidCodec::encode(const Fid &f)
+{
+	if(!f.hasRawSum())
+		return QByteArray();
+
+	uchar header[headerSize];
+	memset(header,0,headerSize);
+	header[0] = formatVersion;
+	qToLittleEndian<qint32>(f.size(),header+4);
+	qToLittleEndian<qint64>(f.rawShots(),header+8);
+
+	double ym = f.yMult(), yo = f.yOffset();
+	quint64 bits;
+	memcpy(&bits,&ym,8);
+	qToLittleEndian<quint64>(bits,header+16);
+	memcpy(&bits,&yo,8);
+	qToLittleEndian<quint64>(bits,header+24);
+
+	return QByteArray(reinterpret_cast<const char*>(header),headerSize) + encodeValues(f.rawSum());
+}
+
+bool FidCodec::decode(const QByteArray d, Fid &f)
+{
+	if(d.size() < headerSize)
+		return false;
+
+	const uchar *header = reinterpret_cast<const uchar*>(d.constData());
+	if(header[0] != formatVersion)
+		return false;
+
+	qint32 count = qFromLittleEndian<qint32>(header+4);
+	qint64 shots = qFromLittleEndian<qint64>(header+8);
+	if(shots < 1)
+		return false;
+
+	double ym, yo;
+	quint64 bits = qFromLittleEndian<quint64>(header+16);
+	memcpy(&ym,&bits,8);
+	bits = qFromLittleEndian<quint64>(header+24);
+	memcpy(&yo,&bits,8);
+
+	QVector<qint64> sum;
+	if(!decodeValues(header+headerSize,d.size()-headerSize,count,sum))
+		return false;
+
+	f.setRawSum(sum,shots,ym,yo);
+	return true;
+}
@@ -0,0 +1,48 @@
+#ifndef FIDCODEC_H
+#define FIDCODEC_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "fid.h"
+
+/*!
+ * \brief Lossless compression of the raw ADC sums stored in an Fid
+ *
+ * Consecutive points of an averaged FID differ by much less than the points themselves, so each sum is stored as the difference from the previous point.
+ * The differences are zigzag-encoded (small negative numbers become small positive numbers) and written with a group varint code:
+ * values are handled in groups of 4, and each group has one control byte that holds a 2-bit length code (1, 2, 4, or 8 bytes) for each value.
+ * The control bytes are stored together, followed by the value bytes, so decoding needs no per-byte branching: each value is a single 8-byte load and a mask.
+ *
+ * Block layout (all fields little endian):
+ * - quint8 version (1), 3 reserved bytes
+ * - qint32 number of points
+ * - qint64 number of shots
+ * - double y multiplier, double y offset
+ * - control bytes (one per group of 4 points)
+ * - value bytes, followed by 8 bytes of padding
+ *
+ * Decoding reproduces the original sums exactly.
+ */
+namespace FidCodec {
+
+/*!
+ * \brief Compresses the raw sum of an Fid
+ * \param f Fid (must have a raw sum)
+ * \return Encoded block, or an empty array if f has no raw sum
+ */
+QByteArray encode(const Fid &f);
+/*!
+ * \brief Restores the raw sum (and therefore the data) of an Fid from an encoded block
+ * \param d Encoded block
+ * \param f Fid to update. Spacing and probe frequency are not changed
+ * \return Whether the block was valid
+ */
+bool decode(const QByteArray d, Fid &f);
+
+QByteArray encodeValues(const QVector<qint64> &values);
+bool decodeValues(const uchar *d, qint64 size, int count, QVector<qint64> &values);
+
+}
+
+#endif // FIDCODEC_H
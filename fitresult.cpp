@@ -5,10 +5,9 @@
 #include <math.h>
 #include <QDir>
 #include <QFile>
-#include <QTextStream>
 #include "analysis.h"
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
+#include "fitresultstore.h"
 
 class FitData : public QSharedData
 {
@@ -67,11 +66,12 @@ void FitResult::deleteFitResult(const int num)
     int dirMillionsNum = num/1000000;
     int dirThousandsNum = num/1000;
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    QString savePath = s.value(QString("savePath"),QString(".")).toString();
+    QString savePath = ConfigService::instance().snapshot().savePath();
     QDir d(savePath + QString("/autofit/%1/%2").arg(dirMillionsNum).arg(dirThousandsNum));
 
-    //open file
+    FitResultStore::instance().remove(num);
+
+    //results saved by earlier versions are text files
     QFile f(QString("%1/%2.txt").arg(d.absolutePath()).arg(num));
     if(f.exists())
         f.remove();
@@ -629,65 +629,13 @@ void FitResult::setLogText(const QString s)
     data->log = s;
 }
 
-void FitResult::save(int num)
+bool FitResult::save(int num)
 {
 	if(num < 1)
-		return;
+		return false;
 
 	data->scanNum = num;
-
-	int dirMillionsNum = (int)floor((double) num/1000000.0);
-	int dirThousandsNum = (int)floor((double) num/1000.0);
-
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-
-	QDir d(savePath + QString("/autofit/%1/%2").arg(dirMillionsNum).arg(dirThousandsNum));
-	if(!d.exists())
-	{
-		if(!d.mkpath(d.absolutePath()))
-			return;
-	}
-
-	//create output file
-	QFile f(QString("%1/%2.txt").arg(d.absolutePath()).arg(num));
-
-	if(!f.open(QIODevice::WriteOnly))
-		return;
-
-	QTextStream t(&f);
-	t.setRealNumberNotation(QTextStream::ScientificNotation);
-	t.setRealNumberPrecision(12);
-
-	QString tab("\t");
-	QString nl("\n");
-
-    t << QString("#FitType") << tab << (int)type() << nl;
-	t << QString("#Category") << tab << (int)category() << nl;
-    t << QString("#Lineshape") << tab << (int)lineShape() << nl;
-	t << QString("#Status") << tab << status() << nl;
-	t << QString("#Iterations") << tab << iterations() << nl;
-	t << QString("#Chisq") << tab << chisq() << nl;
-	t << QString("#ProbeFreq") << tab << probeFreq() << nl;
-	t << QString("#NumParams") << tab << numParams() << nl;
-	t << QString("#Delay") << tab << delay() << nl;
-	t << QString("#HighPass") << tab << hpf() << nl;
-	t << QString("#Exp") << tab << exp() << nl;
-    t << QString("#RemoveDC") << tab << rdc() << nl;
-    t << QString("#ZeroPad") << tab << zpf() << nl;
-    t << QString("#UseWindow") << tab << isUseWindow() << nl;
-	t << QString("#SinglePeaks") << tab << freqAmpSingleList().size() << nl;
-	t << QString("#BufferGas") << tab << bufferGas().name << nl;
-	t << QString("#Temperature") << tab << temperature() << nl;
-	t << QString("#ParameterList") << tab;
-	for(int i=0;i<allFitParams().size() && i<allFitUncertainties().size(); i++)
-		t << nl << allFitParams().at(i) << tab << allFitUncertainties().at(i);
-
-	t << nl << nl << QString("[log]") << nl;
-	t << log();
-
-	t.flush();
-	f.close();
+	return FitResultStore::instance().put(num,*this);
 }
 
 void FitResult::loadFromFile(int num)
@@ -695,11 +643,18 @@ void FitResult::loadFromFile(int num)
 	if(num < 1)
 		return;
 
+	if(FitResultStore::instance().get(num,*this))
+	{
+		data->scanNum = num;
+		return;
+	}
+
+	//fall back to the text files written by earlier versions
+
 	int dirMillionsNum = (int)floor((double) num/1000000.0);
 	int dirThousandsNum = (int)floor((double) num/1000.0);
 
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
+	QString savePath = ConfigService::instance().snapshot().savePath();
 	QDir d(savePath + QString("/autofit/%1/%2").arg(dirMillionsNum).arg(dirThousandsNum));
 
 	//open file
@@ -130,7 +130,7 @@ public:
 	void setTemperature(double t);
 	void appendToLog(const QString s);
     void setLogText(const QString s);
-	void save(int num);
+	bool save(int num);
 	void loadFromFile(int num);    
     double yVal(double x) const;
 
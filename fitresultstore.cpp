@@ -0,0 +1,461 @@
+#include "fitresultstore.h"
+
+#include <QDir>
+#include <QPair>
+#include <QDataStream>
+#include <algorithm>
+
+#include "configservice.h"
+
+namespace {
+
+const quint32 recordMagic = 0x31535246; //"FRS1"
+const int recordHeaderSize = 112;
+const int indexEntrySize = 16;
+const int bufferGasSize = 8;
+
+//deferred results are written once this many have been collected
+const int maxPending = 64;
+
+//records closer together than this are read with a single call in load()
+const qint64 maxReadGap = 4096;
+
+enum RecordFlags {
+	RemoveDcFlag = 1,
+	ZeroPadFlag = 2,
+	UseWindowFlag = 4
+};
+
+}
+
+FitResultStore &FitResultStore::instance()
+{
+	static FitResultStore store;
+	return store;
+}
+
+FitResultStore::FitResultStore() : d_loaded(false), d_deferDepth(0)
+{
+	d_dir = ConfigService::instance().snapshot().savePath() + QString("/autofit");
+}
+
+FitResultStore::~FitResultStore()
+{
+	flush();
+}
+
+bool FitResultStore::put(int num, const FitResult &res)
+{
+	if(num < 1)
+		return true;
+
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	if(!d_pending.contains(num))
+		d_pendingOrder.append(num);
+	d_pending.insert(num,res);
+
+	if(d_deferDepth == 0 || d_pending.size() >= maxPending)
+		return writePending();
+
+	return true;
+}
+
+bool FitResultStore::get(int num, FitResult &out)
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	if(d_pending.contains(num))
+	{
+		out = d_pending.value(num);
+		return true;
+	}
+
+	if(!d_index.contains(num))
+		return false;
+
+	IndexEntry e = d_index.value(num);
+	if(!d_records.seek(e.offset))
+		return false;
+
+	QByteArray rec = d_records.read(e.length);
+	qint64 logOffset;
+	qint32 logLength;
+	if(!decodeRecord(rec.constData(),rec.size(),num,out,logOffset,logLength))
+		return false;
+
+	out.setLogText(readLog(logOffset,logLength));
+	return true;
+}
+
+QHash<int,FitResult> FitResultStore::load(const QList<int> nums, bool withLog)
+{
+	QHash<int,FitResult> out;
+	out.reserve(nums.size());
+
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	QList<QPair<qint64,int> > offsets;
+	offsets.reserve(nums.size());
+	for(int i=0; i<nums.size(); i++)
+	{
+		int n = nums.at(i);
+		if(d_pending.contains(n))
+			out.insert(n,d_pending.value(n));
+		else if(d_index.contains(n) && !out.contains(n))
+			offsets.append(qMakePair(d_index.value(n).offset,n));
+	}
+
+	//reading in file order lets neighboring records share one read
+	std::sort(offsets.begin(),offsets.end());
+	int i = 0;
+	while(i < offsets.size())
+	{
+		qint64 start = offsets.at(i).first;
+		qint64 end = start + d_index.value(offsets.at(i).second).length;
+		int j = i+1;
+		while(j < offsets.size() && offsets.at(j).first - end <= maxReadGap)
+		{
+			end = qMax(end,offsets.at(j).first + d_index.value(offsets.at(j).second).length);
+			j++;
+		}
+
+		QByteArray block;
+		if(d_records.seek(start))
+			block = d_records.read(end - start);
+
+		for(int k=i; k<j; k++)
+		{
+			int n = offsets.at(k).second;
+			qint64 pos = offsets.at(k).first - start;
+			qint32 len = d_index.value(n).length;
+			if(pos + len > block.size())
+				continue;
+
+			FitResult res;
+			qint64 logOffset;
+			qint32 logLength;
+			if(!decodeRecord(block.constData()+pos,len,n,res,logOffset,logLength))
+				continue;
+
+			if(withLog)
+				res.setLogText(readLog(logOffset,logLength));
+			out.insert(n,res);
+		}
+
+		i = j;
+	}
+
+	return out;
+}
+
+void FitResultStore::remove(int num)
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	if(d_pending.remove(num) > 0)
+		d_pendingOrder.removeAll(num);
+
+	if(!d_index.contains(num))
+		return;
+
+	//earlier records are left in place; the index entry with length 0 hides them
+	IndexEntry e;
+	e.offset = 0;
+	e.length = 0;
+	if(d_indexFile.isOpen() && d_indexFile.seek(d_indexFile.size()))
+	{
+		d_indexFile.write(encodeIndexEntry(num,e));
+		d_indexFile.flush();
+	}
+	d_index.remove(num);
+}
+
+bool FitResultStore::contains(int num)
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	return d_pending.contains(num) || d_index.contains(num);
+}
+
+bool FitResultStore::flush()
+{
+	QMutexLocker l(&d_mutex);
+	return writePending();
+}
+
+void FitResultStore::beginDeferredWrites()
+{
+	QMutexLocker l(&d_mutex);
+	d_deferDepth++;
+}
+
+bool FitResultStore::endDeferredWrites()
+{
+	QMutexLocker l(&d_mutex);
+	d_deferDepth = qMax(d_deferDepth-1,0);
+	if(d_deferDepth == 0)
+		return writePending();
+
+	return true;
+}
+
+QString FitResultStore::takeError()
+{
+	QMutexLocker l(&d_mutex);
+	QString out = d_error;
+	d_error.clear();
+	return out;
+}
+
+QByteArray FitResultStore::encodeRecord(int num, const FitResult &res, qint64 logOffset, qint32 logLength)
+{
+	QList<double> p = res.allFitParams();
+	QList<double> u = res.allFitUncertainties();
+	int numValues = qMin(p.size(),u.size());
+
+	QByteArray out;
+	out.reserve(recordHeaderSize + 16*numValues);
+	QDataStream ds(&out,QIODevice::WriteOnly);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+	quint8 flags = 0;
+	if(res.rdc())
+		flags |= RemoveDcFlag;
+	if(res.zpf())
+		flags |= ZeroPadFlag;
+	if(res.isUseWindow())
+		flags |= UseWindowFlag;
+
+	QByteArray gas = res.bufferGas().name.toLatin1().left(bufferGasSize);
+	gas.append(QByteArray(bufferGasSize-gas.size(),'\0'));
+
+	ds << recordMagic << static_cast<qint32>(num) << static_cast<qint32>(res.type()) << static_cast<qint32>(res.category())
+	   << static_cast<qint32>(res.lineShape()) << static_cast<qint32>(res.status()) << static_cast<qint32>(res.iterations())
+	   << static_cast<qint32>(res.freqAmpSingleList().size());
+	ds << flags << quint8(0) << quint16(0) << quint32(0);
+	ds.writeRawData(gas.constData(),bufferGasSize);
+	ds << res.chisq() << res.probeFreq() << res.delay() << res.hpf() << res.exp() << res.temperature();
+	ds << logOffset << logLength << static_cast<qint32>(numValues);
+
+	for(int i=0; i<numValues; i++)
+		ds << p.at(i) << u.at(i);
+
+	return out;
+}
+
+bool FitResultStore::decodeRecord(const char *d, qint64 size, int num, FitResult &out, qint64 &logOffset, qint32 &logLength)
+{
+	if(size < recordHeaderSize)
+		return false;
+
+	QByteArray rec = QByteArray::fromRawData(d,static_cast<int>(size));
+	QDataStream ds(rec);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+	quint32 magic;
+	qint32 recNum, type, category, lineShape, status, iterations, numSingle, numValues;
+	quint8 flags, pad8;
+	quint16 pad16;
+	quint32 pad32;
+	char gas[bufferGasSize+1];
+	double chisq, probeFreq, delay, hpf, exp, temperature;
+
+	ds >> magic >> recNum >> type >> category >> lineShape >> status >> iterations >> numSingle;
+	ds >> flags >> pad8 >> pad16 >> pad32;
+	ds.readRawData(gas,bufferGasSize);
+	gas[bufferGasSize] = '\0';
+	ds >> chisq >> probeFreq >> delay >> hpf >> exp >> temperature;
+	ds >> logOffset >> logLength >> numValues;
+
+	if(magic != recordMagic || recNum != num || numValues < 0 || size != recordHeaderSize + 16*static_cast<qint64>(numValues))
+		return false;
+
+	QList<double> p, u;
+	p.reserve(numValues);
+	u.reserve(numValues);
+	for(int i=0; i<numValues; i++)
+	{
+		double a, b;
+		ds >> a >> b;
+		p.append(a);
+		u.append(b);
+	}
+
+	if(ds.status() != QDataStream::Ok)
+		return false;
+
+	out.setType(static_cast<FitResult::FitterType>(type));
+	out.setCategory(static_cast<FitResult::FitCategory>(category));
+	out.setLineShape(static_cast<FitResult::LineShape>(lineShape));
+	out.setStatus(status);
+	out.setIterations(iterations);
+	out.setChisq(chisq);
+	//the probe frequency must be set before the parameters, which are stored relative to it
+	out.setProbeFreq(probeFreq);
+	out.setDelay(delay);
+	out.setHpf(hpf);
+	out.setExp(exp);
+	out.setRdc(flags & RemoveDcFlag);
+	out.setZpf(flags & ZeroPadFlag);
+	out.setUseWindow(flags & UseWindowFlag);
+	out.setBufferGas(QString::fromLatin1(gas));
+	out.setTemperature(temperature);
+
+	int numPairs = 0;
+	if(out.type() != FitResult::Single)
+		numPairs = (numValues-4-2*numSingle)/3;
+	out.setFitParameters(p,u,numPairs,numSingle);
+
+	return true;
+}
+
+QByteArray FitResultStore::encodeIndexEntry(int num, const FitResultStore::IndexEntry &e)
+{
+	QByteArray out;
+	out.reserve(indexEntrySize);
+	QDataStream ds(&out,QIODevice::WriteOnly);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds << static_cast<qint32>(num) << e.length << e.offset;
+	return out;
+}
+
+void FitResultStore::load()
+{
+	d_loaded = true;
+	if(!openFiles())
+		return;
+
+	QByteArray idx = d_indexFile.readAll();
+	int entries = idx.size()/indexEntrySize;
+
+	QDataStream ds(idx);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	qint64 recordsSize = d_records.size();
+	for(int i=0; i<entries; i++)
+	{
+		qint32 num;
+		IndexEntry e;
+		ds >> num >> e.length >> e.offset;
+
+		if(e.length == 0)
+			d_index.remove(num);
+		else if(e.offset >= 0 && e.offset + e.length <= recordsSize)
+			d_index.insert(num,e);
+	}
+
+	//discard an incomplete entry at the end of the index
+	if(idx.size() != entries*indexEntrySize)
+		d_indexFile.resize(static_cast<qint64>(entries)*indexEntrySize);
+}
+
+bool FitResultStore::openFiles()
+{
+	//the files are opened again if an earlier attempt failed (e.g., the save path was not mounted yet)
+	QDir().mkpath(d_dir);
+
+	QFile *files[3] = { &d_records, &d_logs, &d_indexFile };
+	const char *names[3] = { "fits.dat", "fitlogs.dat", "fits.idx" };
+	for(int i=0; i<3; i++)
+	{
+		if(files[i]->isOpen())
+			continue;
+
+		files[i]->setFileName(QString("%1/%2").arg(d_dir).arg(QString::fromLatin1(names[i])));
+		if(!files[i]->open(QIODevice::ReadWrite))
+		{
+			d_error = QString("Could not open %1 (%2).").arg(files[i]->fileName()).arg(files[i]->errorString());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FitResultStore::writePending()
+{
+	if(d_pending.isEmpty())
+		return true;
+
+	//if the files could not be opened when the store was loaded, the index is read once they can be (the index file is opened last)
+	if(!d_indexFile.isOpen())
+	{
+		d_index.clear();
+		load();
+		if(!d_indexFile.isOpen())
+			return false;
+	}
+
+	QByteArray records, logs, index;
+	qint64 recordBase = d_records.size();
+	qint64 logBase = d_logs.size();
+	QList<QPair<int,IndexEntry> > entries;
+
+	for(int i=0; i<d_pendingOrder.size(); i++)
+	{
+		int num = d_pendingOrder.at(i);
+		FitResult res = d_pending.value(num);
+
+		QByteArray log;
+		if(!res.log().isEmpty())
+			log = qCompress(res.log().toUtf8());
+
+		QByteArray rec = encodeRecord(num,res,logBase+logs.size(),log.size());
+		logs.append(log);
+
+		IndexEntry e;
+		e.offset = recordBase + records.size();
+		e.length = rec.size();
+		records.append(rec);
+		index.append(encodeIndexEntry(num,e));
+		entries.append(qMakePair(num,e));
+	}
+
+	//the index entries are only written once the records and logs they point to are on disk.
+	//If a write fails, the results stay pending; data written before the failure is never referenced by the index
+	if(!d_logs.seek(logBase) || d_logs.write(logs) != logs.size() || !d_logs.flush())
+	{
+		d_error = QString("Could not write %1 (%2).").arg(d_logs.fileName()).arg(d_logs.errorString());
+		return false;
+	}
+	if(!d_records.seek(recordBase) || d_records.write(records) != records.size() || !d_records.flush())
+	{
+		d_error = QString("Could not write %1 (%2).").arg(d_records.fileName()).arg(d_records.errorString());
+		return false;
+	}
+	qint64 indexBase = d_indexFile.size();
+	if(!d_indexFile.seek(indexBase) || d_indexFile.write(index) != index.size() || !d_indexFile.flush())
+	{
+		d_error = QString("Could not write %1 (%2).").arg(d_indexFile.fileName()).arg(d_indexFile.errorString());
+		//a partial entry would shift every later entry
+		d_indexFile.resize(indexBase);
+		return false;
+	}
+
+	for(int i=0; i<entries.size(); i++)
+		d_index.insert(entries.at(i).first,entries.at(i).second);
+
+	d_pending.clear();
+	d_pendingOrder.clear();
+	return true;
+}
+
+QString FitResultStore::readLog(qint64 offset, qint32 length)
+{
+	if(length <= 0 || !d_logs.seek(offset))
+		return QString();
+
+	return QString::fromUtf8(qUncompress(d_logs.read(length)));
+}
@@ -0,0 +1,125 @@
+#ifndef FITRESULTSTORE_H
+#define FITRESULTSTORE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <QMutex>
+
+#include "fitresult.h"
+
+/*!
+ * \brief Binary storage for fit results
+ *
+ * Fit results used to be saved as one text file per scan (autofit/x/y/num.txt), which had to be parsed line by line whenever a batch was reloaded.
+ * The store keeps all fit results in three append-only files in the autofit directory under the save path:
+ * - fits.dat: one record per saved result, with a fixed-size header (fitter settings, category, status, chi squared, buffer gas, ...) followed by the fit parameters and uncertainties as pairs of doubles
+ * - fitlogs.dat: the fit logs, compressed with qCompress. The log is only read when a single result is requested, or when load() is asked for it
+ * - fits.idx: 16-byte entries (scan number, record length, record offset). An entry with length 0 marks a deleted result
+ *
+ * All numbers are little endian.
+ * The index is read into memory the first time the store is used; later entries replace earlier ones, so saving a result again simply appends a new record.
+ * Records and logs are written before their index entries, so a result that was interrupted while it was being written is never visible.
+ *
+ * While a batch is running (see beginDeferredWrites()), results are kept in memory and written in groups, so that the files are not opened and flushed after every fit.
+ * Results that have not been written yet are still returned by get() and load().
+ * If the files cannot be opened or written, the results stay in memory and are written again with the next result (or the next flush()); the failure is reported by takeError().
+ *
+ * Results saved by earlier versions are still read from the text files by FitResult::loadFromFile().
+ * The store is thread-safe, and is accessed through instance().
+ */
+class FitResultStore
+{
+public:
+	static FitResultStore &instance();
+	~FitResultStore();
+
+	/*!
+	 * \brief Saves a fit result, replacing any earlier result for the scan
+	 * \param num Scan number
+	 * \param res Fit result
+	 * \return False if the result (or an earlier one) could not be written. It is kept for a later attempt
+	 */
+	bool put(int num, const FitResult &res);
+	/*!
+	 * \brief Reads the fit result for a scan, including its log
+	 * \param num Scan number
+	 * \param out Fit result to fill in
+	 * \return Whether a result was found
+	 */
+	bool get(int num, FitResult &out);
+	/*!
+	 * \brief Reads the fit results for many scans at once
+	 *
+	 * The records are read in file order, and neighboring records are read with a single call.
+	 *
+	 * \param nums Scan numbers
+	 * \param withLog Whether to read the fit logs
+	 * \return Results that were found, by scan number
+	 */
+	QHash<int,FitResult> load(const QList<int> nums, bool withLog = false);
+	/*!
+	 * \brief Deletes the fit result for a scan
+	 */
+	void remove(int num);
+	/*!
+	 * \brief Whether a result is stored for a scan
+	 */
+	bool contains(int num);
+	/*!
+	 * \brief Writes all deferred results to disk
+	 * \return Whether the write succeeded
+	 */
+	bool flush();
+	/*!
+	 * \brief Starts collecting results in memory instead of writing each one immediately
+	 *
+	 * Calls may be nested; results are written immediately again after the matching number of calls to endDeferredWrites().
+	 */
+	void beginDeferredWrites();
+	/*!
+	 * \brief Ends a beginDeferredWrites() call. The deferred results are written when the last one ends.
+	 * \return Whether the deferred results were written (true if there was nothing to write)
+	 */
+	bool endDeferredWrites();
+	/*!
+	 * \brief Returns a description of the last failed write, and clears it
+	 *
+	 * An empty string means that no write has failed since the last call.
+	 */
+	QString takeError();
+
+private:
+	FitResultStore();
+	Q_DISABLE_COPY(FitResultStore)
+
+	struct IndexEntry {
+		qint64 offset;
+		qint32 length;
+	};
+
+	QMutex d_mutex;
+	QString d_dir;
+	bool d_loaded;
+	QFile d_records;
+	QFile d_logs;
+	QFile d_indexFile;
+	QHash<int,IndexEntry> d_index;
+	QHash<int,FitResult> d_pending;
+	QList<int> d_pendingOrder;
+	int d_deferDepth;
+	QString d_error;
+
+	static QByteArray encodeRecord(int num, const FitResult &res, qint64 logOffset, qint32 logLength);
+	static bool decodeRecord(const char *d, qint64 size, int num, FitResult &out, qint64 &logOffset, qint32 &logLength);
+	static QByteArray encodeIndexEntry(int num, const IndexEntry &e);
+
+	void load();
+	bool openFiles();
+	bool writePending();
+	QString readLog(qint64 offset, qint32 length);
+
+};
+
+#endif // FITRESULTSTORE_H
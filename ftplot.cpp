@@ -12,13 +12,14 @@
 #include <QWidgetAction>
 
 FtPlot::FtPlot(QWidget *parent) :
-	QwtPlot(parent), d_fidDisplayPoints(0), d_type(ShowFt), d_zoom(All), tracesHidden(true),
+	QwtPlot(parent), d_fidDisplayPoints(0), d_type(ShowFt), d_zoom(All), d_highResolution(false), tracesHidden(true),
 	d_verticalAutoScale(true), d_verticalScaleMax(1.0), d_verticalZoomScale(1.0)
 {
 	ftThread = new QThread(this);
 	ftWorker = new FtWorker();
 	connect(ftWorker,&FtWorker::ftDone,this,&FtPlot::newFt);
 	connect(ftWorker,&FtWorker::fidDone,this,&FtPlot::newDisplayFid);
+	connect(ftWorker,&FtWorker::zoomFtDone,this,&FtPlot::newZoomFt);
     connect(ftThread,&QThread::finished,ftWorker,&QObject::deleteLater);
 
     setAxisAutoScale(QwtPlot::xBottom,false);
@@ -45,6 +46,8 @@ FtPlot::FtPlot(QWidget *parent) :
 	fidCurve.setPen(p);
 	setFitCurveColor();
     ftCurve.setRenderHint(QwtPlotItem::RenderAntialiased);
+    zoomFtCurve.setPen(QPen(QPalette().color(QPalette::Highlight),1.0));
+    zoomFtCurve.setRenderHint(QwtPlotItem::RenderAntialiased);
     fidCurve.setRenderHint(QwtPlotItem::RenderAntialiased);
     fitCurve.setRenderHint(QwtPlotItem::RenderAntialiased);
 
@@ -198,6 +201,8 @@ void FtPlot::newFt(const QVector<QPointF> ft, double max)
 
 	if(d_type == ShowFt)
 		replot();
+
+	requestZoomFt();
 }
 
 void FtPlot::newFit(const QVector<QPointF> fitData)
@@ -223,6 +228,40 @@ void FtPlot::newDisplayFid(const QVector<QPointF> fid)
 		replot();
 }
 
+void FtPlot::newZoomFt(const QVector<QPointF> ft)
+{
+	zoomFtCurve.setSamples(ft);
+	if(d_type == ShowFt && d_highResolution)
+		replot();
+}
+
+void FtPlot::setHighResolution(bool on)
+{
+	d_highResolution = on;
+	if(on && d_type == ShowFt)
+	{
+		zoomFtCurve.attach(this);
+		requestZoomFt();
+	}
+	else
+	{
+		zoomFtCurve.detach();
+		zoomFtCurve.setSamples(QVector<QPointF>());
+		replot();
+	}
+}
+
+void FtPlot::requestZoomFt()
+{
+	if(!d_highResolution || d_type != ShowFt || currentFid.size() == 0)
+		return;
+
+	//about two points per pixel across the visible range
+	QwtScaleDiv d = axisScaleDiv(QwtPlot::xBottom);
+	int points = qBound(64,2*canvas()->width(),8192);
+	QMetaObject::invokeMethod(ftWorker,"doZoomFT",Q_ARG(Fid,currentFid),Q_ARG(double,d.lowerBound()),Q_ARG(double,d.upperBound()),Q_ARG(int,points));
+}
+
 void FtPlot::updatePlot()
 {
 	if(currentFid.size()>0)
@@ -237,6 +276,7 @@ void FtPlot::setDisplayType(FtPlot::DisplayType t, bool forceReplot)
 		{
 			ftCurve.detach();
 			fitCurve.detach();
+			zoomFtCurve.detach();
 			fidCurve.attach(this);
 			setAxisTitle(QwtPlot::xBottom,fidXLabel);
 			setAxisScale(QwtPlot::xBottom,0.0,d_fidDisplayPoints*currentFid.spacing()*1e6);
@@ -246,6 +286,8 @@ void FtPlot::setDisplayType(FtPlot::DisplayType t, bool forceReplot)
 			fidCurve.detach();
 			ftCurve.attach(this);
 			fitCurve.attach(this);
+			if(d_highResolution)
+				zoomFtCurve.attach(this);
 			setAxisTitle(QwtPlot::xBottom,ftXLabel);
 			if(d_zoom == Detail)
 			{
@@ -267,6 +309,8 @@ void FtPlot::setDisplayType(FtPlot::DisplayType t, bool forceReplot)
 
 		if(currentFid.size() > 0)
 			replot();
+
+		requestZoomFt();
 	}
 }
 
@@ -433,6 +477,13 @@ QMenu *FtPlot::buildContextMenu()
 		autoScaleAction->setEnabled(false);
     connect(autoScaleAction,&QAction::triggered,[=](){ setAutoScale(true); });
 
+	zoomMenu->addSeparator();
+	QAction *highResAction = zoomMenu->addAction(QString("High resolution"));
+	highResAction->setToolTip(QString("Overlay a finely sampled zoom transform of the visible range"));
+	highResAction->setCheckable(true);
+	highResAction->setChecked(d_highResolution);
+	connect(highResAction,&QAction::toggled,this,&FtPlot::setHighResolution);
+
 
 	if(d_type == ShowFid)
 		zoomMenu->setEnabled(false);
@@ -7,6 +7,7 @@
 #include "fid.h"
 #include "ftworker.h"
 #include "dopplerpair.h"
+#include "rastercurve.h"
 #include <QThread>
 #include <QContextMenuEvent>
 #include <QMenu>
@@ -57,6 +58,8 @@ public slots:
 	void newFt(const QVector<QPointF> ft, double max);
 	void newFit(const QVector<QPointF> fitData);
 	void newDisplayFid(const QVector<QPointF> fid);
+	void newZoomFt(const QVector<QPointF> ft);
+	void setHighResolution(bool on);
 	void updatePlot();
 	void setDisplayType(DisplayType t, bool forceReplot = false);
 	void displayFid(){ setDisplayType(ShowFid); }
@@ -88,8 +91,10 @@ protected:
 	DisplayType d_type;
 	DisplayZoom d_zoom;
 
-	QwtPlotCurve ftCurve;
-	QwtPlotCurve fidCurve;
+	RasterCurve ftCurve;
+	RasterCurve fidCurve;
+	RasterCurve zoomFtCurve; /*!< Zoom transform of the visible range, shown when d_highResolution is true */
+	bool d_highResolution;
 	QwtPlotCurve fitCurve;
 	QwtText fidXLabel;
 	QwtText ftXLabel;
@@ -112,6 +117,7 @@ protected:
 
 	bool eventFilter(QObject *obj, QEvent *ev);
 	virtual void zoom(const QWheelEvent *we);
+	void requestZoomFt();
 
 	
 };
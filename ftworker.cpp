@@ -1,12 +1,15 @@
 #include "ftworker.h"
 #include <gsl/gsl_const.h>
 #include <gsl/gsl_sf.h>
+#include <gsl/gsl_fft_complex.h>
 #include "analysis.h"
+#include "livefeed.h"
 
 FtWorker::FtWorker(QObject *parent) :
 	QObject(parent), real(nullptr), work(nullptr), d_numPnts(0),
 	realPadded(nullptr), workPadded(nullptr), d_numPntsPadded(0),
-    d_delay(0.0), d_hpf(0.0), d_exp(0.0), d_autoPadFids(false), d_removeDC(true), d_lastMax(0.0), d_useWindow(false)
+    d_delay(0.0), d_hpf(0.0), d_exp(0.0), d_autoPadFids(false), d_removeDC(true), d_lastMax(0.0), d_useWindow(false),
+    d_liveFeed(false), d_zoomKernelPoints(0), d_zoomKernelOutput(0), d_zoomKernelLength(0), d_zoomKernelStep(0.0)
 {
 }
 
@@ -51,46 +54,192 @@ QPair<QVector<QPointF>, double> FtWorker::doFT(const Fid f)
     //might need to allocate or reallocate workspace and wavetable
     gsl_fft_real_wavetable *theTable;
     gsl_fft_real_workspace *theWorkspace;
-    if(d_autoPadFids)
-    {
-	    if(fid.size() != d_numPntsPadded)
-	    {
-		    d_numPntsPadded = fid.size();
+    prepareTables(fid.size(),&theTable,&theWorkspace);
 
-		    if(realPadded)
-		    {
-			    gsl_fft_real_wavetable_free(realPadded);
-			    gsl_fft_real_workspace_free(workPadded);
-		    }
+	QVector<QPointF> spectrum = calculateFT(fid,startSize,theTable,theWorkspace);
+	if(d_liveFeed)
+		LiveFeed::instance().publishFt(spectrum,fid.probeFreq());
+	return qMakePair(spectrum,d_lastMax);
+}
 
-		    realPadded = gsl_fft_real_wavetable_alloc(d_numPntsPadded);
-		    workPadded = gsl_fft_real_workspace_alloc(d_numPntsPadded);
-	    }
-	    theTable = realPadded;
-	    theWorkspace = workPadded;
-    }
-    else
-    {
-	    if(fid.size() != d_numPnts)
-	    {
-		    d_numPnts = fid.size();
+QList<QVector<QPointF>> FtWorker::doBandFT(const Fid fid, const QList<QPair<double,double>> bands)
+{
+	QList<QVector<QPointF>> out;
+	for(int i=0; i<bands.size(); i++)
+		out.append(QVector<QPointF>());
 
-		    //free memory if this is a reallocation
-		    if(real)
-		    {
-			    gsl_fft_real_wavetable_free(real);
-			    gsl_fft_real_workspace_free(work);
-		    }
+	if(fid.spacing() < 1e-20 || fid.size() < 4)
+		return out;
 
-		    real = gsl_fft_real_wavetable_alloc(d_numPnts);
-		    work = gsl_fft_real_workspace_alloc(d_numPnts);
-	    }
-	    theTable = real;
-	    theWorkspace = work;
+	int realPoints = fid.size();
+	Fid f = filterFid(fid);
+	if(d_autoPadFids)
+		f = padFid(f);
+
+	//the spectrum has points 0 to n/2; the x value of point k is probe + k/(n*spacing)
+	int n = f.size();
+	int total = n/2 + 1;
+	double probe = f.probeFreq();
+	double spacing = f.spacing();
+	double df = 1.0/(double)n/spacing*1.0e-6;
+
+	QList<QPair<int,int>> ranges;
+	qint64 points = 0;
+	for(int i=0; i<bands.size(); i++)
+	{
+		int first = (int)ceil((bands.at(i).first - probe)/df);
+		int last = (int)floor((bands.at(i).second - probe)/df);
+
+		first = (first < 0 || first >= total) ? 0 : first - 1;
+		last = (last < 0 || last >= total) ? total - 1 : last + 2;
+		first = qMax(0,first);
+		last = qBound(first + 1,last,total - 1);
+
+		ranges.append(qMakePair(first,last));
+		points += last - first + 1;
 	}
 
-	QVector<QPointF> spectrum = calculateFT(fid,startSize,theTable,theWorkspace);
-	return qMakePair(spectrum,d_lastMax);
+	QVector<double> data = f.toVector();
+	QVector<double> mag;
+
+	//a Goertzel filter takes one multiply-add per point of the unpadded FID; the real FFT takes roughly 2.5 n log2(n)
+	double goertzelCost = (double)points*(double)realPoints;
+	double fftCost = 2.5*(double)n*log2((double)n);
+	bool useFft = goertzelCost > fftCost;
+	if(useFft)
+	{
+		gsl_fft_real_wavetable *theTable;
+		gsl_fft_real_workspace *theWorkspace;
+		prepareTables(n,&theTable,&theWorkspace);
+		gsl_fft_real_transform(data.data(),1,data.size(),theTable,theWorkspace);
+	}
+
+	for(int i=0; i<ranges.size(); i++)
+	{
+		int first = ranges.at(i).first;
+		int last = ranges.at(i).second;
+		QVector<QPointF> &band = out[i];
+		band.reserve(last - first + 1);
+		for(int k=first; k<=last; k++)
+		{
+			double x = probe + (double)k/(double)n/spacing*1.0e-6;
+			double m = 0.0;
+
+			//first point is DC; it is blocked, as in calculateFT()
+			if(k > 0)
+			{
+				if(useFft)
+				{
+					//half-complex format: see calculateFT()
+					if(2*k < n)
+						m = sqrt(data.at(2*k-1)*data.at(2*k-1) + data.at(2*k)*data.at(2*k));
+					else
+						m = fabs(data.at(n-1));
+				}
+				else
+				{
+					//padded points are zero, and do not change the sums
+					double c = 2.0*cos(2.0*M_PI*(double)k/(double)n);
+					double s1 = 0.0, s2 = 0.0;
+					for(int j=0; j<realPoints; j++)
+					{
+						double s0 = data.at(j) + c*s1 - s2;
+						s2 = s1;
+						s1 = s0;
+					}
+					m = sqrt(qMax(0.0,s1*s1 + s2*s2 - c*s1*s2));
+				}
+			}
+
+			band.append(QPointF(x,m/(double)realPoints*1000.0));
+		}
+	}
+
+	return out;
+}
+
+QVector<QPointF> FtWorker::doZoomFT(const Fid fid, double fMin, double fMax, int points, bool offsetOnly)
+{
+	QVector<QPointF> out;
+	if(fid.spacing() < 1e-20 || fid.size() < 2 || points < 2 || fMax <= fMin)
+	{
+		emit zoomFtDone(out);
+		return out;
+	}
+
+	Fid f = filterFid(fid);
+	QVector<double> data = f.toVector();
+	int n = data.size();
+	double probe = f.probeFreq();
+	if(offsetOnly)
+		probe = 0.0;
+
+	//X(k) = sum x(n) exp(-i(w0 + k dw)n); with kn = (n^2 + k^2 - (k-n)^2)/2, this is a convolution with the chirp exp(i dw m^2/2)
+	//(Bluestein's algorithm), which is evaluated with FFTs of a power of 2 length
+	double step = (fMax - fMin)/(double)(points-1);
+	double w0 = 2.0*M_PI*(fMin - probe)*1.0e6*f.spacing();
+	double dw = 2.0*M_PI*step*1.0e6*f.spacing();
+	int length = 1;
+	while(length < n + points - 1)
+		length <<= 1;
+
+	//the chirp only depends on the sizes and the step, so it is reused while they stay the same
+	if(d_zoomKernelPoints != n || d_zoomKernelOutput != points || d_zoomKernelLength != length || d_zoomKernelStep != dw)
+	{
+		d_zoomKernelPoints = n;
+		d_zoomKernelOutput = points;
+		d_zoomKernelLength = length;
+		d_zoomKernelStep = dw;
+
+		d_zoomKernel = QVector<double>(2*length,0.0);
+		for(int m=0; m<qMax(n,points); m++)
+		{
+			double dm = (double)m;
+			double phase = fmod(0.5*dw*dm*dm,2.0*M_PI);
+			if(m < points)
+			{
+				d_zoomKernel[2*m] = cos(phase);
+				d_zoomKernel[2*m+1] = sin(phase);
+			}
+			if(m > 0 && m < n)
+			{
+				d_zoomKernel[2*(length-m)] = cos(phase);
+				d_zoomKernel[2*(length-m)+1] = sin(phase);
+			}
+		}
+		gsl_fft_complex_radix2_forward(d_zoomKernel.data(),1,length);
+	}
+
+	QVector<double> work(2*length,0.0);
+	for(int i=0; i<n; i++)
+	{
+		double di = (double)i;
+		double phase = fmod(w0*di + 0.5*dw*di*di,2.0*M_PI);
+		work[2*i] = data.at(i)*cos(phase);
+		work[2*i+1] = -data.at(i)*sin(phase);
+	}
+
+	gsl_fft_complex_radix2_forward(work.data(),1,length);
+	for(int i=0; i<length; i++)
+	{
+		double re = work.at(2*i)*d_zoomKernel.at(2*i) - work.at(2*i+1)*d_zoomKernel.at(2*i+1);
+		double im = work.at(2*i)*d_zoomKernel.at(2*i+1) + work.at(2*i+1)*d_zoomKernel.at(2*i);
+		work[2*i] = re;
+		work[2*i+1] = im;
+	}
+	gsl_fft_complex_radix2_inverse(work.data(),1,length);
+
+	//the remaining factor exp(i dw k^2/2) does not change the magnitude
+	//note: Normalize output, and convert to mV (as in calculateFT())
+	out.reserve(points);
+	for(int k=0; k<points; k++)
+	{
+		double m = sqrt(work.at(2*k)*work.at(2*k) + work.at(2*k+1)*work.at(2*k+1));
+		out.append(QPointF(fMin + (double)k*step,m/(double)n*1000.0));
+	}
+
+	emit zoomFtDone(out);
+	return out;
 }
 
 QVector<QPointF> FtWorker::doFT_noPad(const Fid fid, bool offsetOnly)
@@ -200,6 +349,47 @@ QVector<QPointF> FtWorker::calculateFT(const Fid fid, int realPoints, gsl_fft_re
 	return spectrum;
 }
 
+void FtWorker::prepareTables(int n, gsl_fft_real_wavetable **wt, gsl_fft_real_workspace **ws)
+{
+    if(d_autoPadFids)
+    {
+	    if(n != d_numPntsPadded)
+	    {
+		    d_numPntsPadded = n;
+
+		    if(realPadded)
+		    {
+			    gsl_fft_real_wavetable_free(realPadded);
+			    gsl_fft_real_workspace_free(workPadded);
+		    }
+
+		    realPadded = gsl_fft_real_wavetable_alloc(d_numPntsPadded);
+		    workPadded = gsl_fft_real_workspace_alloc(d_numPntsPadded);
+	    }
+	    *wt = realPadded;
+	    *ws = workPadded;
+    }
+    else
+    {
+	    if(n != d_numPnts)
+	    {
+		    d_numPnts = n;
+
+		    //free memory if this is a reallocation
+		    if(real)
+		    {
+			    gsl_fft_real_wavetable_free(real);
+			    gsl_fft_real_workspace_free(work);
+		    }
+
+		    real = gsl_fft_real_wavetable_alloc(d_numPnts);
+		    work = gsl_fft_real_workspace_alloc(d_numPnts);
+	    }
+	    *wt = real;
+	    *ws = work;
+	}
+}
+
 Fid FtWorker::filterFid(const Fid f)
 {
 	Fid fid;
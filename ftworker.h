@@ -7,6 +7,7 @@
 #include "fid.h"
 #include <gsl/gsl_fft_real.h>
 #include <QPair>
+#include <QList>
 
 /*!
  \brief Class that handles processing of FIDs
@@ -56,6 +57,12 @@ signals:
 	 \param fid The filtered Fid
 	*/
 	void fidDone(QVector<QPointF> fid);
+	/*!
+	 \brief Emitted when a zoom transform is complete
+
+	 \param ft FT data in XY format
+	*/
+	void zoomFtDone(QVector<QPointF> ft);
 
 public slots:
 	/*!
@@ -68,6 +75,37 @@ public slots:
 	*/
 	QPair<QVector<QPointF>,double> doFT(const Fid fid);
 
+	/*!
+	 \brief Calculates the FT magnitude only near the requested frequency bands
+
+	 The FID is filtered and padded as in doFT(), and the points have the same x values and scaling as the corresponding points of doFT().
+	 Each band covers the points within [first,second], plus one point below and two above so that the edges can be interpolated.
+	 If an edge of a band lies outside the spectrum, the band extends to that end of the spectrum.
+
+	 Narrow bands are computed point by point with Goertzel filters, which only need the unpadded FID points.
+	 When that would cost more than a full FFT, the full FFT is computed once and only the requested points are returned.
+
+	 \param fid Fid to analyze
+	 \param bands Frequency ranges (MHz)
+	 \return One list of points for each band, in order of increasing frequency
+	*/
+	QList<QVector<QPointF>> doBandFT(const Fid fid, const QList<QPair<double,double>> bands);
+
+	/*!
+	 \brief Calculates the FT magnitude at evenly spaced frequencies between fMin and fMax (chirp-z transform)
+
+	 The FID is filtered as in doFT(), but not padded: the output can be sampled as finely as needed, and has the same scaling as doFT().
+	 The cost depends on the length of the FID and the number of points, not on the frequency resolution, so a narrow window can be examined at a resolution that would need a very large padded FFT.
+
+	 \param fid Fid to analyze
+	 \param fMin First frequency (MHz, or offset from the probe frequency if offsetOnly is true)
+	 \param fMax Last frequency
+	 \param points Number of points
+	 \param offsetOnly Whether the frequencies are offsets from the probe frequency
+	 \return FT magnitude spectrum in XY format
+	*/
+	QVector<QPointF> doZoomFT(const Fid fid, double fMin, double fMax, int points, bool offsetOnly = false);
+
 	QVector<QPointF> doFT_noPad(const Fid fid, bool offsetOnly = false);
 	QVector<QPointF> doFT_pad(const Fid fid, bool offsetOnly = false);
 
@@ -109,6 +147,10 @@ public slots:
 	void setAutoPad(bool b){ d_autoPadFids = b; }
 	void setRemoveDC(bool b){ d_removeDC = b; }
     void setUseWindow(bool b){ d_useWindow = b; }
+	/*!
+	 \brief Sets whether each FT computed by doFT() is published in the LiveFeed
+	*/
+	void setLiveFeed(bool b){ d_liveFeed = b; }
 	/*!
 	 \brief Access function for truncation
 
@@ -151,6 +193,18 @@ private:
 	double d_lastMax;
     bool d_useWindow;
     QVector<double> d_winf;
+    bool d_liveFeed;
+
+    /*!
+     \brief Makes sure the wavetable and workspace for an FFT of n points are allocated
+    */
+    void prepareTables(int n, gsl_fft_real_wavetable **wt, gsl_fft_real_workspace **ws);
+
+    QVector<double> d_zoomKernel; /*!< FFT of the chirp used by doZoomFT(), in packed complex format */
+    int d_zoomKernelPoints; /*!< FID points, output points, and transform length used for d_zoomKernel */
+    int d_zoomKernelOutput;
+    int d_zoomKernelLength;
+    double d_zoomKernelStep; /*!< Phase step per point used for d_zoomKernel */
 
 };
 
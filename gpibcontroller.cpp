@@ -1,9 +1,21 @@
 #include "gpibcontroller.h"
 
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+//queued transactions are normally sent within a few event loop passes; a longer queue means the bus is not keeping up
+const int maxQueued = 256;
+
+}
+
 GpibController::GpibController(QObject *parent) :
-	HardwareObject(parent)
+	HardwareObject(parent), d_currentAddress(-1), d_nextId(0), d_batchCount(0), d_maxBatch(8), d_addressChanges(0),
+	d_scanActive(false), d_processScheduled(false)
 {
 	d_key = QString("gpibController");
+	d_clock.start();
 }
 
 GpibController::~GpibController()
@@ -13,34 +25,248 @@ GpibController::~GpibController()
 
 bool GpibController::writeCmd(int address, QString cmd)
 {
-	if(address != d_currentAddress)
-    {
-        if(!setAddress(address))
-            return false;
-    }
+	if(!flushWrites(address))
+		return false;
 
-    return p_comm->writeCmd(cmd);
+	qint64 start = d_clock.nsecsElapsed();
+	bool success = p_comm->writeCmd(cmd);
+	recordTransaction(address,0.0,(d_clock.nsecsElapsed()-start)/1e6,success);
+	return success;
 }
 
 bool GpibController::writeBinary(int address, QByteArray dat)
 {
-    if(address != d_currentAddress)
-    {
-        if(!setAddress(address))
-            return false;
-    }
+	if(!flushWrites(address))
+		return false;
 
-    return p_comm->writeBinary(dat);
+	qint64 start = d_clock.nsecsElapsed();
+	bool success = p_comm->writeBinary(dat);
+	recordTransaction(address,0.0,(d_clock.nsecsElapsed()-start)/1e6,success);
+	return success;
 }
 
 QByteArray GpibController::queryCmd(int address, QString cmd)
 {
-    if(address != d_currentAddress)
-    {
-        if(!setAddress(address))
-		  return QByteArray();
-    }
+	if(!flushWrites(address))
+		return QByteArray();
+
+	qint64 start = d_clock.nsecsElapsed();
+	QByteArray resp = p_comm->queryCmd(cmd);
+	recordTransaction(address,0.0,(d_clock.nsecsElapsed()-start)/1e6,!resp.isEmpty());
+	return resp;
+}
+
+int GpibController::enqueueWrite(int address, QString cmd, TransactionPriority p, bool pipeline)
+{
+	Transaction t;
+	t.address = address;
+	t.priority = p;
+	t.data = cmd.toLatin1();
+	t.pipeline = pipeline;
+	return enqueue(t);
+}
+
+int GpibController::enqueueCall(int address, std::function<void()> f, TransactionPriority p)
+{
+	Transaction t;
+	t.address = address;
+	t.priority = p;
+	t.call = f;
+	t.pipeline = false;
+	return enqueue(t);
+}
+
+void GpibController::setScanActive(bool active)
+{
+	d_scanActive = active;
+	if(!active)
+		scheduleProcessing();
+}
+
+void GpibController::logStatistics()
+{
+	QList<int> addresses = d_stats.keys();
+	std::sort(addresses.begin(),addresses.end());
+	for(int i=0; i<addresses.size(); i++)
+	{
+		const TransactionStats &st = d_stats[addresses.at(i)];
+		if(st.count == 0)
+			continue;
+
+		emit logMessage(QString("Address %1: %2 transactions (%3 failed, %4 pipelined). Queue wait: avg %5 ms, max %6 ms. Bus: avg %7 ms, max %8 ms.")
+						.arg(addresses.at(i)).arg(st.count).arg(st.failures).arg(st.pipelined)
+						.arg(st.totalWaitMs/st.count,0,'f',2).arg(st.maxWaitMs,0,'f',2)
+						.arg(st.totalBusMs/st.count,0,'f',2).arg(st.maxBusMs,0,'f',2),QtFTM::LogDebug);
+	}
+	emit logMessage(QString("Address changes: %1").arg(d_addressChanges),QtFTM::LogDebug);
+}
+
+void GpibController::resetStatistics()
+{
+	d_stats.clear();
+	d_addressChanges = 0;
+}
+
+bool GpibController::selectAddress(int address)
+{
+	if(address == d_currentAddress)
+		return true;
+
+	d_batchCount = 0;
+	d_addressChanges++;
+	return setAddress(address);
+}
+
+bool GpibController::flushWrites(int address)
+{
+	//queued writes to this address are sent first, in order, as one write
+	qint64 start = d_clock.nsecsElapsed();
+	QByteArray data;
+	int count = 0;
+	double wait = 0.0;
+	for(int i=0; i<d_queue.size();)
+	{
+		const Transaction &t = d_queue.at(i);
+		if(t.address != address || t.call)
+		{
+			i++;
+			continue;
+		}
+
+		data.append(t.data);
+		wait = qMax(wait,(start-t.enqueuedNs)/1e6);
+		count++;
+		d_queue.removeAt(i);
+	}
+
+	if(!selectAddress(address))
+		return false;
+
+	if(count == 0)
+		return true;
+
+	bool success = p_comm->writeBinary(data);
+	recordTransaction(address,wait,(d_clock.nsecsElapsed()-start)/1e6,success,count-1);
+	if(!success)
+		emit logMessage(QString("Could not send %1 queued command(s) to address %2.").arg(count).arg(address),QtFTM::LogError);
+
+	return success;
+}
+
+int GpibController::enqueue(Transaction t)
+{
+	if(d_queue.size() >= maxQueued)
+	{
+		emit logMessage(QString("Transaction queue is full (%1 transactions). A transaction for address %2 was dropped.").arg(maxQueued).arg(t.address),QtFTM::LogError);
+		return -1;
+	}
+
+	t.id = d_nextId++;
+	t.enqueuedNs = d_clock.nsecsElapsed();
+	d_queue.append(t);
+	scheduleProcessing();
+	return t.id;
+}
+
+int GpibController::nextTransactionIndex() const
+{
+	int best = -1;
+	for(int i=0; i<d_queue.size(); i++)
+	{
+		const Transaction &t = d_queue.at(i);
+		if(d_scanActive && t.priority == StatusPoll)
+			continue;
+
+		if(best < 0 || t.priority < d_queue.at(best).priority)
+		{
+			best = i;
+			continue;
+		}
+
+		//within a priority level, stay on the current address unless the batch limit is reached
+		if(t.priority == d_queue.at(best).priority && d_batchCount < d_maxBatch
+				&& t.address == d_currentAddress && d_queue.at(best).address != d_currentAddress)
+			best = i;
+	}
+
+	return best;
+}
+
+void GpibController::scheduleProcessing()
+{
+	if(d_processScheduled || d_queue.isEmpty())
+		return;
+
+	d_processScheduled = true;
+	QTimer::singleShot(0,this,&GpibController::processQueue);
+}
 
-	return p_comm->queryCmd(cmd);
+void GpibController::recordTransaction(int address, double waitMs, double busMs, bool success, int merged)
+{
+	TransactionStats &st = d_stats[address];
+	st.count++;
+	if(!success)
+		st.failures++;
+	st.pipelined += merged;
+	st.totalWaitMs += waitMs;
+	st.maxWaitMs = qMax(st.maxWaitMs,waitMs);
+	st.totalBusMs += busMs;
+	st.maxBusMs = qMax(st.maxBusMs,busMs);
 }
 
+void GpibController::processQueue()
+{
+	//only one transaction (or one pipelined group) is handled per pass through the event loop,
+	//so that blocking calls from the instruments are never delayed by more than one transaction
+	d_processScheduled = false;
+
+	int index = nextTransactionIndex();
+	if(index < 0)
+		return;
+
+	Transaction t = d_queue.takeAt(index);
+	if(t.call)
+	{
+		//the call uses the blocking functions, which record their own statistics
+		d_batchCount++;
+		t.call();
+		scheduleProcessing();
+		return;
+	}
+
+	QList<Transaction> group;
+	group.append(t);
+	QByteArray data = t.data;
+
+	if(t.pipeline)
+	{
+		//merge later writes to the same address, preserving their order
+		for(int i=index; i<d_queue.size();)
+		{
+			const Transaction &next = d_queue.at(i);
+			if(next.address != t.address)
+			{
+				i++;
+				continue;
+			}
+			if(next.call || !next.pipeline || next.priority != t.priority)
+				break;
+
+			data.append(next.data);
+			group.append(d_queue.takeAt(i));
+		}
+	}
+
+	qint64 start = d_clock.nsecsElapsed();
+	bool success = selectAddress(t.address);
+	if(success)
+		success = p_comm->writeBinary(data);
+	qint64 end = d_clock.nsecsElapsed();
+	d_batchCount++;
+
+	recordTransaction(t.address,(start-t.enqueuedNs)/1e6,(end-start)/1e6,success,group.size()-1);
+	if(!success)
+		emit logMessage(QString("Could not send %1 queued command(s) to address %2.").arg(group.size()).arg(t.address),QtFTM::LogError);
+
+	scheduleProcessing();
+}
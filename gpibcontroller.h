@@ -3,10 +3,63 @@
 
 #include "hardwareobject.h"
 
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <functional>
+
+/*!
+ * \brief Base class for GPIB controllers, with a prioritized transaction scheduler
+ *
+ * All GpibInstruments share the controller (and its thread), so every transaction on the bus is serialized here.
+ * The blocking writeCmd(), writeBinary(), and queryCmd() functions are treated as scan-critical: they execute immediately,
+ * and because they run on the controller's thread, no queued transaction can be interleaved with them.
+ *
+ * Non-blocking writes can be submitted with enqueueWrite(), and operations that need the responses of the device (e.g., status polls, which read and parse several values) with enqueueCall().
+ * These are placed in a queue and processed from the event loop in priority order (see TransactionPriority).
+ * Before a blocking transaction, the writes still queued for its address are sent, so commands always reach a device in the order they were issued.
+ * Scan setup uses this to pipeline writes: a ScanCritical write returns immediately, and is sent together with the query that reads back the new setting.
+ * Within a priority level, transactions for the currently selected address are preferred so that the number of
+ * address changes on the bus is minimized; at most d_maxBatch transactions are taken for one address before the
+ * oldest waiting transaction is served again, which prevents starvation.
+ * Consecutive pipelineable writes to the same address are coalesced into a single write to the controller.
+ * While a scan is being prepared (see setScanActive()), StatusPoll transactions are held in the queue.
+ * A queued write that fails is reported in the log; queued calls report their own errors.
+ * At most 256 transactions can wait in the queue; further ones are rejected (enqueueWrite() and enqueueCall() return -1), so that a stalled bus cannot grow the queue without bound.
+ *
+ * Latency statistics (time spent waiting in the queue and time spent on the bus) are accumulated per address,
+ * and can be written to the log with logStatistics().
+ */
 class GpibController : public HardwareObject
 {
 	Q_OBJECT
 public:
+	/*!
+	 * \brief Priority of a queued transaction. Lower values are served first.
+	 */
+	enum TransactionPriority {
+		ScanCritical,
+		Normal,
+		StatusPoll
+	};
+
+	/*!
+	 * \brief Accumulated latency statistics for one GPIB address
+	 */
+	struct TransactionStats {
+		int count;
+		int failures;
+		int pipelined; /*!< Number of writes that were coalesced into a previous write */
+		double totalWaitMs;
+		double maxWaitMs;
+		double totalBusMs;
+		double maxBusMs;
+
+		TransactionStats() : count(0), failures(0), pipelined(0), totalWaitMs(0.0), maxWaitMs(0.0),
+			totalBusMs(0.0), maxBusMs(0.0) {}
+	};
+
 	GpibController(QObject *parent = nullptr);
     virtual ~GpibController();
 
@@ -17,11 +70,77 @@ public:
 
     QIODevice *device() { return p_comm->device(); }
 
+	/*!
+	 * \brief Queues a write for asynchronous execution
+	 * \param address GPIB address
+	 * \param cmd Command to write
+	 * \param p Priority
+	 * \param pipeline If true, the write may be merged with other queued writes to the same address
+	 * \return Transaction id, or -1 if the queue is full
+	 */
+	int enqueueWrite(int address, QString cmd, TransactionPriority p = Normal, bool pipeline = false);
+
+	/*!
+	 * \brief Queues a function that communicates with one device through the blocking functions
+	 *
+	 * The function is called from the event loop of the controller's thread when its turn comes, so it must not outlive the objects it uses (see QPointer).
+	 *
+	 * \param address GPIB address the function talks to (used for batching)
+	 * \param f Function to call
+	 * \param p Priority
+	 * \return Transaction id, or -1 if the queue is full
+	 */
+	int enqueueCall(int address, std::function<void()> f, TransactionPriority p = Normal);
+
+	int queuedTransactions() const { return d_queue.size(); }
+	TransactionStats statistics(int address) const { return d_stats.value(address); }
+	int addressChanges() const { return d_addressChanges; }
+
+public slots:
+	/*!
+	 * \brief Holds StatusPoll transactions while a scan is being prepared
+	 * \param active True while scan preparation is ongoing
+	 */
+	void setScanActive(bool active);
+	void logStatistics();
+	void resetStatistics();
+
 protected:
     virtual bool readAddress() =0;
     virtual bool setAddress(int a) =0;
 
 	int d_currentAddress;
+
+private:
+	struct Transaction {
+		int id;
+		int address;
+		TransactionPriority priority;
+		QByteArray data;
+		std::function<void()> call; /*!< Set for transactions queued with enqueueCall() */
+		bool pipeline;
+		qint64 enqueuedNs;
+	};
+
+	QList<Transaction> d_queue;
+	QHash<int,TransactionStats> d_stats;
+	QElapsedTimer d_clock;
+	int d_nextId;
+	int d_batchCount;
+	int d_maxBatch;
+	int d_addressChanges;
+	bool d_scanActive;
+	bool d_processScheduled;
+
+	bool selectAddress(int address);
+	bool flushWrites(int address);
+	int enqueue(Transaction t);
+	int nextTransactionIndex() const;
+	void scheduleProcessing();
+	void recordTransaction(int address, double waitMs, double busMs, bool success, int merged = 0);
+
+private slots:
+	void processQueue();
 };
 
 #ifdef QTFTM_GPIBCONTROLLER
@@ -35,6 +35,16 @@ QByteArray GpibInstrument::queryCmd(QString cmd)
     return p_controller->queryCmd(d_address,cmd.append(p_controller->queryTerminator()));
 }
 
+int GpibInstrument::callQueued(std::function<void()> f, GpibController::TransactionPriority p)
+{
+    return p_controller->enqueueCall(d_address,f,p);
+}
+
+bool GpibInstrument::writeCmdPipelined(QString cmd)
+{
+    return p_controller->enqueueWrite(d_address,cmd,GpibController::ScanCritical,true) >= 0;
+}
+
 void GpibInstrument::initialize()
 {
 }
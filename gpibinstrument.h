@@ -25,6 +25,17 @@ public:
     bool writeBinary(QByteArray dat);
     QByteArray queryCmd(QString cmd);
 
+    /*!
+     * \brief Queues a function that talks to this instrument. See GpibController::enqueueCall()
+     */
+    int callQueued(std::function<void()> f, GpibController::TransactionPriority p = GpibController::Normal);
+
+    /*!
+     * \brief Queues a ScanCritical write that is sent no later than the next blocking transaction with this instrument
+     * \return False if the write could not be queued. A failure to send it is reported by that transaction
+     */
+    bool writeCmdPipelined(QString cmd);
+
 public slots:
     virtual void initialize();
     virtual bool testConnection();
@@ -20,7 +20,11 @@ SOURCES += mainwindow.cpp \
     $$PWD/drcorrplot.cpp \
     $$PWD/categoryplot.cpp \
     $$PWD/amdorplot.cpp \
-    $$PWD/amdorwidget.cpp
+    $$PWD/amdorwidget.cpp \
+    $$PWD/minmaxpyramid.cpp \
+    $$PWD/curverenderer.cpp \
+    $$PWD/rastercurve.cpp \
+    $$PWD/batchprintjob.cpp
 
 HEADERS += mainwindow.h \
     ftplot.h \
@@ -44,7 +48,11 @@ HEADERS += mainwindow.h \
     $$PWD/drcorrplot.h \
     $$PWD/categoryplot.h \
     $$PWD/amdorplot.h \
-    $$PWD/amdorwidget.h
+    $$PWD/amdorwidget.h \
+    $$PWD/minmaxpyramid.h \
+    $$PWD/curverenderer.h \
+    $$PWD/rastercurve.h \
+    $$PWD/batchprintjob.h
 
 
 FORMS    += mainwindow.ui \
@@ -2,8 +2,11 @@
 #include <QTimer>
 #include <QApplication>
 
+#include "configservice.h"
+#include "telemetrystore.h"
+
 HardwareManager::HardwareManager(QObject *parent) :
-    QObject(parent), d_waitingForScanTune(false), d_waitingForCalibration(false), d_tuningOldA(-1), d_responseCount(0),
+    QObject(parent), d_waitingForScanTune(false), d_waitingForCalibration(false), d_tuningOldA(-1), p_statusTimer(nullptr), d_responseCount(0),
     d_firstInitialization(true), d_scanActive(false)
 {
 }
@@ -81,10 +84,14 @@ void HardwareManager::initializeHardware()
     connect(md,&MotorDriver::modeChanged,this,&HardwareManager::modeChanged);
     connect(md,&MotorDriver::voltageChanged,this,&HardwareManager::tuningVoltageChanged);
     connect(this,&HardwareManager::updateMotorSettings,md,&MotorDriver::readCavitySettings);
+    //readings are added to the telemetry history directly on the device thread
+    connect(md,&MotorDriver::voltageChanged,[](int v){ TelemetryStore::instance().append(QString("tuningVoltage"),static_cast<double>(v)); });
+    connect(md,&MotorDriver::posUpdate,[](int p){ TelemetryStore::instance().append(QString("mirrorPos"),static_cast<double>(p)); });
     d_hardwareList.append(qMakePair(md,nullptr));
 
     iob = new IOBoardHardware();
-    connect(iob,&IOBoard::triggered,scope,&Oscilloscope::sendCurveQuery);
+    connect(iob,&IOBoard::triggered,scope,&Oscilloscope::trigger);
+    connect(iob,&IOBoard::triggered,this,&HardwareManager::triggersDetected);
     connect(iob,&IOBoard::magnetUpdate,this,&HardwareManager::magnetUpdate);
     connect(this,&HardwareManager::setMagnetFromUI,iob,&IOBoard::setMagnet);
     d_hardwareList.append(qMakePair(iob,nullptr));
@@ -101,6 +108,8 @@ void HardwareManager::initializeHardware()
     connect(this,&HardwareManager::setGasName,fc,&FlowController::setChannelName);
     connect(this,&HardwareManager::setFlowSetpoint,fc,&FlowController::setFlowSetpoint);
     connect(this,&HardwareManager::setPressureSetpoint,fc,&FlowController::setPressureSetpoint);
+    connect(fc,&FlowController::flowUpdate,[](int ch, double f){ TelemetryStore::instance().append(QString("flow%1").arg(ch),f); });
+    connect(fc,&FlowController::pressureUpdate,[](double p){ TelemetryStore::instance().append(QString("pressure"),p); });
     d_hardwareList.append(qMakePair(fc,nullptr));
 
     pGen = new PulseGeneratorHardware();
@@ -240,6 +249,9 @@ void HardwareManager::initializeHardware()
     else
         connect(md,&MotorDriver::deltaF,p_ftmSynth,&FtmSynthesizer::goToCavityDeltaFreq);
 
+    p_statusTimer = new QTimer(this);
+    connect(p_statusTimer,&QTimer::timeout,this,&HardwareManager::pollStatus);
+
     //now, start all threads
     for(int i=0;i<d_hardwareList.size();i++)
     {
@@ -628,6 +640,8 @@ void HardwareManager::prepareForScan(Scan s)
     d_waitingForScanTune = true;
     d_scanActive = true;
     pauseScope(true);
+    QMetaObject::invokeMethod(gpib,"resetStatistics");
+    QMetaObject::invokeMethod(gpib,"setScanActive",Q_ARG(bool,true));
 
     if(d_currentScan.skipTune())
 	    finishPreparation(true);
@@ -1105,6 +1119,7 @@ void HardwareManager::restoreSettingsAfterScanPrep()
 	d_tuningOldA = 0;
 	d_tuningOldPulseConfig = PulseGenConfig();
 	pauseScope(false);
+	QMetaObject::invokeMethod(gpib,"setScanActive",Q_ARG(bool,false));
 	d_currentScan = Scan();
 	return;
 }
@@ -1113,6 +1128,7 @@ void HardwareManager::scanComplete(const Scan s)
 {
 	Q_UNUSED(s)
 	d_scanActive = false;
+	QMetaObject::invokeMethod(gpib,"logStatistics");
 }
 
 void HardwareManager::checkStatus()
@@ -1130,6 +1146,27 @@ void HardwareManager::checkStatus()
 			success = false;
 	}
 
+	//hardware objects record their limits in the settings file during initialization
+	ConfigService::instance().reload();
+
+	int pollInterval = ConfigService::instance().snapshot().value(QString("gpibStatusPollMs"),10000).toInt();
+	if(success && pollInterval > 0)
+	{
+		if(!p_statusTimer->isActive())
+			p_statusTimer->start(pollInterval);
+	}
+	else
+		p_statusTimer->stop();
+
 	emit allHardwareConnected(success);
 }
 
+void HardwareManager::pollStatus()
+{
+	if(d_scanActive)
+		return;
+
+	QMetaObject::invokeMethod(p_ftmSynth,"pollStatus");
+	QMetaObject::invokeMethod(p_drSynth,"pollStatus");
+}
+
@@ -17,6 +17,7 @@
 #include "pinswitchdrivedelaygenerator.h"
 #include "hvpowersupply.h"
 #include <QThread>
+#include <QTimer>
 #include "ioboard.h"
 
 /*!
@@ -184,8 +185,17 @@ signals:
     /*!
      * \brief Emitted when the scope acquires a trace
      * \param QByteArray The raw waveform data
+     * \param int The number of shots averaged into the trace by the scope
+     * \param int The number of frames in the trace (segmented capture)
      */
-	void scopeWaveAcquired(const QByteArray);
+	void scopeWaveAcquired(const QByteArray, int, int);
+
+    /*!
+     * \brief Emitted when the IOBoard detects triggers
+     * \param int Number of triggers
+     * \param qint64 Time the triggers were detected (ms since epoch)
+     */
+    void triggersDetected(int, qint64);
 
     /*!
      * \brief Emitted when mirror position changes
@@ -636,6 +646,14 @@ private:
     QList<QPair<HardwareObject*,QThread*>> d_hardwareList;
 	void checkStatus();
 
+    /*!
+     * \brief Reads the synthesizer frequencies and powers in the background (interval: gpibStatusPollMs setting, 0 disables)
+     *
+     * On the GPIB bus, the reads are queued as StatusPoll transactions, so they never delay scan setup. No polls are sent while a scan is being prepared.
+     */
+    void pollStatus();
+
+    QTimer *p_statusTimer;
     int d_responseCount;
     bool d_firstInitialization;
     bool d_scanActive;
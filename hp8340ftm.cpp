@@ -61,7 +61,7 @@ void HP8340FTM::initialize()
 
 double HP8340FTM::setSynthFreq(double d)
 {
-    if (!p_comm->writeCmd(QString("CW%1MZ;\n").arg(d,0,'f',3)))
+    if (!p_comm->writeCmdPipelined(QString("CW%1MZ;\n").arg(d,0,'f',3)))
     {
         emit logMessage(QString("Could not set synth frequency to %1.").arg(d),QtFTM::LogError);
         emit hardwareFailure();
@@ -91,7 +91,7 @@ double HP8340FTM::setSynthPower(double d)
     if(qAbs(d-power) > 0.09)
     {
         p_comm->device()->waitForReadyRead(50);
-	   p_comm->writeCmd(QString("PL%1DB;\n").arg(QString::number(d,'f',2)));
+	   p_comm->writeCmdPipelined(QString("PL%1DB;\n").arg(QString::number(d,'f',2)));
         p_comm->device()->waitForReadyRead(50);// seems to be same command for both generators
     }
 
@@ -82,7 +82,7 @@ double HP8673DR::setSynthFreq(double d)
     }
 
     //write command to synth here!
-    if (!p_comm->writeCmd(QString("CF%1MZ;\n").arg(rawFreq,0,'f',3)))
+    if (!p_comm->writeCmdPipelined(QString("CF%1MZ;\n").arg(rawFreq,0,'f',3)))
     {
         emit hardwareFailure();
         return -1.0;
@@ -109,7 +109,7 @@ double HP8673DR::setSynthPower(double p)
     if(qAbs(p-power) > 0.09)
     {
         p_comm->device()->waitForReadyRead(50);
-	   p_comm->writeCmd(QString("PL%1DB;\n").arg(QString::number(p,'f',2)));
+	   p_comm->writeCmdPipelined(QString("PL%1DB;\n").arg(QString::number(p,'f',2)));
         p_comm->device()->waitForReadyRead(50);// seems to be same command for both generators
     }
 
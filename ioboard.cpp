@@ -1,7 +1,9 @@
 #include "ioboard.h"
 
+#include <QDateTime>
+
 IOBoard::IOBoard(QObject *parent) :
-    HardwareObject(parent)
+    HardwareObject(parent), d_totalTriggers(0)
 {
     d_key = QString("ioboard");
 
@@ -13,3 +15,12 @@ IOBoard::~IOBoard()
 {
 
 }
+
+void IOBoard::reportTriggers(int n)
+{
+    if(n <= 0)
+        return;
+
+    d_totalTriggers += n;
+    emit triggered(n,QDateTime::currentMSecsSinceEpoch());
+}
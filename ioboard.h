@@ -4,15 +4,29 @@
 
 #include <QTimer>
 
+/*!
+ * \brief Base class for the IO board, which detects triggers and controls digital lines
+ *
+ * The implementation polls for triggers in checkForTrigger() (called by p_readTimer), and calls reportTriggers() with the number of triggers seen since the previous poll.
+ * Triggers are emitted in batches with the triggered() signal, together with the time they were detected.
+ * The running total is kept in d_totalTriggers so that the number of triggers can be compared with the number of waveforms that were actually acquired.
+ */
 class IOBoard : public HardwareObject
 {
     Q_OBJECT
 public:
     explicit IOBoard(QObject *parent = nullptr);
     virtual ~IOBoard();
+
+    qint64 totalTriggers() const { return d_totalTriggers; }
     
 signals:
-    void triggered();
+    /*!
+     * \brief Emitted when the trigger counter advances
+     * \param n Number of triggers since the last emission
+     * \param timestamp Time the triggers were detected (ms since epoch)
+     */
+    void triggered(int n, qint64 timestamp);
     void magnetUpdate(bool);
     
 public slots:
@@ -23,6 +37,9 @@ public slots:
 
 protected:
     QTimer *p_readTimer;
+    qint64 d_totalTriggers;
+
+    void reportTriggers(int n);
     
 };
 
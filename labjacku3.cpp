@@ -2,7 +2,7 @@
 
 LabjackU3::LabjackU3(QObject *parent) :
     IOBoard(parent), d_handle(nullptr), d_serialNo(3), d_cwLine(16), d_highBandLine(17),
-    d_magnetLine(18), d_counterPinOffset(4), d_blockTriggering(false), d_counterCount(0)
+    d_magnetLine(18), d_counterPinOffset(4), d_blockTriggering(false)
 {
     d_subKey = QString("labjacku3");
     d_prettyName = QString("LabJack U3 IO Board");
@@ -161,13 +161,11 @@ void LabjackU3::checkForTrigger()
     if(d_handle == nullptr)
         return;
 
-    quint32 count = readCounter();
-    if(count != d_counterCount)
-    {
-        d_counterCount = count;
-        if(!d_blockTriggering)
-            emit triggered();
-    }
+    //the counter is reset each time it is read, so the value is the number of triggers since the last poll.
+    //More than one trigger may have arrived (e.g., in segmented capture mode at high rep rates)
+    quint32 n = readCounter(true);
+    if(n > 0 && !d_blockTriggering)
+        reportTriggers(static_cast<int>(n));
 }
 
 void LabjackU3::configure()
@@ -216,12 +214,11 @@ void LabjackU3::resetCounter()
         emit hardwareFailure();
         emit logMessage(QString("Error resetting %1 counter. Error code %2").arg(d_prettyName).arg(error),QtFTM::LogError);
     }
-    d_counterCount = 0;
 }
 
-quint32 LabjackU3::readCounter()
+quint32 LabjackU3::readCounter(bool reset)
 {
-    long readTimers[2] = {0,0}, resetTimers[2] = {0,0}, readCounters[2] = {1,0}, resetCounters[2] = {0,0};
+    long readTimers[2] = {0,0}, resetTimers[2] = {0,0}, readCounters[2] = {1,0}, resetCounters[2] = {reset ? 1 : 0,0};
     double timerValues[2] = {0.0,0.0}, counterValues[2] = {0,0};
     long error = eTCValues(d_handle,readTimers,resetTimers,readCounters,resetCounters,timerValues,counterValues,0,0);
     if(error)
@@ -229,6 +226,7 @@ quint32 LabjackU3::readCounter()
         p_readTimer->stop();
         emit hardwareFailure();
         emit logMessage(QString("Error reading %1 counter. Error code %2").arg(d_prettyName).arg(error),QtFTM::LogError);
+        return 0;
     }
     return static_cast<quint32>(counterValues[0]);
 }
@@ -33,11 +33,10 @@ private:
     int d_magnetLine;
     int d_counterPinOffset;
     bool d_blockTriggering;
-    quint32 d_counterCount;
 
     void configure();
     void resetCounter();
-    quint32 readCounter();
+    quint32 readCounter(bool reset = false);
     void closeConnection();
 
 };
@@ -0,0 +1,186 @@
+#include "livefeed.h"
+
+#include <QDateTime>
+#include <QCoreApplication>
+#include <string.h>
+#include <new>
+
+#include "configservice.h"
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const quint32 liveFeedVersion = 1;
+
+//the data blocks start on a cache line
+qint64 alignedSize(qint64 bytes)
+{
+	return (bytes + 63) & ~static_cast<qint64>(63);
+}
+
+}
+
+LiveFeed &LiveFeed::instance()
+{
+	static LiveFeed feed;
+	return feed;
+}
+
+LiveFeed::LiveFeed() : p_header(nullptr), p_map(nullptr), d_size(0), d_scanNumber(0), d_completedShots(0), d_targetShots(0)
+{
+	static_assert(sizeof(std::atomic<quint64>) == sizeof(quint64),"The live feed sequence numbers must be plain 64-bit integers");
+
+	ConfigSnapshot s = ConfigService::instance().snapshot();
+	if(!s.value(QString("liveFeedEnabled"),true).toBool())
+		return;
+
+	d_name = s.value(QString("liveFeedName"),QString("/qtftm-live")).toString();
+	int fidCapacity = qMax(1,s.value(QString("liveFeedFidPoints"),65536).toInt());
+	int ftCapacity = qMax(1,s.value(QString("liveFeedFtPoints"),65536).toInt());
+
+	qint64 fidOffset = alignedSize(sizeof(Header));
+	qint64 ftOffset = fidOffset + alignedSize(static_cast<qint64>(fidCapacity)*static_cast<qint64>(sizeof(double)));
+	qint64 size = ftOffset + alignedSize(static_cast<qint64>(ftCapacity)*2*static_cast<qint64>(sizeof(double)));
+
+#ifdef Q_OS_UNIX
+	QByteArray name = d_name.toLocal8Bit();
+	int fd = shm_open(name.constData(),O_CREAT | O_RDWR,0644);
+	if(fd < 0)
+		return;
+
+	if(ftruncate(fd,static_cast<off_t>(size)) != 0)
+	{
+		close(fd);
+		shm_unlink(name.constData());
+		return;
+	}
+
+	void *m = mmap(nullptr,static_cast<size_t>(size),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if(m == MAP_FAILED)
+	{
+		shm_unlink(name.constData());
+		return;
+	}
+
+	p_map = static_cast<char*>(m);
+	d_size = size;
+#else
+	return;
+#endif
+
+	//a segment left by a previous run is reinitialized; readers wait for the magic before trusting the layout
+	memset(p_map,0,sizeof(Header));
+	p_header = new (p_map) Header;
+	p_header->version = liveFeedVersion;
+	p_header->headerSize = sizeof(Header);
+	p_header->segmentSize = d_size;
+	p_header->pid = QCoreApplication::applicationPid();
+
+	Section *sections[2] = { &p_header->fid, &p_header->ft };
+	for(int i=0; i<2; i++)
+	{
+		Section *sec = sections[i];
+		new (&sec->sequence) std::atomic<quint64>(0);
+		sec->timeStamp = 0;
+		sec->scanNumber = 0;
+		sec->completedShots = 0;
+		sec->targetShots = 0;
+		sec->count = 0;
+		sec->probeFreq = 0.0;
+		sec->spacing = 0.0;
+	}
+	p_header->fid.dataOffset = fidOffset;
+	p_header->fid.capacity = fidCapacity;
+	p_header->fid.pointSize = 1;
+	p_header->ft.dataOffset = ftOffset;
+	p_header->ft.capacity = ftCapacity;
+	p_header->ft.pointSize = 2;
+
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(p_header->magic,"QFTMLIV1",8);
+}
+
+LiveFeed::~LiveFeed()
+{
+#ifdef Q_OS_UNIX
+	if(p_map != nullptr)
+	{
+		//readers that have the segment mapped keep their copy; new readers will not find it
+		munmap(p_map,static_cast<size_t>(d_size));
+		shm_unlink(d_name.toLocal8Bit().constData());
+	}
+#endif
+	p_map = nullptr;
+	p_header = nullptr;
+}
+
+void LiveFeed::publishFid(const Fid f, int scanNumber, int completedShots, int targetShots)
+{
+	d_scanNumber.store(scanNumber);
+	d_completedShots.store(completedShots);
+	d_targetShots.store(targetShots);
+
+	if(p_header == nullptr)
+		return;
+
+	Section &s = p_header->fid;
+	int n = qMin(f.size(),static_cast<int>(s.capacity));
+	double *dest = reinterpret_cast<double*>(p_map + s.dataOffset);
+
+	beginWrite(s);
+	s.timeStamp = QDateTime::currentMSecsSinceEpoch();
+	s.scanNumber = scanNumber;
+	s.completedShots = completedShots;
+	s.targetShots = targetShots;
+	s.count = n;
+	s.probeFreq = f.probeFreq();
+	s.spacing = f.spacing();
+	for(int i=0; i<n; i++)
+		dest[i] = f.at(i);
+	endWrite(s);
+}
+
+void LiveFeed::publishFt(const QVector<QPointF> ft, double probeFreq)
+{
+	if(p_header == nullptr)
+		return;
+
+	Section &s = p_header->ft;
+	int n = qMin(ft.size(),static_cast<int>(s.capacity));
+	double *dest = reinterpret_cast<double*>(p_map + s.dataOffset);
+
+	beginWrite(s);
+	s.timeStamp = QDateTime::currentMSecsSinceEpoch();
+	s.scanNumber = d_scanNumber.load();
+	s.completedShots = d_completedShots.load();
+	s.targetShots = d_targetShots.load();
+	s.count = n;
+	s.probeFreq = probeFreq;
+	s.spacing = 0.0;
+	for(int i=0; i<n; i++)
+	{
+		dest[2*i] = ft.at(i).x();
+		dest[2*i+1] = ft.at(i).y();
+	}
+	endWrite(s);
+}
+
+void LiveFeed::beginWrite(LiveFeed::Section &s)
+{
+	//the odd sequence must be visible before any of the new data
+	quint64 seq = s.sequence.load(std::memory_order_relaxed);
+	s.sequence.store(seq+1,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LiveFeed::endWrite(LiveFeed::Section &s)
+{
+	quint64 seq = s.sequence.load(std::memory_order_relaxed);
+	s.sequence.store(seq+1,std::memory_order_release);
+}
@@ -0,0 +1,93 @@
+#ifndef LIVEFEED_H
+#define LIVEFEED_H
+
+#include <QString>
+#include <QVector>
+#include <QPointF>
+#include <QAtomicInt>
+
+#include <atomic>
+
+#include "fid.h"
+
+/*!
+ * \brief Publishes the FID and FT of the ongoing acquisition in shared memory
+ *
+ * Other programs on the same computer (monitoring scripts, analysis tools) can follow an acquisition without a connection to QtFTM and without the GUI.
+ * The feed is a POSIX shared memory segment (shm_open) named by the liveFeedName setting ("/qtftm-live" by default).
+ * It is created the first time something is published, and removed when the program exits.
+ * Set liveFeedEnabled to false to turn the feed off.
+ *
+ * The segment begins with a Header, followed by the FID data (one double per point, in V) and the FT data (x and y doubles for each point, MHz and mV).
+ * All values are in the native byte order, and all offsets are in bytes from the start of the segment.
+ * The FID and FT each have a Section with its own sequence number, which works like a seqlock:
+ * the writer makes the sequence odd, writes the section and its data, then makes it even again.
+ * A reader copies the sequence, then the section and data, then reads the sequence again; the copy is consistent if both values are equal and even.
+ * There is never more than one writer for a section, and the writer never waits for readers, so publishing costs one copy of the data.
+ *
+ * ScanManager publishes each new average with publishFid(), and the acquisition FtPlot publishes each FT it computes with publishFt() on its FT thread.
+ * Points beyond the capacity of a section (liveFeedFidPoints and liveFeedFtPoints settings) are not published.
+ */
+class LiveFeed
+{
+public:
+	static LiveFeed &instance();
+	~LiveFeed();
+
+	struct Section {
+		std::atomic<quint64> sequence; /*!< Odd while the section is being written */
+		qint64 timeStamp; /*!< Time of the last update, in ms since the epoch */
+		qint32 scanNumber;
+		qint32 completedShots;
+		qint32 targetShots;
+		qint32 count; /*!< Number of points in the data */
+		double probeFreq; /*!< MHz */
+		double spacing; /*!< Time between FID points (s); 0 for the FT */
+		qint64 dataOffset;
+		qint32 capacity; /*!< Maximum number of points */
+		qint32 pointSize; /*!< Doubles per point: 1 for the FID, 2 for the FT */
+	};
+
+	struct Header {
+		char magic[8]; /*!< "QFTMLIV1", written once the rest of the header is initialized */
+		quint32 version;
+		quint32 headerSize;
+		qint64 segmentSize;
+		qint64 pid;
+		Section fid;
+		Section ft;
+	};
+
+	/*!
+	 * \brief Publishes the current average of a scan
+	 * \param f Averaged FID
+	 * \param scanNumber Scan number (may be 0 until the scan is saved)
+	 * \param completedShots Shots averaged so far
+	 * \param targetShots Shots requested for the scan
+	 */
+	void publishFid(const Fid f, int scanNumber, int completedShots, int targetShots);
+	/*!
+	 * \brief Publishes an FT, with the scan information of the last published FID
+	 */
+	void publishFt(const QVector<QPointF> ft, double probeFreq);
+
+	bool isOpen() const { return p_header != nullptr; }
+
+private:
+	LiveFeed();
+	Q_DISABLE_COPY(LiveFeed)
+
+	QString d_name;
+	Header *p_header;
+	char *p_map;
+	qint64 d_size;
+
+	QAtomicInt d_scanNumber;
+	QAtomicInt d_completedShots;
+	QAtomicInt d_targetShots;
+
+	static void beginWrite(Section &s);
+	static void endWrite(Section &s);
+};
+
+#endif // LIVEFEED_H
@@ -2,14 +2,15 @@
 #include "ui_loadbatchdialog.h"
 #include <QSettings>
 
+#include "numberallocator.h"
+
 LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::LoadBatchDialog)
 {
     ui->setupUi(this);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    int surveyMax = s.value(QString("surveyNum"),0).toInt()-1;
+    int surveyMax = NumberAllocator::instance().next(QString("surveyNum"))-1;
     if(surveyMax > 0)
     {
 	    ui->surveySpinBox->setSpecialValueText(QString(""));
@@ -25,7 +26,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
         ui->drScanButton->setChecked(true);
     }
 
-    int drMax = s.value(QString("drNum"),0).toInt()-1;
+    int drMax = NumberAllocator::instance().next(QString("drNum"))-1;
     if(drMax > 0)
     {
 	    ui->drScanSpinBox->setSpecialValueText(QString(""));
@@ -42,7 +43,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
             ui->batchButton->setChecked(true);
     }
 
-    int batchMax = s.value(QString("batchNum"),0).toInt()-1;
+    int batchMax = NumberAllocator::instance().next(QString("batchNum"))-1;
     if(batchMax > 0)
     {
 	    ui->batchSpinBox->setSpecialValueText(QString(""));
@@ -59,7 +60,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
             ui->attenuationButton->setChecked(true);
     }
 
-    int attenMax = s.value(QString("batchAttnNum"),0).toInt()-1;
+    int attenMax = NumberAllocator::instance().next(QString("batchAttnNum"))-1;
     if(attenMax > 0)
     {
 	    ui->attenuationSpinBox->setSpecialValueText(QString(""));
@@ -74,7 +75,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
         ui->attenuationButton->setCheckable(false);
     }
 
-    int drCorrMax = s.value(QString("drCorrNum"),0).toInt()-1;
+    int drCorrMax = NumberAllocator::instance().next(QString("drCorrNum"))-1;
     if(drCorrMax > 0)
     {
 	    ui->drCorrSpinBox->setSpecialValueText(QString(""));
@@ -89,7 +90,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
 	    ui->drCorrButton->setCheckable(false);
     }
 
-    int catMax = s.value(QString("catTestNum"),0).toInt()-1;
+    int catMax = NumberAllocator::instance().next(QString("catTestNum"))-1;
     if(catMax > 0)
     {
 	    ui->catSpinBox->setSpecialValueText(QString(""));
@@ -104,7 +105,7 @@ LoadBatchDialog::LoadBatchDialog(QWidget *parent) :
 	    ui->catButton->setCheckable(false);
     }
 
-    int amdorMax = s.value(QString("amdorNum"),0).toInt()-1;
+    int amdorMax = NumberAllocator::instance().next(QString("amdorNum"))-1;
     if(amdorMax > 0)
     {
         ui->amdorSpinBox->setSpecialValueText(QString(""));
@@ -1,102 +1,296 @@
 #include "loghandler.h"
 #include <QDateTime>
 #include <QDate>
-#include <QApplication>
-#include <QSettings>
+#include <QThread>
+#include <QTimer>
+#include "configservice.h"
 
+namespace {
+
+const int drainInterval = 250;
+const int maxPerSecond = 50;
+const qint64 repeatTimeout = 2000;
+const int flushBytes = 16384;
+const qint64 flushInterval = 1000;
+
+}
 
 LogHandler::LogHandler(QObject *parent) :
-    QObject(parent)
+    QObject(parent), d_head(0), p_timer(nullptr), d_currentMonth(0), d_lastFlush(0), d_repeats(0), d_lastRepeat(0)
 {
-	d_currentMonth = QDate::currentDate().month();
-	d_logFile.setFileName(makeLogFileName());
-	d_logFile.open(QIODevice::Append);
+	p_ring = new Slot[ringSize];
+	for(int i=0; i<ringSize; i++)
+		p_ring[i].seq.storeRelease(static_cast<quint32>(i));
+	d_tail.storeRelease(0);
+
+	//the log file is written on a separate thread; the handler cannot have a parent
+	p_thread = new QThread();
+	p_thread->setObjectName(QString("logThread"));
+	moveToThread(p_thread);
+	connect(p_thread,&QThread::started,this,&LogHandler::initialize);
+	p_thread->start();
 }
 
 LogHandler::~LogHandler()
 {
-	if(d_logFile.isOpen())
-	    d_logFile.close();
+	if(p_thread->isRunning())
+	{
+		QMetaObject::invokeMethod(this,"shutdown",Qt::BlockingQueuedConnection);
+		p_thread->quit();
+		p_thread->wait();
+	}
+
+	delete p_thread;
+	delete[] p_ring;
 }
 
-void LogHandler::logMessage(const QString text, const QtFTM::LogMessageCode type)
+QString LogHandler::formatPlain(const LogRecord &r)
 {
-	QString timeStamp = QDateTime::currentDateTime().toString();
-	writeToFile(text, type, timeStamp);
-
-#ifdef QT_NO_DEBUG
-	if(type == QtFTM::LogDebug)
-		return;
-#endif
-
-	QString out;
-	out.append(QString("<span style=\"font-size:7pt\">%1</span> ").arg(timeStamp));
-
-	switch(type)
+	QString msg = QString("%1: ").arg(QDateTime::fromMSecsSinceEpoch(r.msecs).toString());
+	switch (r.code)
 	{
-    case QtFTM::LogWarning:
-		out.append(QString("<span style=\"font-weight:bold\">Warning: %1</span>").arg(text));
-		emit iconUpdate(type);
-		break;
-    case QtFTM::LogError:
-		out.append(QString("<span style=\"font-weight:bold;color:red\">Error: %1</span>").arg(text));
-		emit iconUpdate(type);
+	case QtFTM::LogWarning:
+		msg.append(QString("[WARNING] "));
 		break;
-    case QtFTM::LogHighlight:
-		out.append(QString("<span style=\"font-weight:bold;color:green\">%1</span>").arg(text));
+	case QtFTM::LogError:
+		msg.append(QString("[ERROR] "));
 		break;
 	case QtFTM::LogDebug:
-		out.append(QString("<span style=\"color:blue\">Debug: %1</span>").arg(text));
+		msg.append(QString("[DEBUG] "));
 		break;
-    case QtFTM::LogNormal:
 	default:
-		out.append(text);
 		break;
 	}
 
-	//emit signal containing formatted message
-	emit sendLogMessage(out);
+	return msg.append(r.text);
+}
+
+void LogHandler::logMessage(const QString text, const QtFTM::LogMessageCode type)
+{
+	LogRecord r;
+	r.msecs = QDateTime::currentMSecsSinceEpoch();
+	r.code = type;
+	r.source = QThread::currentThread()->objectName();
+	r.text = text;
+
+	if(!push(r))
+	{
+		d_dropped.fetchAndAddRelaxed(1);
+		return;
+	}
+
+	//don't wait for the timer if messages are arriving quickly
+	if(d_queued.fetchAndAddRelaxed(1)+1 >= ringSize/4 && d_drainScheduled.testAndSetOrdered(0,1))
+		QMetaObject::invokeMethod(this,"drain",Qt::QueuedConnection);
+}
+
+void LogHandler::initialize()
+{
+	d_currentMonth = QDate::currentDate().month();
+	d_logFile.setFileName(makeLogFileName());
+	d_logFile.open(QIODevice::Append);
+	d_lastFlush = QDateTime::currentMSecsSinceEpoch();
+
+	p_timer = new QTimer(this);
+	p_timer->setInterval(drainInterval);
+	connect(p_timer,&QTimer::timeout,this,&LogHandler::drain);
+	p_timer->start();
+}
+
+void LogHandler::drain()
+{
+	d_drainScheduled.storeRelease(0);
+
+	LogRecord r;
+	int n = 0;
+	while(pop(r))
+	{
+		accept(r);
+		n++;
+	}
+	d_queued.fetchAndAddRelaxed(-n);
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	int dropped = d_dropped.fetchAndStoreRelaxed(0);
+	if(dropped > 0)
+	{
+		LogRecord w;
+		w.msecs = now;
+		w.code = QtFTM::LogWarning;
+		w.source = p_thread->objectName();
+		w.text = QString("%1 log messages were lost because too many were logged at once.").arg(dropped);
+		emitRecord(w);
+	}
+
+	if(d_repeats > 0 && now - d_lastRepeat >= repeatTimeout)
+		flushRepeats();
+
+	for(auto it = d_rates.begin(); it != d_rates.end(); it++)
+	{
+		if(it.value().suppressed > 0 && now/1000 != it.value().second)
+		{
+			LogRecord w;
+			w.msecs = now;
+			w.code = QtFTM::LogWarning;
+			w.source = it.key();
+			w.text = QString("%1 log messages were suppressed (more than %2 per second).").arg(it.value().suppressed).arg(maxPerSecond);
+			emitRecord(w);
+			it.value().suppressed = 0;
+		}
+	}
+
+	writeFile(false);
+
+	if(!d_out.isEmpty())
+	{
+		emit recordsReady(d_out);
+		d_out.clear();
+	}
+}
+
+void LogHandler::shutdown()
+{
+	if(p_timer != nullptr)
+	{
+		p_timer->stop();
+		delete p_timer;
+		p_timer = nullptr;
+	}
+
+	drain();
+	flushRepeats();
+	writeFile(true);
+	d_logFile.close();
+}
+
+bool LogHandler::push(const LogRecord &r)
+{
+	//bounded multi-producer queue: each slot's sequence number says whether it is free for position pos (seq == pos) or holds the record for pos (seq == pos+1)
+	quint32 pos = d_tail.loadAcquire();
+	forever
+	{
+		Slot &s = p_ring[pos % ringSize];
+		qint32 diff = static_cast<qint32>(s.seq.loadAcquire() - pos);
+		if(diff == 0)
+		{
+			if(d_tail.testAndSetOrdered(pos,pos+1))
+			{
+				s.rec = r;
+				s.seq.storeRelease(pos+1);
+				return true;
+			}
+			pos = d_tail.loadAcquire();
+		}
+		else if(diff < 0)
+			return false;
+		else
+			pos = d_tail.loadAcquire();
+	}
+}
+
+bool LogHandler::pop(LogRecord &r)
+{
+	Slot &s = p_ring[d_head % ringSize];
+	if(static_cast<qint32>(s.seq.loadAcquire() - (d_head+1)) < 0)
+		return false;
+
+	r = s.rec;
+	s.rec = LogRecord();
+	s.seq.storeRelease(d_head + ringSize);
+	d_head++;
+	return true;
+}
+
+void LogHandler::accept(const LogRecord &r)
+{
+	if(d_last.msecs > 0 && r.code == d_last.code && r.source == d_last.source && r.text == d_last.text)
+	{
+		d_repeats++;
+		d_lastRepeat = r.msecs;
+		return;
+	}
+
+	flushRepeats();
+	d_last = r;
+
+	if(r.code != QtFTM::LogError)
+	{
+		RateBucket &b = d_rates[r.source];
+		qint64 second = r.msecs/1000;
+		if(second != b.second)
+		{
+			b.second = second;
+			b.count = 0;
+		}
+
+		b.count++;
+		if(b.count > maxPerSecond)
+		{
+			b.suppressed++;
+			return;
+		}
+	}
+
+	emitRecord(r);
+}
+
+void LogHandler::emitRecord(const LogRecord &r)
+{
+	d_fileBuffer.append(formatPlain(r).toLatin1()).append('\n');
+	if(r.code == QtFTM::LogError)
+		writeFile(true);
+
+#ifdef QT_NO_DEBUG
+	if(r.code == QtFTM::LogDebug)
+		return;
+#endif
+
+	d_out.append(r);
+	if(r.code == QtFTM::LogWarning || r.code == QtFTM::LogError)
+		emit iconUpdate(r.code);
+}
+
+void LogHandler::flushRepeats()
+{
+	if(d_repeats == 0)
+		return;
+
+	LogRecord r = d_last;
+	r.msecs = d_lastRepeat;
+	r.text = QString("(previous message repeated %1 times)").arg(d_repeats);
+	d_repeats = 0;
+	emitRecord(r);
 }
 
-void LogHandler::writeToFile(const QString text, const QtFTM::LogMessageCode type, const QString timeStamp)
+void LogHandler::writeFile(bool force)
 {
-    QDate now = QDate::currentDate();
-    if(now.month() != d_currentMonth)
-    {
-	   d_currentMonth = now.month();
-	   QString newLogFile = makeLogFileName();
-
-	   if(d_logFile.isOpen())
-		  d_logFile.close();
-
-	   d_logFile.setFileName(newLogFile);
-
-	   d_logFile.open(QIODevice::Append);
-    }
-
-    if(d_logFile.isOpen())
-    {
-	    QString msg = QString("%1: ").arg(timeStamp);
-	    switch (type)
-	    {
-	    case QtFTM::LogWarning:
-		    msg.append(QString("[WARNING] "));
-		    break;
-	    case QtFTM::LogError:
-		    msg.append(QString("[ERROR] "));
-		    break;
-	    case QtFTM::LogDebug:
-		    msg.append(QString("[DEBUG] "));
-		    break;
-	    default:
-		    break;
-	    }
-
-	    msg.append(text).append(QString("\n"));
-
-	    d_logFile.write(msg.toLatin1());
-	    d_logFile.flush();
-    }
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	QDate today = QDate::currentDate();
+	bool newMonth = today.month() != d_currentMonth;
+
+	if(d_fileBuffer.isEmpty() && !newMonth)
+		return;
+
+	if(!force && !newMonth && d_fileBuffer.size() < flushBytes && now - d_lastFlush < flushInterval)
+		return;
+
+	if(d_logFile.isOpen())
+	{
+		d_logFile.write(d_fileBuffer);
+		d_logFile.flush();
+	}
+	d_fileBuffer.clear();
+	d_lastFlush = now;
+
+	if(newMonth)
+	{
+		d_currentMonth = today.month();
+		if(d_logFile.isOpen())
+			d_logFile.close();
+
+		d_logFile.setFileName(makeLogFileName());
+		d_logFile.open(QIODevice::Append);
+	}
 }
 
 
@@ -108,7 +302,6 @@ QString LogHandler::makeLogFileName()
     else
 	   month = QString::number(d_currentMonth);
 
-    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-    return QString("%1/log/%2%3.log").arg(s.value(QString("savePath")).toString()).arg(QDate::currentDate().year()).arg(month);
+    return QString("%1/log/%2%3.log").arg(ConfigService::instance().snapshot().savePath()).arg(QDate::currentDate().year()).arg(month);
 
 }
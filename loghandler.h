@@ -4,9 +4,45 @@
 #include <QObject>
 #include <QString>
 #include <QFile>
+#include <QList>
+#include <QHash>
+#include <QAtomicInteger>
+#include <QMetaType>
 
 #include "datastructs.h"
 
+class QThread;
+class QTimer;
+
+/*!
+ \brief A single log message
+*/
+struct LogRecord {
+	qint64 msecs; /*!< Time the message was logged (ms since the epoch) */
+	QtFTM::LogMessageCode code;
+	QString source; /*!< Name of the thread that logged the message */
+	QString text;
+
+	LogRecord() : msecs(0), code(QtFTM::LogNormal) {}
+};
+
+Q_DECLARE_METATYPE(LogRecord)
+
+/*!
+ \brief Collects log messages, writes them to the monthly log file, and sends them to the UI
+
+ logMessage() may be called directly from any thread: the message is placed in a fixed-size lock-free ring, and the call never blocks.
+ If the ring is full, the message is dropped and counted, and a warning with the number of dropped messages is logged once there is room again.
+
+ The handler runs on its own thread, and empties the ring every 250 ms (or as soon as it is a quarter full).
+ Each group of messages is then:
+ - collapsed: a message identical to the previous one (same source, code, and text) is only counted, and a "repeated n times" line is logged when a different message arrives or no repeat has been seen for 2 s
+ - rate limited: each source may log 50 messages per second. Errors are never suppressed; other messages over the limit are counted and summarized at the start of the next second
+ - written to the log file, which is flushed once 16 kB are waiting, 1 s after the last flush, or immediately after an error
+ - sent to the UI with recordsReady() as structured records, which are only formatted when they are displayed (see LogModel)
+
+ The handler must be deleted from the thread that created it, after every thread that logs messages has stopped; remaining messages are written before it is destroyed.
+*/
 class LogHandler : public QObject
 {
     Q_OBJECT
@@ -14,21 +50,69 @@ public:
     explicit LogHandler(QObject *parent = nullptr);
 	~LogHandler();
 
+	/*!
+	 \brief Formats a record as a line of the log file (without the newline)
+	*/
+	static QString formatPlain(const LogRecord &r);
+
 signals:
-	//sends the formatted messages to the UI
-	void sendLogMessage(const QString);
+	//sends the new records to the UI
+	void recordsReady(const QList<LogRecord>);
 	void sendStatusMessage(const QString);
 	void iconUpdate(QtFTM::LogMessageCode);
 
 public slots:
-	//access functions for transmitting messages to UI
+	//thread-safe; may be connected with Qt::DirectConnection
 	void logMessage(const QString text, const QtFTM::LogMessageCode type=QtFTM::LogNormal);
 
+private slots:
+	void initialize();
+	void drain();
+	void shutdown();
+
 private:
+	struct Slot {
+		QAtomicInteger<quint32> seq;
+		LogRecord rec;
+	};
+
+	struct RateBucket {
+		qint64 second;
+		int count;
+		int suppressed;
+
+		RateBucket() : second(0), count(0), suppressed(0) {}
+	};
+
+	static const int ringSize = 4096;
+
+	Slot *p_ring;
+	QAtomicInteger<quint32> d_tail;
+	quint32 d_head;
+	QAtomicInt d_queued;
+	QAtomicInt d_drainScheduled;
+	QAtomicInt d_dropped;
+
+	QThread *p_thread;
+	QTimer *p_timer;
+
 	QFile d_logFile;
 	int d_currentMonth;
+	QByteArray d_fileBuffer;
+	qint64 d_lastFlush;
+
+	LogRecord d_last;
+	int d_repeats;
+	qint64 d_lastRepeat;
+	QHash<QString,RateBucket> d_rates;
+	QList<LogRecord> d_out;
 
-	void writeToFile(const QString text, const QtFTM::LogMessageCode type, const QString timeStamp);
+	bool push(const LogRecord &r);
+	bool pop(LogRecord &r);
+	void accept(const LogRecord &r);
+	void emitRecord(const LogRecord &r);
+	void flushRepeats();
+	void writeFile(bool force);
 	QString makeLogFileName();
 
 };
@@ -0,0 +1,101 @@
+#include "logmodel.h"
+
+#include <QDateTime>
+#include <QFont>
+#include <QBrush>
+
+LogModel::LogModel(QObject *parent) :
+	QAbstractListModel(parent), d_maxRecords(10000)
+{
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+	Q_UNUSED(parent)
+	return d_records.size();
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+	if(!index.isValid() || index.row() >= d_records.size())
+		return QVariant();
+
+	const LogRecord &r = d_records.at(index.row());
+	switch(role)
+	{
+	case Qt::DisplayRole:
+	{
+		QString out = QString("%1  ").arg(QDateTime::fromMSecsSinceEpoch(r.msecs).toString(QString("MMM dd hh:mm:ss")));
+		if(r.code == QtFTM::LogWarning)
+			out.append(QString("Warning: "));
+		else if(r.code == QtFTM::LogError)
+			out.append(QString("Error: "));
+		else if(r.code == QtFTM::LogDebug)
+			out.append(QString("Debug: "));
+		return out.append(r.text);
+	}
+	case Qt::ForegroundRole:
+		if(r.code == QtFTM::LogError)
+			return QBrush(Qt::red);
+		if(r.code == QtFTM::LogHighlight)
+			return QBrush(Qt::darkGreen);
+		if(r.code == QtFTM::LogDebug)
+			return QBrush(Qt::blue);
+		return QVariant();
+	case Qt::FontRole:
+		if(r.code == QtFTM::LogWarning || r.code == QtFTM::LogError || r.code == QtFTM::LogHighlight)
+		{
+			QFont f;
+			f.setBold(true);
+			return f;
+		}
+		return QVariant();
+	case Qt::ToolTipRole:
+		if(r.source.isEmpty())
+			return QDateTime::fromMSecsSinceEpoch(r.msecs).toString();
+		return QString("%1 (%2)").arg(QDateTime::fromMSecsSinceEpoch(r.msecs).toString()).arg(r.source);
+	default:
+		return QVariant();
+	}
+}
+
+QString LogModel::toPlainText() const
+{
+	QString out;
+	for(int i=0; i<d_records.size(); i++)
+		out.append(LogHandler::formatPlain(d_records.at(i))).append(QString("\n"));
+
+	return out;
+}
+
+void LogModel::appendRecords(const QList<LogRecord> records)
+{
+	if(records.isEmpty())
+		return;
+
+	int excess = d_records.size() + records.size() - d_maxRecords;
+	if(excess > 0)
+	{
+		int remove = qMin(excess,d_records.size());
+		if(remove > 0)
+		{
+			beginRemoveRows(QModelIndex(),0,remove-1);
+			d_records.erase(d_records.begin(),d_records.begin()+remove);
+			endRemoveRows();
+		}
+	}
+
+	//if there are more new records than fit, only the last ones are kept
+	int first = qMax(records.size() - d_maxRecords,0);
+	beginInsertRows(QModelIndex(),d_records.size(),d_records.size() + records.size() - first - 1);
+	for(int i=first; i<records.size(); i++)
+		d_records.append(records.at(i));
+	endInsertRows();
+}
+
+void LogModel::clear()
+{
+	beginResetModel();
+	d_records.clear();
+	endResetModel();
+}
@@ -0,0 +1,39 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+
+#include "loghandler.h"
+
+/*!
+ \brief List model for the log tab
+
+ Holds the records sent by the LogHandler (at most 10000; the oldest are removed first).
+ The text, color, and font of a row are only computed when the view asks for them, so only the rows on screen are ever formatted.
+*/
+class LogModel : public QAbstractListModel
+{
+	Q_OBJECT
+public:
+	explicit LogModel(QObject *parent = nullptr);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role) const;
+
+	/*!
+	 \brief All records, formatted as in the log file
+	*/
+	QString toPlainText() const;
+
+public slots:
+	void appendRecords(const QList<LogRecord> records);
+	void clear();
+
+private:
+	QList<LogRecord> d_records;
+	int d_maxRecords;
+
+};
+
+#endif // LOGMODEL_H
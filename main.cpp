@@ -6,6 +6,8 @@
 #include <QDesktopServices>
 #include <QProcessEnvironment>
 
+#include "configservice.h"
+
 #include <gsl/gsl_errno.h>
 
 #ifdef Q_OS_UNIX
@@ -137,8 +139,11 @@ int main(int argc, char *argv[])
     qRegisterMetaType<QList<QVector<QPointF> > >("QList<QVector<QPointF> >");
     qRegisterMetaType<FlowConfig>("FlowConfig");
     qRegisterMetaType<FitResult>("FitResult");
+    qRegisterMetaType<ConfigSnapshot>("ConfigSnapshot");
+    qRegisterMetaType<QList<LogRecord> >("QList<LogRecord>");
     qRegisterMetaType<QtFTM::FlowSetting>("QtFTM::FlowSetting");
     qRegisterMetaType<QPair<QList<QVector<QPointF>>,QPointF>>("QPair<QList<QVector<QPointF>>,QPointF>");
+    qRegisterMetaType<CurveRenderer::Request>("CurveRenderer::Request");
 
     gsl_set_error_handler_off();
 
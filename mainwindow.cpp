@@ -11,6 +11,7 @@
 #include <QWidgetAction>
 #include <QInputDialog>
 #include <QDateTime>
+#include <QScrollBar>
 
 #include "scan.h"
 #include "singlescandialog.h"
@@ -21,6 +22,7 @@
 #include "amdorbatch.h"
 #include "batch.h"
 #include "batchwizard.h"
+#include "batchcheckpoint.h"
 #include "communicationdialog.h"
 #include "settingsdialog.h"
 #include "ftsynthsettingswidget.h"
@@ -31,6 +33,11 @@
 #include "batchattenuation.h"
 #include "dopplerpairfitter.h"
 #include "amdorwidget.h"
+#include "numberallocator.h"
+#include "configservice.h"
+#include "scanindex.h"
+#include "scanrepository.h"
+#include "telemetrystore.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent), ui(new Ui::MainWindow), d_hardwareConnected(false), d_logCount(0), d_logIcon(QtFTM::LogNormal)
@@ -87,6 +94,61 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->menuResolution->addActions(resGroup->actions());
 
+    //scope-side averaging and segmented (FastFrame) capture. 1 = each trigger is transferred individually
+    //the two modes are exclusive, so selecting one turns the other off
+    QString scopeSubKey = s.value(QString("scope/subKey"),QString("virtual")).toString();
+    QActionGroup *avgGroup = new QActionGroup(ui->menuScopeAveraging);
+    avgGroup->setExclusive(true);
+    QActionGroup *frameGroup = new QActionGroup(ui->menuScopeFrames);
+    frameGroup->setExclusive(true);
+    int scopeAvgs = s.value(QString("scope/%1/averages").arg(scopeSubKey),1).toInt();
+    int scopeFrames = s.value(QString("scope/%1/frames").arg(scopeSubKey),1).toInt();
+    QList<int> avgOptions;
+    avgOptions << 1 << 4 << 16 << 64 << 256 << 512;
+    for(int i=0; i<avgOptions.size(); i++)
+    {
+        int n = avgOptions.at(i);
+        QAction *a = avgGroup->addAction(n == 1 ? QString("Off") : QString("%1 shots").arg(n));
+        a->setCheckable(true);
+        a->setChecked(n == scopeAvgs);
+        connect(a,&QAction::triggered,[=](){
+            if(n > 1)
+                frameGroup->actions().first()->setChecked(true);
+            scopeAveragesChanged(n);
+        });
+    }
+    ui->menuScopeAveraging->addActions(avgGroup->actions());
+
+    QList<int> frameOptions;
+    frameOptions << 1 << 10 << 25 << 50 << 100 << 200;
+    for(int i=0; i<frameOptions.size(); i++)
+    {
+        int n = frameOptions.at(i);
+        QAction *a = frameGroup->addAction(n == 1 ? QString("Off") : QString("%1 frames").arg(n));
+        a->setCheckable(true);
+        a->setChecked(n == scopeFrames);
+        connect(a,&QAction::triggered,[=](){
+            if(n > 1)
+                avgGroup->actions().first()->setChecked(true);
+            scopeFramesChanged(n);
+        });
+    }
+    ui->menuScopeFrames->addActions(frameGroup->actions());
+
+    //store the raw ADC sums of new scans in compressed form (see FidCodec)
+    ui->menuSettings->addSeparator();
+    QAction *compressAction = ui->menuSettings->addAction(QString("&Compress FID Storage"));
+    compressAction->setCheckable(true);
+    compressAction->setChecked(ConfigService::instance().snapshot().compressFid());
+    connect(compressAction,&QAction::toggled,[](bool b){
+        ConfigService::instance().setValue(QString("compressFid"),b);
+    });
+
+    ui->menuTools->addSeparator();
+    QAction *indexAction = ui->menuTools->addAction(QString("Rebuild Scan &Index"));
+    indexAction->setObjectName(QString("actionRebuild_Scan_Index"));
+    connect(indexAction,&QAction::triggered,this,&MainWindow::rebuildScanIndex);
+
     QGridLayout *gl = new QGridLayout;
     for(int i=0; i<QTFTM_PGEN_NUMCHANNELS; i++)
     {
@@ -153,12 +215,22 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->statusBar->addPermanentWidget(mirrorProgress,1);
 
 	//log handler
-	lh = new LogHandler(this);
-	connect(lh,&LogHandler::sendLogMessage,ui->log,&QTextEdit::append);
-	connect(lh,&LogHandler::sendLogMessage,[=](){
+	//messages are logged directly from the thread that sends them; the handler writes the file on its own thread
+	QThread::currentThread()->setObjectName(QString("uiThread"));
+	lh = new LogHandler();
+	p_logModel = new LogModel(this);
+	ui->log->setModel(p_logModel);
+	connect(ui->clearLogButton,&QPushButton::clicked,p_logModel,&LogModel::clear);
+	connect(lh,&LogHandler::recordsReady,this,[=](const QList<LogRecord> records){
+		QScrollBar *sb = ui->log->verticalScrollBar();
+		bool atEnd = sb->value() == sb->maximum();
+		p_logModel->appendRecords(records);
+		if(atEnd)
+			ui->log->scrollToBottom();
+
         if(ui->tabWidget->currentIndex() != ui->tabWidget->indexOf(ui->logTab))
 		{
-			d_logCount++;
+			d_logCount += records.size();
             ui->tabWidget->setTabText(ui->tabWidget->indexOf(ui->logTab),QString("Log (%1)").arg(d_logCount));
 		}
 	});
@@ -166,7 +238,13 @@ MainWindow::MainWindow(QWidget *parent) :
 	connect(lh,&LogHandler::iconUpdate,this,&MainWindow::setLogIcon);
 
 	acquisitionThread = new QThread(this);
+	acquisitionThread->setObjectName(QString("acquisitionThread"));
 	controlThread = new QThread(this);
+	controlThread->setObjectName(QString("controlThread"));
+	saveThread = new QThread(this);
+	saveThread->setObjectName(QString("saveThread"));
+	indexThread = new QThread(this);
+	indexThread->setObjectName(QString("indexThread"));
 
     p_hwm = new HardwareManager();
     connect(this,&MainWindow::scopeResolutionChanged,p_hwm,&HardwareManager::scopeResolutionChanged);
@@ -178,7 +256,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(p_hwm,&HardwareManager::attenUpdate,this,&MainWindow::attnUpdate);
     connect(p_hwm,&HardwareManager::taattenUpdate,this,&MainWindow::taattnUpdate);
     connect(p_hwm,&HardwareManager::attnTablePrepComplete,this,&MainWindow::attnTablePrepComplete);
-    connect(p_hwm,&HardwareManager::logMessage,lh,&LogHandler::logMessage);
+    connect(p_hwm,&HardwareManager::logMessage,lh,&LogHandler::logMessage,Qt::DirectConnection);
     connect(p_hwm,&HardwareManager::statusMessage,lh,&LogHandler::sendStatusMessage);
     connect(p_hwm,&HardwareManager::allHardwareConnected,this,&MainWindow::hardwareStatusChanged);
     connect(ui->ftmControlDoubleSpinBox,doubleVc,p_hwm,&HardwareManager::setFtmCavityFreqFromUI);
@@ -290,21 +368,34 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(controlThread,&QThread::started,p_hwm,&HardwareManager::initializeHardware);
     p_hwm->moveToThread(controlThread);
 
+	p_scanWriter = new ScanWriter();
+	connect(p_scanWriter,&ScanWriter::logMessage,lh,&LogHandler::logMessage,Qt::DirectConnection);
+	connect(saveThread,&QThread::started,p_scanWriter,&ScanWriter::recoverJournal);
+	p_scanWriter->moveToThread(saveThread);
+
 	sm = new ScanManager();
+	sm->setScanWriter(p_scanWriter);
+	connect(p_scanWriter,&ScanWriter::scanSaved,sm,&ScanManager::scanSaved);
 
-	connect(sm,&ScanManager::logMessage,lh,&LogHandler::logMessage);
+	connect(sm,&ScanManager::logMessage,lh,&LogHandler::logMessage,Qt::DirectConnection);
 	connect(sm,&ScanManager::statusMessage,lh,&LogHandler::sendStatusMessage);
 	connect(sm,&ScanManager::peakUpFid,ui->peakUpPlot,&FtPlot::newFid);
 	connect(sm,&ScanManager::scanFid,ui->acqFtPlot,&FtPlot::newFid);
+	//the acquisition FT is published in the live feed from the FT thread
+	if(ConfigService::instance().snapshot().value(QString("liveFeedEnabled"),true).toBool())
+		QMetaObject::invokeMethod(ui->acqFtPlot->worker(),"setLiveFeed",Q_ARG(bool,true));
 	connect(sm,&ScanManager::initializationComplete,ui->scanSpinBox,&QAbstractSpinBox::stepUp);
     connect(sm,&ScanManager::scanShotAcquired,this,&MainWindow::updateScanProgressBar);
 	connect(sm,&ScanManager::fatalSaveError,ui->scanSpinBox,&QAbstractSpinBox::stepDown);
+	connect(sm,&ScanManager::pausedAfterSaveErrors,this,&MainWindow::pauseAcq);
 	connect(ui->actionPause,&QAction::triggered,sm,&ScanManager::pause);
 	connect(ui->actionResume,&QAction::triggered,sm,&ScanManager::resume);
 	connect(ui->actionAbort,&QAction::triggered,sm,&ScanManager::abortScan);
 	connect(ui->rollingAvgsSpinBox,intVc,sm,&ScanManager::setPeakUpAvgs);
+	connect(&ConfigService::instance(),&ConfigService::configChanged,sm,&ScanManager::configChanged);
 	connect(ui->resetRollingAvgsButton,&QAbstractButton::clicked,sm,&ScanManager::resetPeakUpAvgs);
     connect(p_hwm,&HardwareManager::scopeWaveAcquired,sm,&ScanManager::fidReceived);
+    connect(p_hwm,&HardwareManager::triggersDetected,sm,&ScanManager::triggersReceived);
     connect(sm,&ScanManager::initializeHardwareForScan,p_hwm,&HardwareManager::prepareForScan);
     connect(p_hwm,&HardwareManager::scanInitialized,sm,&ScanManager::startScan);
     connect(p_hwm,&HardwareManager::probeFreqUpdate,sm,&ScanManager::setCurrentProbeFreq);
@@ -316,9 +407,20 @@ MainWindow::MainWindow(QWidget *parent) :
 
 	connect(ui->actionStart_Single,&QAction::triggered,this,&MainWindow::singleScanCallback);
 	connect(ui->actionStart_Batch,&QAction::triggered,this,&MainWindow::batchScanCallback);
+    connect(ui->actionResume_Batch,&QAction::triggered,this,&MainWindow::resumeBatchCallback);
 
 	batchThread = new QThread();
+	batchThread->setObjectName(QString("batchThread"));
+
+	//telemetry is saved on the save thread, so that the device threads that record it are never blocked by disk access
+	QTimer *telemetryTimer = new QTimer;
+	telemetryTimer->setInterval(600000);
+	telemetryTimer->moveToThread(saveThread);
+	connect(saveThread,&QThread::started,telemetryTimer,static_cast<void (QTimer::*)()>(&QTimer::start));
+	connect(saveThread,&QThread::finished,telemetryTimer,&QObject::deleteLater);
+	connect(telemetryTimer,&QTimer::timeout,[](){ TelemetryStore::instance().save(); });
 
+	saveThread->start();
 	acquisitionThread->start();
 	controlThread->start();
 
@@ -335,7 +437,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
 	connect(ui->peakUpPlot,&FtPlot::newFtMax,ui->peakUpMaxValueBox,&QDoubleSpinBox::setValue);
 
-	ui->scanSpinBox->setValue(s.value(QString("scanNum"),0).toInt());
+	ui->scanSpinBox->setValue(NumberAllocator::instance().lastScanNumber());
 
 	ui->batchProgressBar->setValue(0);
 	ui->shotsProgressBar->setValue(0);
@@ -355,22 +457,38 @@ MainWindow::~MainWindow()
 	acquisitionThread->wait();
 	delete sm;
 
+	//let the writer finish any queued scans before stopping its thread
+	QMetaObject::invokeMethod(p_scanWriter,"flush",Qt::BlockingQueuedConnection);
+	saveThread->quit();
+	saveThread->wait();
+	delete p_scanWriter;
+
 	controlThread->quit();
 	controlThread->wait();
     delete p_hwm;
 
+	//a rebuild of the scan index can take a long time; the partial result is discarded
+	ScanIndex::instance().cancelRebuild();
+	indexThread->quit();
+	indexThread->wait();
+
+	ScanRepository::instance().shutdown();
+
+	//every thread that logs messages has stopped; the remaining messages are written now
+	delete lh;
+
 	delete ui;
 
 }
 
-void MainWindow::updateScanProgressBar()
+void MainWindow::updateScanProgressBar(int n)
 {
-	ui->shotsProgressBar->setValue(ui->shotsProgressBar->value()+1);
+	ui->shotsProgressBar->setValue(ui->shotsProgressBar->value()+n);
 }
 
-void MainWindow::updateBatchProgressBar()
+void MainWindow::updateBatchProgressBar(int n)
 {
-    ui->batchProgressBar->setValue(ui->batchProgressBar->value()+1);
+    ui->batchProgressBar->setValue(ui->batchProgressBar->value()+n);
 }
 
 void MainWindow::updateUiConfig()
@@ -379,6 +497,7 @@ void MainWindow::updateUiConfig()
 	{
 	   ui->actionStart_Single->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
 	   ui->actionStart_Batch->setDisabled(d_uiState & (Acquiring|Tuning)  || d_uiState & Asleep);
+	   ui->actionResume_Batch->setDisabled(d_uiState & (Acquiring|Tuning)  || d_uiState & Asleep);
 	   ui->actionPause->setEnabled((d_uiState & Acquiring) && !(d_uiState & Paused) && !(d_uiState & Asleep));
 	   ui->actionResume->setEnabled((d_uiState & Acquiring) && (d_uiState & Paused) && !(d_uiState & Asleep));
 	   ui->actionAbort->setEnabled(d_uiState & Acquiring && !(d_uiState & Asleep));
@@ -396,12 +515,15 @@ void MainWindow::updateUiConfig()
 	   ui->gasControlGroup->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
 	   ui->pulseConfigWidget->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
 	   ui->menuResolution->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
+	   ui->menuScopeAveraging->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
+	   ui->menuScopeFrames->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
 	   ui->menuMotor_Driver->setDisabled(d_uiState & (Acquiring|Tuning) || d_uiState & Asleep);
 	}
 	else
 	{
 		ui->actionStart_Single->setEnabled(false);
         ui->actionStart_Batch->setEnabled(false);
+        ui->actionResume_Batch->setEnabled(false);
 		ui->actionPause->setEnabled(false);
 		ui->actionResume->setEnabled(false);
 		ui->actionAbort->setEnabled(false);
@@ -419,6 +541,8 @@ void MainWindow::updateUiConfig()
 		ui->gasControlGroup->setEnabled(false);
 		ui->pulseConfigWidget->setEnabled(false);
         ui->menuResolution->setEnabled(false);
+        ui->menuScopeAveraging->setEnabled(false);
+        ui->menuScopeFrames->setEnabled(false);
         ui->menuMotor_Driver->setEnabled(false);
 	}
 }
@@ -431,7 +555,7 @@ void MainWindow::saveLogCallback()
         QFile f(fileName);
         if(f.open(QIODevice::WriteOnly) && f.isWritable())
         {
-            f.write(ui->log->document()->toPlainText().toLatin1());
+            f.write(p_logModel->toPlainText().toLatin1());
             f.close();
             statusLabel->setText(QString("Log written to %1.").arg(fileName));
         }
@@ -483,6 +607,9 @@ void MainWindow::resumeAcq()
 
 void MainWindow::synthSettingsChanged()
 {
+    //the synthesizers write their new ranges to the settings file
+    ConfigService::instance().reload();
+
     QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
     s.beginGroup(QString("ftmSynth"));
     s.beginGroup(s.value(QString("subKey"),QString("virtual")).toString());
@@ -754,6 +881,58 @@ void MainWindow::batchScanCallback()
 	aw->deleteLater();
 }
 
+void MainWindow::resumeBatchCallback()
+{
+    if(batchThread->isRunning())
+        return;
+
+    QList<BatchCheckpoint::Info> list = BatchCheckpoint::available();
+    if(list.isEmpty())
+    {
+        QMessageBox::information(this,QString("Resume Batch"),QString("There are no interrupted batches that can be resumed."),QMessageBox::Ok);
+        return;
+    }
+
+    QStringList items;
+    for(int i=0; i<list.size(); i++)
+        items.append(QString("%1 (%2 scans, last scan %3)").arg(list.at(i).title).arg(list.at(i).scans)
+                     .arg(list.at(i).lastScan.toString(QString("yyyy-MM-dd hh:mm"))));
+
+    bool ok = false;
+    QString item = QInputDialog::getItem(this,QString("Resume Batch"),QString("Interrupted batch:"),items,0,false,&ok);
+    if(!ok)
+        return;
+
+    BatchCheckpoint::Info info = list.at(items.indexOf(item));
+
+    QMessageBox mb(QMessageBox::Question,QString("Resume Batch"),
+                   QString("%1 was interrupted after %2 scans. The saved scans will be processed again without being acquired, and acquisition will continue from the next scan.\n\nResume %1, or discard it so that it can no longer be resumed?")
+                   .arg(info.title).arg(info.scans),QMessageBox::Cancel,this);
+    QPushButton *resume = mb.addButton(QString("Resume"),QMessageBox::AcceptRole);
+    QPushButton *discard = mb.addButton(QString("Discard"),QMessageBox::DestructiveRole);
+    mb.setDefaultButton(resume);
+    mb.exec();
+
+    if(mb.clickedButton() == discard)
+    {
+        BatchCheckpoint::discard(info.type,info.number);
+        return;
+    }
+
+    if(mb.clickedButton() != resume)
+        return;
+
+    QString error;
+    BatchManager *bm = BatchCheckpoint::restore(info.type,info.number,error);
+    if(bm == nullptr)
+    {
+        QMessageBox::warning(this,QString("Resume Batch"),QString("Could not resume %1. %2").arg(info.title).arg(error),QMessageBox::Ok);
+        return;
+    }
+
+    startBatchManager(bm);
+}
+
 void MainWindow::sleep(bool b)
 {
 	if(b)
@@ -825,6 +1004,7 @@ void MainWindow::launchCommunicationDialog()
     connect(p_hwm,&HardwareManager::testComplete,&d,&CommunicationDialog::testComplete);
 
 	d.exec();
+	ConfigService::instance().reload();
 }
 
 void MainWindow::launchFtSettings()
@@ -857,6 +1037,7 @@ void MainWindow::launchIOBoardSettings()
     connect(p_hwm,&HardwareManager::testComplete,&d,&IOBoardConfigDialog::testComplete);
 
     d.exec();
+    ConfigService::instance().reload();
 }
 
 void MainWindow::resolutionChanged(QtFTM::ScopeResolution res)
@@ -869,6 +1050,31 @@ void MainWindow::resolutionChanged(QtFTM::ScopeResolution res)
 
 }
 
+void MainWindow::scopeAveragesChanged(int n)
+{
+    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+    QString subKey = s.value(QString("scope/subKey"),QString("virtual")).toString();
+    s.setValue(QString("scope/%1/averages").arg(subKey),n);
+    if(n > 1)
+        s.setValue(QString("scope/%1/frames").arg(subKey),1);
+    s.sync();
+
+    //the scope applies averaging settings along with the resolution
+    emit scopeResolutionChanged();
+}
+
+void MainWindow::scopeFramesChanged(int n)
+{
+    QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+    QString subKey = s.value(QString("scope/subKey"),QString("virtual")).toString();
+    s.setValue(QString("scope/%1/frames").arg(subKey),n);
+    if(n > 1)
+        s.setValue(QString("scope/%1/averages").arg(subKey),1);
+    s.sync();
+
+    emit scopeResolutionChanged();
+}
+
 void MainWindow::tuningComplete()
 {
     if(d_uiState & Tuning)
@@ -1282,7 +1488,11 @@ void MainWindow::startBatchManager(BatchManager *bm)
 		else if(bm->type() == QtFTM::DrScan)
 			plot = new DrPlot(bm->number());
 		else if(bm->type() == QtFTM::Survey)
-			plot = new SurveyPlot(bm->number());
+		{
+			SurveyPlot *sp = new SurveyPlot(bm->number());
+			sp->setSpectrumStore(static_cast<BatchSurvey*>(bm)->spectrumStore());
+			plot = sp;
+		}
         else if(bm->type() == QtFTM::DrCorrelation || bm->type() == QtFTM::Amdor)
             plot = new DrCorrPlot(bm->number(),bm->type());
         else if(bm->type() == QtFTM::Categorize)
@@ -1308,14 +1518,14 @@ void MainWindow::startBatchManager(BatchManager *bm)
 	connect(bm,&QObject::destroyed,batchThread,&QThread::quit);
     connect(bm,&BatchManager::beginScan,this,&MainWindow::scanStarting);
     connect(bm,&BatchManager::beginScan,sm,&ScanManager::prepareScan);
-	connect(bm,&BatchManager::logMessage,lh,&LogHandler::logMessage);
+	connect(bm,&BatchManager::logMessage,lh,&LogHandler::logMessage,Qt::DirectConnection);
 
 	if(bm->type() == QtFTM::Attenuation)
 	{
 		connect(bm,&BatchManager::batchComplete,this,&MainWindow::attnTableBatchComplete);
 		connect(sm,&ScanManager::dummyComplete,bm,&BatchManager::scanComplete);
-        connect(static_cast<BatchAttenuation*>(bm),&BatchAttenuation::elementComplete,this,&MainWindow::updateScanProgressBar);
-        connect(static_cast<BatchAttenuation*>(bm),&BatchAttenuation::elementComplete,this,&MainWindow::updateBatchProgressBar);
+        connect(static_cast<BatchAttenuation*>(bm),&BatchAttenuation::elementComplete,this,[=](){ updateScanProgressBar(); });
+        connect(static_cast<BatchAttenuation*>(bm),&BatchAttenuation::elementComplete,this,[=](){ updateBatchProgressBar(); });
 		connect(ui->actionAbort,&QAction::triggered,static_cast<BatchAttenuation*>(bm),&BatchAttenuation::abort);
 
 		ui->shotsProgressBar->setRange(0,0);
@@ -1324,7 +1534,7 @@ void MainWindow::startBatchManager(BatchManager *bm)
 	else
 	{
         if(bm->type() == QtFTM::Categorize || bm->type() == QtFTM::Amdor)
-            connect(bm,&BatchManager::advanced,this,&MainWindow::updateBatchProgressBar,Qt::UniqueConnection);
+            connect(bm,&BatchManager::advanced,this,[=](){ updateBatchProgressBar(); });
         else
             connect(sm,&ScanManager::scanShotAcquired,this,&MainWindow::updateBatchProgressBar,Qt::UniqueConnection);
 		connect(bm,&BatchManager::batchComplete,this,&MainWindow::batchComplete);
@@ -1384,6 +1594,8 @@ void MainWindow::launchSettingsDialog(SettingsWidget *w)
 	SettingsDialog d(w,this);
 
 	d.exec();
+	//some widgets write settings before they are applied (e.g., synthesizer band changes)
+	ConfigService::instance().reload();
 }
 
 QString MainWindow::guessBufferString()
@@ -1425,3 +1637,24 @@ void MainWindow::closeEvent(QCloseEvent *ev)
 	emit closing();
 	ev->accept();
 }
+
+void MainWindow::rebuildScanIndex()
+{
+    if(indexThread->isRunning())
+        return;
+
+    //the scan files are read on a separate thread; acquisition can continue in the meantime
+    QAction *a = findChild<QAction*>(QString("actionRebuild_Scan_Index"));
+    if(a != nullptr)
+        a->setEnabled(false);
+
+    ScanIndexBuilder *b = new ScanIndexBuilder();
+    connect(b,&ScanIndexBuilder::logMessage,lh,&LogHandler::logMessage,Qt::DirectConnection);
+    connect(indexThread,&QThread::started,b,&ScanIndexBuilder::run);
+    connect(b,&ScanIndexBuilder::finished,indexThread,&QThread::quit);
+    connect(indexThread,&QThread::finished,b,&QObject::deleteLater);
+    if(a != nullptr)
+        connect(b,&QObject::destroyed,a,[a](){ a->setEnabled(true); });
+    b->moveToThread(indexThread);
+    indexThread->start();
+}
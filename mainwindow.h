@@ -9,7 +9,9 @@
 #include <QProgressBar>
 #include "hardwaremanager.h"
 #include "loghandler.h"
+#include "logmodel.h"
 #include "scanmanager.h"
+#include "scanwriter.h"
 #include "batchmanager.h"
 #include "settingswidget.h"
 #include "led.h"
@@ -54,8 +56,8 @@ public:
 	Q_DECLARE_FLAGS(State,StateFlag)
 
 public slots:
-	void updateScanProgressBar();
-    void updateBatchProgressBar();
+	void updateScanProgressBar(int n = 1);
+    void updateBatchProgressBar(int n = 1);
 	void updateUiConfig();
     void saveLogCallback();
     void logOnErrorCallback(bool ch);
@@ -82,6 +84,7 @@ public slots:
 
 	void singleScanCallback();
 	void batchScanCallback();
+    void resumeBatchCallback();
 	void sleep(bool b);
     void delayedSleep();
 	void hardwareStatusChanged(bool success);
@@ -90,6 +93,8 @@ public slots:
 	void launchDrSettings();
     void launchIOBoardSettings();
     void resolutionChanged(QtFTM::ScopeResolution res);
+    void scopeAveragesChanged(int n);
+    void scopeFramesChanged(int n);
     void tuningComplete();
     void tuneCavityCallback();
     void calibrateCavityCallback();
@@ -107,6 +112,7 @@ public slots:
     void updatePulseLeds(const PulseGenConfig cc);
     void updatePulseLed(int index, QtFTM::PulseSetting s, QVariant val);
     void dcVoltageUpdate(int v);
+    void rebuildScanIndex();
 
 signals:
     void changeGasName(int, QString);
@@ -119,12 +125,16 @@ private:
 	QThread *acquisitionThread;
 	QThread *controlThread;
 	QThread *batchThread;
+	QThread *saveThread;
+	QThread *indexThread;
 	QLabel *statusLabel;
 	QProgressBar *mirrorProgress;
 
 	ScanManager *sm;
+	ScanWriter *p_scanWriter;
     HardwareManager *p_hwm;
 	LogHandler *lh;
+	LogModel *p_logModel;
     AmdorWidget *p_amdorWidget;
 
 	QList<QPair<QLabel*,Led*>> d_ledList;
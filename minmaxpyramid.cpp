@@ -0,0 +1,209 @@
+#include "minmaxpyramid.h"
+
+MinMaxPyramid::MinMaxPyramid() : d_size(0), d_monotonic(true), d_ascending(true)
+{
+}
+
+void MinMaxPyramid::setData(const QVector<QPointF> d)
+{
+	int old = d_size;
+	if(p_store.isNull() && d.constData() == d_data.constData() && d.size() == old)
+		return;
+
+	//batch plots resend the whole curve with new points at the end
+	bool extends = p_store.isNull() && old > 0 && d.size() >= old && d.first() == d_data.first() && d.at(old-1) == d_data.at(old-1);
+	if(!extends)
+	{
+		clear();
+		old = 0;
+	}
+
+	d_data = d;
+	grow(old,d_data.size());
+}
+
+void MinMaxPyramid::setStore(QSharedPointer<SpectrumStore> s)
+{
+	//a store only grows, so only the new points need to be added
+	int old = d_size;
+	if(s != p_store)
+	{
+		clear();
+		old = 0;
+		p_store = s;
+	}
+
+	if(!p_store.isNull())
+		grow(old,p_store->size());
+}
+
+void MinMaxPyramid::clear()
+{
+	d_data.clear();
+	p_store.clear();
+	d_levels.clear();
+	d_size = 0;
+	d_monotonic = true;
+	d_ascending = true;
+}
+
+QPointF MinMaxPyramid::point(int i) const
+{
+	if(p_store.isNull())
+		return d_data.at(i);
+
+	return p_store->at(i);
+}
+
+QVector<QPointF> MinMaxPyramid::points(int first, int count) const
+{
+	if(p_store.isNull())
+		return d_data.mid(first,count);
+
+	return p_store->read(first,count);
+}
+
+MinMaxPyramid::Range MinMaxPyramid::range(int first, int last) const
+{
+	Range out;
+	first = qMax(first,0);
+	last = qMin(last,d_size);
+	if(first >= last)
+		return out;
+
+	out.count = last - first;
+	out.min = point(first).y();
+	out.max = out.min;
+
+	//at each level, the elements before the first whole block and after the last whole block are merged individually;
+	//the whole blocks in between are covered by the next level
+	int lo = first, hi = last, level = 0;
+	while(lo < hi)
+	{
+		if(level == d_levels.size())
+		{
+			for(int i=lo; i<hi; i++)
+			{
+				Block b = block(level,i);
+				out.min = qMin(out.min,b.min);
+				out.max = qMax(out.max,b.max);
+			}
+			break;
+		}
+
+		while(lo < hi && (lo & (blockSize-1)))
+		{
+			Block b = block(level,lo++);
+			out.min = qMin(out.min,b.min);
+			out.max = qMax(out.max,b.max);
+		}
+		while(lo < hi && (hi & (blockSize-1)))
+		{
+			Block b = block(level,--hi);
+			out.min = qMin(out.min,b.min);
+			out.max = qMax(out.max,b.max);
+		}
+
+		lo >>= blockShift;
+		hi >>= blockShift;
+		level++;
+	}
+
+	return out;
+}
+
+int MinMaxPyramid::countBefore(double x) const
+{
+	int lo = 0, hi = d_size;
+	while(lo < hi)
+	{
+		int mid = lo + (hi-lo)/2;
+		double v = point(mid).x();
+		if(d_ascending ? v <= x : v >= x)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+void MinMaxPyramid::grow(int old, int size)
+{
+	d_size = size;
+	if(d_size == 0 || size == old)
+		return;
+
+	//if the direction changes (e.g., the first points all had the same x value), every point has to be checked again
+	bool ascending = point(d_size-1).x() >= point(0).x();
+	if(ascending != d_ascending || old == 0)
+	{
+		old = 0;
+		d_monotonic = true;
+		d_levels.clear();
+	}
+	d_ascending = ascending;
+
+	//the new points (and the block they begin in) are read once, which matters when they come from a store
+	int start = (old >> blockShift) << blockShift;
+	QVector<QPointF> p = points(start,d_size-start);
+	for(int i=qMax(old-start,1); i<p.size() && d_monotonic; i++)
+	{
+		if(d_ascending ? p.at(i).x() < p.at(i-1).x() : p.at(i).x() > p.at(i-1).x())
+			d_monotonic = false;
+	}
+
+	update(start,p);
+}
+
+void MinMaxPyramid::update(int start, const QVector<QPointF> &p)
+{
+	//each level holds one block for every blockSize elements of the level below, until a level has no more than blockSize elements
+	int count = d_size;
+	int changed = start;
+	int level = 1;
+	while(count > blockSize)
+	{
+		int blocks = (count + blockSize - 1) >> blockShift;
+		if(d_levels.size() < level)
+			d_levels.append(QVector<Block>());
+
+		QVector<Block> &l = d_levels[level-1];
+		l.resize(blocks);
+
+		int firstBlock = changed >> blockShift;
+		for(int j=firstBlock; j<blocks; j++)
+		{
+			int first = j << blockShift;
+			int end = qMin(first + blockSize,count);
+			Block b;
+			b.min = level == 1 ? p.at(first-start).y() : d_levels.at(level-2).at(first).min;
+			b.max = level == 1 ? b.min : d_levels.at(level-2).at(first).max;
+			for(int i=first+1; i<end; i++)
+			{
+				double mn = level == 1 ? p.at(i-start).y() : d_levels.at(level-2).at(i).min;
+				double mx = level == 1 ? mn : d_levels.at(level-2).at(i).max;
+				b.min = qMin(b.min,mn);
+				b.max = qMax(b.max,mx);
+			}
+			l[j] = b;
+		}
+
+		changed = firstBlock;
+		count = blocks;
+		level++;
+	}
+}
+
+MinMaxPyramid::Block MinMaxPyramid::block(int level, int index) const
+{
+	if(level == 0)
+	{
+		Block b;
+		b.min = point(index).y();
+		b.max = b.min;
+		return b;
+	}
+
+	return d_levels.at(level-1).at(index);
+}
@@ -0,0 +1,85 @@
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include <QVector>
+#include <QPointF>
+#include <QList>
+#include <QSharedPointer>
+
+#include "spectrumstore.h"
+
+/*!
+ * \brief Multi-resolution minimum/maximum index for a curve whose x values are sorted
+ *
+ * Level 0 is the curve itself. Each higher level stores the minimum and maximum y value of consecutive blocks of blockSize elements of the level below it, so a query over any range of points visits at most a few blocks per level.
+ * Together with a binary search on x (countBefore()), this lets a plot compute the range of each pixel column in O(log N) time, no matter how many points the curve contains.
+ *
+ * Batch plots receive the whole curve every time a scan is added. setData() recognizes when the new curve extends the old one and only updates the blocks covering the new points.
+ * The points may instead be read from a SpectrumStore (setStore()), which only grows; the pyramid then does not keep a copy of them.
+ * x values may increase or decrease, but must be monotonic; if they are not, isMonotonic() returns false and the index should not be used.
+ */
+class MinMaxPyramid
+{
+public:
+	MinMaxPyramid();
+
+	struct Range {
+		int count;
+		double min;
+		double max;
+
+		Range() : count(0), min(0.0), max(0.0) {}
+	};
+
+	/*!
+	 * \brief Updates the index for a new version of the curve
+	 *
+	 * If the new curve begins with all the points of the old one, only the new points are added; otherwise, the index is rebuilt.
+	 *
+	 * \param d Curve data
+	 */
+	void setData(const QVector<QPointF> d);
+	/*!
+	 * \brief Indexes the points in a store, adding the points appended since the last call
+	 */
+	void setStore(QSharedPointer<SpectrumStore> s);
+	void clear();
+
+	int size() const { return d_size; }
+	QPointF point(int i) const;
+	QVector<QPointF> points(int first, int count) const;
+	bool isMonotonic() const { return d_monotonic; }
+	bool isAscending() const { return d_ascending; }
+
+	/*!
+	 * \brief Binary search for the number of points that come before x in storage order, including points equal to x
+	 * \return Index of the first point after x
+	 */
+	int countBefore(double x) const;
+	/*!
+	 * \brief Minimum and maximum y values of points first to last-1
+	 */
+	Range range(int first, int last) const;
+
+private:
+	static const int blockShift = 3;
+	static const int blockSize = 1 << blockShift;
+
+	struct Block {
+		double min;
+		double max;
+	};
+
+	QVector<QPointF> d_data;
+	QSharedPointer<SpectrumStore> p_store;
+	QList<QVector<Block>> d_levels;
+	int d_size;
+	bool d_monotonic;
+	bool d_ascending;
+
+	void grow(int old, int size);
+	void update(int start, const QVector<QPointF> &p);
+	Block block(int level, int index) const;
+};
+
+#endif // MINMAXPYRAMID_H
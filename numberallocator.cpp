@@ -0,0 +1,215 @@
+#include "numberallocator.h"
+
+#include <QSettings>
+#include <QApplication>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QStringList>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+NumberAllocator &NumberAllocator::instance()
+{
+	static NumberAllocator alloc;
+	return alloc;
+}
+
+NumberAllocator::NumberAllocator() : p_counters(nullptr)
+{
+	//the counter file lives next to the settings file, on the local disk
+	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+	QString dir = QFileInfo(s.fileName()).absolutePath();
+	d_counterFile.setFileName(QString("%1/counters.dat").arg(dir));
+	d_journal.setFileName(QString("%1/counters.journal").arg(dir));
+	d_lockFileName = QString("%1/counters.lock").arg(dir);
+
+	if(!d_counterFile.open(QIODevice::ReadWrite))
+		return;
+
+	bool init = d_counterFile.size() < static_cast<qint64>(sizeof(CounterFile));
+	if(init && !d_counterFile.resize(sizeof(CounterFile)))
+		return;
+
+	uchar *m = d_counterFile.map(0,sizeof(CounterFile));
+	if(m == nullptr)
+		return;
+
+	p_counters = reinterpret_cast<CounterFile*>(m);
+	if(init || memcmp(p_counters->magic,"QFTMNUM1",8) != 0)
+	{
+		//new or unreadable file. Counters are initialized from the settings file, and then from the journal
+		memset(p_counters,0,sizeof(CounterFile));
+		memcpy(p_counters->magic,"QFTMNUM1",8);
+		syncCounters();
+	}
+
+	if(d_journal.open(QIODevice::ReadWrite))
+		replayJournal();
+}
+
+NumberAllocator::~NumberAllocator()
+{
+	if(p_counters != nullptr)
+	{
+		syncCounters();
+		d_counterFile.unmap(reinterpret_cast<uchar*>(p_counters));
+		p_counters = nullptr;
+	}
+	d_counterFile.close();
+	d_journal.close();
+}
+
+int NumberAllocator::allocate(const QString key, int count)
+{
+	QMutexLocker l(&d_mutex);
+	if(count < 1)
+		return -1;
+
+	if(p_counters == nullptr || !d_journal.isOpen())
+	{
+		//fall back on the settings file
+		QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+		int first = static_cast<int>(legacyValue(key));
+		s.setValue(key,key == QString("scanNum") ? first+count-1 : first+count);
+		s.sync();
+		return first;
+	}
+
+	QLockFile lock(d_lockFileName);
+	if(!lock.tryLock(5000))
+		return -1;
+
+	CounterSlot *c = slot(key,true);
+	if(c == nullptr)
+		return -1;
+
+	//the journal record is synced before the counter is advanced
+	qint64 first = c->next;
+	d_journal.seek(d_journal.size());
+	if(d_journal.write(QString("%1 %2 %3\n").arg(key).arg(first).arg(count).toLatin1()) < 0 || !syncJournal())
+		return -1;
+
+	c->next = first + count;
+	if(!syncCounters())
+		return -1;
+
+	//once the counters are synced, old journal records are no longer needed
+	if(d_journal.size() > 65536)
+	{
+		d_journal.resize(0);
+		syncJournal();
+	}
+
+	return static_cast<int>(first);
+}
+
+int NumberAllocator::next(const QString key)
+{
+	QMutexLocker l(&d_mutex);
+	if(p_counters == nullptr)
+		return static_cast<int>(legacyValue(key));
+
+	CounterSlot *c = slot(key,false);
+	if(c == nullptr)
+		return static_cast<int>(legacyValue(key));
+
+	return static_cast<int>(c->next);
+}
+
+NumberAllocator::CounterSlot *NumberAllocator::slot(const QString key, bool create)
+{
+	QByteArray k = key.toLatin1().left(d_keyLength-1);
+	int n = qBound(0,static_cast<int>(p_counters->numSlots),d_maxSlots);
+	for(int i=0; i<n; i++)
+	{
+		if(strncmp(p_counters->slots[i].key,k.constData(),d_keyLength) == 0)
+			return &p_counters->slots[i];
+	}
+
+	if(!create || n >= d_maxSlots)
+		return nullptr;
+
+	CounterSlot *c = &p_counters->slots[n];
+	memset(c->key,0,d_keyLength);
+	memcpy(c->key,k.constData(),k.size());
+	c->next = legacyValue(key);
+	p_counters->numSlots = n+1;
+	return c;
+}
+
+qint64 NumberAllocator::legacyValue(const QString key) const
+{
+	//in the settings file, scanNum is the last scan number, while the batch keys are the next batch number
+	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+	if(key == QString("scanNum"))
+		return s.value(key,0).toLongLong()+1;
+
+	return s.value(key,1).toLongLong();
+}
+
+bool NumberAllocator::syncCounters()
+{
+#ifdef Q_OS_UNIX
+	return msync(p_counters,sizeof(CounterFile),MS_SYNC) == 0;
+#else
+	return true;
+#endif
+}
+
+bool NumberAllocator::syncJournal()
+{
+	if(!d_journal.flush())
+		return false;
+#ifdef Q_OS_UNIX
+	return fsync(d_journal.handle()) == 0;
+#else
+	return true;
+#endif
+}
+
+void NumberAllocator::replayJournal()
+{
+	QLockFile lock(d_lockFileName);
+	if(!lock.tryLock(5000))
+		return;
+
+	//every journal record is a reserved range; make sure the counters are past all of them
+	d_journal.seek(0);
+	while(!d_journal.atEnd())
+	{
+		QStringList l = QString::fromLatin1(d_journal.readLine()).trimmed().split(QChar(' '));
+		if(l.size() != 3)
+			continue;
+
+		bool ok1 = false, ok2 = false;
+		qint64 first = l.at(1).toLongLong(&ok1);
+		qint64 count = l.at(2).toLongLong(&ok2);
+		if(!ok1 || !ok2)
+			continue;
+
+		CounterSlot *c = slot(l.at(0),true);
+		if(c != nullptr && c->next < first + count)
+			c->next = first + count;
+	}
+
+	if(!syncCounters())
+		return;
+
+	//mirror the counters to the settings file once, so that it is a reasonable starting point if the counter file is ever lost
+	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+	int n = qBound(0,static_cast<int>(p_counters->numSlots),d_maxSlots);
+	for(int i=0; i<n; i++)
+	{
+		QString key = QString::fromLatin1(p_counters->slots[i].key,qstrnlen(p_counters->slots[i].key,d_keyLength));
+		qint64 next = p_counters->slots[i].next;
+		s.setValue(key,key == QString("scanNum") ? next-1 : next);
+	}
+	s.sync();
+
+	d_journal.resize(0);
+	syncJournal();
+}
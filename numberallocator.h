@@ -0,0 +1,81 @@
+#ifndef NUMBERALLOCATOR_H
+#define NUMBERALLOCATOR_H
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+
+/*!
+ * \brief Allocates scan and batch numbers
+ *
+ * Scan numbers (key "scanNum") and batch numbers (the BatchManager's d_numKey) used to be stored in the settings file, which was rewritten and synced each time a number was used.
+ * The allocator instead keeps one 64-bit counter per key in a small memory-mapped file next to the settings file.
+ * Each counter holds the next number that will be handed out.
+ *
+ * An allocation first appends the reserved range to a journal and syncs it, then advances the counter and syncs the mapped page.
+ * If the program stops between these steps, the journal is replayed the next time the allocator is created, so a number is never handed out twice.
+ * A lock file serializes allocations between processes.
+ *
+ * The first time a key is used, the counter is initialized from the value in the settings file so that numbering continues where it left off.
+ * If the counter file cannot be mapped, the allocator falls back to the settings file.
+ *
+ * The allocator is thread-safe, and is accessed through instance().
+ */
+class NumberAllocator
+{
+public:
+	static NumberAllocator &instance();
+	~NumberAllocator();
+
+	/*!
+	 * \brief Reserves a range of consecutive numbers
+	 * \param key Counter name (e.g., scanNum, surveyNum)
+	 * \param count Number of values to reserve
+	 * \return First number of the range, or -1 if the allocation failed
+	 */
+	int allocate(const QString key, int count = 1);
+	/*!
+	 * \brief The number that the next allocation will return
+	 * \param key Counter name
+	 * \return Next number
+	 */
+	int next(const QString key);
+	/*!
+	 * \brief Most recently allocated scan number (0 if none)
+	 */
+	int lastScanNumber() { return next(QString("scanNum"))-1; }
+
+private:
+	NumberAllocator();
+	Q_DISABLE_COPY(NumberAllocator)
+
+	static const int d_keyLength = 24;
+	static const int d_maxSlots = 31;
+
+	struct CounterSlot {
+		char key[d_keyLength];
+		qint64 next;
+	};
+
+	struct CounterFile {
+		char magic[8];
+		qint32 numSlots;
+		qint32 reserved;
+		CounterSlot slots[d_maxSlots];
+	};
+
+	QMutex d_mutex;
+	QFile d_counterFile;
+	QFile d_journal;
+	QString d_lockFileName;
+	CounterFile *p_counters;
+
+	CounterSlot *slot(const QString key, bool create);
+	qint64 legacyValue(const QString key) const;
+	bool syncCounters();
+	bool syncJournal();
+	void replayJournal();
+
+};
+
+#endif // NUMBERALLOCATOR_H
@@ -5,7 +5,7 @@
 #include <math.h>
 
 Oscilloscope::Oscilloscope(QObject *parent) :
-    HardwareObject(parent), d_acquisitionActive(false)
+    HardwareObject(parent), d_acquisitionActive(false), d_averages(1), d_frames(1), d_triggerCount(0)
 {
     d_key = QString("scope");
 }
@@ -13,3 +13,21 @@ Oscilloscope::Oscilloscope(QObject *parent) :
 Oscilloscope::~Oscilloscope()
 {
 }
+
+void Oscilloscope::trigger(int n)
+{
+    //without averaging or segmented capture, every trigger results in a curve query
+    if(triggersPerRecord() <= 1)
+    {
+        sendCurveQuery();
+        return;
+    }
+
+    if(!d_acquisitionActive)
+        return;
+
+    //keep calling sendCurveQuery while the record is being read, so that the implementation can detect a timeout
+    d_triggerCount += n;
+    if(d_triggerCount >= triggersPerRecord())
+        sendCurveQuery();
+}
@@ -6,6 +6,20 @@
 
 
 
+/*!
+ * \brief Base class for oscilloscopes
+ *
+ * Each time the IOBoard detects triggers, trigger() is called, which calls sendCurveQuery() once the scope has captured a full record.
+ * The implementation then emits fidAcquired() with the raw waveform.
+ *
+ * Implementations may support scope-side averaging, in which the oscilloscope averages d_averages triggers in hardware before a single record is transferred.
+ * The number of averages is stored in the settings file at scope/subKey/averages (1 = disabled), and is read when setResolution() is called.
+ * fidAcquired() reports the number of shots contained in the record so that the ScanManager can keep Scan::completedShots() correct.
+ *
+ * Implementations may also support segmented (FastFrame) capture, in which the oscilloscope stores d_frames consecutive triggers as separate frames, and all frames are retrieved by a single curve query.
+ * The number of frames is stored at scope/subKey/frames (1 = disabled). The frames are concatenated in the data block, and are unpacked by the ScanManager.
+ * Averaging and segmented capture are exclusive; if both are set, averaging takes precedence.
+ */
 class Oscilloscope : public HardwareObject
 {
 	Q_OBJECT
@@ -13,17 +27,35 @@ public:
 	explicit Oscilloscope(QObject *parent = nullptr);	
     virtual ~Oscilloscope();
 
+    int averages() const { return d_averages; }
+    int frames() const { return d_frames; }
+    int triggersPerRecord() const { return d_averages*d_frames; }
+
 signals:
-	void fidAcquired(const QByteArray d);
+    /*!
+     * \brief Emitted when a waveform has been transferred
+     * \param d Waveform prefix followed by the data block
+     * \param shots Number of triggers averaged into each frame of the record
+     * \param frames Number of frames concatenated in the data block
+     */
+	void fidAcquired(const QByteArray d, int shots = 1, int frames = 1);
     void statusMessage(const QString s);
 	
 public slots:
+    /*!
+     * \brief Called when the IOBoard detects triggers
+     * \param n Number of triggers since the last call
+     */
+    void trigger(int n = 1);
     virtual void setResolution() =0;
     virtual void sendCurveQuery() =0;
-    virtual void setActive(bool active = true) { d_acquisitionActive = active; }
+    virtual void setActive(bool active = true) { d_acquisitionActive = active; d_triggerCount = 0; }
 
 protected:
     bool d_acquisitionActive;
+    int d_averages; /*!< Number of triggers averaged by the scope per record. 1 = scope-side averaging disabled */
+    int d_frames; /*!< Number of triggers captured as separate frames per record. 1 = segmented capture disabled */
+    int d_triggerCount; /*!< Triggers received since the current record was started. Reset by the implementation once the record has been read */
 };
 
 #ifdef QTFTM_OSCILLOSCOPE
@@ -1,6 +1,8 @@
 #include "peaklistwidget.h"
 #include "ui_peaklistwidget.h"
 #include "fitresult.h"
+#include "scanrepository.h"
+#include "scanindex.h"
 #include <QMenu>
 #include <math.h>
 #include <QMessageBox>
@@ -72,7 +74,7 @@ void PeakListWidget::replaceScan(int num)
     if(num > 0)
     {
         removeScan(num);
-        addScan(num);
+        addScan(ScanRepository::instance().get(num));
     }
 }
 
@@ -223,6 +225,29 @@ void PeakListWidget::exportLinesToFile()
     QDesktopServices::openUrl(QUrl(QString("file://%1").arg(f.fileName())));
 }
 
+void PeakListWidget::addNearbyScans()
+{
+    QModelIndexList l = ui->peakListTable->selectionModel()->selectedRows();
+    if(l.isEmpty())
+        return;
+
+    int row = p_proxy->mapToSource(l.first()).row();
+    double freq = p_plModel->data(p_plModel->index(row,1),Qt::EditRole).toDouble();
+
+    //lines are only seen within about 0.5 MHz of the cavity frequency
+    QList<int> scans = ScanIndex::instance().find(ScanIndex::Query().cavityNear(freq,0.5));
+    for(int i=0; i<scans.size(); i++)
+    {
+        FitResult res(scans.at(i));
+
+        for(int j=0; j<res.freqAmpPairList().size(); j++)
+            p_plModel->addUniqueLine(scans.at(i),res.freqAmpPairList().at(j).first,res.freqAmpPairList().at(j).second);
+
+        for(int j=0; j<res.freqAmpSingleList().size(); j++)
+            p_plModel->addUniqueLine(scans.at(i),res.freqAmpSingleList().at(j).first,res.freqAmpSingleList().at(j).second);
+    }
+}
+
 void PeakListWidget::contextMenu(QPoint pos)
 {
     QModelIndexList l = ui->peakListTable->selectionModel()->selectedRows();
@@ -235,6 +260,11 @@ void PeakListWidget::contextMenu(QPoint pos)
 	   exportAct->setEnabled(false);
     connect(exportAct,&QAction::triggered,this,&PeakListWidget::exportLinesToFile);
 
+    QAction *nearAct = menu->addAction(QString("Add lines from nearby scans"));
+    if(l.isEmpty())
+        nearAct->setEnabled(false);
+    connect(nearAct,&QAction::triggered,this,&PeakListWidget::addNearbyScans);
+
     menu->addSeparator();
 
     QAction *rsAct = menu->addAction(QString("Remove selected"));
@@ -34,6 +34,7 @@ public slots:
     void selectScan(int num);
     void addUniqueLine(int scanNum, double freq, double amp, QString comment = QString(""));
     void exportLinesToFile();
+    void addNearbyScans();
 
     void contextMenu(QPoint pos);
 
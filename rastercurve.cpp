@@ -0,0 +1,137 @@
+#include "rastercurve.h"
+
+#include <QPainter>
+#include <QPaintDevice>
+#include <qwt6/qwt_plot.h>
+#include <qwt6/qwt_series_data.h>
+
+#include "configservice.h"
+
+RasterCurve::RasterCurve(const QString &title) : QObject(), QwtPlotCurve(title), p_renderer(nullptr),
+	d_threaded(false), d_generation(0), d_serial(0)
+{
+	setThreaded(ConfigService::instance().snapshot().value(QString("plotRenderThread"),true).toBool());
+}
+
+RasterCurve::~RasterCurve()
+{
+	//the shared thread keeps running; a render that is in progress finishes before the renderer is deleted
+	if(p_renderer != nullptr)
+		p_renderer->deleteLater();
+}
+
+void RasterCurve::setThreaded(bool on)
+{
+	d_threaded = on;
+	d_current = Layer();
+	d_requested = Layer();
+	d_image = QImage();
+}
+
+void RasterCurve::drawSeries(QPainter *painter, const QwtScaleMap &xMap, const QwtScaleMap &yMap, const QRectF &canvasRect, int from, int to) const
+{
+	if(!d_threaded || style() != QwtPlotCurve::Lines || symbol() != nullptr || brush().style() != Qt::NoBrush || !isCanvasPainter(painter,canvasRect))
+	{
+		QwtPlotCurve::drawSeries(painter,xMap,yMap,canvasRect,from,to);
+		return;
+	}
+
+	if(dataSize() == 0)
+		return;
+
+	QRect rect = canvasRect.toAlignedRect();
+	if(!d_current.matches(d_generation,xMap,yMap,rect) && !d_requested.matches(d_generation,xMap,yMap,rect))
+		requestImage(xMap,yMap,rect);
+
+	if(d_image.isNull())
+	{
+		QwtPlotCurve::drawSeries(painter,xMap,yMap,canvasRect,from,to);
+		return;
+	}
+
+	//place the corners of the last image where its data coordinates are on the current scales
+	QRect r = d_current.rect;
+	QPointF topLeft(xMap.transform(d_current.xMap.invTransform(r.left())),yMap.transform(d_current.yMap.invTransform(r.top())));
+	QPointF bottomRight(xMap.transform(d_current.xMap.invTransform(r.left() + r.width())),yMap.transform(d_current.yMap.invTransform(r.top() + r.height())));
+
+	painter->save();
+	painter->setClipRect(canvasRect);
+	painter->drawImage(QRectF(topLeft,bottomRight),d_image);
+	painter->restore();
+}
+
+void RasterCurve::itemChanged()
+{
+	//the next drawSeries() requests a new image; the old one is drawn until it is ready
+	d_generation++;
+	QwtPlotCurve::itemChanged();
+}
+
+void RasterCurve::imageReady(int serial, QImage image)
+{
+	if(serial != d_serial)
+		return;
+
+	d_current = d_requested;
+	d_image = image;
+
+	//only the canvas needs to be redrawn; the scales have not changed
+	if(plot() != nullptr)
+		QMetaObject::invokeMethod(plot()->canvas(),"replot",Qt::DirectConnection);
+}
+
+bool RasterCurve::isCanvasPainter(const QPainter *painter, const QRectF &canvasRect) const
+{
+	//printers, PDF files, and exported images are drawn directly
+	if(plot() == nullptr || painter->device() == nullptr)
+		return false;
+
+	int type = painter->device()->devType();
+	if(type != QInternal::Widget && type != QInternal::Pixmap && type != QInternal::Image)
+		return false;
+
+	return canvasRect.toAlignedRect().size() == plot()->canvas()->contentsRect().size();
+}
+
+void RasterCurve::requestImage(const QwtScaleMap &xMap, const QwtScaleMap &yMap, const QRect &rect) const
+{
+	CurveRenderer::Request r;
+	r.serial = ++d_serial;
+	r.xMap = xMap;
+	r.yMap = yMap;
+	r.rect = rect;
+	r.pen = pen();
+	r.antialias = testRenderHint(QwtPlotItem::RenderAntialiased);
+
+	//the samples are implicitly shared when they were set as a QVector; otherwise they are copied
+	const QwtArraySeriesData<QPointF> *d = dynamic_cast<const QwtArraySeriesData<QPointF>*>(data());
+	if(d != nullptr)
+		r.samples = d->samples();
+	else
+	{
+		r.samples.reserve(static_cast<int>(dataSize()));
+		for(size_t i=0; i<dataSize(); i++)
+			r.samples.append(sample(static_cast<int>(i)));
+	}
+
+	d_requested.generation = d_generation;
+	d_requested.xMap = xMap;
+	d_requested.yMap = yMap;
+	d_requested.rect = rect;
+
+	if(p_renderer == nullptr)
+	{
+		p_renderer = new CurveRenderer();
+		connect(p_renderer,&CurveRenderer::imageReady,this,&RasterCurve::imageReady);
+		p_renderer->moveToThread(CurveRenderer::sharedThread());
+	}
+
+	p_renderer->setLatest(r.serial);
+	QMetaObject::invokeMethod(p_renderer,"render",Q_ARG(CurveRenderer::Request,r));
+}
+
+bool RasterCurve::Layer::matches(int g, const QwtScaleMap &x, const QwtScaleMap &y, const QRect &r) const
+{
+	return g == generation && r == rect && x.s1() == xMap.s1() && x.s2() == xMap.s2() && x.p1() == xMap.p1() && x.p2() == xMap.p2()
+			&& y.s1() == yMap.s1() && y.s2() == yMap.s2() && y.p1() == yMap.p1() && y.p2() == yMap.p2();
+}
@@ -0,0 +1,63 @@
+#ifndef RASTERCURVE_H
+#define RASTERCURVE_H
+
+#include <QObject>
+#include <QImage>
+
+#include <qwt6/qwt_plot_curve.h>
+#include <qwt6/qwt_scale_map.h>
+
+#include "curverenderer.h"
+
+/*!
+ * \brief A QwtPlotCurve that is drawn on a worker thread
+ *
+ * Drawing a curve with many points on every replot keeps the GUI thread busy when FIDs arrive quickly.
+ * A RasterCurve instead sends its samples and the current scale maps to its CurveRenderer, and draws the resulting image when it is ready.
+ * The renderers of all curves share one thread (see CurveRenderer::sharedThread()), so the number of threads does not grow with the number of plots.
+ * Until then, the previous image is drawn, stretched to where its data range is on the current scales, so panning and zooming respond immediately.
+ * Other plot items (zones, markers, fit curves) are drawn normally on top of the image.
+ *
+ * The curve is drawn directly (as a QwtPlotCurve) if threaded rendering is disabled (setting plotRenderThread), when it is printed or exported, before the first image is ready, and if it has symbols, a brush, or a style other than Lines.
+ */
+class RasterCurve : public QObject, public QwtPlotCurve
+{
+	Q_OBJECT
+public:
+	explicit RasterCurve(const QString &title = QString());
+	virtual ~RasterCurve();
+
+	bool isThreaded() const { return d_threaded; }
+	void setThreaded(bool on);
+
+	virtual void drawSeries(QPainter *painter, const QwtScaleMap &xMap, const QwtScaleMap &yMap, const QRectF &canvasRect, int from, int to) const;
+	virtual void itemChanged();
+
+private slots:
+	void imageReady(int serial, QImage image);
+
+private:
+	struct Layer {
+		int generation;
+		QwtScaleMap xMap;
+		QwtScaleMap yMap;
+		QRect rect;
+
+		Layer() : generation(-1) {}
+		bool matches(int g, const QwtScaleMap &x, const QwtScaleMap &y, const QRect &r) const;
+	};
+
+	mutable CurveRenderer *p_renderer; /*!< Created when the first image is requested */
+	bool d_threaded;
+	int d_generation; /*!< Incremented when the samples or appearance change */
+
+	mutable int d_serial;
+	mutable Layer d_requested;
+	mutable Layer d_current;
+	mutable QImage d_image;
+
+	bool isCanvasPainter(const QPainter *painter, const QRectF &canvasRect) const;
+	void requestImage(const QwtScaleMap &xMap, const QwtScaleMap &yMap, const QRect &rect) const;
+};
+
+#endif // RASTERCURVE_H
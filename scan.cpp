@@ -1,11 +1,16 @@
 #include "scan.h"
 #include <QSharedData>
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
 #include <math.h>
 #include <QDir>
 #include <QDateTime>
 #include <QTextStream>
+#include <QSaveFile>
+
+#include "numberallocator.h"
+#include "fidcodec.h"
+#include "scanindex.h"
+#include "scanrepository.h"
 
 /*!
  \brief Data storage for Scan
@@ -18,7 +23,8 @@ public:
 	ScanData() : number(-1), ts(QDateTime::currentDateTime()), ftFreq(-1.0), ftAtten(-1), drFreq(-1.0), drPower(-100.0),
 	   targetShots(0), completedShots(0), fid(Fid()), initialized(false), saved(false), aborted(false), dummy(false), skipTune(false),
       postTuneShots(0), postTuneDelayShots(0), tuningVoltage(-1), cavityVoltage(-1), protectionDelayTime (-1),
-	  scopeDelayTime(-1), dipoleMoment(0.0), magnet(false), dcVoltage(0) {}
+	  scopeDelayTime(-1), dipoleMoment(0.0), magnet(false), dcVoltage(0), triggersSeen(-1), waveformsAcquired(-1),
+	  waveformsAveraged(-1), triggerSpan(0.0) {}
 	ScanData(const ScanData &other) :
 		QSharedData(other), number(other.number), ts(other.ts), ftFreq(other.ftFreq), ftAtten(other.ftAtten), drFreq(other.drFreq),
 	   drPower(other.drPower), flowConfig(other.flowConfig),
@@ -27,7 +33,8 @@ public:
        skipTune(other.skipTune), postTuneShots(other.postTuneShots), postTuneDelayShots(other.postTuneDelayShots),
        tuningVoltage(other.tuningVoltage), cavityVoltage(other.cavityVoltage),
         protectionDelayTime(other.protectionDelayTime), scopeDelayTime(other.scopeDelayTime), dipoleMoment(other.dipoleMoment),
-	   magnet(other.magnet), dcVoltage(other.dcVoltage) {}
+	   magnet(other.magnet), dcVoltage(other.dcVoltage), triggersSeen(other.triggersSeen), waveformsAcquired(other.waveformsAcquired),
+	   waveformsAveraged(other.waveformsAveraged), triggerSpan(other.triggerSpan) {}
 	~ScanData() {}
 
 	int number;
@@ -64,6 +71,11 @@ public:
 
     int dcVoltage;
 
+    int triggersSeen;
+    int waveformsAcquired;
+    int waveformsAveraged;
+    double triggerSpan;
+
 };
 
 Scan::Scan() : data(new ScanData)
@@ -89,7 +101,7 @@ Scan &Scan::operator=(const Scan &rhs)
 Scan Scan::settingsFromPrevious(int num)
 {
     Scan out;
-    Scan other(num);
+    Scan other = ScanRepository::instance().get(num);
 
     out.setAttenuation(other.attenuation());
     out.setDcVoltage(other.dcVoltage());
@@ -160,6 +172,34 @@ int Scan::dcVoltage() const
 	return data->dcVoltage;
 }
 
+int Scan::triggersSeen() const
+{
+	return data->triggersSeen;
+}
+
+int Scan::waveformsAcquired() const
+{
+	return data->waveformsAcquired;
+}
+
+int Scan::waveformsAveraged() const
+{
+	return data->waveformsAveraged;
+}
+
+double Scan::triggerSpan() const
+{
+	return data->triggerSpan;
+}
+
+double Scan::dutyCycle() const
+{
+	if(data->triggersSeen <= 0 || data->waveformsAveraged < 0)
+		return -1.0;
+
+	return (double)data->waveformsAveraged/(double)data->triggersSeen;
+}
+
 double Scan::drPower() const
 {
 	return data->drPower;
@@ -283,11 +323,13 @@ void Scan::setNumber(int n)
 	data->number = n;
 }
 
-void Scan::increment()
+void Scan::increment(int n)
 {
+    //a block of hardware-averaged shots is only counted if none of its shots fall in the post-tuning delay
     data->postTuneShots++;
     if(!tuneDelay())
-        data->completedShots++;
+        data->completedShots += n;
+    data->postTuneShots += n-1;
 }
 
 void Scan::setFid(const Fid f)
@@ -368,63 +410,111 @@ void Scan::initializationComplete()
 
 void Scan::save()
 {
+	//figure out scan number and write the file
+	if(allocateNumber() < 1 || !writeFile())
+	{
+		//this is bad... abort!
+		data->aborted = true;
+		return;
+	}
+
+	data->saved = true;
+}
+
+int Scan::allocateNumber()
+{
+	//the scan number is reserved immediately, so the file can be written later (see ScanWriter)
+	data->number = NumberAllocator::instance().allocate(QString("scanNum"));
+	return data->number;
+}
 
-	//figure out scan number and where to save data
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	data->number = s.value(QString("scanNum"),0).toInt()+1;
+void Scan::setSaved()
+{
+	data->saved = true;
+}
 
-	int dirMillionsNum = (int)floor((double) number()/1000000.0);
-	int dirThousandsNum = (int)floor((double) number()/1000.0);
+QString Scan::filePath(int num, bool createDir)
+{
+	int dirMillionsNum = (int)floor((double) num/1000000.0);
+	int dirThousandsNum = (int)floor((double) num/1000.0);
 
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
+	QString savePath = ConfigService::instance().snapshot().savePath();
 	QDir d(savePath + QString("/scans/%1/%2").arg(dirMillionsNum).arg(dirThousandsNum));
-	if(!d.exists())
+	if(createDir && !d.exists())
 	{
 		if(!d.mkpath(d.absolutePath()))
-		{
-			//this is bad... abort!
-			data->aborted=true;
-			return;
-		}
+			return QString();
 	}
 
-	//create output file
-	QFile f(QString("%1/%2.txt").arg(d.absolutePath()).arg(number()));
+	return QString("%1/%2.txt").arg(d.absolutePath()).arg(num);
+}
+
+bool Scan::writeFile() const
+{
+	QString fileName = filePath(number(),true);
+	if(fileName.isEmpty())
+		return false;
 
+	//QSaveFile writes to a temporary file, and only replaces the scan file once everything has been flushed to disk
+	QSaveFile f(fileName);
 	if(!f.open(QIODevice::WriteOnly))
-	{
-		//this is also bad... abort!
-		data->aborted = true;
-		return;
-	}
+		return false;
 
 	QTextStream t(&f);
 
 	//write header and column heading
 	t << scanHeader();
-	t << QString("\nfid%1").arg(number());
-	t.setRealNumberNotation(QTextStream::ScientificNotation);
-
-	//this controls how many digits are printed after decimal.
-	//in principle, an 8 bit digitizer requires only 3 digits (range = -127 to 128)
-	//For each ~factor of 10 averages, we need ~one more digit of precision
-	//This starts at 7 digits (sci notation; 6 places after decimal), and adds 1 for every factor of 10 shots.
-	int logFactor = 0;
-	if(completedShots() > 0)
-		logFactor = (int)floor(log10((double)completedShots()));
-	t.setRealNumberPrecision(6+logFactor);
-
-	//write data
-    for(int i=0; i<fid().size(); i++)
-		t << QString("\n") << fid().at(i);
+
+	//the raw sum is stored exactly, on a single line
+	if(ConfigService::instance().snapshot().compressFid() && fid().hasRawSum())
+	{
+		t << QString("\nfidz%1\n").arg(number());
+		t << QString::fromLatin1(FidCodec::encode(fid()).toBase64());
+	}
+	else
+	{
+		t << QString("\nfid%1").arg(number());
+		t.setRealNumberNotation(QTextStream::ScientificNotation);
+
+		//this controls how many digits are printed after decimal.
+		//in principle, an 8 bit digitizer requires only 3 digits (range = -127 to 128)
+		//For each ~factor of 10 averages, we need ~one more digit of precision
+		//This starts at 7 digits (sci notation; 6 places after decimal), and adds 1 for every factor of 10 shots.
+		int logFactor = 0;
+		if(completedShots() > 0)
+			logFactor = (int)floor(log10((double)completedShots()));
+		t.setRealNumberPrecision(6+logFactor);
+
+		//write data
+		for(int i=0; i<fid().size(); i++)
+			t << QString("\n") << fid().at(i);
+	}
 
 	t.flush();
-	f.close();
+	if(!f.commit())
+		return false;
 
-	//increment scan number
-	s.setValue(QString("scanNum"),data->number);
-    s.sync();
-	data->saved = true;
+	//keep the metadata index up to date, and drop any cached copy of an earlier version of this scan
+	ScanIndex::instance().add(*this);
+	ScanRepository::instance().invalidate(number());
+	return true;
+}
+
+Scan Scan::fromHeader(const QString header, const QVector<double> fidData, const QByteArray rawFid)
+{
+	Scan out;
+	QStringList lines = header.split(QChar('\n'),QString::SkipEmptyParts);
+	for(int i=0; i<lines.size(); i++)
+	{
+		if(lines.at(i).startsWith(QString("#")))
+			out.parseFileLine(lines.at(i));
+	}
+
+	if(rawFid.isEmpty() || !FidCodec::decode(rawFid,out.data->fid))
+		out.data->fid.setData(fidData);
+	out.data->initialized = true;
+	out.data->targetShots = out.completedShots();
+	return out;
 }
 
 void Scan::abortScan()
@@ -462,6 +552,14 @@ void Scan::setDcVoltage(int v)
 	data->dcVoltage = v;
 }
 
+void Scan::setTriggerStatistics(int seen, int acquired, int averaged, double span)
+{
+	data->triggersSeen = seen;
+	data->waveformsAcquired = acquired;
+	data->waveformsAveraged = averaged;
+	data->triggerSpan = span;
+}
+
 QString Scan::scanHeader() const
 {
 	QString out;
@@ -492,22 +590,32 @@ QString Scan::scanHeader() const
     t << QString("#Rep rate\t") << repRate() << QString("\tHz\n");
     t << data->flowConfig.headerString();
     t << data->pulseConfig.headerString();
+    if(triggersSeen() >= 0)
+    {
+        t << QString("#Triggers seen\t") << triggersSeen() << QString("\t\n");
+        t << QString("#Waveforms acquired\t") << waveformsAcquired() << QString("\t\n");
+        t << QString("#Waveforms averaged\t") << waveformsAveraged() << QString("\t\n");
+        t << QString("#Trigger span\t") << triggerSpan() << QString("\ts\n");
+        t << QString("#Duty cycle\t") << dutyCycle() << QString("\t\n");
+    }
 
 	t.flush();
 	return out;
 }
 
-void Scan::parseFile(int num)
+Scan Scan::readHeader(int num)
+{
+	Scan out;
+	out.parseFile(num,true);
+	return out;
+}
+
+void Scan::parseFile(int num, bool headerOnly)
 {
 	if(num<1)
 		return;
 
-	int dirMillionsNum = (int)floor((double) num/1000000.0);
-	int dirThousandsNum = (int)floor((double) num/1000.0);
-
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-	QString savePath = s.value(QString("savePath"),QString(".")).toString();
-	QFile f(savePath + QString("/scans/%1/%2/%3.txt").arg(dirMillionsNum).arg(dirThousandsNum).arg(num));
+	QFile f(filePath(num));
 
 	if(!f.exists())
 		return;
@@ -516,6 +624,7 @@ void Scan::parseFile(int num)
 		return;
 
 	QVector<double> fidData;
+	bool compressed = false;
 
 	while(!f.atEnd())
 	{
@@ -525,13 +634,29 @@ void Scan::parseFile(int num)
 		else if(line.startsWith(QString("#")))
 			parseFileLine(line);
 		else if(line.startsWith(QString("fid")))
+		{
+			compressed = line.startsWith(QString("fidz"));
 			break;
+		}
 	}
 
-	while(!f.atEnd())
-		fidData.append(QString(f.readLine()).toDouble());
+	if(headerOnly)
+		data->fid.setData(QVector<double>());
+	else if(compressed)
+	{
+		//the spacing and probe frequency have already been read from the header
+		QByteArray block = QByteArray::fromBase64(f.readLine().trimmed());
+		if(!FidCodec::decode(block,data->fid))
+			data->fid.setData(QVector<double>());
+	}
+	else
+	{
+		while(!f.atEnd())
+			fidData.append(QString(f.readLine()).toDouble());
+
+		data->fid.setData(fidData);
+	}
 
-	data->fid.setData(fidData);
 	data->saved = true;
 	data->initialized = true;
 	data->targetShots = completedShots();
@@ -585,6 +710,14 @@ void Scan::parseFileLine(QString s)
 		data->fid.setProbeFreq(val.toDouble());
 	else if(key.startsWith(QString("#FID spacing")))
 		data->fid.setSpacing(val.toDouble());
+    else if(key.startsWith(QString("#Triggers seen")))
+        data->triggersSeen = val.toInt();
+    else if(key.startsWith(QString("#Waveforms acquired")))
+        data->waveformsAcquired = val.toInt();
+    else if(key.startsWith(QString("#Waveforms averaged")))
+        data->waveformsAveraged = val.toInt();
+    else if(key.startsWith(QString("#Trigger span")))
+        data->triggerSpan = val.toDouble();
     else if(key.startsWith(QString("#Rep rate")))
         data->pulseConfig.setRepRate(val.toDouble());
 	else if(key.startsWith(QString("#Gas")))
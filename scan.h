@@ -9,6 +9,7 @@
 #include "fid.h"
 #include <QStringList>
 #include <QDateTime>
+#include <QByteArray>
 
 class ScanData;
 
@@ -27,8 +28,8 @@ class ScanData;
  At that point, the scan proceeds until the target number of shots is reached (isAcquisitionComplete()) or the scan is aborted (abortScan()).
  Upon completion, the save() function is called.
 
- When saved, the current scan number is read from persistent settings, and a data file with that number is generated and stored in /home/data/QtFtm/scans/x/y/z.txt, where x is millions, y is thousands, and z is the scan number.
- After saving, the scan number in persistent settings is incremented.
+ When saved, the scan number is reserved from the NumberAllocator, and a data file with that number is generated and stored in /home/data/QtFtm/scans/x/y/z.txt, where x is millions, y is thousands, and z is the scan number.
+ If the FID carries the sum of raw ADC codes and FID compression is enabled (setting compressFid), the data section of the file is a "fidz" line followed by the base64-encoded FidCodec block instead of one voltage per line.
  The constructor from a scan number attempts to parse the file located at that same location.
 */
 class Scan
@@ -45,6 +46,7 @@ public:
  \brief Load scan with specified number from disk
 
  If the file cannot be read or parsed, a default invalid scan is returned.
+ This always parses the file; use ScanRepository::get() to share scans that have already been loaded.
 
  \param num Scan number to load
 */
@@ -218,6 +220,27 @@ public:
 
     int dcVoltage() const;
 
+    /*!
+     * \brief Number of triggers detected by the IOBoard during the acquisition (-1 if not recorded)
+     */
+    int triggersSeen() const;
+    /*!
+     * \brief Number of shots contained in the waveforms received from the oscilloscope during the acquisition
+     */
+    int waveformsAcquired() const;
+    /*!
+     * \brief Number of shots that were averaged into the Fid
+     */
+    int waveformsAveraged() const;
+    /*!
+     * \brief Time between the first and last trigger batch of the acquisition, in seconds
+     */
+    double triggerSpan() const;
+    /*!
+     * \brief Fraction of triggers that were averaged into the Fid (-1 if not recorded)
+     */
+    double dutyCycle() const;
+
 	/*!
 	 \brief
 
@@ -225,10 +248,13 @@ public:
 	*/
 	void setNumber(int n);
 	/*!
-	 \brief
+	 \brief Adds shots to the scan. Shots acquired during the post-tuning delay are not counted.
+
+	 If n > 1, the shots are counted only if the first of them comes after the post-tuning delay.
 
+	 \param n Number of shots (greater than 1 when the oscilloscope averages in hardware)
 	*/
-	void increment();
+	void increment(int n = 1);
 	/*!
 	 \brief
 
@@ -318,10 +344,29 @@ public:
 	*/
 	void initializationComplete();
 	/*!
-	 \brief
+	 \brief Assigns the next scan number, and writes the scan file synchronously
 
 	*/
 	void save();
+	/*!
+	 \brief Reserves the next scan number without writing the file
+
+	 Used when the file is written later by the ScanWriter.
+
+	 \return int The scan number
+	*/
+	int allocateNumber();
+	/*!
+	 \brief Marks the scan as saved (i.e., handed off to the ScanWriter)
+
+	*/
+	void setSaved();
+	/*!
+	 \brief Writes the scan file for number(). The file is only replaced once it has been completely written and synced.
+
+	 \return bool True if successful
+	*/
+	bool writeFile() const;
 	/*!
 	 \brief
 
@@ -343,12 +388,41 @@ public:
 
     void setDcVoltage(int v);
 
+    void setTriggerStatistics(int seen, int acquired, int averaged, double span);
+
 	/*!
 	 \brief
 
 	 \return QString
 	*/
 	QString scanHeader() const;
+
+	/*!
+	 \brief Location of the file for a scan number
+
+	 \param num Scan number
+	 \param createDir If true, the directory is created if needed
+	 \return QString File name, or an empty string if the directory could not be created
+	*/
+	static QString filePath(int num, bool createDir = false);
+	/*!
+	 \brief Reconstructs a scan from its header (see scanHeader()) and FID data
+
+	 \param header Header text
+	 \param fidData FID points
+	 \param rawFid Compressed raw sum (see FidCodec). If valid, it is used instead of fidData
+	 \return Scan The scan
+	*/
+	static Scan fromHeader(const QString header, const QVector<double> fidData, const QByteArray rawFid = QByteArray());
+	/*!
+	 \brief Loads only the header of a scan file
+
+	 The FID is not read, so this is much faster than Scan(int) when only the settings are needed (e.g., when building the ScanIndex).
+
+	 \param num Scan number
+	 \return Scan The scan, with an empty FID. If the file could not be read, the scan number is -1
+	*/
+	static Scan readHeader(int num);
 	
 private:
 	QSharedDataPointer<ScanData> data; /*!< Implicitly shared data storage */
@@ -357,8 +431,9 @@ private:
 	 \brief
 
 	 \param num
+	 \param headerOnly If true, stop before the FID data
 	*/
-	void parseFile(int num);
+	void parseFile(int num, bool headerOnly = false);
 	/*!
 	 \brief
 
@@ -0,0 +1,592 @@
+#include "scanindex.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTextStream>
+#include <limits>
+#include <algorithm>
+#include <string.h>
+
+#include "scan.h"
+#include "configservice.h"
+
+namespace {
+
+//returns the part [lo,hi) of a sorted row list whose values lie in [min,max]
+template<typename T>
+void rangeOf(const QVector<int> &idx, const QVector<T> &col, T min, T max, int &lo, int &hi)
+{
+	lo = std::lower_bound(idx.constBegin(),idx.constEnd(),min,[&col](int row, T v){ return col.at(row) < v; }) - idx.constBegin();
+	hi = std::upper_bound(idx.constBegin(),idx.constEnd(),max,[&col](T v, int row){ return v < col.at(row); }) - idx.constBegin();
+	if(hi < lo)
+		hi = lo;
+}
+
+template<typename T>
+void insertSorted(QVector<int> &idx, const QVector<T> &col, int row)
+{
+	T v = col.at(row);
+	auto it = std::upper_bound(idx.begin(),idx.end(),v,[&col](T val, int r){ return val < col.at(r); });
+	idx.insert(it,row);
+}
+
+template<typename T>
+void sortRows(QVector<int> &idx, const QVector<T> &col)
+{
+	std::stable_sort(idx.begin(),idx.end(),[&col](int a, int b){ return col.at(a) < col.at(b); });
+}
+
+}
+
+ScanIndex::Query::Query() : ftMin(std::numeric_limits<double>::lowest()), ftMax(std::numeric_limits<double>::max()),
+	drMin(std::numeric_limits<double>::lowest()), drMax(std::numeric_limits<double>::max()),
+	attnMin(std::numeric_limits<int>::min()), attnMax(std::numeric_limits<int>::max())
+{
+}
+
+ScanIndex::Query &ScanIndex::Query::cavityNear(double center, double width)
+{
+	ftMin = center - width;
+	ftMax = center + width;
+	return *this;
+}
+
+ScanIndex::Query &ScanIndex::Query::drNear(double center, double width)
+{
+	drMin = center - width;
+	drMax = center + width;
+	return *this;
+}
+
+ScanIndex::Query &ScanIndex::Query::between(const QDateTime from, const QDateTime to)
+{
+	start = from;
+	end = to;
+	return *this;
+}
+
+
+
+int ScanIndex::Table::gasId(const QString name, bool *added)
+{
+	int id = gasNames.indexOf(name);
+	if(id < 0)
+	{
+		gasNames.append(name);
+		id = gasNames.size()-1;
+		if(added != nullptr)
+			*added = true;
+	}
+	return id;
+}
+
+void ScanIndex::Table::append(const ScanIndex::Row &r, bool *newGas)
+{
+	//the sorted lists are only kept up to date once they have been built with sortIndexes()
+	bool updateIndexes = sorted;
+	int row = size();
+	number.append(r.number);
+	time.append(r.time);
+	ftFreq.append(r.ftFreq);
+	drFreq.append(r.drFreq);
+	drPower.append(r.drPower);
+	attn.append(r.attn);
+	shots.append(r.shots);
+	gas.append(gasId(r.gas,newGas));
+	live.append(true);
+
+	int old = rowOf.value(r.number,-1);
+	rowOf.insert(r.number,row);
+	if(old >= 0)
+	{
+		live[old] = false;
+		if(updateIndexes)
+		{
+			byFt.removeOne(old);
+			byDr.removeOne(old);
+			byTime.removeOne(old);
+		}
+	}
+
+	if(updateIndexes)
+	{
+		insertSorted(byFt,ftFreq,row);
+		insertSorted(byDr,drFreq,row);
+		insertSorted(byTime,time,row);
+	}
+}
+
+void ScanIndex::Table::sortIndexes()
+{
+	QVector<int> rows;
+	rows.reserve(rowOf.size());
+	for(int i=0; i<size(); i++)
+	{
+		if(live.at(i))
+			rows.append(i);
+	}
+
+	byFt = rows;
+	sortRows(byFt,ftFreq);
+	byDr = rows;
+	sortRows(byDr,drFreq);
+	byTime = rows;
+	sortRows(byTime,time);
+	sorted = true;
+}
+
+
+
+ScanIndex &ScanIndex::instance()
+{
+	static ScanIndex index;
+	return index;
+}
+
+ScanIndex::ScanIndex() : d_loaded(false), d_rebuilding(false)
+{
+	d_dir = ConfigService::instance().snapshot().savePath() + QString("/scans/index");
+}
+
+ScanIndex::~ScanIndex()
+{
+	for(int i=0; i<NumColumns; i++)
+		d_files[i].close();
+}
+
+void ScanIndex::add(const Scan &s)
+{
+	if(s.number() < 1)
+		return;
+
+	Row r = rowFromScan(s);
+
+	QWriteLocker l(&d_lock);
+	if(!d_loaded)
+		load();
+
+	if(d_rebuilding)
+		d_addedDuringRebuild.append(r);
+
+	bool newGas = false;
+	d_table.append(r,&newGas);
+	appendRow(d_table.size()-1,newGas);
+}
+
+QList<int> ScanIndex::find(const ScanIndex::Query &q)
+{
+	d_lock.lockForRead();
+	if(!d_loaded)
+	{
+		d_lock.unlock();
+		d_lock.lockForWrite();
+		if(!d_loaded)
+			load();
+		d_lock.unlock();
+		d_lock.lockForRead();
+	}
+
+	const Table &t = d_table;
+	qint64 tMin = q.start.isValid() ? q.start.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+	qint64 tMax = q.end.isValid() ? q.end.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+
+	//narrow the search with the most selective sorted list
+	const QVector<int> *rows = &t.byFt;
+	int lo = 0, hi = t.byFt.size();
+	int l2, h2;
+	rangeOf(t.byFt,t.ftFreq,q.ftMin,q.ftMax,lo,hi);
+	rangeOf(t.byDr,t.drFreq,q.drMin,q.drMax,l2,h2);
+	if(h2-l2 < hi-lo)
+	{
+		rows = &t.byDr;
+		lo = l2;
+		hi = h2;
+	}
+	rangeOf(t.byTime,t.time,tMin,tMax,l2,h2);
+	if(h2-l2 < hi-lo)
+	{
+		rows = &t.byTime;
+		lo = l2;
+		hi = h2;
+	}
+
+	QVector<bool> gasOk(t.gasNames.size(),q.gas.isEmpty());
+	if(!q.gas.isEmpty())
+	{
+		for(int i=0; i<t.gasNames.size(); i++)
+			gasOk[i] = t.gasNames.at(i).contains(q.gas,Qt::CaseInsensitive);
+	}
+
+	QList<int> out;
+	for(int i=lo; i<hi; i++)
+	{
+		int row = rows->at(i);
+		if(t.ftFreq.at(row) < q.ftMin || t.ftFreq.at(row) > q.ftMax)
+			continue;
+		if(t.drFreq.at(row) < q.drMin || t.drFreq.at(row) > q.drMax)
+			continue;
+		if(t.time.at(row) < tMin || t.time.at(row) > tMax)
+			continue;
+		if(t.attn.at(row) < q.attnMin || t.attn.at(row) > q.attnMax)
+			continue;
+		if(!gasOk.value(t.gas.at(row)))
+			continue;
+
+		out.append(t.number.at(row));
+	}
+	d_lock.unlock();
+
+	std::sort(out.begin(),out.end());
+	return out;
+}
+
+int ScanIndex::count()
+{
+	QWriteLocker l(&d_lock);
+	if(!d_loaded)
+		load();
+
+	return d_table.rowOf.size();
+}
+
+int ScanIndex::rebuild(std::function<void(int)> progress)
+{
+	{
+		QWriteLocker l(&d_lock);
+		if(!d_loaded)
+			load();
+		if(d_rebuilding)
+			return -1;
+
+		d_rebuilding = true;
+		d_cancelRebuild.store(0);
+		d_addedDuringRebuild.clear();
+	}
+
+	//read the header of every scan file; the index directory itself contains no scan files
+	Table t;
+	int files = 0;
+	QDirIterator it(ConfigService::instance().snapshot().savePath() + QString("/scans"),QStringList(QString("*.txt")),
+				 QDir::Files,QDirIterator::Subdirectories);
+	while(it.hasNext())
+	{
+		if(d_cancelRebuild.load())
+		{
+			QWriteLocker l(&d_lock);
+			d_addedDuringRebuild.clear();
+			d_rebuilding = false;
+			return -1;
+		}
+
+		it.next();
+		bool ok = false;
+		int num = it.fileInfo().completeBaseName().toInt(&ok);
+		if(!ok || num < 1)
+			continue;
+
+		Scan s = Scan::readHeader(num);
+		files++;
+		if(progress && files % 10000 == 0)
+			progress(files);
+		if(s.number() != num)
+			continue;
+
+		t.append(rowFromScan(s));
+	}
+
+	QWriteLocker l(&d_lock);
+	for(int i=0; i<d_addedDuringRebuild.size(); i++)
+		t.append(d_addedDuringRebuild.at(i));
+	d_addedDuringRebuild.clear();
+	d_rebuilding = false;
+
+	//the new index is written next to the old one, and then replaces it
+	QString newDir = d_dir + QString(".new");
+	QDir(newDir).removeRecursively();
+	if(!writeTable(newDir,t))
+	{
+		QDir(newDir).removeRecursively();
+		return -1;
+	}
+
+	for(int i=0; i<NumColumns; i++)
+		d_files[i].close();
+	QDir(d_dir).removeRecursively();
+	if(!QDir().rename(newDir,d_dir))
+		return -1;
+
+	t.sortIndexes();
+	d_table = t;
+	openFiles();
+
+	return d_table.rowOf.size();
+}
+
+void ScanIndex::cancelRebuild()
+{
+	d_cancelRebuild.store(1);
+}
+
+ScanIndex::Row ScanIndex::rowFromScan(const Scan &s)
+{
+	Row r;
+	r.number = s.number();
+	r.time = s.timeStamp().toMSecsSinceEpoch();
+	r.ftFreq = s.ftFreq();
+	r.drFreq = s.drFreq();
+	r.drPower = s.drPower();
+	r.attn = s.attenuation();
+	r.shots = s.completedShots();
+
+	//the gas mix is the sorted list of gases that were flowing
+	QStringList gases;
+	FlowConfig fc = s.flowConfig();
+	for(int i=0; i<fc.size(); i++)
+	{
+		QString name = fc.setting(i,QtFTM::FlowSettingName).toString().trimmed();
+		if(!name.isEmpty() && fc.setting(i,QtFTM::FlowSettingFlow).toDouble() > 0.0)
+			gases.append(name);
+	}
+	gases.sort();
+	r.gas = gases.join(QString(", "));
+
+	return r;
+}
+
+QString ScanIndex::columnFileName(ScanIndex::Column c)
+{
+	switch(c)
+	{
+	case NumberColumn:
+		return QString("number.col");
+	case TimeColumn:
+		return QString("time.col");
+	case FtColumn:
+		return QString("ftfreq.col");
+	case DrColumn:
+		return QString("drfreq.col");
+	case DrPowerColumn:
+		return QString("drpower.col");
+	case AttnColumn:
+		return QString("attn.col");
+	case ShotsColumn:
+		return QString("shots.col");
+	case GasColumn:
+		return QString("gas.col");
+	default:
+		return QString();
+	}
+}
+
+int ScanIndex::columnSize(ScanIndex::Column c)
+{
+	switch(c)
+	{
+	case TimeColumn:
+	case FtColumn:
+	case DrColumn:
+	case DrPowerColumn:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+const char *ScanIndex::columnData(const ScanIndex::Table &t, ScanIndex::Column c, int row)
+{
+	//columns are stored in native byte order; the index can always be rebuilt from the scan files
+	switch(c)
+	{
+	case NumberColumn:
+		return reinterpret_cast<const char*>(t.number.constData()+row);
+	case TimeColumn:
+		return reinterpret_cast<const char*>(t.time.constData()+row);
+	case FtColumn:
+		return reinterpret_cast<const char*>(t.ftFreq.constData()+row);
+	case DrColumn:
+		return reinterpret_cast<const char*>(t.drFreq.constData()+row);
+	case DrPowerColumn:
+		return reinterpret_cast<const char*>(t.drPower.constData()+row);
+	case AttnColumn:
+		return reinterpret_cast<const char*>(t.attn.constData()+row);
+	case ShotsColumn:
+		return reinterpret_cast<const char*>(t.shots.constData()+row);
+	case GasColumn:
+		return reinterpret_cast<const char*>(t.gas.constData()+row);
+	default:
+		return nullptr;
+	}
+}
+
+void ScanIndex::load()
+{
+	d_loaded = true;
+	QDir().mkpath(d_dir);
+
+	Table t;
+	QFile g(QString("%1/gases.txt").arg(d_dir));
+	if(g.open(QIODevice::ReadOnly))
+	{
+		QTextStream ts(&g);
+		while(!ts.atEnd())
+			t.gasNames.append(ts.readLine());
+		g.close();
+	}
+
+	//a row is only complete if every column contains it
+	QByteArray cols[NumColumns];
+	int rows = std::numeric_limits<int>::max();
+	for(int i=0; i<NumColumns; i++)
+	{
+		Column c = static_cast<Column>(i);
+		QFile f(QString("%1/%2").arg(d_dir).arg(columnFileName(c)));
+		if(f.open(QIODevice::ReadOnly))
+			cols[i] = f.readAll();
+		rows = qMin(rows,cols[i].size()/columnSize(c));
+	}
+
+	t.number.resize(rows);
+	t.time.resize(rows);
+	t.ftFreq.resize(rows);
+	t.drFreq.resize(rows);
+	t.drPower.resize(rows);
+	t.attn.resize(rows);
+	t.shots.resize(rows);
+	t.gas.resize(rows);
+	if(rows > 0)
+	{
+		memcpy(t.number.data(),cols[NumberColumn].constData(),static_cast<size_t>(rows)*columnSize(NumberColumn));
+		memcpy(t.time.data(),cols[TimeColumn].constData(),static_cast<size_t>(rows)*columnSize(TimeColumn));
+		memcpy(t.ftFreq.data(),cols[FtColumn].constData(),static_cast<size_t>(rows)*columnSize(FtColumn));
+		memcpy(t.drFreq.data(),cols[DrColumn].constData(),static_cast<size_t>(rows)*columnSize(DrColumn));
+		memcpy(t.drPower.data(),cols[DrPowerColumn].constData(),static_cast<size_t>(rows)*columnSize(DrPowerColumn));
+		memcpy(t.attn.data(),cols[AttnColumn].constData(),static_cast<size_t>(rows)*columnSize(AttnColumn));
+		memcpy(t.shots.data(),cols[ShotsColumn].constData(),static_cast<size_t>(rows)*columnSize(ShotsColumn));
+		memcpy(t.gas.data(),cols[GasColumn].constData(),static_cast<size_t>(rows)*columnSize(GasColumn));
+	}
+
+	bool gasAdded = false;
+	t.live.fill(true,rows);
+	for(int i=0; i<rows; i++)
+	{
+		if(t.gas.at(i) < 0 || t.gas.at(i) >= t.gasNames.size())
+			t.gas[i] = t.gasId(QString(""),&gasAdded);
+
+		int old = t.rowOf.value(t.number.at(i),-1);
+		if(old >= 0)
+			t.live[old] = false;
+		t.rowOf.insert(t.number.at(i),i);
+	}
+
+	t.sortIndexes();
+	d_table = t;
+
+	//discard any incomplete row, and rewrite the gas names if one was missing
+	for(int i=0; i<NumColumns; i++)
+	{
+		Column c = static_cast<Column>(i);
+		QFile f(QString("%1/%2").arg(d_dir).arg(columnFileName(c)));
+		if(f.exists() && f.size() != static_cast<qint64>(rows)*columnSize(c))
+			f.resize(static_cast<qint64>(rows)*columnSize(c));
+	}
+	if(gasAdded && g.open(QIODevice::WriteOnly))
+	{
+		QTextStream ts(&g);
+		for(int i=0; i<d_table.gasNames.size(); i++)
+			ts << d_table.gasNames.at(i) << QString("\n");
+		ts.flush();
+		g.close();
+	}
+
+	openFiles();
+}
+
+bool ScanIndex::openFiles()
+{
+	bool success = true;
+	for(int i=0; i<NumColumns; i++)
+	{
+		Column c = static_cast<Column>(i);
+		d_files[i].close();
+		d_files[i].setFileName(QString("%1/%2").arg(d_dir).arg(columnFileName(c)));
+		if(!d_files[i].open(QIODevice::WriteOnly|QIODevice::Append))
+			success = false;
+	}
+
+	return success;
+}
+
+bool ScanIndex::appendRow(int row, bool newGas)
+{
+	//the gas name is written first, so that a complete row never refers to a missing name
+	if(newGas)
+	{
+		QFile g(QString("%1/gases.txt").arg(d_dir));
+		if(!g.open(QIODevice::WriteOnly|QIODevice::Append))
+			return false;
+		g.write(d_table.gasNames.last().toUtf8() + '\n');
+		g.close();
+	}
+
+	bool success = true;
+	for(int i=0; i<NumColumns; i++)
+	{
+		Column c = static_cast<Column>(i);
+		if(!d_files[i].isOpen() || d_files[i].write(columnData(d_table,c,row),columnSize(c)) != columnSize(c))
+			success = false;
+		d_files[i].flush();
+	}
+
+	return success;
+}
+
+bool ScanIndex::writeTable(const QString dir, const ScanIndex::Table &t) const
+{
+	if(!QDir().mkpath(dir))
+		return false;
+
+	QFile g(QString("%1/gases.txt").arg(dir));
+	if(!g.open(QIODevice::WriteOnly))
+		return false;
+	QTextStream ts(&g);
+	for(int i=0; i<t.gasNames.size(); i++)
+		ts << t.gasNames.at(i) << QString("\n");
+	ts.flush();
+	g.close();
+
+	for(int i=0; i<NumColumns; i++)
+	{
+		Column c = static_cast<Column>(i);
+		QFile f(QString("%1/%2").arg(dir).arg(columnFileName(c)));
+		if(!f.open(QIODevice::WriteOnly))
+			return false;
+		qint64 bytes = static_cast<qint64>(t.size())*columnSize(c);
+		if(t.size() > 0 && f.write(columnData(t,c,0),bytes) != bytes)
+			return false;
+		f.close();
+	}
+
+	return true;
+}
+
+
+
+ScanIndexBuilder::ScanIndexBuilder(QObject *parent) : QObject(parent)
+{
+}
+
+void ScanIndexBuilder::run()
+{
+	emit logMessage(QString("Rebuilding scan index. Scans can be acquired while this is running."));
+	int n = ScanIndex::instance().rebuild([this](int files){
+		emit logMessage(QString("Scan index: %1 files read...").arg(files));
+	});
+
+	if(n < 0)
+		emit logMessage(QString("The scan index was not rebuilt."),QtFTM::LogWarning);
+	else
+		emit logMessage(QString("Scan index rebuilt. %1 scans indexed.").arg(n),QtFTM::LogHighlight);
+
+	emit finished(n);
+}
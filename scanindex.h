@@ -0,0 +1,193 @@
+#ifndef SCANINDEX_H
+#define SCANINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QDateTime>
+#include <QFile>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include <functional>
+
+#include "datastructs.h"
+
+class Scan;
+
+/*!
+ * \brief On-disk index of scan metadata
+ *
+ * Finding scans by their settings would otherwise require opening every scan file.
+ * The index stores the most commonly searched header fields of every scan in a columnar table: one file per column (scan number, date, cavity frequency, DR frequency, DR power, attenuation, shots, and gas mix) in scans/index under the save path.
+ * Gas mixes are dictionary-encoded; the names are stored in gases.txt.
+ * Rows are only ever appended, and a scan that is written again replaces its earlier row.
+ *
+ * The columns are read the first time the index is used, and sorted row lists are kept in memory for the cavity frequency, DR frequency, and date.
+ * find() uses the most selective of these to narrow down the rows, and then checks the remaining criteria, so that range queries take milliseconds even for millions of scans.
+ *
+ * Scans are added by Scan::writeFile(), so the index is maintained incrementally.
+ * Existing archives can be indexed with rebuild() (see ScanIndexBuilder), which reads the headers of all scan files.
+ * If the program stopped while a row was being appended, the incomplete row is discarded when the index is loaded.
+ *
+ * The index is thread-safe, and is accessed through instance().
+ */
+class ScanIndex
+{
+public:
+	/*!
+	 * \brief Criteria for find(). Unset criteria match every scan.
+	 */
+	struct Query {
+		double ftMin;
+		double ftMax;
+		double drMin;
+		double drMax;
+		QDateTime start;
+		QDateTime end;
+		int attnMin;
+		int attnMax;
+		QString gas; /*!< Matches scans whose gas mix contains this text (case insensitive) */
+
+		Query();
+		/*!
+		 * \brief Restricts the cavity frequency to center +/- width (MHz)
+		 */
+		Query &cavityNear(double center, double width);
+		/*!
+		 * \brief Restricts the DR frequency to center +/- width (MHz)
+		 */
+		Query &drNear(double center, double width);
+		/*!
+		 * \brief Restricts the date to the given interval (an invalid QDateTime leaves that end open)
+		 */
+		Query &between(const QDateTime from, const QDateTime to = QDateTime());
+	};
+
+	static ScanIndex &instance();
+	~ScanIndex();
+
+	/*!
+	 * \brief Adds or replaces the row for a scan
+	 * \param s Scan; must have a valid number
+	 */
+	void add(const Scan &s);
+	/*!
+	 * \brief Finds all scans matching the query
+	 * \param q Query
+	 * \return Scan numbers, in increasing order
+	 */
+	QList<int> find(const Query &q);
+	/*!
+	 * \brief Number of indexed scans
+	 */
+	int count();
+	/*!
+	 * \brief Rebuilds the index from the scan files
+	 *
+	 * The scan headers are read without holding the index lock, so scans can be added and the index can be searched while this is running.
+	 * Scans added in the meantime are merged into the new index.
+	 *
+	 * \param progress If not null, called with the number of files read so far
+	 * \return Number of scans in the new index, or -1 if it could not be written
+	 */
+	int rebuild(std::function<void(int)> progress = nullptr);
+	/*!
+	 * \brief Stops a running rebuild(). The existing index is kept.
+	 */
+	void cancelRebuild();
+
+private:
+	ScanIndex();
+	Q_DISABLE_COPY(ScanIndex)
+
+	enum Column {
+		NumberColumn,
+		TimeColumn,
+		FtColumn,
+		DrColumn,
+		DrPowerColumn,
+		AttnColumn,
+		ShotsColumn,
+		GasColumn,
+		NumColumns
+	};
+
+	struct Row {
+		qint32 number;
+		qint64 time;
+		double ftFreq;
+		double drFreq;
+		double drPower;
+		qint32 attn;
+		qint32 shots;
+		QString gas;
+	};
+
+	struct Table {
+		QVector<qint32> number;
+		QVector<qint64> time;
+		QVector<double> ftFreq;
+		QVector<double> drFreq;
+		QVector<double> drPower;
+		QVector<qint32> attn;
+		QVector<qint32> shots;
+		QVector<qint32> gas;
+		QStringList gasNames;
+
+		QVector<bool> live;
+		QHash<int,int> rowOf;
+		QVector<int> byFt;
+		QVector<int> byDr;
+		QVector<int> byTime;
+		bool sorted;
+
+		Table() : sorted(false) {}
+		int size() const { return number.size(); }
+		int gasId(const QString name, bool *added = nullptr);
+		void append(const Row &r, bool *newGas = nullptr);
+		void sortIndexes();
+	};
+
+	QReadWriteLock d_lock;
+	QString d_dir;
+	Table d_table;
+	QFile d_files[NumColumns];
+	bool d_loaded;
+	bool d_rebuilding;
+	QAtomicInt d_cancelRebuild;
+	QList<Row> d_addedDuringRebuild;
+
+	static Row rowFromScan(const Scan &s);
+	static QString columnFileName(Column c);
+	static int columnSize(Column c);
+	static const char *columnData(const Table &t, Column c, int row);
+
+	void load();
+	bool openFiles();
+	bool appendRow(int row, bool newGas);
+	bool writeTable(const QString dir, const Table &t) const;
+
+};
+
+/*!
+ * \brief Runs ScanIndex::rebuild() on a separate thread, and reports progress to the log
+ */
+class ScanIndexBuilder : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ScanIndexBuilder(QObject *parent = nullptr);
+
+signals:
+	void logMessage(const QString, const QtFTM::LogMessageCode = QtFTM::LogNormal);
+	void finished(int scans);
+
+public slots:
+	void run();
+
+};
+
+#endif // SCANINDEX_H
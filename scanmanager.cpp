@@ -1,40 +1,101 @@
 #include "scanmanager.h"
 
-#include <QSettings>
-#include <QApplication>
+#include "configservice.h"
 
 #include "analysis.h"
+#include "scanwriter.h"
+#include "livefeed.h"
 
 ScanManager::ScanManager(QObject *parent) :
     QObject(parent), d_paused(false), d_acquiring(false), d_numRetries(0),
-    d_connectAcqAverageAfterNextFid(false)
+    d_connectAcqAverageAfterNextFid(false), p_writer(nullptr), d_failedSaves(0), d_saturatedFrames(0), d_outlierFrames(0),
+    d_triggersSeen(0), d_waveformsAcquired(0), d_firstTriggerTime(-1), d_lastTriggerTime(-1)
 {
 
 	connect(this,&ScanManager::newFid,this,&ScanManager::peakUpAverage);
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
 
 	//these are settings that are relevant for the peak up plot
 	//currentProbeFreq will be updated when the ftm synth initializes, then anytime its value changes
-	d_peakUpAvgs = s.value(QString("peakUpAvgs"),20).toInt();
+	d_peakUpAvgs = ConfigService::instance().snapshot().peakUpAverages();
 	d_peakUpCount = 0;
 	d_currentProbeFreq = 4999.6;
 }
 
 
-void ScanManager::fidReceived(const QByteArray d)
+void ScanManager::fidReceived(const QByteArray d, int shots, int frames)
 {
 	Fid f;
 
 	//if a scan is active, take the probe frequency from the scan. otherwise, use most recent value
+	double probeFreq = d_currentProbeFreq;
 	if(d_currentScan.isInitialized() && !d_currentScan.isAcquisitionComplete())
-        f = Analysis::parseWaveform(d,d_currentScan.fid().probeFreq());
+	{
+        probeFreq = d_currentScan.fid().probeFreq();
+		if(d_acquiring && !d_paused)
+			d_waveformsAcquired += shots*frames;
+	}
+
+	if(frames > 1)
+	{
+		//segmented record: each frame is an individual shot. Saturated shots and outliers are discarded,
+		//and the rest are averaged together so that the scan and peak up averages are only updated once per record
+		QList<bool> saturated;
+		QList<Fid> frameList = Analysis::parseWaveformFrames(d,probeFreq,frames,&saturated);
+		if(frameList.isEmpty())
+			return;
+
+		QList<bool> outliers = Analysis::findOutlierFrames(frameList);
+		const Fid &first = frameList.first();
+		QVector<qint64> sum(first.size());
+		int accepted = 0;
+		for(int i=0; i<frameList.size(); i++)
+		{
+			if(saturated.at(i))
+			{
+				d_saturatedFrames++;
+				continue;
+			}
+			if(outliers.at(i))
+			{
+				d_outlierFrames++;
+				continue;
+			}
+
+			//all frames of a record share the same scaling, so their raw codes can be summed directly
+			const Fid &fr = frameList.at(i);
+			if(!fr.rawCompatible(first))
+				continue;
+			QVector<qint64> codes = fr.rawSum();
+			for(int j=0; j<sum.size(); j++)
+				sum[j] += codes.at(j);
+			accepted++;
+		}
+
+		if(accepted == 0)
+			return;
+
+		f = Fid(first.spacing(),probeFreq,QVector<double>());
+		f.setRawSum(sum,accepted,first.yMult(),first.yOffset());
+		shots *= accepted;
+	}
 	else
-        f = Analysis::parseWaveform(d,d_currentProbeFreq);
+	{
+        f = Analysis::parseWaveform(d,probeFreq);
+
+		//a scope-averaged record counts as shots identical shots in the raw sum
+		if(shots > 1 && f.hasRawSum())
+		{
+			QVector<qint64> sum = f.rawSum();
+			for(int j=0; j<sum.size(); j++)
+				sum[j] *= shots;
+			f.setRawSum(sum,shots,f.yMult(),f.yOffset());
+		}
+	}
 
     if(f.probeFreq()<0.0) //parsing error!
         return;
 
-	emit newFid(f);
+	emit newFid(f,shots);
 
     if(d_connectAcqAverageAfterNextFid)
     {
@@ -43,6 +104,18 @@ void ScanManager::fidReceived(const QByteArray d)
     }
 }
 
+void ScanManager::triggersReceived(int n, qint64 timestamp)
+{
+	//only triggers that occur while a scan is acquiring are counted
+	if(!d_acquiring || d_paused || !d_currentScan.isInitialized() || d_currentScan.isAcquisitionComplete())
+		return;
+
+	d_triggersSeen += n;
+	if(d_firstTriggerTime < 0)
+		d_firstTriggerTime = timestamp;
+	d_lastTriggerTime = timestamp;
+}
+
 void ScanManager::prepareScan(Scan s)
 {
 
@@ -84,6 +157,12 @@ void ScanManager::startScan(Scan s)
 		return;
 	}
 	d_currentScan = s;
+	d_saturatedFrames = 0;
+	d_outlierFrames = 0;
+	d_triggersSeen = 0;
+	d_waveformsAcquired = 0;
+	d_firstTriggerTime = -1;
+	d_lastTriggerTime = -1;
 
 	//the Hardware manager will set the scan to initialized if it was successful
 	if(d_currentScan.isInitialized())
@@ -130,27 +209,32 @@ void ScanManager::setPeakUpAvgs(int a)
 	if(a>0)
 	{
 		//set the value, and record it in settings
-		QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-
 		d_peakUpAvgs = a;
-		s.setValue(QString("peakUpAvgs"),a);
-		s.sync();
+		ConfigService::instance().setValue(QString("peakUpAvgs"),a);
 	}
 }
 
-void ScanManager::acqAverage(const Fid f)
+void ScanManager::configChanged(const ConfigSnapshot c)
+{
+	if(c.peakUpAverages() > 0)
+		d_peakUpAvgs = c.peakUpAverages();
+}
+
+void ScanManager::acqAverage(const Fid f, int shots)
 {
 	//pausing amounts to ignoring new FIDs that come in
 	if(d_paused)
 		return;
 
 	//increment the scan, and pass along messages to UI
-
-	d_currentScan.increment();
+	//with scope-side averaging, the last block may go past the target; the progress bars only count up to the target
+	int previous = d_currentScan.completedShots();
+	d_currentScan.increment(shots);
 	int n = d_currentScan.completedShots();
-    if(n>0)
+	int added = n - previous;
+    if(added>0)
     {
-        emit scanShotAcquired();
+        emit scanShotAcquired(qMax(0,qMin(added,d_currentScan.targetShots()-previous)));
         emit statusMessage(QString("Acquiring... (%1/%2)").arg(n).arg(d_currentScan.targetShots()));
     }
 
@@ -164,35 +248,55 @@ void ScanManager::acqAverage(const Fid f)
 	//because Fid is implicitly shared, modifying it would cause a copy on write since currentScan.fid() was sent to UI
 	//it's more efficient to create a new Fid with the new data and assign it to currentScan, so that the
 	//vector containing the FID data doesn't get looped over twice
-    if(n>0)
+    if(added>0)
     {
-        if(n>1)
+        //the raw ADC sums are accumulated as long as every block can be added exactly; otherwise only the voltages are kept
+        Fid old = d_currentScan.fid();
+        bool raw = f.hasRawSum() && f.rawShots() == added;
+        if(previous>0)
         {
-            //make data vector of the appropriate size
-            QVector<double> newData(f.size());
-
-            //do the rolling average, and set the FID of the scan appropriately
-            for(int i=0; i<f.size(); i++)
-                newData[i] = (d_currentScan.fid().at(i)*((double)n-1.0)+f.at(i))/(double)n;
-
-            d_currentScan.setFid(Fid(d_currentScan.fid().spacing(),d_currentScan.fid().probeFreq(),newData));
+            if(raw && old.rawCompatible(f) && old.rawShots() == previous)
+            {
+                QVector<qint64> sum = old.rawSum();
+                QVector<qint64> add = f.rawSum();
+                for(int i=0; i<sum.size(); i++)
+                    sum[i] += add.at(i);
+
+                Fid next(old.spacing(),old.probeFreq(),QVector<double>());
+                next.setRawSum(sum,n,f.yMult(),f.yOffset());
+                d_currentScan.setFid(next);
+            }
+            else
+            {
+                //make data vector of the appropriate size
+                QVector<double> newData(f.size());
+
+                //do the rolling average, and set the FID of the scan appropriately
+                for(int i=0; i<f.size(); i++)
+                    newData[i] = (old.at(i)*(double)previous+f.at(i)*(double)added)/(double)n;
+
+                d_currentScan.setFid(Fid(old.spacing(),old.probeFreq(),newData));
+            }
         }
         else
-            d_currentScan.setFid(f);
+        {
+            Fid first = f;
+            if(!raw)
+                first.clearRawSum();
+            d_currentScan.setFid(first);
+        }
 
         emit scanFid(d_currentScan.fid());
+        LiveFeed::instance().publishFid(d_currentScan.fid(),d_currentScan.number(),n,d_currentScan.targetShots());
     }
 
 
 	//if we're done, save and notify the rest of the program that the scan is done
 	if(d_currentScan.isAcquisitionComplete())
 	{
-		d_currentScan.save();	
-		if(!d_currentScan.isSaved())
-		{
-			emit logMessage(QString("Could not open file for saving scan %1").arg(d_currentScan.number()),QtFTM::LogError);
-			emit fatalSaveError();
-		}
+		recordTriggerStatistics();
+		saveCurrentScan();
+		logAcquisitionStatistics();
 		d_acquiring = false;
 		emit scanComplete(d_currentScan);
 		d_numRetries = 0;
@@ -210,13 +314,9 @@ void ScanManager::abortScan()
 	//only do the following if the scan has been initialized, but not yet saved
 	if(d_currentScan.isInitialized() && !d_currentScan.isSaved())
 	{
-
-		d_currentScan.save();
-		if(!d_currentScan.isSaved())
-		{
-			emit logMessage(QString("Could not open file for saving scan %1").arg(d_currentScan.number()),QtFTM::LogError);
-			emit fatalSaveError();
-		}
+		recordTriggerStatistics();
+		saveCurrentScan();
+		logAcquisitionStatistics();
     }
 
 	emit scanComplete(d_currentScan);
@@ -258,3 +358,87 @@ void ScanManager::retryScan()
 	    }
     }
 }
+
+void ScanManager::saveCurrentScan()
+{
+	//with a ScanWriter, only the scan number is assigned here; the file is written on the writer's thread
+	if(p_writer != nullptr)
+	{
+		if(d_currentScan.allocateNumber() < 1)
+			emit logMessage(QString("Could not reserve a scan number."),QtFTM::LogError);
+		else if(p_writer->submit(d_currentScan))
+		{
+			d_currentScan.setSaved();
+			return;
+		}
+		else
+		{
+			emit logMessage(QString("Could not queue scan %1 for saving. Saving directly.").arg(d_currentScan.number()),QtFTM::LogWarning);
+			if(d_currentScan.writeFile())
+			{
+				d_currentScan.setSaved();
+				return;
+			}
+		}
+	}
+	else
+		d_currentScan.save();
+
+	if(!d_currentScan.isSaved())
+	{
+		emit logMessage(QString("Could not open file for saving scan %1").arg(d_currentScan.number()),QtFTM::LogError);
+		emit fatalSaveError();
+	}
+}
+
+void ScanManager::scanSaved(int num, bool success)
+{
+	if(success)
+	{
+		d_failedSaves = 0;
+		emit logMessage(QString("Scan %1 written to disk.").arg(num),QtFTM::LogDebug);
+		return;
+	}
+
+	d_failedSaves++;
+	emit logMessage(QString("Scan %1 could not be saved.").arg(num),QtFTM::LogError);
+	emit fatalSaveError();
+
+	//if the disk is full or unreachable, every following scan would be lost too
+	int maxFailures = ConfigService::instance().snapshot().value(QString("maxFailedSaves"),3).toInt();
+	if(d_failedSaves >= maxFailures && d_acquiring && !d_paused)
+	{
+		pause();
+		emit logMessage(QString("%1 consecutive scans could not be saved. Acquisition has been paused; check the save path before resuming.")
+					 .arg(d_failedSaves),QtFTM::LogError);
+		emit pausedAfterSaveErrors();
+	}
+}
+
+void ScanManager::recordTriggerStatistics()
+{
+	double span = 0.0;
+	if(d_firstTriggerTime >= 0)
+		span = (double)(d_lastTriggerTime - d_firstTriggerTime)/1000.0;
+
+	d_currentScan.setTriggerStatistics(d_triggersSeen,d_waveformsAcquired,d_currentScan.completedShots(),span);
+}
+
+void ScanManager::logAcquisitionStatistics()
+{
+	//called after the scan is saved, so that the scan number is known
+	if(d_saturatedFrames > 0 || d_outlierFrames > 0)
+		emit logMessage(QString("Scan %1: %2 saturated and %3 outlier shots were rejected.")
+					 .arg(d_currentScan.number()).arg(d_saturatedFrames).arg(d_outlierFrames));
+
+	d_saturatedFrames = 0;
+	d_outlierFrames = 0;
+
+	QString rate;
+	if(d_currentScan.triggerSpan() > 0.0)
+		rate = QString(", %1 averaged shots/s").arg((double)d_currentScan.waveformsAveraged()/d_currentScan.triggerSpan(),0,'f',2);
+	emit logMessage(QString("Scan %1: %2 triggers, %3 shots acquired, %4 averaged (duty cycle %5%)%6.")
+				 .arg(d_currentScan.number()).arg(d_currentScan.triggersSeen()).arg(d_currentScan.waveformsAcquired())
+				 .arg(d_currentScan.waveformsAveraged())
+				 .arg(d_currentScan.dutyCycle() >= 0.0 ? d_currentScan.dutyCycle()*100.0 : 0.0,0,'f',1).arg(rate),QtFTM::LogDebug);
+}
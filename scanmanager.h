@@ -6,6 +6,9 @@
 #include "fid.h"
 #include "oscilloscope.h"
 #include "scan.h"
+#include "configservice.h"
+
+class ScanWriter;
 
 /*!
  \brief Class that handles data acquisition for scans
@@ -24,8 +27,11 @@
  If all initialization was successful, averaging is initiated by connecting the newFid() signal to the acqAverage() slot, where FIDs are averaged until the target number of shots is reached or the scan is aborted.
  If the scan is paused, new FIDs are ignored in the acqAverage() function until unpaused.
  When a shot is averaged in, the scanShotAcquired() signal is emitted to increment the progress bar on the UI, and the scanFid() signal is emitted to update the plots on the UI.
+ If the oscilloscope averages in hardware, each waveform carries the number of shots it contains, and it is weighted accordingly in the average.
 
- When a scan is complete, either by reaching the target number of shots or by being aborted, the Scan::save() function is called, and the scan is emitted (acquisitionComplete()) for further processing by the UI and the BatchManager.
+ When a scan is complete, either by reaching the target number of shots or by being aborted, the scan is saved, and the scan is emitted (acquisitionComplete()) for further processing by the UI and the BatchManager.
+ If a ScanWriter has been set (setScanWriter()), only the scan number is assigned here, and the file is written on the writer's thread while the next scan proceeds.
+ Otherwise, Scan::save() is called.
  At this point, the newFid signal is disconnected from the acqAverage slot, and all acquisition-related variables are reset.
 
  Finally, some scans are used just to change hardware settings, not to actually start an acquisition.
@@ -45,6 +51,13 @@ public:
 	 \param parent Is not set, as this lives in its own thread
 	*/
 	explicit ScanManager(QObject *parent = nullptr);
+
+	/*!
+	 \brief Sets the writer used to save scans. Must be called before the ScanManager is moved to its thread.
+
+	 \param w The ScanWriter, which lives in its own thread
+	*/
+	void setScanWriter(ScanWriter *w) { p_writer = w; }
 	
 signals:
 	/*!
@@ -80,8 +93,9 @@ signals:
 	 \sa d_peakUpFid
 
 	 \param Fid
+	 \param int Number of shots averaged into the Fid by the oscilloscope
 	*/
-	void newFid(const Fid);
+	void newFid(const Fid, int);
 	/*!
 	 \brief Signal sent to HardwareManager to prepare hardware for scan
 
@@ -109,8 +123,9 @@ signals:
 
 	 Used to update the scan and batch progress bars
 
+	 \param int Number of shots that were added to the scan
 	*/
-	void scanShotAcquired();
+	void scanShotAcquired(int);
 	/*!
 	 \brief Emitted when an acquisition is complete
 
@@ -136,6 +151,13 @@ signals:
 
 	*/
 	void fatalSaveError();
+	/*!
+	 \brief Emitted when acquisition has been paused because several consecutive scans could not be saved
+
+	 The number of failures is set by the maxFailedSaves setting (default 3).
+
+	*/
+	void pausedAfterSaveErrors();
 	
 public slots:
 	/*!
@@ -144,9 +166,23 @@ public slots:
 	 Uses the current probe frequency and the Oscilloscope::parseWaveform() function to construct the Fid object.
 	 Emits the newFid() signal.
 
+	 If the response contains more than one frame (segmented capture), each frame is treated as a separate shot.
+	 Saturated shots and outliers (see Analysis::findOutlierFrames()) are rejected, and the remaining shots are averaged into one Fid.
+
 	 \param d The oscilloscope response.
+	 \param shots Number of shots averaged into each frame by the oscilloscope
+	 \param frames Number of frames in the response
+	*/
+	void fidReceived(const QByteArray d, int shots = 1, int frames = 1);
+	/*!
+	 \brief Counts triggers detected by the IOBoard during an acquisition
+
+	 Together with the number of shots received from the oscilloscope and the number averaged into the scan, this gives the duty cycle of the acquisition, which is stored in the scan header.
+
+	 \param n Number of triggers
+	 \param timestamp Time the triggers were detected (ms since epoch)
 	*/
-	void fidReceived(const QByteArray d);
+	void triggersReceived(int n, qint64 timestamp);
 	/*!
 	 \brief Begins hardware initialization for scan.
 
@@ -192,10 +228,12 @@ public slots:
 
 	 If paused is true, the Fid is ignored.
 	 Otherwise, the shot number is incremented, and the newFid signal disconnected from this slot if the target number has been reached.
+	 The Fid is weighted by the number of shots it contains.
 
 	 \param f The new Fid to average
+	 \param shots Number of shots averaged into f by the oscilloscope
 	*/
-	void acqAverage(const Fid f);
+	void acqAverage(const Fid f, int shots = 1);
 	/*!
 	 \brief Pauses acquisition by setting paused to true
 
@@ -224,6 +262,19 @@ public slots:
 
     void retryScan();
 
+    /*!
+     \brief Called when the ScanWriter has finished writing a scan file
+
+     \param num Scan number
+     \param success Whether the file was written
+    */
+    void scanSaved(int num, bool success);
+
+    /*!
+     \brief Updates the cached settings from a new ConfigSnapshot
+    */
+    void configChanged(const ConfigSnapshot c);
+
 private:
 	Fid d_peakUpFid; /*!< The Fid containing the rolling average */
 
@@ -233,10 +284,29 @@ private:
     bool d_acquiring;
     int d_numRetries;
     bool d_connectAcqAverageAfterNextFid;
+    ScanWriter *p_writer; /*!< Writes scan files in its own thread. If null, scans are saved synchronously */
+    int d_failedSaves; /*!< Number of consecutive scans that could not be written by the ScanWriter */
 
 	int d_peakUpAvgs; /*!< Number of FIDs to include in d_peakUpFid */
 	int d_peakUpCount; /*!< Current number of FIDs included in d_peakUpFid */
     double d_currentProbeFreq; /*!< Current probe frequency */
+    int d_saturatedFrames; /*!< Segmented-capture shots rejected for saturation during the current scan */
+    int d_outlierFrames; /*!< Segmented-capture shots rejected as outliers during the current scan */
+
+    int d_triggersSeen; /*!< Triggers reported by the IOBoard during the current scan */
+    int d_waveformsAcquired; /*!< Shots contained in the waveforms received during the current scan */
+    qint64 d_firstTriggerTime; /*!< Time of the first trigger batch of the current scan (ms since epoch) */
+    qint64 d_lastTriggerTime; /*!< Time of the most recent trigger batch of the current scan (ms since epoch) */
+
+    void logAcquisitionStatistics();
+    /*!
+     \brief Saves d_currentScan, either by handing it to the ScanWriter or with Scan::save()
+    */
+    void saveCurrentScan();
+    /*!
+     \brief Stores the trigger accounting for the current scan in its header (see Scan::setTriggerStatistics())
+    */
+    void recordTriggerStatistics();
 	
 };
 
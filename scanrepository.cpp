@@ -0,0 +1,168 @@
+#include "scanrepository.h"
+
+#include <QThread>
+
+#include "configservice.h"
+
+ScanRepository &ScanRepository::instance()
+{
+	static ScanRepository repo;
+	return repo;
+}
+
+ScanRepository::ScanRepository(QObject *parent) : QObject(parent)
+{
+	//costs are in kB
+	int mb = ConfigService::instance().snapshot().value(QString("scanCacheMB"),256).toInt();
+	d_cache.setMaxCost(qMax(mb,1)*1024);
+
+	p_thread = new QThread();
+	moveToThread(p_thread);
+	p_thread->start();
+}
+
+ScanRepository::~ScanRepository()
+{
+	shutdown();
+	delete p_thread;
+}
+
+Scan ScanRepository::get(int num)
+{
+	if(num < 1)
+		return Scan();
+
+	QMutexLocker l(&d_mutex);
+	forever
+	{
+		if(d_pending.contains(num))
+			return d_pending.value(num);
+
+		Scan *s = d_cache.object(num);
+		if(s != nullptr)
+			return *s;
+
+		//another thread is already reading this scan; wait for it instead of reading it again
+		if(!d_loading.contains(num))
+			break;
+		d_loadFinished.wait(&d_mutex);
+	}
+
+	d_loading.insert(num);
+	l.unlock();
+
+	Scan out(num);
+
+	l.relock();
+	d_loading.remove(num);
+	bool stale = d_stale.remove(num);
+	if(!stale && out.number() == num && out.fid().size() > 0)
+	{
+		int cost = costOf(out);
+		if(cost <= d_cache.maxCost())
+			d_cache.insert(num,new Scan(out),cost);
+	}
+	d_loadFinished.wakeAll();
+
+	return out;
+}
+
+bool ScanRepository::contains(int num)
+{
+	QMutexLocker l(&d_mutex);
+	return d_pending.contains(num) || d_cache.contains(num);
+}
+
+void ScanRepository::putPending(const Scan s)
+{
+	if(s.number() < 1)
+		return;
+
+	QMutexLocker l(&d_mutex);
+	d_pending.insert(s.number(),s);
+}
+
+void ScanRepository::invalidate(int num)
+{
+	QMutexLocker l(&d_mutex);
+	d_pending.remove(num);
+	d_cache.remove(num);
+	if(d_loading.contains(num))
+		d_stale.insert(num);
+}
+
+void ScanRepository::prefetch(const QList<int> nums)
+{
+	QMutexLocker l(&d_mutex);
+	if(!p_thread->isRunning())
+		return;
+
+	bool wasEmpty = d_prefetchQueue.isEmpty();
+	d_prefetchQueue.clear();
+	for(int i=0; i<nums.size(); i++)
+	{
+		int n = nums.at(i);
+		if(n > 0 && !d_pending.contains(n) && !d_cache.contains(n) && !d_loading.contains(n))
+			d_prefetchQueue.append(n);
+	}
+
+	//if the queue was not empty, processPrefetch() is already scheduled or running, and will pick up the new list
+	if(wasEmpty && !d_prefetchQueue.isEmpty())
+		QMetaObject::invokeMethod(this,"processPrefetch",Qt::QueuedConnection);
+}
+
+void ScanRepository::prefetchNeighbors(int num, int step, int ahead, int behind)
+{
+	if(num < 1)
+		return;
+
+	int dir = step < 0 ? -1 : 1;
+	QList<int> nums;
+	for(int i=1; i<=ahead; i++)
+		nums.append(num + dir*i);
+	for(int i=1; i<=behind; i++)
+		nums.append(num - dir*i);
+
+	prefetch(nums);
+}
+
+void ScanRepository::shutdown()
+{
+	{
+		QMutexLocker l(&d_mutex);
+		d_prefetchQueue.clear();
+	}
+
+	if(p_thread->isRunning())
+	{
+		p_thread->quit();
+		p_thread->wait();
+	}
+}
+
+void ScanRepository::processPrefetch()
+{
+	forever
+	{
+		int num;
+		{
+			QMutexLocker l(&d_mutex);
+			if(d_prefetchQueue.isEmpty())
+				return;
+			num = d_prefetchQueue.takeFirst();
+		}
+
+		get(num);
+	}
+}
+
+int ScanRepository::costOf(const Scan &s)
+{
+	//the FID data (and the raw sum, if present) dominate; 1 kB is added for the header
+	Fid f = s.fid();
+	qint64 bytes = static_cast<qint64>(f.size())*static_cast<qint64>(sizeof(double));
+	if(f.hasRawSum())
+		bytes += static_cast<qint64>(f.rawSum().size())*static_cast<qint64>(sizeof(qint64));
+
+	return static_cast<int>(bytes/1024) + 1;
+}
@@ -0,0 +1,101 @@
+#ifndef SCANREPOSITORY_H
+#define SCANREPOSITORY_H
+
+#include <QObject>
+#include <QCache>
+#include <QSet>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "scan.h"
+
+class QThread;
+
+/*!
+ * \brief Process-wide cache of scans loaded from disk
+ *
+ * Loading a scan with Scan(int) parses the whole scan file, and the same scan is often needed by several parts of the program (the analysis widget, the peak list, batch loaders, and so on).
+ * The repository keeps recently used scans in memory, so each file is only parsed once.
+ * Because Scan is implicitly shared, get() only copies a pointer; a caller that modifies its copy detaches from the cached scan.
+ *
+ * The cache is bounded by the total size of the FIDs it holds (setting scanCacheMB, default 256), and the least recently used scans are evicted first.
+ * If a scan is requested from several threads at the same time, it is read once: the other callers wait for the first load to finish.
+ *
+ * prefetch() reads scans on a separate thread, so that the next scans are usually in memory before they are requested (see AnalysisWidget::loadScan()).
+ * Only the most recent prefetch request is kept; scans that were queued by an earlier request and not read yet are dropped.
+ *
+ * Scans that have been handed to the ScanWriter are added with putPending(), so that get() returns them before their files exist (a batch may use the scan that just finished as the template for the next one).
+ * They are held outside of the cache, so they cannot be evicted, until the file is written.
+ * Scan::writeFile() calls invalidate() when a scan file is written or replaced.
+ * The repository is thread-safe, and is accessed through instance().
+ * shutdown() must be called before the application exits to stop the prefetch thread.
+ */
+class ScanRepository : public QObject
+{
+	Q_OBJECT
+public:
+	static ScanRepository &instance();
+	~ScanRepository();
+
+	/*!
+	 * \brief Returns a scan, reading it from disk if it is not in the cache
+	 * \param num Scan number
+	 * \return Scan; an invalid scan if it could not be read
+	 */
+	Scan get(int num);
+	/*!
+	 * \brief Whether a scan is in the cache (or waiting to be written)
+	 */
+	bool contains(int num);
+	/*!
+	 * \brief Holds a scan whose file has not been written yet. It is returned by get() until invalidate() is called for it.
+	 */
+	void putPending(const Scan s);
+	/*!
+	 * \brief Removes a scan from the cache, and from the scans waiting to be written. A load that is in progress will not be cached.
+	 */
+	void invalidate(int num);
+	/*!
+	 * \brief Reads scans on the prefetch thread
+	 * \param nums Scan numbers, in the order they should be read. Replaces any scans still waiting from an earlier call
+	 */
+	void prefetch(const QList<int> nums);
+	/*!
+	 * \brief Prefetches the scans that are likely to be viewed after num
+	 *
+	 * Reads the next scans in the direction of step, followed by the previous scan.
+	 *
+	 * \param num Current scan number
+	 * \param step 1 when stepping forward, -1 when stepping backward
+	 * \param ahead Number of scans to read in the direction of step
+	 * \param behind Number of scans to read in the opposite direction
+	 */
+	void prefetchNeighbors(int num, int step, int ahead = 3, int behind = 1);
+	/*!
+	 * \brief Stops the prefetch thread
+	 */
+	void shutdown();
+
+private slots:
+	void processPrefetch();
+
+private:
+	explicit ScanRepository(QObject *parent = nullptr);
+	Q_DISABLE_COPY(ScanRepository)
+
+	static int costOf(const Scan &s);
+
+	QMutex d_mutex;
+	QWaitCondition d_loadFinished;
+	QCache<int,Scan> d_cache;
+	QHash<int,Scan> d_pending; /*!< Scans queued in the ScanWriter; not subject to eviction */
+	QSet<int> d_loading;
+	QSet<int> d_stale;
+	QList<int> d_prefetchQueue;
+	QThread *p_thread;
+
+};
+
+#endif // SCANREPOSITORY_H
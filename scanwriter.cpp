@@ -0,0 +1,221 @@
+#include "scanwriter.h"
+
+#include <QSettings>
+#include <QApplication>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QMap>
+
+#include "fidcodec.h"
+#include "scanrepository.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+ScanWriter::ScanWriter(int capacity, QObject *parent) :
+	QObject(parent), d_capacity(capacity), d_slots(capacity), d_failedWrites(0)
+{
+	//the journal is kept in the same directory as the settings file, which is on the local disk
+	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
+	d_journal.setFileName(QString("%1/scanjournal.dat").arg(QFileInfo(s.fileName()).absolutePath()));
+	d_journal.open(QIODevice::ReadWrite);
+}
+
+ScanWriter::~ScanWriter()
+{
+	if(d_journal.isOpen())
+		d_journal.close();
+}
+
+bool ScanWriter::submit(const Scan s)
+{
+	if(!d_slots.tryAcquire())
+	{
+		emit logMessage(QString("Scan write queue is full (%1 scans). Waiting for the writer to catch up.").arg(d_capacity),QtFTM::LogDebug);
+		d_slots.acquire();
+	}
+
+	if(!appendEntry(s))
+	{
+		d_slots.release();
+		return false;
+	}
+
+	//the scan must be available to ScanRepository::get() as soon as it is complete, which is before its file is written.
+	//It is removed from the repository's pending scans when Scan::writeFile() succeeds
+	Scan pending = s;
+	pending.setSaved();
+	ScanRepository::instance().putPending(pending);
+
+	QMetaObject::invokeMethod(this,"writeScan",Qt::QueuedConnection,Q_ARG(Scan,s));
+	return true;
+}
+
+void ScanWriter::recoverJournal()
+{
+	QMutexLocker l(&d_journalMutex);
+	if(!d_journal.isOpen())
+	{
+		emit logMessage(QString("Could not open scan journal (%1). Scans will be written without a journal.").arg(d_journal.fileName()),QtFTM::LogWarning);
+		return;
+	}
+
+	//read all complete records. A record that was only partially written when the program stopped is discarded
+	struct PendingScan {
+		QString header;
+		QVector<double> fid;
+		QByteArray rawFid;
+	};
+	QMap<int,PendingScan> pending;
+	d_journal.seek(0);
+	QDataStream ds(&d_journal);
+	ds.setVersion(QDataStream::Qt_5_0);
+	qint64 goodPos = 0;
+	while(!ds.atEnd())
+	{
+		quint8 type = 0;
+		qint32 num = -1;
+		ds >> type >> num;
+		if(type == JournalEntry)
+		{
+			PendingScan p;
+			ds >> p.header >> p.fid;
+			if(ds.status() != QDataStream::Ok)
+				break;
+			pending.insert(num,p);
+		}
+		else if(type == JournalRawEntry)
+		{
+			PendingScan p;
+			ds >> p.header >> p.rawFid;
+			if(ds.status() != QDataStream::Ok)
+				break;
+			pending.insert(num,p);
+		}
+		else if(type == JournalCommit)
+		{
+			if(ds.status() != QDataStream::Ok)
+				break;
+			pending.remove(num);
+		}
+		else
+			break;
+
+		goodPos = d_journal.pos();
+	}
+
+	if(goodPos < d_journal.size())
+	{
+		emit logMessage(QString("Discarding %1 bytes of incomplete data at the end of the scan journal.").arg(d_journal.size()-goodPos),QtFTM::LogWarning);
+		d_journal.resize(goodPos);
+	}
+
+	int failed = 0;
+	for(auto it = pending.constBegin(); it != pending.constEnd(); it++)
+	{
+		Scan s = Scan::fromHeader(it.value().header,it.value().fid,it.value().rawFid);
+		if(s.number() != it.key() || !s.writeFile())
+		{
+			failed++;
+			emit logMessage(QString("Could not recover scan %1 from the journal. The journal will be kept.").arg(it.key()),QtFTM::LogError);
+			continue;
+		}
+
+		d_journal.seek(d_journal.size());
+		QDataStream out(&d_journal);
+		out.setVersion(QDataStream::Qt_5_0);
+		out << static_cast<quint8>(JournalCommit) << static_cast<qint32>(it.key());
+		emit logMessage(QString("Scan %1 was recovered from the journal.").arg(it.key()),QtFTM::LogHighlight);
+	}
+
+	syncJournal();
+	d_failedWrites = failed;
+	l.unlock();
+
+	compactJournal();
+}
+
+void ScanWriter::flush()
+{
+	compactJournal();
+}
+
+bool ScanWriter::appendEntry(const Scan &s)
+{
+	QMutexLocker l(&d_journalMutex);
+	if(!d_journal.isOpen())
+		return true;
+
+	d_journal.seek(d_journal.size());
+	QDataStream ds(&d_journal);
+	ds.setVersion(QDataStream::Qt_5_0);
+	//a compressed raw sum is smaller than the voltages, and preserves the exact data
+	if(s.fid().hasRawSum())
+		ds << static_cast<quint8>(JournalRawEntry) << static_cast<qint32>(s.number()) << s.scanHeader() << FidCodec::encode(s.fid());
+	else
+		ds << static_cast<quint8>(JournalEntry) << static_cast<qint32>(s.number()) << s.scanHeader() << s.fid().toVector();
+	if(ds.status() != QDataStream::Ok)
+	{
+		emit logMessage(QString("Could not write scan %1 to the journal.").arg(s.number()),QtFTM::LogError);
+		return false;
+	}
+
+	return syncJournal();
+}
+
+void ScanWriter::appendCommit(int num)
+{
+	QMutexLocker l(&d_journalMutex);
+	if(!d_journal.isOpen())
+		return;
+
+	d_journal.seek(d_journal.size());
+	QDataStream ds(&d_journal);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds << static_cast<quint8>(JournalCommit) << static_cast<qint32>(num);
+	syncJournal();
+}
+
+bool ScanWriter::syncJournal()
+{
+	//must be called with the journal mutex locked
+	if(!d_journal.flush())
+		return false;
+#ifdef Q_OS_UNIX
+	if(fsync(d_journal.handle()) != 0)
+		return false;
+#endif
+	return true;
+}
+
+void ScanWriter::compactJournal()
+{
+	//once every journaled scan is on disk, the journal can be emptied.
+	//A scan that has been submitted holds a slot before it is journaled, so it cannot be lost here
+	QMutexLocker l(&d_journalMutex);
+	if(!d_journal.isOpen() || d_failedWrites > 0 || d_slots.available() < d_capacity || d_journal.size() == 0)
+		return;
+
+	d_journal.resize(0);
+	syncJournal();
+}
+
+void ScanWriter::writeScan(const Scan s)
+{
+	bool success = s.writeFile();
+	if(success)
+		appendCommit(s.number());
+	else
+	{
+		QMutexLocker l(&d_journalMutex);
+		d_failedWrites++;
+		l.unlock();
+		emit logMessage(QString("Could not write file for scan %1. It will be recovered from the journal the next time the program is started.")
+					 .arg(s.number()),QtFTM::LogError);
+	}
+
+	d_slots.release();
+	emit scanSaved(s.number(),success);
+	compactJournal();
+}
@@ -0,0 +1,82 @@
+#ifndef SCANWRITER_H
+#define SCANWRITER_H
+
+#include <QObject>
+#include <QFile>
+#include <QMutex>
+#include <QSemaphore>
+
+#include "datastructs.h"
+#include "scan.h"
+
+/*!
+ * \brief Writes scan files on a separate thread
+ *
+ * Writing a scan file involves formatting every point of the FID and syncing the file to disk, which can take a noticeable amount of time when the save path is on a network drive.
+ * The ScanManager hands completed scans to the writer with submit(), and can continue immediately with the next scan.
+ *
+ * Before submit() returns, the scan is appended to a journal on the local disk (next to the settings file), and the journal is synced.
+ * The scan is then queued, and the writer thread writes the scan file (see Scan::writeFile()), records the completion in the journal, and emits scanSaved().
+ * When the queue is empty and no write has failed, the journal is truncated.
+ * If the program exits or crashes while scans are queued, or if a write fails, the scans are written from the journal the next time recoverJournal() is called.
+ *
+ * The queue is bounded; if d_capacity scans are waiting, submit() blocks until the writer catches up.
+ */
+class ScanWriter : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ScanWriter(int capacity = 16, QObject *parent = nullptr);
+	~ScanWriter();
+
+	/*!
+	 * \brief Journals a scan and queues it for writing. Thread-safe.
+	 * \param s The scan. A number must already have been assigned (see Scan::allocateNumber())
+	 * \return True if the scan was journaled and queued
+	 */
+	bool submit(const Scan s);
+	int pendingScans() const { return d_capacity - d_slots.available(); }
+
+signals:
+	void logMessage(const QString, const QtFTM::LogMessageCode = QtFTM::LogNormal);
+	/*!
+	 * \brief Emitted when a queued scan has been written and synced to disk
+	 * \param num Scan number
+	 * \param success Whether the file was written
+	 */
+	void scanSaved(int num, bool success);
+
+public slots:
+	/*!
+	 * \brief Writes any scans that are in the journal but were not completed
+	 */
+	void recoverJournal();
+	/*!
+	 * \brief Called after all previously queued scans have been processed; truncates the journal if possible
+	 */
+	void flush();
+
+private:
+	enum JournalRecord {
+		JournalEntry = 1,
+		JournalCommit = 2,
+		JournalRawEntry = 3 /*!< Like JournalEntry, but the FID is stored as a FidCodec block */
+	};
+
+	const int d_capacity;
+	QSemaphore d_slots;
+	QMutex d_journalMutex;
+	QFile d_journal;
+	int d_failedWrites;
+
+	bool appendEntry(const Scan &s);
+	void appendCommit(int num);
+	bool syncJournal();
+	void compactJournal();
+
+private slots:
+	void writeScan(const Scan s);
+
+};
+
+#endif // SCANWRITER_H
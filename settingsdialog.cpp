@@ -3,6 +3,8 @@
 #include <QDialogButtonBox>
 #include <QPushButton>
 
+#include "configservice.h"
+
 SettingsDialog::SettingsDialog(SettingsWidget *w, QWidget *parent) :
 	QDialog(parent)
 {
@@ -23,12 +25,14 @@ SettingsDialog::SettingsDialog(SettingsWidget *w, QWidget *parent) :
 	connect(w,&SettingsWidget::somethingChanged,bb->button(QDialogButtonBox::RestoreDefaults),&QWidget::setEnabled);
 	connect(w,&SettingsWidget::somethingChanged,bb->button(QDialogButtonBox::Apply),&QWidget::setEnabled);
 	connect(bb,&QDialogButtonBox::accepted,w,&SettingsWidget::saveSettings);
+	connect(bb,&QDialogButtonBox::accepted,&ConfigService::instance(),&ConfigService::reload);
 	connect(bb->button(QDialogButtonBox::RestoreDefaults),&QAbstractButton::clicked,w,&SettingsWidget::loadSettings);
 	connect(bb->button(QDialogButtonBox::RestoreDefaults),&QAbstractButton::clicked,
 		   bb->button(QDialogButtonBox::RestoreDefaults),&QWidget::setEnabled);
 	connect(bb->button(QDialogButtonBox::RestoreDefaults),&QAbstractButton::clicked,
 		   bb->button(QDialogButtonBox::Apply),&QWidget::setEnabled);
 	connect(bb->button(QDialogButtonBox::Apply),&QAbstractButton::clicked,w,&SettingsWidget::saveSettings);
+	connect(bb->button(QDialogButtonBox::Apply),&QAbstractButton::clicked,&ConfigService::instance(),&ConfigService::reload);
 	connect(bb->button(QDialogButtonBox::Apply),&QAbstractButton::clicked,
 		   bb->button(QDialogButtonBox::Apply),&QWidget::setEnabled);
 	connect(bb->button(QDialogButtonBox::Apply),&QAbstractButton::clicked,
@@ -0,0 +1,168 @@
+#include "spectrumstore.h"
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#include "configservice.h"
+
+SpectrumStore::SpectrumStore() : d_fileOk(false), d_size(0), d_fileTiles(0), d_useCounter(0), d_lastTile(-1), p_lastTileData(nullptr)
+{
+	int mb = ConfigService::instance().snapshot().value(QString("spectrumResidentMB"),64).toInt();
+	d_maxResident = qMax(2,(mb*1024*1024)/(tileSize*static_cast<int>(sizeof(QPointF))));
+
+	d_file.setFileTemplate(QDir::tempPath() + QString("/qtftm-spectrum-XXXXXX"));
+	d_fileOk = d_file.open();
+
+	d_tail.reserve(tileSize);
+	d_emptyTile.fill(QPointF(),tileSize);
+}
+
+void SpectrumStore::append(const QVector<QPointF> d)
+{
+	QMutexLocker l(&d_mutex);
+	int i = 0;
+	while(i < d.size())
+	{
+		int n = qMin(d.size() - i,tileSize - d_tail.size());
+		d_tail.append(d.mid(i,n));
+		i += n;
+		d_size += n;
+
+		if(d_tail.size() == tileSize)
+			writeTail();
+	}
+}
+
+int SpectrumStore::size() const
+{
+	QMutexLocker l(&d_mutex);
+	return d_size;
+}
+
+QPointF SpectrumStore::at(int i) const
+{
+	QMutexLocker l(&d_mutex);
+	if(i < 0 || i >= d_size)
+		return QPointF();
+
+	return tileData(i >> tileShift)[i & (tileSize-1)];
+}
+
+QVector<QPointF> SpectrumStore::read(int first, int count) const
+{
+	QMutexLocker l(&d_mutex);
+	first = qMax(first,0);
+	count = qMin(count,d_size - first);
+
+	QVector<QPointF> out;
+	if(count <= 0)
+		return out;
+
+	out.resize(count);
+	int i = 0;
+	while(i < count)
+	{
+		int index = first + i;
+		int offset = index & (tileSize-1);
+		int n = qMin(count - i,tileSize - offset);
+		const QPointF *t = tileData(index >> tileShift);
+		std::copy(t + offset,t + offset + n,out.data() + i);
+		i += n;
+	}
+
+	return out;
+}
+
+const QPointF *SpectrumStore::tileData(int tile) const
+{
+	//must be called with the mutex locked
+	int complete = d_fileTiles + d_memoryTiles.size();
+	if(tile >= complete)
+		return d_tail.constData();
+
+	if(tile >= d_fileTiles)
+		return d_memoryTiles.at(tile - d_fileTiles).constData();
+
+	d_useCounter++;
+	if(tile == d_lastTile)
+	{
+		d_mapped[tile].lastUsed = d_useCounter;
+		return p_lastTileData;
+	}
+
+	auto it = d_mapped.find(tile);
+	if(it == d_mapped.end())
+	{
+		if(d_mapped.size() >= d_maxResident)
+		{
+			//unmap the least recently used tile
+			auto lru = d_mapped.begin();
+			for(auto j = d_mapped.begin(); j != d_mapped.end(); j++)
+			{
+				if(j.value().lastUsed < lru.value().lastUsed)
+					lru = j;
+			}
+			if(lru.key() == d_lastTile)
+				d_lastTile = -1;
+			if(lru.value().copy.isEmpty())
+				d_file.unmap(reinterpret_cast<uchar*>(const_cast<QPointF*>(lru.value().data)));
+			d_mapped.erase(lru);
+		}
+
+		qint64 bytes = static_cast<qint64>(tileSize)*static_cast<qint64>(sizeof(QPointF));
+		Tile t;
+		t.lastUsed = d_useCounter;
+		uchar *p = d_file.map(static_cast<qint64>(tile)*bytes,bytes);
+		if(p != nullptr)
+			t.data = reinterpret_cast<const QPointF*>(p);
+		else
+		{
+			//read the tile instead. The file position is restored by writeTail()
+			t.copy.resize(tileSize);
+			if(!d_file.seek(static_cast<qint64>(tile)*bytes) || d_file.read(reinterpret_cast<char*>(t.copy.data()),bytes) != bytes)
+			{
+				d_lastTile = -1;
+				return d_emptyTile.constData();
+			}
+			t.data = t.copy.constData();
+		}
+		//the copy in the hash shares the buffer that data points to
+		it = d_mapped.insert(tile,t);
+	}
+	else
+		it.value().lastUsed = d_useCounter;
+
+	d_lastTile = tile;
+	p_lastTileData = it.value().data;
+	return p_lastTileData;
+}
+
+void SpectrumStore::writeTail()
+{
+	//must be called with the mutex locked
+	//once a tile has been kept in memory, later tiles are kept in memory too, so that the tiles in the file stay contiguous
+	qint64 bytes = static_cast<qint64>(d_tail.size())*static_cast<qint64>(sizeof(QPointF));
+	if(d_fileOk && d_memoryTiles.isEmpty())
+	{
+		//tiles may have been read since the last write, which moves the file position
+		if(d_file.seek(static_cast<qint64>(d_fileTiles)*bytes) && d_file.write(reinterpret_cast<const char*>(d_tail.constData()),bytes) == bytes && d_file.flush())
+		{
+			uchar *p = d_file.map(static_cast<qint64>(d_fileTiles)*bytes,bytes);
+			if(p != nullptr)
+			{
+				d_file.unmap(p);
+				d_fileTiles++;
+				d_tail.clear();
+				return;
+			}
+		}
+
+		d_fileOk = false;
+	}
+
+	d_memoryTiles.append(d_tail);
+	d_tail.clear();
+	d_tail.reserve(tileSize);
+}
@@ -0,0 +1,70 @@
+#ifndef SPECTRUMSTORE_H
+#define SPECTRUMSTORE_H
+
+#include <QVector>
+#include <QPointF>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QTemporaryFile>
+
+/*!
+ * \brief Append-only list of points kept in a memory-mapped temporary file
+ *
+ * A long survey produces far more spectrum points than should be kept in memory, and both the BatchSurvey and the SurveyPlot need all of them.
+ * The batch appends each chunk to a store, and the plot reads from the same store (it is shared with QSharedPointer), so only one copy of the spectrum exists, and most of it is on disk.
+ *
+ * Points are grouped in tiles of tileSize points. Complete tiles are written to the file, and are mapped into memory when they are read.
+ * At most a fixed number of tiles stay mapped (setting spectrumResidentMB, default 64); the least recently used tile is unmapped first.
+ * If a tile cannot be mapped (e.g., no address space is left), it is read from the file into memory instead, and counts against the same limit.
+ * The last, incomplete tile is kept in memory.
+ *
+ * All functions are thread-safe.
+ * If the temporary file cannot be created, or a tile cannot be written or mapped, the points are kept in memory instead, so the store always works.
+ */
+class SpectrumStore
+{
+public:
+	SpectrumStore();
+
+	void append(const QVector<QPointF> d);
+	int size() const;
+	bool isEmpty() const { return size() == 0; }
+	QPointF at(int i) const;
+	QPointF first() const { return at(0); }
+	QPointF last() const { return at(size()-1); }
+	/*!
+	 * \brief Copies points first to first+count-1 (or to the end of the store)
+	 */
+	QVector<QPointF> read(int first, int count) const;
+
+private:
+	static const int tileShift = 16;
+	static const int tileSize = 1 << tileShift;
+
+	struct Tile {
+		const QPointF *data; /*!< Points into the mapping, or into copy */
+		QVector<QPointF> copy; /*!< Holds the tile if it could not be mapped */
+		quint64 lastUsed;
+	};
+
+	mutable QMutex d_mutex;
+	mutable QTemporaryFile d_file;
+	bool d_fileOk;
+	int d_size;
+	int d_maxResident;
+
+	QVector<QPointF> d_tail; /*!< Points after the last complete tile */
+	QList<QVector<QPointF>> d_memoryTiles; /*!< Complete tiles that could not be written to the file */
+	int d_fileTiles; /*!< Number of complete tiles in the file */
+	mutable QHash<int,Tile> d_mapped;
+	mutable quint64 d_useCounter;
+	mutable int d_lastTile;
+	mutable const QPointF *p_lastTileData;
+	QVector<QPointF> d_emptyTile; /*!< Returned if a tile can be neither mapped nor read */
+
+	const QPointF *tileData(int tile) const;
+	void writeTail();
+};
+
+#endif // SPECTRUMSTORE_H
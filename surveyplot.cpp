@@ -1,9 +1,34 @@
 #include "surveyplot.h"
 
 #include <qwt6/qwt_symbol.h>
+#include <qwt6/qwt_series_data.h>
+
+namespace {
+
+//gives the curve direct access to the points in a store
+class SpectrumSeriesData : public QwtSeriesData<QPointF>
+{
+public:
+    explicit SpectrumSeriesData(QSharedPointer<SpectrumStore> s) : p_store(s), d_size(s->size()) {}
+
+    size_t size() const { return static_cast<size_t>(d_size); }
+    QPointF sample(size_t i) const { return p_store->at(static_cast<int>(i)); }
+    QRectF boundingRect() const
+    {
+        if(d_boundingRect.width() < 0.0)
+            d_boundingRect = qwtBoundingRect(*this);
+        return d_boundingRect;
+    }
+
+private:
+    QSharedPointer<SpectrumStore> p_store;
+    int d_size;
+};
+
+}
 
 SurveyPlot::SurveyPlot(int num, QWidget *parent) :
-    AbstractBatchPlot(QString("surveyPlot"),parent)
+    AbstractBatchPlot(QString("surveyPlot"),parent), d_ownStore(false)
 {
     QFont labelFont(QString("sans serif"),8);
     QwtText plotTitle(QString("Survey %1").arg(num));
@@ -16,6 +41,12 @@ SurveyPlot::SurveyPlot(int num, QWidget *parent) :
 }
 
 
+void SurveyPlot::setSpectrumStore(QSharedPointer<SpectrumStore> s)
+{
+    d_curveStore = s;
+    d_ownStore = false;
+}
+
 void SurveyPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF> > d)
 {
     if(d_metaDataList.isEmpty())
@@ -31,7 +62,7 @@ void SurveyPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF>
         p_calCurve->setSymbol(new QwtSymbol(QwtSymbol::Ellipse,QBrush(highlight),QPen(highlight),QSize(5,5)));
 
         //for a survey, there will only be one data curve
-        QwtPlotCurve *curve = new QwtPlotCurve(QString("Survey"));
+        QwtPlotCurve *curve = new RasterCurve(QString("Survey"));
         curve->setPen(QPen(QPalette().color(QPalette::Text)));
         curve->setRenderHint(QwtPlotItem::RenderAntialiased);
         d_plotCurves.append(curve);
@@ -40,7 +71,7 @@ void SurveyPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF>
         pcmd.curve = curve;
         pcmd.visible = true;
         pcmd.yMin = 0.0;
-        pcmd.yMax = d.first().at(0).y();
+        pcmd.yMax = d.first().isEmpty() ? 0.0 : d.first().at(0).y();
         d_plotCurveMetaData.append(pcmd);
 
         p_calCurve->attach(this);
@@ -64,16 +95,22 @@ void SurveyPlot::receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF>
     }
     else
     {
+        //d only contains the new chunk. The whole survey is in the store shared with the BatchSurvey
+        if(d_curveStore.isNull())
+        {
+            d_curveStore = QSharedPointer<SpectrumStore>(new SpectrumStore);
+            d_ownStore = true;
+        }
+        if(d_ownStore)
+            d_curveStore->append(d.at(0));
+
         double max = 0.0;
-        for(int i=d_plotCurveData.at(0).size(); i<d.at(0).size(); i++)
+        for(int i=0; i<d.at(0).size(); i++)
             max = qMax(max,d.at(0).at(i).y());
 
         d_plotCurveMetaData[0].yMax = qMax(max,d_plotCurveMetaData.at(0).yMax);
         expandAutoScaleRange(QwtPlot::yLeft,0.0,max);
         expandAutoScaleRange(QwtPlot::xBottom,md.minXVal,md.maxXVal);
-
-        d_plotCurves[0]->setSamples(d.at(0));
-        d_plotCurveData = d;
     }
 
     d_metaDataList.append(md);
@@ -349,8 +386,9 @@ void SurveyPlot::print()
     setAxisScale(QwtPlot::yLeft,yMin,yMax);
 
 
-    //un-filter data
-    d_plotCurves[0]->setSamples(d_plotCurveData.at(0));
+    //un-filter data; the points are read from the store while the curve is drawn
+    if(!d_curveStore.isNull())
+        d_plotCurves[0]->setData(new SpectrumSeriesData(d_curveStore));
 
     //hide zone
     bool zoneWasVisible = p_selectedZone->isVisible();
@@ -9,11 +9,21 @@ class SurveyPlot : public AbstractBatchPlot
 public:
     explicit SurveyPlot(int num, QWidget *parent = nullptr);
 
+    /*!
+     \brief Reads the survey from the store that the BatchSurvey writes to (see BatchSurvey::spectrumStore())
+
+     If no store is set, the plot keeps its own store, and appends the chunks it receives to it.
+    */
+    void setSpectrumStore(QSharedPointer<SpectrumStore> s);
+
     // AbstractBatchPlot interface
 public slots:
     void receiveData(QtFTM::BatchPlotMetaData md, QList<QVector<QPointF> > d);
     void print();
 
+private:
+    bool d_ownStore;
+
 };
 
 #endif // SURVEYPLOT_H
@@ -0,0 +1,128 @@
+#include "surveystitcher.h"
+
+#include <math.h>
+#include <algorithm>
+
+SurveyStitcher::SurveyStitcher(double halfWidth, double cavityFwhm, bool descending) :
+	d_halfWidth(halfWidth), d_fwhm(cavityFwhm), d_direction(descending ? -1.0 : 1.0), d_gridSet(false),
+	d_origin(0.0), d_spacing(1.0), d_firstOpen(0)
+{
+	if(d_fwhm <= 0.0)
+		d_fwhm = 1.0;
+}
+
+void SurveyStitcher::addScan(const QVector<QPointF> ft, double cavityFreq, int shots)
+{
+	if(ft.size() < 2)
+		return;
+
+	//the grid is the point spacing of the first scan, with a bin on its first usable point
+	if(!d_gridSet)
+	{
+		d_spacing = fabs(ft.at(1).x() - ft.at(0).x());
+		if(d_spacing <= 0.0)
+			return;
+
+		d_origin = d_direction > 0.0 ? cavityFreq - d_halfWidth : cavityFreq + d_halfWidth;
+		d_gridSet = true;
+	}
+
+	//noise estimate: the median intensity is dominated by the noise floor unless most of the band contains lines
+	QVector<double> usable;
+	usable.reserve(ft.size());
+	for(int i=0; i<ft.size(); i++)
+	{
+		if(fabs(ft.at(i).x() - cavityFreq) <= d_halfWidth)
+			usable.append(fabs(ft.at(i).y()));
+	}
+	if(usable.isEmpty())
+		return;
+
+	std::nth_element(usable.begin(),usable.begin() + usable.size()/2,usable.end());
+	double sigma = usable.at(usable.size()/2);
+	if(sigma <= 0.0)
+		sigma = 1.0;
+
+	for(int i=0; i<ft.size(); i++)
+	{
+		double x = ft.at(i).x();
+		double detuning = x - cavityFreq;
+		if(fabs(detuning) > d_halfWidth)
+			continue;
+
+		double u = binPosition(x);
+		qint64 k = static_cast<qint64>(floor(u));
+		double f = u - static_cast<double>(k);
+
+		//bins that were already finished cannot change
+		if(k < d_firstOpen)
+			continue;
+
+		qint64 needed = k + 2 - d_firstOpen;
+		if(needed > d_open.size())
+			d_open.resize(static_cast<int>(needed));
+
+		double r = 1.0/(1.0 + (2.0*detuning/d_fwhm)*(2.0*detuning/d_fwhm));
+		double w = r*r/(sigma*sigma);
+		double y = ft.at(i).y()/r;
+
+		Accumulator &a = d_open[static_cast<int>(k - d_firstOpen)];
+		a.weight += (1.0-f)*w;
+		a.weightedY += (1.0-f)*w*y;
+		a.shots += (1.0-f)*static_cast<double>(shots)*r*r;
+
+		Accumulator &b = d_open[static_cast<int>(k + 1 - d_firstOpen)];
+		b.weight += f*w;
+		b.weightedY += f*w*y;
+		b.shots += f*static_cast<double>(shots)*r*r;
+	}
+}
+
+QVector<SurveyStitcher::Bin> SurveyStitcher::takeFinished(double nextCavityFreq)
+{
+	if(!d_gridSet)
+		return QVector<Bin>();
+
+	//the lowest bin a later scan can reach
+	double edge = nextCavityFreq - d_direction*d_halfWidth;
+	qint64 limit = static_cast<qint64>(floor(binPosition(edge)));
+
+	return take(qMin(limit - d_firstOpen,static_cast<qint64>(d_open.size())));
+}
+
+QVector<SurveyStitcher::Bin> SurveyStitcher::takeAll()
+{
+	return take(d_open.size());
+}
+
+QVector<SurveyStitcher::Bin> SurveyStitcher::take(qint64 count)
+{
+	QVector<Bin> out;
+	if(count <= 0)
+		return out;
+
+	out.reserve(static_cast<int>(count));
+	for(int i=0; i<count; i++)
+	{
+		//bins in gaps between scans have no data, and are left out
+		const Accumulator &a = d_open.at(i);
+		if(a.weight <= 0.0)
+			continue;
+
+		Bin b;
+		b.x = d_origin + d_direction*static_cast<double>(d_firstOpen + i)*d_spacing;
+		b.y = a.weightedY/a.weight;
+		b.shots = a.shots;
+		out.append(b);
+	}
+
+	d_open.remove(0,static_cast<int>(count));
+	d_firstOpen += count;
+	return out;
+}
+
+double SurveyStitcher::binPosition(double x) const
+{
+	//bin coordinates increase in the direction of the survey
+	return d_direction*(x - d_origin)/d_spacing;
+}
@@ -0,0 +1,81 @@
+#ifndef SURVEYSTITCHER_H
+#define SURVEYSTITCHER_H
+
+#include <QVector>
+#include <QPointF>
+
+/*!
+ * \brief Combines the overlapping parts of consecutive survey scans into one spectrum
+ *
+ * Each survey scan covers the band within halfWidth of its cavity frequency.
+ * When halfWidth is larger than half the step size, neighbouring scans overlap, and every frequency is measured by several scans.
+ * The stitcher co-adds them on a common grid (the point spacing of the first scan), so the extra measurements improve the signal-to-noise ratio instead of being discarded.
+ *
+ * A point measured at detuning d from the cavity frequency is attenuated by the cavity response R(d) = 1/(1+(2d/fwhm)^2), and its noise is estimated from the median intensity of its scan (sigma).
+ * The point is corrected to R = 1 and added with the inverse-variance weight w = R^2/sigma^2, so points far from the cavity frequency and noisy scans count less.
+ * Each point is shared between the two nearest grid bins by linear interpolation.
+ *
+ * The effective number of shots of a bin is the sum of shots*R^2 over its contributions: the number of shots at the cavity frequency that would give the same signal-to-noise ratio.
+ *
+ * Scans must arrive in the order of the survey (increasing or decreasing frequency).
+ * takeFinished() returns the bins that no later scan can reach, so the spectrum can be written and plotted as the survey runs; only the bins within reach of the next scan are kept in memory.
+ */
+class SurveyStitcher
+{
+public:
+	struct Bin {
+		double x;
+		double y;
+		double shots; /*!< Effective number of shots */
+	};
+
+	/*!
+	 * \param halfWidth Usable half-width of each scan around the cavity frequency (MHz)
+	 * \param cavityFwhm Full width at half maximum of the cavity response (MHz)
+	 * \param descending Whether the survey steps down in frequency
+	 */
+	SurveyStitcher(double halfWidth = 0.0, double cavityFwhm = 1.0, bool descending = false);
+
+	/*!
+	 * \brief Adds the part of an FT within halfWidth of the cavity frequency
+	 * \param ft FT of the scan
+	 * \param cavityFreq Cavity frequency of the scan (MHz)
+	 * \param shots Number of shots
+	 */
+	void addScan(const QVector<QPointF> ft, double cavityFreq, int shots);
+	/*!
+	 * \brief Removes and returns the bins that cannot receive contributions from a scan whose cavity frequency is beyond nextCavityFreq
+	 */
+	QVector<Bin> takeFinished(double nextCavityFreq);
+	/*!
+	 * \brief Removes and returns all remaining bins (the survey is complete)
+	 */
+	QVector<Bin> takeAll();
+
+	double halfWidth() const { return d_halfWidth; }
+	double cavityFwhm() const { return d_fwhm; }
+
+private:
+	struct Accumulator {
+		double weight;
+		double weightedY;
+		double shots;
+
+		Accumulator() : weight(0.0), weightedY(0.0), shots(0.0) {}
+	};
+
+	double d_halfWidth;
+	double d_fwhm;
+	double d_direction;
+	bool d_gridSet;
+	double d_origin;
+	double d_spacing;
+
+	QVector<Accumulator> d_open; /*!< Bins that may still change; d_open[0] is bin d_firstOpen */
+	qint64 d_firstOpen;
+
+	QVector<Bin> take(qint64 count);
+	double binPosition(double x) const;
+};
+
+#endif // SURVEYSTITCHER_H
@@ -3,6 +3,8 @@
 #include <QApplication>
 #include <QVBoxLayout>
 
+#include "numberallocator.h"
+
 SurveySummaryPage::SurveySummaryPage(QWidget *parent) :
      QWizardPage(parent)
 {
@@ -30,11 +32,9 @@ int SurveySummaryPage::nextId() const
 
 void SurveySummaryPage::initializePage()
 {
-	QSettings s(QSettings::SystemScope,QApplication::organizationName(),QApplication::applicationName());
-
 	//get settings and show them
-	int surveyNum = s.value("surveyNum",1).toInt();
-	int firstScanNum = s.value("scanNum",0).toInt()+1;
+	int surveyNum = NumberAllocator::instance().next(QString("surveyNum"));
+	int firstScanNum = NumberAllocator::instance().lastScanNumber()+1;
 	bool hasCal = field(QString("surveyCal")).toBool();
 	double start = field(QString("surveyStart")).toDouble();
 	double stop = field(QString("surveyStop")).toDouble();
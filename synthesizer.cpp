@@ -1,5 +1,9 @@
 #include "synthesizer.h"
 
+#include <QPointer>
+
+#include "gpibinstrument.h"
+
 Synthesizer::Synthesizer(QObject *parent) :
     HardwareObject(parent), d_mult(1.0), d_offset(0.0), d_hardwareMinFreq(50), d_hardwareMaxFreq(26500)
 {
@@ -96,6 +100,25 @@ double Synthesizer::readPower()
     return p;
 }
 
+void Synthesizer::pollStatus()
+{
+    GpibInstrument *gi = qobject_cast<GpibInstrument*>(p_comm);
+    if(gi == nullptr)
+    {
+        readFreq();
+        readPower();
+        return;
+    }
+
+    QPointer<Synthesizer> self(this);
+    gi->callQueued([self](){
+        if(self.isNull())
+            return;
+        self->readFreq();
+        self->readPower();
+    },GpibController::StatusPoll);
+}
+
 double Synthesizer::setPower(double p)
 {
     if(p < d_hardwareMinPower || p > d_hardwareMaxPower)
@@ -25,6 +25,11 @@ public slots:
     double readPower();
     double setPower(double p);
 
+    /*!
+     * \brief Reads the frequency and power. On a GPIB bus, the reads are queued as a StatusPoll transaction.
+     */
+    void pollStatus();
+
 
 protected:
     virtual double realToRaw(double f);
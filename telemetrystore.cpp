@@ -0,0 +1,339 @@
+#include "telemetrystore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include "configservice.h"
+
+namespace {
+
+const quint32 telemetryMagic = 0x314d4c54; //"TLM1"
+
+const int rawCapacity = 4096;
+const int secondsCapacity = 6*3600;
+const int minutesCapacity = 30*1440;
+
+}
+
+TelemetryStore &TelemetryStore::instance()
+{
+	static TelemetryStore store;
+	return store;
+}
+
+TelemetryStore::TelemetryStore() : d_loaded(false)
+{
+	d_fileName = ConfigService::instance().snapshot().savePath() + QString("/telemetry/history.dat");
+}
+
+TelemetryStore::~TelemetryStore()
+{
+	save();
+}
+
+void TelemetryStore::append(const QString channel, double value)
+{
+	append(channel,value,QDateTime::currentMSecsSinceEpoch());
+}
+
+void TelemetryStore::append(const QString channel, double value, qint64 time)
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	Channel &c = d_channels[channel];
+	Point p;
+	p.time = time;
+	p.mean = value;
+	p.min = value;
+	p.max = value;
+	p.count = 1;
+	c.levels[Raw].append(p);
+
+	//when a new second starts, the last one is added to the seconds ring and to the open minute
+	Point &s = c.open[0];
+	qint64 secondStart = time - time%interval(Seconds);
+	if(s.count > 0 && s.time != secondStart)
+	{
+		c.levels[Seconds].append(s);
+
+		Point &m = c.open[1];
+		qint64 minuteStart = s.time - s.time%interval(Minutes);
+		if(m.count > 0 && m.time != minuteStart)
+		{
+			c.levels[Minutes].append(m);
+			m.count = 0;
+		}
+
+		if(m.count == 0)
+		{
+			m = s;
+			m.time = minuteStart;
+		}
+		else
+			addToAggregate(m,s);
+
+		s.count = 0;
+	}
+
+	if(s.count == 0)
+	{
+		s = p;
+		s.time = secondStart;
+	}
+	else
+		addToAggregate(s,p);
+}
+
+QVector<TelemetryStore::Point> TelemetryStore::history(const QString channel, qint64 from, qint64 to, int maxPoints)
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	QVector<Point> out;
+	if(!d_channels.contains(channel) || to < from)
+		return out;
+
+	const Channel &c = d_channels[channel];
+
+	//a ring "reaches" from if it holds data that old, or if no ring holds older data than it does
+	qint64 oldest = to;
+	for(int i=Raw; i<=Minutes; i++)
+	{
+		if(c.levels[i].size() > 0)
+			oldest = qMin(oldest,c.levels[i].at(0).time);
+	}
+	qint64 reach = qMax(from,oldest);
+
+	int level = -1, first = 0, last = 0;
+	for(int i=Raw; i<=Minutes; i++)
+	{
+		const Ring &r = c.levels[i];
+		if(r.size() == 0)
+			continue;
+
+		level = i;
+		first = r.lowerBound(from);
+		last = r.lowerBound(to+1);
+		if(r.at(0).time <= reach && last - first <= maxPoints)
+			break;
+	}
+
+	if(level < 0)
+		return out;
+
+	const Ring &r = c.levels[level];
+	out.reserve(last-first+1);
+	for(int i=first; i<last; i++)
+		out.append(r.at(i));
+
+	//the open aggregate holds the most recent readings
+	if(level != Raw)
+	{
+		const Point &o = c.open[level-1];
+		if(o.count > 0 && o.time >= from && o.time <= to)
+			out.append(o);
+	}
+
+	if(maxPoints > 0 && out.size() > maxPoints)
+	{
+		int group = (out.size() + maxPoints - 1)/maxPoints;
+		QVector<Point> merged;
+		merged.reserve(maxPoints);
+		for(int i=0; i<out.size(); i++)
+		{
+			if(i%group == 0)
+				merged.append(out.at(i));
+			else
+				addToAggregate(merged.last(),out.at(i));
+		}
+		out = merged;
+	}
+
+	return out;
+}
+
+QStringList TelemetryStore::channels()
+{
+	QMutexLocker l(&d_mutex);
+	if(!d_loaded)
+		load();
+
+	QStringList out = d_channels.keys();
+	out.sort();
+	return out;
+}
+
+bool TelemetryStore::save()
+{
+	QMutexLocker sl(&d_saveMutex);
+
+	QStringList names;
+	{
+		QMutexLocker l(&d_mutex);
+		if(!d_loaded)
+			return true;
+		names = d_channels.keys();
+	}
+
+	if(names.isEmpty())
+		return true;
+
+	//each channel is serialized with the mutex held, one at a time, so append() waits for at most one channel.
+	//Copying the rings instead would make the next append() on each device thread detach and copy them
+	QByteArray data;
+	QDataStream ds(&data,QIODevice::WriteOnly);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+	ds << telemetryMagic << static_cast<qint32>(names.size());
+	for(int n=0; n<names.size(); n++)
+	{
+		ds << names.at(n);
+
+		QMutexLocker l(&d_mutex);
+		const Channel &c = d_channels[names.at(n)];
+		for(int i=Raw; i<=Minutes; i++)
+		{
+			const Ring &r = c.levels[i];
+			ds << static_cast<qint32>(r.size());
+			for(int j=0; j<r.size(); j++)
+			{
+				const Point &p = r.at(j);
+				ds << p.time << p.mean << p.min << p.max << p.count;
+			}
+		}
+	}
+
+	if(ds.status() != QDataStream::Ok)
+		return false;
+
+	QDir d = QFileInfo(d_fileName).absoluteDir();
+	if(!d.exists() && !d.mkpath(d.absolutePath()))
+		return false;
+
+	QSaveFile f(d_fileName);
+	if(!f.open(QIODevice::WriteOnly))
+		return false;
+
+	if(f.write(data) != data.size())
+	{
+		f.cancelWriting();
+		return false;
+	}
+
+	return f.commit();
+}
+
+qint64 TelemetryStore::interval(TelemetryStore::Resolution r)
+{
+	switch(r)
+	{
+	case Seconds:
+		return 1000;
+	case Minutes:
+		return 60000;
+	default:
+		return 0;
+	}
+}
+
+void TelemetryStore::addToAggregate(TelemetryStore::Point &a, const TelemetryStore::Point &p)
+{
+	qint32 n = a.count + p.count;
+	a.mean = (a.mean*static_cast<double>(a.count) + p.mean*static_cast<double>(p.count))/static_cast<double>(n);
+	a.min = qMin(a.min,p.min);
+	a.max = qMax(a.max,p.max);
+	a.count = n;
+}
+
+void TelemetryStore::load()
+{
+	//must be called with the mutex locked
+	d_loaded = true;
+
+	QFile f(d_fileName);
+	if(!f.open(QIODevice::ReadOnly))
+		return;
+
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_0);
+	ds.setByteOrder(QDataStream::LittleEndian);
+
+	quint32 magic;
+	qint32 numChannels;
+	ds >> magic >> numChannels;
+	if(magic != telemetryMagic || ds.status() != QDataStream::Ok)
+		return;
+
+	for(int i=0; i<numChannels && ds.status() == QDataStream::Ok; i++)
+	{
+		QString name;
+		ds >> name;
+		Channel c;
+		for(int j=Raw; j<=Minutes; j++)
+		{
+			qint32 n;
+			ds >> n;
+			for(int k=0; k<n && ds.status() == QDataStream::Ok; k++)
+			{
+				Point p;
+				ds >> p.time >> p.mean >> p.min >> p.max >> p.count;
+				c.levels[j].append(p);
+			}
+		}
+
+		if(ds.status() == QDataStream::Ok)
+			d_channels.insert(name,c);
+	}
+}
+
+TelemetryStore::Channel::Channel()
+{
+	levels[Raw] = Ring(rawCapacity);
+	levels[Seconds] = Ring(secondsCapacity);
+	levels[Minutes] = Ring(minutesCapacity);
+	for(int i=0; i<2; i++)
+	{
+		open[i].time = 0;
+		open[i].mean = 0.0;
+		open[i].min = 0.0;
+		open[i].max = 0.0;
+		open[i].count = 0;
+	}
+}
+
+void TelemetryStore::Ring::append(const TelemetryStore::Point &p)
+{
+	if(d_capacity <= 0)
+		return;
+
+	if(d_data.size() < d_capacity)
+		d_data.append(p);
+	else
+	{
+		d_data[d_first] = p;
+		d_first = (d_first+1)%d_capacity;
+	}
+}
+
+int TelemetryStore::Ring::lowerBound(qint64 time) const
+{
+	int lo = 0, hi = size();
+	while(lo < hi)
+	{
+		int mid = lo + (hi-lo)/2;
+		if(at(mid).time < time)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
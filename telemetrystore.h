@@ -0,0 +1,104 @@
+#ifndef TELEMETRYSTORE_H
+#define TELEMETRYSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+
+/*!
+ * \brief History of pressure, flows, tuning voltage and mirror position
+ *
+ * The HardwareManager reports these values as they are read, but only the values at the end of each scan are saved (in the Scan header).
+ * The telemetry store keeps every reading of each channel at three resolutions, so that drifts can be compared with the signal over a long batch:
+ * - raw: the last rawCapacity readings
+ * - seconds: min, max, and mean over each second, for the last 6 hours
+ * - minutes: min, max, and mean over each minute, for the last 30 days
+ *
+ * Each resolution is a ring buffer with a fixed capacity, so memory use does not grow with time.
+ * append() only adds the reading to the ring and to the open aggregates, so it can be called on the device threads; it never writes to disk.
+ * history() returns the finest resolution that covers the requested range with no more than the requested number of points.
+ *
+ * The rings are saved (savePath/telemetry/history.dat) by save(), which the MainWindow calls every 10 minutes on the save thread, and when the program exits. They are read again when the store is first used.
+ * The store is thread-safe, and is accessed through instance().
+ */
+class TelemetryStore
+{
+public:
+	static TelemetryStore &instance();
+	~TelemetryStore();
+
+	enum Resolution {
+		Raw,
+		Seconds,
+		Minutes
+	};
+
+	struct Point {
+		qint64 time; /*!< Start of the interval (or time of the reading), in ms since the epoch */
+		double mean;
+		double min;
+		double max;
+		qint32 count;
+	};
+
+	/*!
+	 * \brief Adds a reading, timestamped with the current time
+	 */
+	void append(const QString channel, double value);
+	void append(const QString channel, double value, qint64 time);
+
+	/*!
+	 * \brief Returns the readings of a channel between from and to (ms since the epoch)
+	 *
+	 * The finest resolution that reaches back to from is used, unless it has more than maxPoints points in the range.
+	 * If even the minute aggregates have more than maxPoints points, neighboring points are merged.
+	 */
+	QVector<Point> history(const QString channel, qint64 from, qint64 to, int maxPoints = 2000);
+	QStringList channels();
+
+	/*!
+	 * \brief Writes all rings to disk
+	 * \return Whether the write succeeded
+	 */
+	bool save();
+
+private:
+	TelemetryStore();
+	Q_DISABLE_COPY(TelemetryStore)
+
+	class Ring {
+	public:
+		explicit Ring(int capacity = 0) : d_capacity(capacity), d_first(0) {}
+
+		int size() const { return d_data.size(); }
+		const Point &at(int i) const { return d_data.at((d_first + i) % d_data.size()); }
+		void append(const Point &p);
+		int lowerBound(qint64 time) const;
+
+	private:
+		int d_capacity;
+		int d_first; /*!< Index of the oldest point once the ring is full */
+		QVector<Point> d_data;
+	};
+
+	struct Channel {
+		Ring levels[3];
+		Point open[2]; /*!< Aggregates that are still being filled, for seconds and minutes */
+
+		Channel();
+	};
+
+	QMutex d_mutex;
+	QMutex d_saveMutex;
+	QString d_fileName;
+	bool d_loaded;
+	QHash<QString,Channel> d_channels;
+
+	static qint64 interval(Resolution r);
+	static void addToAggregate(Point &a, const Point &p);
+	void load();
+};
+
+#endif // TELEMETRYSTORE_H
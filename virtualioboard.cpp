@@ -54,5 +54,5 @@ long VirtualIOBoard::setMagnet(bool mag)
 
 void VirtualIOBoard::checkForTrigger()
 {
-	emit triggered();
+	reportTriggers(1);
 }
@@ -1,6 +1,7 @@
 #include "virtualscope.h"
 
 #include <QFile>
+#include <math.h>
 
 VirtualScope::VirtualScope(QObject *parent) :
 	Oscilloscope(parent)
@@ -40,6 +41,8 @@ void VirtualScope::initialize()
 	}
 
 	d_waveformPrefix = QByteArray("1;x;x;x;RI;LSB;x;x;x;x;5e-7;x;x;x;4.08e-3;0");
+	//averaged records are transferred with 2 bytes per point, like the real scope in averaging mode
+	d_averagedWaveformPrefix = QByteArray("2;x;x;x;RI;LSB;x;x;x;x;5e-7;x;x;x;1.59375e-5;0");
 	testConnection();
 }
 
@@ -69,22 +72,57 @@ void VirtualScope::setResolution()
 
 	for(int i=0; i<d_currentVirtualData.size(); i++)
 		d_currentVirtualData[i] = d_virtualData.at(i);
+
+	d_averages = qBound(1,s.value(QString("%1/%2/averages").arg(d_key).arg(d_subKey),1).toInt(),512);
+	d_frames = qBound(1,s.value(QString("%1/%2/frames").arg(d_key).arg(d_subKey),1).toInt(),1000);
+	if(d_averages > 1)
+		d_frames = 1;
+	d_triggerCount = 0;
 }
 
 void VirtualScope::sendCurveQuery()
 {
+	if(d_averages > 1)
+	{
+		//emulate scope-side averaging: one record for every d_averages triggers, with the noise reduced accordingly
+		d_triggerCount = 0;
+
+		double noiseScale = 1.0/sqrt(static_cast<double>(d_averages));
+		QByteArray out = QByteArray("#");
+		QByteArray numBytes = QByteArray::number(2*d_currentVirtualData.size());
+		out.append(QByteArray::number(numBytes.size())).append(numBytes);
+
+		for(int i=0; i<d_currentVirtualData.size(); i++)
+		{
+			double d = d_currentVirtualData.at(i);
+			d += noiseScale*static_cast<double>((qrand() % 200000) - 100000)/1e6;
+			qint16 dat = qBound(-32768,static_cast<int>(d/1.59375e-5),32767);
+			out.append(static_cast<char>(dat & 0xff));
+			out.append(static_cast<char>((dat >> 8) & 0xff));
+		}
+		out.append(QChar('\n'));
+
+		emit fidAcquired(d_averagedWaveformPrefix+out,d_averages);
+		return;
+	}
+
+	//in segmented mode, d_frames independent shots are concatenated in one block, like FastFrame on the real scope
+	d_triggerCount = 0;
 	QByteArray out = QByteArray("#");
-	QByteArray numBytes = QByteArray::number(d_currentVirtualData.size());
+	QByteArray numBytes = QByteArray::number(d_frames*d_currentVirtualData.size());
 	out.append(QByteArray::number(numBytes.size())).append(numBytes);
 
-	for(int i=0; i<d_currentVirtualData.size(); i++)
+	for(int j=0; j<d_frames; j++)
 	{
-		double d = d_currentVirtualData.at(i);
-		d += static_cast<double>((qrand() % 200000) - 100000)/1e6;
-		qint8 dat = qBound(-128,static_cast<int>(d/4.08e-3),127);
-		out.append(dat);
+		for(int i=0; i<d_currentVirtualData.size(); i++)
+		{
+			double d = d_currentVirtualData.at(i);
+			d += static_cast<double>((qrand() % 200000) - 100000)/1e6;
+			qint8 dat = qBound(-128,static_cast<int>(d/4.08e-3),127);
+			out.append(dat);
+		}
 	}
 	out.append(QChar('\n'));
 
-	emit fidAcquired(d_waveformPrefix+out);
+	emit fidAcquired(d_waveformPrefix+out,1,d_frames);
 }
@@ -23,6 +23,7 @@ private:
 	QVector<double> d_virtualData;
 	QVector<double> d_currentVirtualData;
 	QByteArray d_waveformPrefix;
+	QByteArray d_averagedWaveformPrefix;
 };
 
 #endif // VIRTUALSCOPE_H